@@ -44,6 +44,17 @@
 # include <signal.h>
 #endif
 
+/* the job server listens on a unix domain socket */
+#if defined (HAVE_SYS_SOCKET_H) && defined (HAVE_SYS_UN_H) && \
+    defined (HAVE_UNISTD_H) && !defined (_WIN32)
+# include <sys/types.h>
+# include <sys/socket.h>
+# include <sys/stat.h>
+# include <sys/un.h>
+# include <unistd.h>
+# define XPOST_MAIN_SERVE
+#endif
+
 #include "xpost.h"
 #include "xpost_log.h"
 #ifdef _MSC_VER
@@ -129,10 +140,12 @@ _xpost_main_usage(const char *filename)
     printf("Usage: %s [options] [file.ps]\n\n", filename);
     printf("Postscript level 2 interpreter\n\n");
     printf("Options:\n");
-    printf("  -o, --output=[FILE]                output file\n");
+    printf("  -o, --output=[FILE]                output file, %%d is the page number (png)\n");
     printf("  -d, --device=[STRING]              device name\n");
     printf("  -Dname=token, --define name=token  add definition to userdict\n");
     printf("  -g, --geometry=WxH{+-}X{+-}Y       geometry specification\n");
+    printf("  -i, --image=[FILE]                 quick-launch image of the initialized vm\n");
+    printf("  -s, --serve=[SOCKET]               run the jobs sent to a unix domain socket\n");
     printf("  -q, --quiet                        suppress interpreter messages (default)\n");
     printf("  -v, --verbose                      do not go quiet into that good night\n");
     printf("  -t, --trace                        add additional tracing messages, implies -v\n");
@@ -144,6 +157,44 @@ _xpost_main_usage(const char *filename)
     i = 0;
     while (_xpost_main_devices[i])
         printf("\t%s\n", _xpost_main_devices[i++]);
+#ifdef XPOST_MAIN_SERVE
+    printf("\n");
+    printf("  Jobs sent to the socket of --serve, one per connection:\n");
+    printf("\tdevice NAME        device of the job [default=-d]\n");
+    printf("\toutput FILE        output file of the job [default=-o]\n");
+    printf("\t                   required by png, pgm and ppm\n");
+    printf("\tdefine name=token  add definition to userdict, after the -D ones\n");
+    printf("\tgeometry WxH+X+Y   geometry specification\n");
+    printf("\tquit               stop the server after the job\n");
+    printf("\tan empty line, then the program until the end of the sending side.\n");
+    printf("\tWhat the job writes to stdout is sent back.\n");
+    printf("\tOnly the owner of the server can connect: a job can read,\n");
+    printf("\twrite and delete any file the server can.\n");
+#endif
+}
+
+/* tell if the device, with a mode selector or not, is supported */
+static int
+_xpost_main_device_check(const char *device)
+{
+    char *devstr = strdup(device);
+    char *subdevice;
+    int i;
+
+    if (!devstr)
+        return 0;
+    if ((subdevice=strchr(devstr,':')))
+        *subdevice++='\0';
+    for (i = 0; _xpost_main_devices[i]; i++)
+    {
+        if (strcmp(_xpost_main_devices[i], devstr) == 0)
+        {
+            free(devstr);
+            return 1;
+        }
+    }
+    free(devstr);
+    return 0;
 }
 
 static int
@@ -228,11 +279,428 @@ _xpost_geometry_parse(const char *geometry, int *width, int *height, int *xoffse
     return 1;
 }
 
+#ifdef XPOST_MAIN_SERVE
+
+/* number of warm contexts kept by the server, one per device */
+#define XPOST_MAIN_SERVE_CONTEXTS 4
+
+typedef struct
+{
+    char *device;
+    Xpost_Context *ctx;
+    unsigned long used; /* the job that used it last, to drop the oldest */
+} Xpost_Main_Serve_Context;
+
+typedef struct
+{
+    Xpost_Main_Serve_Context ctab[XPOST_MAIN_SERVE_CONTEXTS];
+    const char *device; /* device of the jobs that give none */
+    const char *output_file; /* output file of the jobs that give none */
+    int output_msg;
+    int num_defs;
+    char **defs; /* the -D definitions, made for all the jobs */
+    unsigned long jobs;
+} Xpost_Main_Server;
+
+/* the initialized context of the device, frozen after the -D definitions,
+   created if none is warm yet */
+static Xpost_Context *
+_xpost_main_serve_context(Xpost_Main_Server *srv, const char *device)
+{
+    Xpost_Main_Serve_Context *c = &srv->ctab[0];
+    Xpost_Context *ctx;
+    int i;
+
+    for (i = 0; i < XPOST_MAIN_SERVE_CONTEXTS; i++)
+    {
+        if (srv->ctab[i].ctx && strcmp(srv->ctab[i].device, device) == 0)
+        {
+            srv->ctab[i].used = srv->jobs;
+            return srv->ctab[i].ctx;
+        }
+        if (!srv->ctab[i].ctx)
+            c = &srv->ctab[i];
+        else if (c->ctx && srv->ctab[i].used < c->used)
+            c = &srv->ctab[i];
+    }
+
+    if (c->ctx)
+    {
+        XPOST_LOG_INFO("dropping warm context for %s", c->device);
+        xpost_destroy(c->ctx);
+        free(c->device);
+        c->ctx = NULL;
+    }
+    if (!(ctx = xpost_create(device,
+                             srv->output_file ? XPOST_OUTPUT_FILENAME : XPOST_OUTPUT_DEFAULT,
+                             srv->output_file,
+                             XPOST_SHOWPAGE_NOPAUSE,
+                             srv->output_msg,
+                             XPOST_IGNORE_SIZE, 0, 0)))
+    {
+        XPOST_LOG_ERR("Failed to initialize.");
+        return NULL;
+    }
+    if (srv->defs)
+        xpost_add_definitions(ctx, srv->num_defs, srv->defs);
+    if (!(c->device = strdup(device)) || !xpost_freeze(ctx, 1))
+    {
+        XPOST_LOG_ERR("cannot keep context for %s", device);
+        free(c->device);
+        xpost_destroy(ctx);
+        return NULL;
+    }
+    c->ctx = ctx;
+    c->used = srv->jobs;
+    return ctx;
+}
+
+/* whether the device writes its pages to a file, which a job must
+   give: png has no default, and pgm and ppm would mix their pages
+   with the text sent back to the client */
+static int
+_xpost_main_serve_needs_output(const char *device)
+{
+    static const char *devices[] = { "png", "pgm", "ppm", NULL };
+    size_t len = strcspn(device, ":");
+    int i;
+
+    for (i = 0; devices[i]; i++)
+    {
+        if (strlen(devices[i]) == len && strncmp(device, devices[i], len) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+static void
+_xpost_main_serve_reply(int fd, const char *msg, const char *arg)
+{
+    char buf[1200];
+    int n;
+
+    n = snprintf(buf, sizeof buf, "xpost: %s: %s\n", msg, arg);
+    if (n > (int)sizeof buf - 1)
+        n = (int)sizeof buf - 1;
+    if (n > 0 && write(fd, buf, (size_t)n) < 0)
+        XPOST_LOG_ERR("cannot reply to the job");
+}
+
+/* the definition of OutputFileName, as a string token */
+static char *
+_xpost_main_serve_output(const char *output)
+{
+    char *def;
+    char *p;
+
+    def = malloc(strlen("OutputFileName=()") + 2 * strlen(output) + 1);
+    if (!def)
+        return NULL;
+    p = def + sprintf(def, "OutputFileName=(");
+    for (; *output; output++)
+    {
+        if (*output == '(' || *output == ')' || *output == '\\')
+            *p++ = '\\';
+        *p++ = *output;
+    }
+    strcpy(p, ")");
+    return def;
+}
+
+/* read a request line, without its end, unbuffered:
+   the program that follows is read from fd by the interpreter */
+static int
+_xpost_main_serve_getline(int fd, char *line, size_t size)
+{
+    size_t n = 0;
+    ssize_t r;
+    char c;
+
+    for (;;)
+    {
+        r = read(fd, &c, 1);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return 0;
+        if (c == '\n')
+            break;
+        if (n + 1 == size)
+            return 0;
+        line[n++] = c;
+    }
+    if (n > 0 && line[n - 1] == '\r')
+        n--;
+    line[n] = '\0';
+    return 1;
+}
+
+/* the next bytes of the program of a job */
+static long
+_xpost_main_serve_read(void *data, void *buf, size_t len)
+{
+    int fd = *(int *)data;
+    ssize_t n;
+
+    do
+        n = read(fd, buf, len);
+    while (n < 0 && errno == EINTR);
+    return (n < 0) ? 0 : (long)n;
+}
+
+/*
+   run the job of the connection fd: its request lines up to an empty
+   line, then its program, read until the client ends its sending side.
+   what the job writes to stdout is sent back, then the vm is reset.
+   return 1 if the server must stop.
+ */
+static int
+_xpost_main_serve_job(Xpost_Main_Server *srv, int fd)
+{
+    char line[1024];
+    char *device = NULL;
+    char **defs = NULL;
+    int num_defs = 0;
+    int has_output = 0;
+    Xpost_Input_Callback cb;
+    Xpost_Context *ctx;
+    int stop = 0;
+    int ok = 0;
+    int ret;
+    int out;
+    int i;
+
+    while (_xpost_main_serve_getline(fd, line, sizeof line))
+    {
+        char *val;
+        char **d;
+
+        if (!*line)
+        {
+            ok = 1;
+            break;
+        }
+        if ((val = strchr(line, ' ')))
+            *val++ = '\0';
+
+        if (!strcmp(line, "quit"))
+        {
+            stop = 1;
+            continue;
+        }
+        if (!val)
+        {
+            _xpost_main_serve_reply(fd, "missing request value", line);
+            goto end_job;
+        }
+        if (!strcmp(line, "device"))
+        {
+            if (!_xpost_main_device_check(val))
+            {
+                _xpost_main_serve_reply(fd, "wrong device", val);
+                goto end_job;
+            }
+            free(device);
+            device = strdup(val);
+        }
+        else if (!strcmp(line, "geometry"))
+        {
+            int width, height, xoffset, xsign, yoffset, ysign;
+
+            /* checked only: sizes are not implemented yet */
+            if (!_xpost_geometry_parse(val,
+                                       &width, &height,
+                                       &xoffset, &xsign,
+                                       &yoffset, &ysign))
+            {
+                _xpost_main_serve_reply(fd, "bad formatted geometry", val);
+                goto end_job;
+            }
+        }
+        else if (!strcmp(line, "output") || !strcmp(line, "define"))
+        {
+            d = realloc(defs, (num_defs + 1) * sizeof *defs);
+            if (!d)
+                goto end_job;
+            defs = d;
+            defs[num_defs] = (line[0] == 'o') ? _xpost_main_serve_output(val) : strdup(val);
+            if (!defs[num_defs])
+                goto end_job;
+            if (!strncmp(defs[num_defs], "OutputFileName=", strlen("OutputFileName=")))
+                has_output = 1;
+            num_defs++;
+        }
+        else
+        {
+            _xpost_main_serve_reply(fd, "unknown request", line);
+            goto end_job;
+        }
+    }
+    if (!ok)
+        goto end_job;
+
+    if (!has_output && !srv->output_file &&
+        _xpost_main_serve_needs_output(device ? device : srv->device))
+    {
+        _xpost_main_serve_reply(fd, "missing output file for device",
+                                device ? device : srv->device);
+        goto end_job;
+    }
+
+    srv->jobs++;
+    if (!(ctx = _xpost_main_serve_context(srv, device ? device : srv->device)))
+    {
+        _xpost_main_serve_reply(fd, "cannot create context for device",
+                                device ? device : srv->device);
+        goto end_job;
+    }
+    if (defs)
+        xpost_add_definitions(ctx, num_defs, defs);
+
+    /* send back what the job writes */
+    fflush(stdout);
+    out = dup(STDOUT_FILENO);
+    if (out < 0 || dup2(fd, STDOUT_FILENO) < 0)
+    {
+        XPOST_LOG_ERR("cannot send the output of the job");
+        if (out >= 0)
+            close(out);
+        out = -1;
+    }
+    else
+    {
+        cb.read = _xpost_main_serve_read;
+        cb.data = &fd;
+        ret = xpost_run(ctx, XPOST_INPUT_CALLBACK, &cb);
+        while (ret == XPOST_RUN_IOBLOCK)
+            ret = xpost_run(ctx, XPOST_INPUT_RESUME, NULL);
+    }
+    fflush(stdout);
+    if (out >= 0)
+    {
+        dup2(out, STDOUT_FILENO);
+        close(out);
+    }
+
+    /* the next job of the device starts from the frozen vm */
+    if (!xpost_reset(ctx))
+    {
+        for (i = 0; i < XPOST_MAIN_SERVE_CONTEXTS; i++)
+        {
+            if (srv->ctab[i].ctx == ctx)
+            {
+                XPOST_LOG_ERR("cannot reset context for %s", srv->ctab[i].device);
+                xpost_destroy(ctx);
+                free(srv->ctab[i].device);
+                srv->ctab[i].ctx = NULL;
+            }
+        }
+    }
+
+  end_job:
+    /* the client sees the end of the output, and what it sent
+       that was not read is dropped before closing */
+    shutdown(fd, SHUT_WR);
+    while (read(fd, line, sizeof line) > 0)
+        ;
+    close(fd);
+    for (i = 0; i < num_defs; i++)
+        free(defs[i]);
+    free(defs);
+    free(device);
+    return stop;
+}
+
+/* accept the jobs on the socket at path, one at a time,
+   until one of them stops the server */
+static int
+_xpost_main_serve(Xpost_Main_Server *srv, const char *path)
+{
+    struct sockaddr_un addr;
+    struct stat sb;
+    mode_t mask;
+    int stop = 0;
+    int ret;
+    int sfd;
+    int fd;
+    int i;
+#ifdef HAVE_SIGACTION
+    struct sigaction sa;
+
+    /* a client gone before the end of its job must not end the server */
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, NULL);
+#endif
+
+    if (strlen(path) >= sizeof addr.sun_path)
+    {
+        XPOST_LOG_ERR("socket path too long");
+        return 0;
+    }
+    /* a socket left by a previous server is replaced, not another file */
+    if (lstat(path, &sb) == 0 && S_ISSOCK(sb.st_mode))
+        unlink(path);
+
+    sfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sfd < 0)
+    {
+        XPOST_LOG_ERR("cannot create socket: %s", strerror(errno));
+        return 0;
+    }
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    /* a job runs any program with the file operators, under the uid
+       of the server: only its owner may connect */
+    mask = umask(077);
+    ret = bind(sfd, (struct sockaddr *)&addr, sizeof addr);
+    umask(mask);
+    if (ret < 0 ||
+        chmod(path, S_IRUSR | S_IWUSR) < 0 ||
+        listen(sfd, 16) < 0)
+    {
+        XPOST_LOG_ERR("cannot listen on %s: %s", path, strerror(errno));
+        close(sfd);
+        return 0;
+    }
+    XPOST_LOG_INFO("serving jobs on %s", path);
+
+    while (!stop)
+    {
+        fd = accept(sfd, NULL, NULL);
+        if (fd < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            XPOST_LOG_ERR("cannot accept job: %s", strerror(errno));
+            break;
+        }
+        stop = _xpost_main_serve_job(srv, fd);
+    }
+
+    close(sfd);
+    unlink(path);
+    for (i = 0; i < XPOST_MAIN_SERVE_CONTEXTS; i++)
+    {
+        if (srv->ctab[i].ctx)
+        {
+            xpost_destroy(srv->ctab[i].ctx);
+            free(srv->ctab[i].device);
+        }
+    }
+    return stop;
+}
+
+#endif
+
 int main(int argc, char *argv[])
 {
     Xpost_Context *ctx;
     const char *geometry = NULL;
     const char *output_file = NULL;
+    const char *image = NULL;
+    const char *serve = NULL;
     const char *device = NULL;
     const char *ps_file = NULL;
     const char *filename = argv[0];
@@ -350,6 +818,8 @@ int main(int argc, char *argv[])
             else XPOST_MAIN_IF_OPT("-o", "--output=", output_file)
             else XPOST_MAIN_IF_OPT("-d", "--device=", device)
             else XPOST_MAIN_IF_OPT("-g", "--geometry=", geometry)
+            else XPOST_MAIN_IF_OPT("-i", "--image=", image)
+            else XPOST_MAIN_IF_OPT("-s", "--serve=", serve)
             else
             {
                 printf("unknown option\n");
@@ -385,26 +855,7 @@ int main(int argc, char *argv[])
                (ysign == 1) ? '+' : '-', yoffset);
     }
 
-    {
-        char *devstr = strdup(device);
-        char *subdevice;
-        if ((subdevice=strchr(devstr,':')))
-            *subdevice++='\0';
-        /* check devices */
-        have_device = 0;
-        i = 0;
-        while (_xpost_main_devices[i])
-        {
-            if (strcmp(_xpost_main_devices[i], devstr) == 0)
-            {
-                have_device = 1;
-                break;
-            }
-            i++;
-        }
-        free(devstr);
-    }
-
+    have_device = _xpost_main_device_check(device);
     if (!have_device)
     {
         XPOST_LOG_ERR("wrong device.");
@@ -412,6 +863,35 @@ int main(int argc, char *argv[])
         goto quit_xpost;
     }
 
+    if (image)
+        xpost_image_set(image);
+
+    if (serve)
+    {
+#ifdef XPOST_MAIN_SERVE
+        Xpost_Main_Server srv;
+        int ret;
+
+        memset(&srv, 0, sizeof srv);
+        srv.device = device;
+        srv.output_file = output_file;
+        srv.output_msg = output_msg;
+        srv.num_defs = num_defs;
+        srv.defs = defs;
+        ret = _xpost_main_serve(&srv, serve);
+        for (i = 0; i < num_defs; ++i)
+            free(defs[i]);
+        free(defs);
+        if (!ret)
+            goto quit_xpost;
+        xpost_quit();
+        return EXIT_SUCCESS;
+#else
+        XPOST_LOG_ERR("no unix domain sockets to serve jobs on");
+        goto quit_xpost;
+#endif
+    }
+
     if (!(ctx = xpost_create(device,
                              XPOST_OUTPUT_FILENAME,
                              output_file,
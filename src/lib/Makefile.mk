@@ -19,9 +19,11 @@ src/lib/xpost_dev_generic.c \
 src/lib/xpost_dict.c \
 src/lib/xpost_error.c \
 src/lib/xpost_file.c \
+src/lib/xpost_filter.c \
 src/lib/xpost_font.c \
 src/lib/xpost_free.c \
 src/lib/xpost_garbage.c \
+src/lib/xpost_image.c \
 src/lib/xpost_interpreter.c \
 src/lib/xpost_log.c \
 src/lib/xpost_main.c \
@@ -52,6 +54,8 @@ src/lib/xpost_op_token.c \
 src/lib/xpost_op_type.c \
 src/lib/xpost_operator.c \
 src/lib/xpost_oplib.c \
+src/lib/xpost_pool.c \
+src/lib/xpost_rom.c \
 src/lib/xpost_array.h \
 src/lib/xpost_compat.h \
 src/lib/xpost_dev_bgr.h \
@@ -60,9 +64,11 @@ src/lib/xpost_dev_generic.h \
 src/lib/xpost_dict.h \
 src/lib/xpost_error.h \
 src/lib/xpost_file.h \
+src/lib/xpost_filter.h \
 src/lib/xpost_font.h \
 src/lib/xpost_free.h \
 src/lib/xpost_garbage.h \
+src/lib/xpost_image.h \
 src/lib/xpost_log.h \
 src/lib/xpost_main.h \
 src/lib/xpost_matrix.h \
@@ -90,6 +96,7 @@ src/lib/xpost_op_type.h \
 src/lib/xpost_op_token.h \
 src/lib/xpost_operator.h \
 src/lib/xpost_oplib.h \
+src/lib/xpost_rom.h \
 src/lib/xpost_private.h
 
 if HAVE_LIBPNG
@@ -112,9 +119,11 @@ endif
 
 
 src_lib_libxpost_la_CPPFLAGS = \
+-I$(top_builddir)/src/lib \
 -DPACKAGE_DATA_DIR=\"$(pkgdatadir)\" \
 -DPACKAGE_INSTALL_DIR=\"$(prefix)/\" \
--DXPOST_BUILD
+-DXPOST_BUILD \
+-DXPOST_BUILD_ROM
 
 src_lib_libxpost_la_CFLAGS = \
 @XPOST_LIB_CFLAGS@ \
@@ -126,3 +135,40 @@ src_lib_libxpost_la_LIBADD = \
 @XPOST_COV_LIBS@
 
 src_lib_libxpost_la_LDFLAGS = -no-undefined -version-info @version_info@
+
+# PostScript files built into the library, see xpost_rom.h
+
+xpost_rom_files = \
+$(top_srcdir)/data/init.ps \
+$(top_srcdir)/data/err.ps \
+$(top_srcdir)/data/qsort.ps \
+$(top_srcdir)/data/prepr.ps \
+$(top_srcdir)/data/graphics.ps \
+$(top_srcdir)/data/device.ps \
+$(top_srcdir)/data/image.ps \
+$(top_srcdir)/data/pgmimage.ps \
+$(top_srcdir)/data/ppmimage.ps \
+$(top_srcdir)/data/nulldev.ps \
+$(top_srcdir)/data/gstate.ps \
+$(top_srcdir)/data/color.ps \
+$(top_srcdir)/data/path.ps \
+$(top_srcdir)/data/clip.ps \
+$(top_srcdir)/data/paint.ps \
+$(top_srcdir)/data/font.ps \
+$(top_srcdir)/data/test.ps \
+$(top_srcdir)/data/testdraw.ps
+
+rom_verbose = $(rom_verbose_@AM_V@)
+rom_verbose_ = $(rom_verbose_@AM_DEFAULT_V@)
+rom_verbose_0 = @echo "  ROM     " $@;
+
+src/lib/xpost_rom_data.h: $(top_srcdir)/src/lib/xpost_rom.awk $(xpost_rom_files) Makefile
+	$(AM_V_at)$(MKDIR_P) src/lib
+	$(rom_verbose)$(AWK) -f $(top_srcdir)/src/lib/xpost_rom.awk $(xpost_rom_files) > $@.tmp && mv $@.tmp $@
+
+BUILT_SOURCES = src/lib/xpost_rom_data.h
+nodist_src_lib_libxpost_la_SOURCES = src/lib/xpost_rom_data.h
+
+EXTRA_DIST += src/lib/xpost_rom.awk
+
+XPOST_CLEANFILES += src/lib/xpost_rom_data.h
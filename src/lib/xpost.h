@@ -32,6 +32,8 @@
 #ifndef XPOST_H
 #define XPOST_H
 
+#include <stddef.h> /* size_t */
+
 #ifdef XPAPI
 # undef XPAPI
 #endif
@@ -135,12 +137,31 @@ XPAPI const char *xpost_lib_dir_get(void);
  */
 XPAPI const char *xpost_data_dir_get(void);
 
+/**
+ * @brief Set the quick-launch image file.
+ *
+ * @param filename The image file, or @c NULL.
+ *
+ * When an image file is set, xpost_create() maps the virtual memory
+ * saved in @p filename instead of running init.ps, and writes it
+ * there first if it is missing or out of date. If @p filename is
+ * @c NULL, the XPOST_IMAGE environment variable is used, and if it
+ * is not set either, no image is used. Images need mmap().
+ */
+XPAPI void xpost_image_set(const char *filename);
+
 /**
  * @typedef Xpost_Context
  * @brief The context abstract structure for a thread of execution of ps code.
  */
 typedef struct _Xpost_Context Xpost_Context;
 
+/**
+ * @typedef Xpost_Context_Pool
+ * @brief A set of contexts cloned from one initialized context.
+ */
+typedef struct _Xpost_Context_Pool Xpost_Context_Pool;
+
 /**
  * @typedef Xpost_Showpage_Semantics
  * @brief Specify the behavior the interpreter should take when executing `showpage`.
@@ -167,26 +188,86 @@ typedef enum {
     XPOST_OUTPUT_DEFAULT, /**< Ignores outputptr. */
     XPOST_OUTPUT_FILENAME, /**< Treats outputptr as a char* to a
                                 zero-terminated OS path string
-                                (implemented in pgm and ppm devices). */
-    XPOST_OUTPUT_BUFFERIN, /**< Treats outputptr as an unsigned char *
-                                and render directly into this memory
-                                (not currently implemented). */
+                                (implemented in pgm, ppm and png
+                                devices). The png device writes a
+                                file per page, replacing %d in the
+                                path with the page number. */
+    XPOST_OUTPUT_BUFFERIN, /**< Treats outputptr as a const
+                                #Xpost_Output_Buffer * and renders
+                                directly into its memory (implemented
+                                in raster and bgr devices). */
     XPOST_OUTPUT_BUFFEROUT /**< Treats outputptr as an unsigned char **
-                                and malloc()s a new buffer and assigns
-                                it to the unsigned char * which
-                                outputptr points to. */
+                                and assigns the buffer of the device
+                                to the unsigned char * which outputptr
+                                points to at each page (see also
+                                xpost_page_callback_set()). */
 } Xpost_Output_Type;
 
+/**
+ * @typedef Xpost_Pixel_Format
+ * @brief The layout of the pixels given to a #Xpost_Page_Func, 8 bits
+ * per component, in memory order.
+ */
+typedef enum {
+    XPOST_PIXEL_FORMAT_RGB, /**< 3 bytes: red, green, blue. */
+    XPOST_PIXEL_FORMAT_ARGB, /**< 4 bytes: alpha, red, green, blue. */
+    XPOST_PIXEL_FORMAT_BGR, /**< 3 bytes: blue, green, red. */
+    XPOST_PIXEL_FORMAT_BGRA /**< 4 bytes: blue, green, red, alpha. */
+} Xpost_Pixel_Format;
+
+/**
+ * @typedef Xpost_Page_Func
+ * @brief Function called by `showpage` with the pixels of the page.
+ *
+ * @param ctx The context executing `showpage`.
+ * @param page The number of the page in the job, starting at 1.
+ * @param pixels The first row of the page, at the top.
+ * @param width The width of the page in pixels.
+ * @param height The height of the page in pixels.
+ * @param stride The size of a row in bytes.
+ * @param format The layout of the pixels.
+ * @param data The data given to xpost_page_callback_set().
+ *
+ * The pixels belong to the device: they are only valid until the
+ * function returns, and the next page is drawn into the same memory.
+ * A client keeping a page must copy it.
+ */
+typedef void (*Xpost_Page_Func)(Xpost_Context *ctx,
+                                int page,
+                                const unsigned char *pixels,
+                                int width,
+                                int height,
+                                int stride,
+                                Xpost_Pixel_Format format,
+                                void *data);
+
+/**
+ * @typedef Xpost_Output_Buffer
+ * @brief The memory a device renders into with #XPOST_OUTPUT_BUFFERIN.
+ *
+ * The structure is copied by xpost_create(); @p pixels must stay
+ * valid until the context is destroyed. The page of the device has
+ * the size of the buffer, and `erasepage` paints it white in place.
+ */
+typedef struct
+{
+    unsigned char *pixels; /**< The first row of the page, at the top. */
+    int width; /**< The width of the page in pixels. */
+    int height; /**< The height of the page in pixels. */
+    int stride; /**< The size of a row in bytes, which may exceed the
+                     size of its pixels to draw into a larger canvas. */
+    Xpost_Pixel_Format format; /**< The layout of the pixels. */
+} Xpost_Output_Buffer;
+
 /**
  * @typedef Xpost_Input_Type
  * @brief Specify the interpretation of the inputptr parameter to xpost_run().
  */
 typedef enum {
     XPOST_INPUT_STRING, /**< Treats inputptr as a char * to an
-                             zero-terminated ascii string, writes the
-                             whole string into a temporary file and
-                             falls through to the #XPOST_INPUT_FILEPTR
-                             case. */
+                             zero-terminated ascii string, copies it
+                             and executes the copy as a file read
+                             from memory (see also xpost_run_buffer()). */
     XPOST_INPUT_FILENAME, /**< Treats inputptr as a char * to a
                               zero-terminated OS path string, and
                               pushes the path string itself,
@@ -195,9 +276,82 @@ typedef enum {
                                postscript file object and pushes it on
                                the execution stack (scheduling it to
                                execute). */
-    XPOST_INPUT_RESUME /**< Bypasses any execution scheduling. */
+    XPOST_INPUT_RESUME, /**< Bypasses any execution scheduling. */
+    XPOST_INPUT_CALLBACK /**< Treats inputptr as a const
+                              #Xpost_Input_Callback *, and executes
+                              the bytes returned by its function as
+                              they arrive. */
 } Xpost_Input_Type;
 
+/**
+ * @def XPOST_RUN_IOBLOCK
+ * @brief Returned by xpost_run() when a job read with
+ * #XPOST_INPUT_CALLBACK waits for its next bytes (the @c ioblock
+ * error code).
+ */
+#define XPOST_RUN_IOBLOCK 29
+
+/**
+ * @typedef Xpost_Input_Read_Func
+ * @brief Function returning the next bytes of a program.
+ *
+ * @param data The data of the #Xpost_Input_Callback.
+ * @param buf The buffer to fill.
+ * @param len The size of the buffer.
+ * @return The count of bytes stored in @p buf, 0 at the end of the
+ * program, or -1 if no bytes are available yet.
+ *
+ * The function is called whenever the interpreter has consumed the
+ * bytes read so far. When it returns -1, xpost_run() returns
+ * #XPOST_RUN_IOBLOCK, and the job continues when xpost_run() is called again
+ * with #XPOST_INPUT_RESUME, presumably once more bytes are available.
+ * A filter reading the program cannot wait for bytes in the middle
+ * of its data: before it is read, the function is called until it
+ * returns 0, and xpost_run() returns #XPOST_RUN_IOBLOCK meanwhile.
+ */
+typedef long (*Xpost_Input_Read_Func)(void *data, void *buf, size_t len);
+
+/**
+ * @typedef Xpost_Input_Callback
+ * @brief The source of a program read with #XPOST_INPUT_CALLBACK.
+ *
+ * The structure is only read by xpost_run(); @p data must stay valid
+ * until the job ends.
+ */
+typedef struct
+{
+    Xpost_Input_Read_Func read; /**< The function returning the bytes. */
+    void *data; /**< The data passed to @p read. */
+} Xpost_Input_Callback;
+
+/**
+ * @typedef Xpost_Job
+ * @brief A program run by xpost_context_pool_run().
+ */
+typedef struct
+{
+    Xpost_Input_Type input_type; /**< How to read @p input, as for xpost_run(). */
+    const void *input; /**< The program, as the input of xpost_run(). */
+    int result; /**< Set to the value returned by xpost_run() at the end
+                     of the job, or to -1 if no context was free. */
+} Xpost_Job;
+
+/**
+ * @typedef Xpost_Step_Status
+ * @brief The state of a job returned by xpost_step().
+ */
+typedef enum {
+    XPOST_STEP_RUNNING, /**< The budget is spent, the job goes on at
+                             the next call. */
+    XPOST_STEP_PAGE, /**< `showpage` returned with
+                          #XPOST_SHOWPAGE_RETURN semantics: the page is
+                          ready, the job goes on at the next call. */
+    XPOST_STEP_INPUT, /**< The job waits for the next bytes of its
+                           #XPOST_INPUT_CALLBACK. */
+    XPOST_STEP_DONE, /**< The job ended. */
+    XPOST_STEP_ERROR /**< No job was started. */
+} Xpost_Step_Status;
+
 /**
  * @typedef Xpost_Set_Size
  * @brief FIXME: to fill...
@@ -233,6 +387,9 @@ typedef enum
  *
  * When not needed the context must be freed with xpost_destroy().
  *
+ * Contexts do not share any state but the locked tables of contexts
+ * and memory files, so each thread may create and run its own.
+ *
  * @see xpost_destroy()
  */
 XPAPI Xpost_Context *xpost_create(const char *device,
@@ -266,6 +423,25 @@ XPAPI int xpost_add_definitions(Xpost_Context *ctx,
                                 int cnt,
                                 char *defs[]);
 
+/**
+ * @brief Set the function called with each page of the raster devices.
+ *
+ * @param ctx The context to use.
+ * @param func The function, or @c NULL to remove it.
+ * @param data The data passed to @p func.
+ *
+ * The raster, png and bgr devices call @p func at each `showpage`,
+ * with the memory they draw into, so a page is handed to the client
+ * without copying it and without returning from xpost_run(). The
+ * function is kept by xpost_reset(), and inherited by the contexts
+ * made with `fork` or xpost_clone().
+ *
+ * @see Xpost_Page_Func
+ */
+XPAPI void xpost_page_callback_set(Xpost_Context *ctx,
+                                   Xpost_Page_Func func,
+                                   void *data);
+
 /**
  * @brief Execute ps program.
  *
@@ -286,10 +462,13 @@ XPAPI int xpost_add_definitions(Xpost_Context *ctx,
  *
  * For a filename, push a proc to open and execute it.
  *
- * For a string, write to a temp file and fall-through to FILE * case.
+ * For a string, copy it and execute it as a file read from memory.
  *
  * For a FILE *, mark executable and push to exec stack.
  *
+ * For a callback, execute the bytes as they are returned, and return
+ * #XPOST_RUN_IOBLOCK to the caller whenever none are available yet.
+ *
  * As a special-case, if executing a FILE *, and that file is a
  * console or tty, it pushes a proc which launches the postscript
  * `executive` which offers PS> prompts.
@@ -306,6 +485,214 @@ XPAPI int xpost_run(Xpost_Context *ctx,
                     Xpost_Input_Type input_type,
                     const void *inputptr);
 
+/**
+ * @brief Execute a PostScript program held in memory.
+ *
+ * @param ctx The context.
+ * @param buf The program.
+ * @param len The size of the program in bytes.
+ * @return The same values as xpost_run(), or an error code if the
+ *         program cannot be opened.
+ *
+ * This function is xpost_run() with #XPOST_INPUT_STRING, except that
+ * the program is given by its length, so it may contain NUL bytes
+ * (binary tokens, image data), and it is read in place, without a
+ * copy. The buffer must stay valid until the job ends, that is until
+ * this function returns, or until the session is resumed to its end
+ * if it returns for #XPOST_SHOWPAGE_RETURN.
+ */
+XPAPI int xpost_run_buffer(Xpost_Context *ctx,
+                           const void *buf,
+                           size_t len);
+
+/**
+ * @brief Schedule a ps program without running it.
+ *
+ * @param ctx The context to run.
+ * @param input_type The input type to use, except #XPOST_INPUT_RESUME.
+ * @param inputptr The program, as for xpost_run().
+ * @return 0 on success, or an error code if the program cannot be
+ *         opened.
+ *
+ * This function does what xpost_run() does before running the program.
+ * The job is then run by calls to xpost_step(), or to xpost_run() with
+ * #XPOST_INPUT_RESUME to run it to its end.
+ *
+ * @see xpost_step()
+ */
+XPAPI int xpost_start(Xpost_Context *ctx,
+                      Xpost_Input_Type input_type,
+                      const void *inputptr);
+
+/**
+ * @brief Run a part of the job started by xpost_start().
+ *
+ * @param ctx The context of the job.
+ * @param max_ops The largest number of objects to execute, not bounded
+ *        if 0 or less.
+ * @param max_us The largest time to run in microseconds, not bounded
+ *        if 0 or less.
+ * @return The state of the job.
+ *
+ * This function runs the job until its budget is spent, its page is
+ * ready, it waits for input, or it ends, so that a host can run many
+ * jobs in its own loop without a thread for each one. The time is
+ * looked at every few objects, so it may be overrun by the time of one
+ * operator (a large `fill`, or `image`).
+ *
+ * The state of a job stopped by its budget is kept in the context as
+ * is, and nothing else may be run on the context until the job ends.
+ *
+ * @see xpost_start()
+ */
+XPAPI Xpost_Step_Status xpost_step(Xpost_Context *ctx,
+                                   long max_ops,
+                                   long max_us);
+
+/**
+ * @brief Freeze the current state of the context for job-server use.
+ *
+ * @param ctx The context to freeze.
+ * @param global Whether to freeze global VM as well as local VM.
+ * @return 1 on success, 0 on failure.
+ *
+ * This function writes local VM (and global VM if @p global is
+ * non-zero) of @p ctx to its memory file, and continues on a private
+ * copy-on-write mapping of that file. It is meant to be called once,
+ * after xpost_create() and any xpost_add_definitions().
+ *
+ * A frozen VM is no longer wrapped in a save/restore by xpost_run();
+ * call xpost_reset() between jobs instead.
+ *
+ * @see xpost_reset()
+ */
+XPAPI int xpost_freeze(Xpost_Context *ctx, int global);
+
+/**
+ * @brief Reset a frozen context to the state it was frozen in.
+ *
+ * @param ctx The context to reset.
+ * @return 1 on success, 0 on failure.
+ *
+ * This function discards all changes made to the VM frozen by
+ * xpost_freeze() by dropping its private mappings, so its cost does
+ * not depend on what the previous job did.
+ *
+ * @see xpost_freeze()
+ */
+XPAPI int xpost_reset(Xpost_Context *ctx);
+
+/**
+ * @brief Create a new context from the frozen state of a context.
+ *
+ * @param ctx The context to clone, frozen with its global VM.
+ * @return The new context, or @c NULL on failure.
+ *
+ * This function makes a context with private copies of the local and
+ * global VM that @p ctx was frozen with by xpost_freeze(), without
+ * running init.ps again. The copies share the pages of the frozen
+ * memory files until they are written. The clone is itself frozen,
+ * so xpost_reset() brings it back to that state.
+ *
+ * When not needed the clone must be freed with xpost_destroy(),
+ * before @p ctx.
+ *
+ * @see xpost_freeze()
+ * @see xpost_context_pool_create()
+ */
+XPAPI Xpost_Context *xpost_clone(Xpost_Context *ctx);
+
+/**
+ * @brief Create a pool of initialized contexts.
+ *
+ * @param size The number of contexts in the pool, or 0 for one per
+ * processor.
+ * @return The pool, or @c NULL on failure.
+ *
+ * The other parameters are those of xpost_create(), which is called
+ * once. The resulting context is frozen, and @p size contexts are
+ * cloned from it with xpost_clone(), so the cost of initializing the
+ * interpreter is paid once for the whole pool. All the contexts share
+ * the same device and output configuration.
+ *
+ * The number of contexts is currently limited by the size of the
+ * tables of memory files (MAXMFILE in xpost_interpreter.h), minus the
+ * files of the frozen context; a pool of one context per processor is
+ * capped to it.
+ *
+ * @see xpost_context_pool_acquire()
+ * @see xpost_context_pool_destroy()
+ */
+XPAPI Xpost_Context_Pool *xpost_context_pool_create(int size,
+                                                    const char *device,
+                                                    Xpost_Output_Type output_type,
+                                                    const void *outputptr,
+                                                    Xpost_Showpage_Semantics semantics,
+                                                    Xpost_Output_Message output_msg,
+                                                    Xpost_Set_Size set_size,
+                                                    int width,
+                                                    int height);
+
+/**
+ * @brief Take a clean context from the pool.
+ *
+ * @param pool The pool.
+ * @return A context to pass to xpost_run(), or @c NULL if all the
+ * contexts of @p pool are in use.
+ *
+ * @see xpost_context_pool_release()
+ */
+XPAPI Xpost_Context *xpost_context_pool_acquire(Xpost_Context_Pool *pool);
+
+/**
+ * @brief Give a context back to the pool.
+ *
+ * @param pool The pool.
+ * @param ctx A context returned by xpost_context_pool_acquire().
+ * @return 1 on success, 0 on failure.
+ *
+ * The context is reset with xpost_reset(), so the next job acquiring
+ * it finds it as it was after initialization.
+ */
+XPAPI int xpost_context_pool_release(Xpost_Context_Pool *pool,
+                                     Xpost_Context *ctx);
+
+/**
+ * @brief Run jobs in parallel on the contexts of a pool.
+ *
+ * @param pool The pool.
+ * @param jobs The jobs.
+ * @param count The number of jobs.
+ * @return 1 when all the jobs have run, 0 if none could be started.
+ *
+ * Each context of @p pool not acquired by the caller runs on its own
+ * thread, taking the next job until none is left. The contexts do
+ * not share any VM, so the jobs run in parallel. A job returning for
+ * #XPOST_SHOWPAGE_RETURN, or waiting on its callback with
+ * #XPOST_RUN_IOBLOCK, is resumed until it ends, and the context is
+ * then released as by xpost_context_pool_release(). The function
+ * returns when all the jobs have ended.
+ *
+ * Without thread support, the jobs run one after the other in the
+ * calling thread.
+ *
+ * The pool functions may be called from several threads, as may
+ * xpost_create(), xpost_clone() and xpost_destroy() of other contexts
+ * while jobs run: the tables of contexts and of memory files are
+ * locked. Only xpost_init(), xpost_quit() and xpost_image_set() must
+ * be called when no job runs.
+ */
+XPAPI int xpost_context_pool_run(Xpost_Context_Pool *pool,
+                                 Xpost_Job *jobs,
+                                 int count);
+
+/**
+ * @brief Destroy a pool and all its contexts.
+ *
+ * @param pool The pool.
+ */
+XPAPI void xpost_context_pool_destroy(Xpost_Context_Pool *pool);
+
 /**
  * @brief Destroy the given context.
  *
@@ -94,10 +94,9 @@ Xpost_Object xpost_array_cons_memory(Xpost_Memory_File *mem,
         xpost_memory_table_get_addr(mem,
                                     XPOST_MEMORY_TABLE_SPECIAL_SAVE_STACK, &vs);
         cnt = xpost_stack_count(mem, vs);
-        tab->tab[rent].mark = ( (0 << XPOST_MEMORY_TABLE_MARK_DATA_MARK_OFFSET)
-                | (0 << XPOST_MEMORY_TABLE_MARK_DATA_REFCOUNT_OFFSET)
-                | (cnt << XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_OFFSET)
-                | (cnt << XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_OFFSET) );
+        tab->lev[rent] = ( (0 << XPOST_MEMORY_TABLE_LEVEL_DATA_REFCOUNT_OFFSET)
+                | (cnt << XPOST_MEMORY_TABLE_LEVEL_DATA_LOWLEVEL_OFFSET)
+                | (cnt << XPOST_MEMORY_TABLE_LEVEL_DATA_TOPLEVEL_OFFSET) );
 
         /* fill array with the null object */
         for (i = 0; i < sz; i++)
@@ -158,15 +157,17 @@ int xpost_array_put_memory(Xpost_Memory_File *mem,
                            Xpost_Object o)
 {
     int ret;
-    if (!xpost_save_ent_is_saved(mem, xpost_object_get_ent(a)))
-        if (!xpost_save_save_ent(mem, arraytype, a.comp_.sz, xpost_object_get_ent(a)))
-            return VMerror;
+    unsigned int off;
     if (i > a.comp_.sz)
     {
         XPOST_LOG_ERR("cannot put value in array (rangecheck) %u > [%u]", i, a.comp_.sz);
         /*breakhere((Xpost_Context *)mem);*/
         return rangecheck;
     }
+    off = (unsigned int)(a.comp_.off + i) * sizeof(Xpost_Object);
+    if (!xpost_save_chunk_is_saved(mem, xpost_object_get_ent(a), off))
+        if (!xpost_save_save_chunk(mem, xpost_object_get_ent(a), off))
+            return VMerror;
     ret = xpost_memory_put(mem, xpost_object_get_ent(a),
                            (unsigned int)(a.comp_.off + i),
                            (unsigned int)sizeof(Xpost_Object), &o);
@@ -524,3 +524,88 @@ xpost_realpath(const char *path, char *resolved_path)
     return realpath(path, resolved_path);
 #endif
 }
+
+#ifdef XPOST_THREADS
+
+/* the function of a thread, and its data */
+typedef struct
+{
+    void (*func)(void *);
+    void *data;
+} Xpost_Thread_Start;
+
+# ifdef HAVE_PTHREAD
+static void *
+_xpost_thread_main(void *arg)
+# else
+static DWORD WINAPI
+_xpost_thread_main(LPVOID arg)
+# endif
+{
+    Xpost_Thread_Start start = *(Xpost_Thread_Start *)arg;
+
+    free(arg);
+    start.func(start.data);
+    return 0;
+}
+
+#endif
+
+int
+xpost_thread_start(Xpost_Thread *thread, void (*func)(void *), void *data)
+{
+#ifdef XPOST_THREADS
+    Xpost_Thread_Start *start;
+
+    start = malloc(sizeof(Xpost_Thread_Start));
+    if (!start)
+        return 0;
+    start->func = func;
+    start->data = data;
+# ifdef HAVE_PTHREAD
+    if (pthread_create(thread, NULL, _xpost_thread_main, start) == 0)
+        return 1;
+# else
+    *thread = CreateThread(NULL, 0, _xpost_thread_main, start, 0, NULL);
+    if (*thread)
+        return 1;
+# endif
+    free(start);
+#else
+    (void)thread;
+    (void)func;
+    (void)data;
+#endif
+    return 0;
+}
+
+void
+xpost_thread_join(Xpost_Thread thread)
+{
+#ifdef HAVE_PTHREAD
+    pthread_join(thread, NULL);
+#elif defined(_WIN32)
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    (void)thread;
+#endif
+}
+
+int
+xpost_cpu_count(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    long n;
+
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#else
+    return 1;
+#endif
+}
@@ -122,6 +122,80 @@ unsigned char xpost_module_path_get(const void *addr, char *buf, unsigned int si
 
 char *xpost_realpath(const char *path, char *resolved_path);
 
+/*
+ * Threads, locks, conditions and thread-local storage. Without thread
+ * support, the locks and conditions do nothing and xpost_thread_start()
+ * fails.
+ */
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+# define XPOST_THREADS 1
+typedef pthread_mutex_t Xpost_Lock;
+typedef pthread_t Xpost_Thread;
+# define XPOST_LOCK_INIT PTHREAD_MUTEX_INITIALIZER
+# define xpost_lock_init(l) pthread_mutex_init(l, NULL)
+# define xpost_lock_fini(l) pthread_mutex_destroy(l)
+# define xpost_lock(l) pthread_mutex_lock(l)
+# define xpost_unlock(l) pthread_mutex_unlock(l)
+typedef pthread_cond_t Xpost_Cond;
+# define xpost_cond_init(c) pthread_cond_init(c, NULL)
+# define xpost_cond_fini(c) pthread_cond_destroy(c)
+# define xpost_cond_wait(c, l) pthread_cond_wait(c, l)
+# define xpost_cond_broadcast(c) pthread_cond_broadcast(c)
+#elif defined(_WIN32)
+# define XPOST_THREADS 1
+typedef SRWLOCK Xpost_Lock;
+typedef HANDLE Xpost_Thread;
+# define XPOST_LOCK_INIT SRWLOCK_INIT
+# define xpost_lock_init(l) InitializeSRWLock(l)
+# define xpost_lock_fini(l) ((void)(l))
+# define xpost_lock(l) AcquireSRWLockExclusive(l)
+# define xpost_unlock(l) ReleaseSRWLockExclusive(l)
+typedef CONDITION_VARIABLE Xpost_Cond;
+# define xpost_cond_init(c) InitializeConditionVariable(c)
+# define xpost_cond_fini(c) ((void)(c))
+# define xpost_cond_wait(c, l) SleepConditionVariableSRW(c, l, INFINITE, 0)
+# define xpost_cond_broadcast(c) WakeAllConditionVariable(c)
+#else
+typedef int Xpost_Lock;
+typedef int Xpost_Thread;
+# define XPOST_LOCK_INIT 0
+# define xpost_lock_init(l) ((void)(l))
+# define xpost_lock_fini(l) ((void)(l))
+# define xpost_lock(l) ((void)(l))
+# define xpost_unlock(l) ((void)(l))
+typedef int Xpost_Cond;
+# define xpost_cond_init(c) ((void)(c))
+# define xpost_cond_fini(c) ((void)(c))
+# define xpost_cond_wait(c, l) ((void)(c), (void)(l))
+# define xpost_cond_broadcast(c) ((void)(c))
+#endif
+
+#ifndef XPOST_THREADS
+# define XPOST_THREAD_LOCAL
+#elif defined(_MSC_VER)
+# define XPOST_THREAD_LOCAL __declspec(thread)
+#else
+# define XPOST_THREAD_LOCAL __thread
+#endif
+
+/**
+ * @brief start a thread running @p func with @p data.
+ *
+ * @return 1 on success, 0 on failure.
+ */
+int xpost_thread_start(Xpost_Thread *thread, void (*func)(void *), void *data);
+
+/**
+ * @brief wait for the end of a thread started with xpost_thread_start().
+ */
+void xpost_thread_join(Xpost_Thread thread);
+
+/**
+ * @brief return the number of online processors, at least 1.
+ */
+int xpost_cpu_count(void);
+
 /**
  * @}
  */
@@ -47,6 +47,7 @@
 #endif
 
 #include "xpost.h"
+#include "xpost_log.h"
 #include "xpost_compat.h" /* mkstemp */
 #include "xpost_object.h"
 #include "xpost_memory.h"
@@ -54,6 +55,7 @@
 #include "xpost_free.h"  //  initializes free list
 #include "xpost_error.h"
 #include "xpost_save.h"  // initializes save/restore stacks
+#include "xpost_file.h"  // finalizes unreachable files
 
 #include "xpost_context.h"
 
@@ -65,40 +67,109 @@ int xpost_context_init_ctxlist(Xpost_Memory_File *mem)
     Xpost_Memory_Table *tab;
     int ret;
 
-    ret = xpost_memory_table_alloc(mem, MAXCONTEXT * sizeof(unsigned int), 0, &ent);
+    ret = xpost_memory_table_alloc(mem, CTXLISTSIZE * sizeof(unsigned int), 0, &ent);
     if (!ret)
     {
         return 0; /* was unregistered error */
     }
     assert(ent == XPOST_MEMORY_TABLE_SPECIAL_CONTEXT_LIST);
     tab = &mem->table;
-    memset(mem->base + tab->tab[XPOST_MEMORY_TABLE_SPECIAL_CONTEXT_LIST].adr, 0,
-           MAXCONTEXT * sizeof(unsigned int));
+    memset(mem->base + tab->adr[XPOST_MEMORY_TABLE_SPECIAL_CONTEXT_LIST], 0,
+           CTXLISTSIZE * sizeof(unsigned int));
 
     return 1;
 }
 
-/* add a context ID to the context list in mfile */
+/* add a context ID to the context list in mfile.
+   the list doubles when full, the size in use of its entity
+   is the size of the list. */
 int xpost_context_append_ctxlist(Xpost_Memory_File *mem,
                   unsigned int cid)
+{
+    unsigned int n;
+    unsigned int sz;
+    unsigned int adr;
+    Xpost_Memory_Table *tab;
+    unsigned int *ctxlist;
+
+    tab = &mem->table;
+    ctxlist = (void *)(mem->base + tab->adr[XPOST_MEMORY_TABLE_SPECIAL_CONTEXT_LIST]);
+    sz = tab->used[XPOST_MEMORY_TABLE_SPECIAL_CONTEXT_LIST] / sizeof(unsigned int);
+    for (n = 0; ctxlist[n]; n++)
+        ;
+    /* keep the 0 which ends the list */
+    if (n + 1 >= sz)
+    {
+        adr = xpost_free_realloc(mem,
+                                 tab->adr[XPOST_MEMORY_TABLE_SPECIAL_CONTEXT_LIST],
+                                 sz * sizeof(unsigned int),
+                                 2 * sz * sizeof(unsigned int));
+        if (!adr)
+        {
+            XPOST_LOG_ERR("cannot grow context list");
+            return 0;
+        }
+        tab->adr[XPOST_MEMORY_TABLE_SPECIAL_CONTEXT_LIST] = adr;
+        tab->used[XPOST_MEMORY_TABLE_SPECIAL_CONTEXT_LIST] = 2 * sz * sizeof(unsigned int);
+        ctxlist = (void *)(mem->base + adr);
+        memset(ctxlist + sz, 0, sz * sizeof(unsigned int));
+    }
+    ctxlist[n] = cid;
+    return 1;
+}
+
+
+/* replace a context ID in the context list in mfile */
+int xpost_context_replace_ctxlist(Xpost_Memory_File *mem,
+                                  unsigned int oldcid,
+                                  unsigned int newcid)
 {
     int i;
     Xpost_Memory_Table *tab;
     unsigned int *ctxlist;
 
     tab = &mem->table;
-    ctxlist = (void *)(mem->base + tab->tab[XPOST_MEMORY_TABLE_SPECIAL_CONTEXT_LIST].adr);
-    // find first empty
-    for (i=0; i < MAXCONTEXT; i++)
+    ctxlist = (void *)(mem->base + tab->adr[XPOST_MEMORY_TABLE_SPECIAL_CONTEXT_LIST]);
+    for (i=0; ctxlist[i]; i++)
     {
-        if (ctxlist[i] == 0)
+        if (ctxlist[i] == oldcid)
         {
-            ctxlist[i] = cid;
+            ctxlist[i] = newcid;
             return 1;
         }
     }
     return 0;
 }
+int xpost_context_remove_ctxlist(Xpost_Memory_File *mem,
+                                 unsigned int cid)
+{
+    int i, n;
+    Xpost_Memory_Table *tab;
+    unsigned int *ctxlist;
+
+    tab = &mem->table;
+    ctxlist = (void *)(mem->base + tab->adr[XPOST_MEMORY_TABLE_SPECIAL_CONTEXT_LIST]);
+    for (n=0; ctxlist[n]; n++)
+        ;
+    for (i=0; i < n; i++)
+    {
+        if (ctxlist[i] == cid)
+        {
+            /* keep the list packed: the last entry fills the hole */
+            ctxlist[i] = ctxlist[n - 1];
+            ctxlist[n - 1] = 0;
+            return 1;
+        }
+    }
+    return 0;
+}
+unsigned int *xpost_context_get_ctxlist(Xpost_Memory_File *mem)
+{
+    Xpost_Memory_Table *tab;
+
+    tab = &mem->table;
+    return (void *)(mem->base + tab->adr[XPOST_MEMORY_TABLE_SPECIAL_CONTEXT_LIST]);
+}
 
 
 /* build a stack, return address */
@@ -115,8 +186,6 @@ unsigned int makestack(Xpost_Memory_File *mem)
 static
 int initglobal(Xpost_Context *ctx,
                Xpost_Context *(*xpost_interpreter_cid_get_context)(unsigned int cid),
-               int (*xpost_interpreter_get_initializing)(void),
-               void (*xpost_interpreter_set_initializing)(int),
                Xpost_Memory_File *(*xpost_interpreter_alloc_global_memory)(void),
                int (*garbage_collect_function)(Xpost_Memory_File *mem, int dosweep, int markall))
 {
@@ -138,8 +207,7 @@ int initglobal(Xpost_Context *ctx,
 
     fd = mkstemp(g_filenam);
 
-    ret = xpost_memory_file_init(ctx->gl, g_filenam, fd, xpost_interpreter_cid_get_context,
-            xpost_interpreter_get_initializing, xpost_interpreter_set_initializing);
+    ret = xpost_memory_file_init(ctx->gl, g_filenam, fd, xpost_interpreter_cid_get_context);
     if (!ret)
     {
         close(fd);
@@ -159,6 +227,7 @@ int initglobal(Xpost_Context *ctx,
         return 0;
     }
     xpost_memory_register_garbage_collect_function(ctx->gl, garbage_collect_function);
+    xpost_memory_register_finalize_function(ctx->gl, filetype, xpost_file_finalize);
     ret = xpost_save_init(ctx->gl);
     if (!ret)
     {
@@ -191,8 +260,6 @@ int initglobal(Xpost_Context *ctx,
 static
 int initlocal(Xpost_Context *ctx,
               Xpost_Context *(*xpost_interpreter_cid_get_context)(unsigned int cid),
-              int (*xpost_interpreter_get_initializing)(void),
-              void (*xpost_interpreter_set_initializing)(int),
               Xpost_Memory_File *(*xpost_interpreter_alloc_local_memory)(void),
               int (*garbage_collect_function)(Xpost_Memory_File *mem, int dosweep, int markall))
 {
@@ -214,8 +281,7 @@ int initlocal(Xpost_Context *ctx,
 
     fd = mkstemp(l_filenam);
 
-    ret = xpost_memory_file_init(ctx->lo, l_filenam, fd, xpost_interpreter_cid_get_context,
-            xpost_interpreter_get_initializing, xpost_interpreter_set_initializing);
+    ret = xpost_memory_file_init(ctx->lo, l_filenam, fd, xpost_interpreter_cid_get_context);
     if (!ret)
     {
         close(fd);
@@ -238,6 +304,7 @@ int initlocal(Xpost_Context *ctx,
 #ifndef XPOST_NO_GC
     xpost_memory_register_garbage_collect_function(ctx->lo, garbage_collect_function);
 #endif
+    xpost_memory_register_finalize_function(ctx->lo, filetype, xpost_file_finalize);
     ret = xpost_save_init(ctx->lo);
     if (!ret)
     {
@@ -271,50 +338,66 @@ int initlocal(Xpost_Context *ctx,
 }
 
 
-/* initialize context
-   allocates operator table
-   allocates systemdict
-   populates systemdict and optab with operators
+/* initialize a new context
+   allocates its local and global vm
+   returns its cid, 0 on failure
  */
-int xpost_context_init(Xpost_Context *ctx,
-                       int (*xpost_interpreter_cid_init)(unsigned int *cid),
-                       Xpost_Context *(*xpost_interpreter_cid_get_context)(unsigned int cid),
-                       int (*xpost_interpreter_get_initializing)(void),
-                       void (*xpost_interpreter_set_initializing)(int),
-                       Xpost_Memory_File *(*xpost_interpreter_alloc_local_memory)(void),
-                       Xpost_Memory_File *(*xpost_interpreter_alloc_global_memory)(void),
-                       int (*garbage_collect_function)(Xpost_Memory_File *mem, int dosweep, int markall))
+unsigned int xpost_context_init(int (*xpost_interpreter_cid_init)(unsigned int *cid),
+                                void (*xpost_interpreter_cid_release)(unsigned int cid),
+                                Xpost_Context *(*xpost_interpreter_cid_get_context)(unsigned int cid),
+                                Xpost_Memory_File *(*xpost_interpreter_alloc_local_memory)(void),
+                                Xpost_Memory_File *(*xpost_interpreter_alloc_global_memory)(void),
+                                int (*garbage_collect_function)(Xpost_Memory_File *mem, int dosweep, int markall))
 {
+    unsigned int cid;
+    Xpost_Context *ctx;
     int ret;
 
-    ret = xpost_interpreter_cid_init(&ctx->id);
+    ret = xpost_interpreter_cid_init(&cid);
     if (!ret)
         return 0;
+    ctx = xpost_interpreter_cid_get_context(cid);
+    /* the entry may have held a context which ended */
+    memset(ctx, 0, sizeof *ctx);
+    ctx->id = cid;
     ctx->state = C_IDLE;
 
     ret = initlocal(ctx, xpost_interpreter_cid_get_context, 
-            xpost_interpreter_get_initializing, xpost_interpreter_set_initializing, 
             xpost_interpreter_alloc_local_memory, garbage_collect_function);
     if (!ret)
     {
+        xpost_interpreter_cid_release(cid);
         return 0;
     }
     ret = initglobal(ctx, xpost_interpreter_cid_get_context, 
-            xpost_interpreter_get_initializing, xpost_interpreter_set_initializing, 
             xpost_interpreter_alloc_global_memory, garbage_collect_function);
     if (!ret)
     {
         xpost_memory_file_exit(ctx->lo);
+        xpost_interpreter_cid_release(cid);
         return 0;
     }
     ctx->event_handler = null;
     ctx->ignoreinvalidaccess = 0;
+    ctx->binseq = 0;
+    ctx->ioyield = 0;
+    ctx->iofd = -1;
+    ctx->running = 0;
+    ctx->jobsave = null;
+    ctx->step_ops = -1;
+    ctx->step_end = 0;
+    ctx->page_func = NULL;
+    ctx->page_data = NULL;
+    ctx->joiner = 0;
+    ctx->detached = 0;
+    ctx->in_onerror = 0;
     ctx->xpost_interpreter_cid_init = xpost_interpreter_cid_init;
+    ctx->xpost_interpreter_cid_release = xpost_interpreter_cid_release;
     ctx->xpost_interpreter_alloc_local_memory = xpost_interpreter_alloc_local_memory;
     ctx->xpost_interpreter_alloc_global_memory = xpost_interpreter_alloc_global_memory;
     ctx->garbage_collect_function = garbage_collect_function;
 
-    return 1;
+    return cid;
 }
 
 /* destroy context
@@ -324,6 +407,8 @@ void xpost_context_exit(Xpost_Context *ctx)
 {
     xpost_memory_file_exit(ctx->gl);
     xpost_memory_file_exit(ctx->lo);
+    free(ctx->snapshot);
+    ctx->snapshot = NULL;
 }
 
 /* return the appropriate global or local memory file for the composite object */
@@ -361,8 +446,6 @@ int xpost_context_install_event_handler(Xpost_Context *ctx,
 unsigned int xpost_context_fork1(Xpost_Context *ctx,
                                  int (*xpost_interpreter_cid_init)(unsigned int *cid),
                                  Xpost_Context *(*xpost_interpreter_cid_get_context)(unsigned int cid),
-                                 int (*xpost_interpreter_get_initializing)(void),
-                                 void (*xpost_interpreter_set_initializing)(int),
                                  Xpost_Memory_File *(*xpost_interpreter_alloc_local_memory)(void),
                                  Xpost_Memory_File *(*xpost_interpreter_alloc_global_memory)(void),
                                  int (*garbage_collect_function)(Xpost_Memory_File *mem, int dosweep, int markall))
@@ -379,10 +462,8 @@ unsigned int xpost_context_fork1(Xpost_Context *ctx,
     newctx->id = newcid;
     newctx->state = C_IDLE;
     initlocal(newctx, xpost_interpreter_cid_get_context, 
-            xpost_interpreter_get_initializing, xpost_interpreter_set_initializing, 
             xpost_interpreter_alloc_local_memory, garbage_collect_function);
     initglobal(newctx, xpost_interpreter_cid_get_context, 
-            xpost_interpreter_get_initializing, xpost_interpreter_set_initializing, 
             xpost_interpreter_alloc_global_memory, garbage_collect_function);
     newctx->vmmode = LOCAL;
     return newcid;
@@ -395,8 +476,6 @@ unsigned int xpost_context_fork1(Xpost_Context *ctx,
 unsigned int xpost_context_fork2(Xpost_Context *ctx,
                                  int (*xpost_interpreter_cid_init)(unsigned int *cid),
                                  Xpost_Context *(*xpost_interpreter_cid_get_context)(unsigned int cid),
-                                 int (*xpost_interpreter_get_initializing)(void),
-                                 void (*xpost_interpreter_set_initializing)(int),
                                  Xpost_Memory_File *(*xpost_interpreter_alloc_local_memory)(void),
                                  Xpost_Memory_File *(*xpost_interpreter_alloc_global_memory)(void),
                                  int (*garbage_collect_function)(Xpost_Memory_File *mem, int dosweep, int markall))
@@ -413,7 +492,6 @@ unsigned int xpost_context_fork2(Xpost_Context *ctx,
     newctx->id = newcid;
     newctx->state = C_IDLE;
     initlocal(ctx, xpost_interpreter_cid_get_context, 
-            xpost_interpreter_get_initializing, xpost_interpreter_set_initializing, 
             xpost_interpreter_alloc_local_memory, garbage_collect_function);
     newctx->gl = ctx->gl;
     xpost_context_append_ctxlist(newctx->gl, newcid);
@@ -436,6 +514,7 @@ unsigned int xpost_context_fork3(Xpost_Context *ctx,
     unsigned int newcid;
     Xpost_Context *newctx;
     int ret;
+    int i;
 
     (void)xpost_interpreter_alloc_global_memory;
     (void)xpost_interpreter_alloc_local_memory;
@@ -446,10 +525,21 @@ unsigned int xpost_context_fork3(Xpost_Context *ctx,
     *newctx = *ctx; // struct copy for defaults
     newctx->id = newcid;
     newctx->state = C_IDLE;
+    newctx->queued = 0;
+    newctx->iofd = -1;
     newctx->lo = ctx->lo;
-    xpost_context_append_ctxlist(newctx->lo, newcid);
     newctx->gl = ctx->gl;
-    xpost_context_append_ctxlist(newctx->gl, newcid);
+    if (!xpost_context_append_ctxlist(newctx->lo, newcid))
+    {
+        ctx->xpost_interpreter_cid_release(newcid);
+        return 0;
+    }
+    if (!xpost_context_append_ctxlist(newctx->gl, newcid))
+    {
+        xpost_context_remove_ctxlist(newctx->lo, newcid);
+        ctx->xpost_interpreter_cid_release(newcid);
+        return 0;
+    }
 
     newctx->os = makestack(newctx->lo);
     newctx->es = makestack(newctx->lo);
@@ -457,10 +547,82 @@ unsigned int xpost_context_fork3(Xpost_Context *ctx,
     newctx->hold = makestack(newctx->lo);
     newctx->lo->start = XPOST_MEMORY_TABLE_SPECIAL_BOGUS_NAME + 1;
 
-    xpost_stack_push(newctx->lo, newctx->ds,
-            xpost_stack_bottomup_fetch(ctx->lo, ctx->ds, 0)); // systemdict
-    printf("fork cid %u, ctx->id %u\n", newcid, newctx->id);
+    /* systemdict, globaldict and userdict, shared through the vm */
+    for (i = 0; i < 3 && i < xpost_stack_count(ctx->lo, ctx->ds); i++)
+        xpost_stack_push(newctx->lo, newctx->ds,
+                xpost_stack_bottomup_fetch(ctx->lo, ctx->ds, i));
     return newcid;
 }
 
+/*
+   end a process made by xpost_context_fork3.
+   its stacks are left to the garbage collector.
+   */
+void xpost_context_fork_free(Xpost_Context *ctx)
+{
+    xpost_context_remove_ctxlist(ctx->lo, ctx->id);
+    xpost_context_remove_ctxlist(ctx->gl, ctx->id);
+    ctx->xpost_interpreter_cid_release(ctx->id);
+}
+
+/*
+   make new process with private copies of the frozen global
+   and local vm of ctx, which are shared until written
+   (pooled "job")
+   */
+unsigned int xpost_context_clone(Xpost_Context *ctx,
+                                 int (*xpost_interpreter_cid_init)(unsigned int *cid),
+                                 Xpost_Context *(*xpost_interpreter_cid_get_context)(unsigned int cid),
+                                 Xpost_Memory_File *(*xpost_interpreter_alloc_local_memory)(void),
+                                 Xpost_Memory_File *(*xpost_interpreter_alloc_global_memory)(void))
+{
+    unsigned int newcid;
+    Xpost_Context *newctx;
+    Xpost_Memory_File *lo;
+    Xpost_Memory_File *gl;
+    int ret;
+
+    if (!ctx->snapshot || !ctx->lo->frozen || !ctx->gl->frozen)
+    {
+        XPOST_LOG_ERR("context must be frozen to be cloned");
+        return 0;
+    }
+
+    lo = xpost_interpreter_alloc_local_memory();
+    if (!lo || !xpost_memory_file_clone(lo, ctx->lo))
+        return 0;
+    gl = xpost_interpreter_alloc_global_memory();
+    if (!gl || !xpost_memory_file_clone(gl, ctx->gl))
+    {
+        xpost_memory_file_exit(lo);
+        return 0;
+    }
+    ret = xpost_interpreter_cid_init(&newcid);
+    if (!ret)
+    {
+        xpost_memory_file_exit(gl);
+        xpost_memory_file_exit(lo);
+        return 0;
+    }
 
+    newctx = xpost_interpreter_cid_get_context(newcid);
+    *newctx = *ctx->snapshot; // struct copy of the frozen state
+    newctx->id = newcid;
+    newctx->state = C_IDLE;
+    newctx->lo = lo;
+    newctx->gl = gl;
+    newctx->origin = ctx->id;
+    xpost_context_replace_ctxlist(newctx->lo, ctx->id, newcid);
+    xpost_context_replace_ctxlist(newctx->gl, ctx->id, newcid);
+
+    newctx->snapshot = malloc(sizeof *newctx->snapshot);
+    if (!newctx->snapshot)
+    {
+        XPOST_LOG_ERR("cannot allocate context snapshot");
+        xpost_context_exit(newctx);
+        newctx->xpost_interpreter_cid_release(newcid);
+        return 0;
+    }
+    *newctx->snapshot = *newctx;
+    return newcid;
+}
@@ -41,7 +41,10 @@
  * @{
  */
 
-#define MAXCONTEXT 10
+/**
+ * @brief initial size of the context list of a memory file (which then grows, automatically)
+ */
+#define CTXLISTSIZE 16
 
 /**
  * @brief valid values for Xpost_Context::vmmode
@@ -72,8 +75,62 @@ struct _Xpost_Context {
         int itransform;
         int rotate;
         int concatmatrix;
+        int currentpoint;
+        int moveto;
+        int moveto_cont;
+        int rmoveto_cont;
+        int lineto;
+        int lineto_cont;
+        int rlineto_cont;
+        int curveto;
+        int curveto_cont1;
+        int curveto_cont2;
+        int curveto_cont3;
+        int rcurveto_cont;
+        int bgr_create_cont;
+        int loadbgrdevicecont;
+        int png_create_cont;
+        int loadpngdevicecont;
+        int raster_create_cont;
+        int loadrasterdevicecont;
+        int xcb_create_cont;
+        int xcb_event_handler;
+        int loadxcbdevicecont;
+        int win32_create_cont;
+        int win32_event_handler;
+        int loadwin32devicecont;
     } opcode_shortcuts;  /**< opcodes for internal use, to avoid lookups */
 
+    struct
+    {
+        Xpost_Object dollarerror;
+        Xpost_Object errordict;
+        Xpost_Object Private;
+        Xpost_Object width;
+        Xpost_Object height;
+        Xpost_Object dotcopydict;
+        Xpost_Object nativecolorspace;
+        Xpost_Object DeviceGray;
+        Xpost_Object DeviceRGB;
+        Xpost_Object roll;
+        Xpost_Object DrawLine;
+        Xpost_Object exec;
+        Xpost_Object repeat;
+        Xpost_Object cvx;
+        Xpost_Object Rbracket;
+        Xpost_Object graphicsdict;
+        Xpost_Object currgstate;
+        Xpost_Object currpath;
+        Xpost_Object cmd;
+        Xpost_Object data;
+        Xpost_Object move;
+        Xpost_Object line;
+        Xpost_Object curve;
+        Xpost_Object close;
+    } name_shortcuts;  /**< names for internal use, to avoid lookups */
+
+    Xpost_Object arc_start_proc; /**< procedure run by arc and arcn before the first curve */
+
     Xpost_Object currentobject;  /**< currently-executing object, for error() */
 
     /*@dependent@*/
@@ -88,14 +145,33 @@ struct _Xpost_Context {
     unsigned int vmmode; /**< allocating in GLOBAL or LOCAL */
     unsigned int state;  /**< process state: running, blocked, iowait */
     unsigned int quit;  /**< if 1 cause mainloop() to return, if 0 keep looping */
+    unsigned int joiner; /**< cid of the context waiting in join for this one, 0 if none */
+    int detached; /**< freed when done, without waiting for join */
+    int queued; /**< in the run queue of its job, see mainloop() */
 
     Xpost_Object event_handler;
     Xpost_Object window_device;
     const char *device_str;
 
     int ignoreinvalidaccess; //briefly allow invalid access to put userdict in systemdict (per PLRM)
+    int binseq; /**< the last token scanned was a binary object sequence, executed immediately */
+    int ioyield; /**< a blocked read returns to the caller of xpost_run */
+    int iofd; /**< the descriptor a blocked read waits on, -1 if none */
+    int running; /**< a job is started and has not ended, see xpost_step() */
+    Xpost_Object jobsave; /**< the save of local vm the job ends with, null if frozen */
+    long step_ops; /**< evals the job may still run in xpost_step(), -1 if not bounded */
+    double step_end; /**< time in microseconds xpost_step() returns at, 0 if not bounded */
+    Xpost_Page_Func page_func; /**< called with each page of the raster devices, NULL if none */
+    void *page_data; /**< the data passed to page_func */
+    int in_onerror; /**< depth of nested calls to the error handler */
+    int tracing; /**< log each object executed */
+    int debugload; /**< dump the dictionaries searched by load */
+
+    struct _Xpost_Context *snapshot; /**< copy of the context made by xpost_freeze() */
+    unsigned int origin; /**< cid of the context this one is a clone of, 0 if none */
 
     int (*xpost_interpreter_cid_init)(unsigned int *cid);
+    void (*xpost_interpreter_cid_release)(unsigned int cid);
     Xpost_Memory_File *(*xpost_interpreter_alloc_local_memory)(void);
     Xpost_Memory_File *(*xpost_interpreter_alloc_global_memory)(void);
     int (*garbage_collect_function)(Xpost_Memory_File *mem, int dosweep, int markall);
@@ -105,16 +181,14 @@ int xpost_context_init_ctxlist(Xpost_Memory_File *mem);
 int xpost_context_append_ctxlist(Xpost_Memory_File *mem, unsigned cid);
 
 /**
- * @brief initialize the context structure
+ * @brief initialize a new context, returning its cid or 0
  */
-int xpost_context_init(Xpost_Context *ctx,
-                       int (*xpost_interpreter_cid_init)(unsigned int *cid),
-                       Xpost_Context *(*xpost_interpreter_cid_get_context)(unsigned int cid),
-                       int (*xpost_interpreter_get_initializing)(void),
-                       void (*xpost_interpreter_set_initializing)(int),
-                       Xpost_Memory_File *(*xpost_interpreter_alloc_local_memory)(void),
-                       Xpost_Memory_File *(*xpost_interpreter_alloc_global_memory)(void),
-                       int (*garbage_collect_function)(Xpost_Memory_File *mem, int dosweep, int markall));
+unsigned int xpost_context_init(int (*xpost_interpreter_cid_init)(unsigned int *cid),
+                                void (*xpost_interpreter_cid_release)(unsigned int cid),
+                                Xpost_Context *(*xpost_interpreter_cid_get_context)(unsigned int cid),
+                                Xpost_Memory_File *(*xpost_interpreter_alloc_local_memory)(void),
+                                Xpost_Memory_File *(*xpost_interpreter_alloc_global_memory)(void),
+                                int (*garbage_collect_function)(Xpost_Memory_File *mem, int dosweep, int markall));
 
 /**
  * @brief destroy the context structure, and all components
@@ -146,8 +220,6 @@ int xpost_context_install_event_handler(Xpost_Context *ctx,
 unsigned int xpost_context_fork1(Xpost_Context *ctx,
                                  int (*xpost_interpreter_cid_init)(unsigned int *cid),
                                  Xpost_Context *(*xpost_interpreter_cid_get_context)(unsigned int cid),
-                                 int (*xpost_interpreter_get_initializing)(void),
-                                 void (*xpost_interpreter_set_initializing)(int),
                                  Xpost_Memory_File *(*xpost_interpreter_alloc_local_memory)(void),
                                  Xpost_Memory_File *(*xpost_interpreter_alloc_global_memory)(void),
                                  int (*garbage_collect_function)(Xpost_Memory_File *mem, int dosweep, int markall));
@@ -158,8 +230,6 @@ unsigned int xpost_context_fork1(Xpost_Context *ctx,
 unsigned int xpost_context_fork2(Xpost_Context *ctx,
                                  int (*xpost_interpreter_cid_init)(unsigned int *cid),
                                  Xpost_Context *(*xpost_interpreter_cid_get_context)(unsigned int cid),
-                                 int (*xpost_interpreter_get_initializing)(void),
-                                 void (*xpost_interpreter_set_initializing)(int),
                                  Xpost_Memory_File *(*xpost_interpreter_alloc_local_memory)(void),
                                  Xpost_Memory_File *(*xpost_interpreter_alloc_global_memory)(void),
                                  int (*garbage_collect_function)(Xpost_Memory_File *mem, int dosweep, int markall));
@@ -174,6 +244,41 @@ unsigned int xpost_context_fork3(Xpost_Context *ctx,
                                  Xpost_Memory_File *(*xpost_interpreter_alloc_global_memory)(void),
                                  int (*garbage_collect_function)(Xpost_Memory_File *mem, int dosweep, int markall));
 
+/**
+ * @brief make a new process with private copies of the frozen vm of ctx (pool)
+ */
+unsigned int xpost_context_clone(Xpost_Context *ctx,
+                                 int (*xpost_interpreter_cid_init)(unsigned int *cid),
+                                 Xpost_Context *(*xpost_interpreter_cid_get_context)(unsigned int cid),
+                                 Xpost_Memory_File *(*xpost_interpreter_alloc_local_memory)(void),
+                                 Xpost_Memory_File *(*xpost_interpreter_alloc_global_memory)(void));
+
+/**
+ * @brief replace a context ID in the context list of mfile
+ */
+int xpost_context_replace_ctxlist(Xpost_Memory_File *mem,
+                                  unsigned int oldcid,
+                                  unsigned int newcid);
+
+/**
+ * @brief remove a context ID from the context list of mfile
+ */
+int xpost_context_remove_ctxlist(Xpost_Memory_File *mem,
+                                 unsigned int cid);
+
+/**
+ * @brief return the context list of mfile:
+ * the IDs of its contexts, the first 0 ends the list.
+ * The list moves when it grows, so do not keep the pointer across an append.
+ */
+unsigned int *xpost_context_get_ctxlist(Xpost_Memory_File *mem);
+
+/**
+ * @brief end a process made by xpost_context_fork3(),
+ * and make its context table entry free
+ */
+void xpost_context_fork_free(Xpost_Context *ctx);
+
 /**
  * @}
  */
@@ -51,6 +51,7 @@
 
 #include "xpost_operator.h" /* create operators */
 #include "xpost_op_dict.h" /* call load operator for convenience */
+#include "xpost_dev_generic.h" /* finalize the private data */
 #include "xpost_dev_bgr.h" /* check prototypes */
 
 #define FAST_C_BUFFER
@@ -60,33 +61,40 @@ typedef struct
     unsigned char blue, green, red;
 } Xpost_Bgr_Pixel;
 
-typedef struct
-{
-    int width, height, byte_stride;
-    Xpost_Bgr_Pixel data[1];
-} Xpost_Bgr_Buffer;
-
 typedef struct
 {
     int width, height;
     /*
      * add additional members to private struct
      */
+    int page; /* pages emitted */
 #ifdef FAST_C_BUFFER
-    Xpost_Bgr_Buffer *buf;
+    unsigned char *data; /* the page, rows from the top */
+    int stride; /* bytes per row */
+    int own; /* data was allocated by the device, not given by the client */
 #endif
 } PrivateData;
 
 
-static Xpost_Object namePrivate;
-static Xpost_Object namewidth;
-static Xpost_Object nameheight;
-static Xpost_Object namedotcopydict;
-static Xpost_Object namenativecolorspace;
-static Xpost_Object nameDeviceRGB;
+#ifdef FAST_C_BUFFER
+
+/* free the page of a device which became garbage */
+static
+int _finalize(Xpost_Memory_File *mem,
+              unsigned int ent)
+{
+    PrivateData private;
+
+    if (!xpost_memory_get(mem, ent, 0, sizeof(private), &private))
+        return 0;
+
+    if (private.own)
+        free(private.data);
 
+    return 1;
+}
 
-static unsigned int _create_cont_opcode;
+#endif
 
 /* create an instance of the device
    using the class .copydict procedure */
@@ -99,8 +107,8 @@ int _create(Xpost_Context *ctx,
     xpost_stack_push(ctx->lo, ctx->os, width);
     xpost_stack_push(ctx->lo, ctx->os, height);
     xpost_stack_push(ctx->lo, ctx->os, classdic);
-    xpost_dict_put(ctx, classdic, namewidth, width);
-    xpost_dict_put(ctx, classdic, nameheight, height);
+    xpost_dict_put(ctx, classdic, ctx->name_shortcuts.width, width);
+    xpost_dict_put(ctx, classdic, ctx->name_shortcuts.height, height);
 
     //printf("create\n");
     //fflush(0);
@@ -108,11 +116,11 @@ int _create(Xpost_Context *ctx,
        //call base-class's Create procedure (to initialize ImgData array)
        then call _create_cont, by continuation. */
     if (!xpost_stack_push(ctx->lo, ctx->es,
-                          xpost_operator_cons_opcode(_create_cont_opcode)))
+                          xpost_operator_cons_opcode(ctx->opcode_shortcuts.bgr_create_cont)))
         return execstackoverflow;
 
     if (!xpost_stack_push(ctx->lo, ctx->es,
-                          xpost_dict_get(ctx, classdic, namedotcopydict)))
+                          xpost_dict_get(ctx, classdic, ctx->name_shortcuts.dotcopydict)))
         return execstackoverflow;
 
     return 0;
@@ -130,6 +138,9 @@ int _create_cont(Xpost_Context *ctx,
     PrivateData private;
     integer width = w.int_.val;
     integer height = h.int_.val;
+#ifdef FAST_C_BUFFER
+    Xpost_Object inbufstr;
+#endif
     //printf("create_cont\n");
 
     /* create a string to contain device data structure */
@@ -139,10 +150,11 @@ int _create_cont(Xpost_Context *ctx,
         XPOST_LOG_ERR("cannot allocat private data structure");
         return unregistered;
     }
-    xpost_dict_put(ctx, devdic, namePrivate, privatestr);
+    xpost_dict_put(ctx, devdic, ctx->name_shortcuts.Private, privatestr);
 
     private.width = width;
     private.height = height;
+    private.page = 0;
 
     /*
      *
@@ -151,9 +163,44 @@ int _create_cont(Xpost_Context *ctx,
      */
 
 #ifdef FAST_C_BUFFER
+    inbufstr = xpost_dict_get(ctx, xpost_stack_bottomup_fetch(ctx->lo, ctx->ds, 0),
+                              xpost_name_cons(ctx, "OutputBufferIn"));
+    if (xpost_object_get_type(inbufstr) == stringtype)
     {
-        /* allocate buffer header and array */
-        private.buf = malloc(sizeof(Xpost_Bgr_Buffer) + sizeof(Xpost_Bgr_Pixel)*width*height);
+        Xpost_Output_Buffer inbuf;
+
+        /* draw into the client's memory */
+        memcpy(&inbuf, xpost_string_get_pointer(ctx, inbufstr), sizeof(inbuf));
+        if (inbuf.format != XPOST_PIXEL_FORMAT_BGR)
+        {
+            XPOST_LOG_ERR("bgr device needs a bgr output buffer");
+            return unregistered;
+        }
+        if (inbuf.stride < inbuf.width * (int)sizeof(Xpost_Bgr_Pixel))
+        {
+            XPOST_LOG_ERR("output buffer stride too small");
+            return unregistered;
+        }
+        private.data = inbuf.pixels;
+        private.stride = inbuf.stride;
+        private.own = 0;
+
+        /* a device made by the program may not draw past the buffer */
+        if (private.width > inbuf.width)
+            private.width = inbuf.width;
+        if (private.height > inbuf.height)
+            private.height = inbuf.height;
+    }
+    else
+    {
+        private.stride = width * sizeof(Xpost_Bgr_Pixel);
+        private.data = malloc(private.stride * height);
+        if (!private.data)
+        {
+            XPOST_LOG_ERR("cannot allocate buffer memory");
+            return unregistered;
+        }
+        private.own = 1;
     }
 #else
     { /*
@@ -197,6 +244,11 @@ int _create_cont(Xpost_Context *ctx,
     xpost_memory_put(xpost_context_select_memory(ctx, privatestr),
                      xpost_object_get_ent(privatestr), 0,
                      sizeof(private), &private);
+#ifdef FAST_C_BUFFER
+    if (private.own)
+        xpost_device_set_private_finalizer(ctx, privatestr,
+                                           XPOST_DEVICE_PRIVATE_TAG_BGR, _finalize);
+#endif
 
     /* return device instance dictionary to ps */
     xpost_stack_push(ctx->lo, ctx->os, devdic);
@@ -236,7 +288,7 @@ int _putpix(Xpost_Context *ctx,
         y = xpost_int_cons(y.real_.val);
 
     /* load private data struct from string */
-    privatestr = xpost_dict_get(ctx, devdic, namePrivate);
+    privatestr = xpost_dict_get(ctx, devdic, ctx->name_shortcuts.Private);
     if (xpost_object_get_type(privatestr) == invalidtype)
         return undefined;
     xpost_memory_get(xpost_context_select_memory(ctx, privatestr),
@@ -251,14 +303,134 @@ int _putpix(Xpost_Context *ctx,
         return 0;
 
     {
-        Xpost_Bgr_Pixel pixel;
-        pixel.blue = blue.int_.val;
-        pixel.green = green.int_.val;
-        pixel.red = red.int_.val;
-        private.buf->data[y.int_.val * private.width + x.int_.val] = pixel;
+        Xpost_Bgr_Pixel *pixel;
+
+        pixel = (Xpost_Bgr_Pixel *)(private.data + y.int_.val * private.stride) + x.int_.val;
+        pixel->blue = blue.int_.val;
+        pixel->green = green.int_.val;
+        pixel->red = red.int_.val;
     }
 
-    /* save private data struct in string */
+    return 0;
+}
+
+/* fill the rectangle in place, rather than with PutPix for each pixel.
+   the far edges are inclusive, as in the PPMIMAGE FillRect */
+static
+int _fillrect(Xpost_Context *ctx,
+              Xpost_Object red,
+              Xpost_Object green,
+              Xpost_Object blue,
+              Xpost_Object x,
+              Xpost_Object y,
+              Xpost_Object width,
+              Xpost_Object height,
+              Xpost_Object devdic)
+{
+    Xpost_Object privatestr;
+    PrivateData private;
+    Xpost_Bgr_Pixel pixel;
+    Xpost_Bgr_Pixel *row;
+    int x0, y0, x1, y1;
+    int i;
+
+    /* fold numbers to integertype */
+    if (xpost_object_get_type(red) == realtype)
+        red = xpost_int_cons(red.real_.val * 255.0);
+    else
+        red.int_.val *= 255;
+    if (xpost_object_get_type(green) == realtype)
+        green = xpost_int_cons(green.real_.val * 255.0);
+    else
+        green.int_.val *= 255;
+    if (xpost_object_get_type(blue) == realtype)
+        blue = xpost_int_cons(blue.real_.val * 255.0);
+    else
+        blue.int_.val *= 255;
+    if (xpost_object_get_type(x) == realtype)
+        x = xpost_int_cons(x.real_.val);
+    if (xpost_object_get_type(y) == realtype)
+        y = xpost_int_cons(y.real_.val);
+    if (xpost_object_get_type(width) == realtype)
+        width = xpost_int_cons(width.real_.val);
+    if (xpost_object_get_type(height) == realtype)
+        height = xpost_int_cons(height.real_.val);
+
+    /* adjust ranges */
+    if (width.int_.val < 0)
+    {
+        width.int_.val = abs(width.int_.val);
+        x.int_.val -= width.int_.val;
+    }
+    if (height.int_.val < 0)
+    {
+        height.int_.val = abs(height.int_.val);
+        y.int_.val -= height.int_.val;
+    }
+
+    /* load private data struct from string */
+    privatestr = xpost_dict_get(ctx, devdic, ctx->name_shortcuts.Private);
+    if (xpost_object_get_type(privatestr) == invalidtype)
+        return undefined;
+    xpost_memory_get(xpost_context_select_memory(ctx, privatestr),
+                     xpost_object_get_ent(privatestr), 0,
+                     sizeof(private), &private);
+
+    /* clip */
+    x0 = x.int_.val < 0 ? 0 : x.int_.val;
+    y0 = y.int_.val < 0 ? 0 : y.int_.val;
+    x1 = x.int_.val + width.int_.val;
+    y1 = y.int_.val + height.int_.val;
+    if (x1 >= private.width)
+        x1 = private.width - 1;
+    if (y1 >= private.height)
+        y1 = private.height - 1;
+    if (x0 > x1 || y0 > y1)
+        return 0;
+
+    /* paint the first row, and copy it to the others */
+    pixel.blue = blue.int_.val;
+    pixel.green = green.int_.val;
+    pixel.red = red.int_.val;
+    row = (Xpost_Bgr_Pixel *)(private.data + y0 * private.stride) + x0;
+    for (i = 0; i <= x1 - x0; i++)
+    {
+        row[i] = pixel;
+    }
+    for (i = 1; i <= y1 - y0; i++)
+    {
+        memcpy((unsigned char *)row + i * private.stride, row,
+               (x1 - x0 + 1) * sizeof(Xpost_Bgr_Pixel));
+    }
+
+    return 0;
+}
+
+#endif
+
+#ifdef FAST_C_BUFFER
+
+static
+int _destroy(Xpost_Context *ctx,
+             Xpost_Object devdic)
+{
+    Xpost_Object privatestr;
+    PrivateData private;
+
+    /* load private data struct from string */
+    privatestr = xpost_dict_get(ctx, devdic, ctx->name_shortcuts.Private);
+    if (xpost_object_get_type(privatestr) == invalidtype)
+        return undefined;
+    xpost_memory_get(xpost_context_select_memory(ctx, privatestr),
+                     xpost_object_get_ent(privatestr), 0,
+                     sizeof(private), &private);
+
+    if (private.own)
+        free(private.data);
+
+    /* leave nothing for the finalizer */
+    private.data = NULL;
+    private.own = 0;
     xpost_memory_put(xpost_context_select_memory(ctx, privatestr),
                      xpost_object_get_ent(privatestr), 0,
                      sizeof(private), &private);
@@ -276,7 +448,7 @@ int _flush(Xpost_Context *ctx,
     PrivateData private;
 
     /* load private data struct from string */
-    privatestr = xpost_dict_get(ctx, devdic, namePrivate);
+    privatestr = xpost_dict_get(ctx, devdic, ctx->name_shortcuts.Private);
     if (xpost_object_get_type(privatestr) == invalidtype)
         return undefined;
     xpost_memory_get(xpost_context_select_memory(ctx, privatestr),
@@ -294,6 +466,7 @@ int _emit(Xpost_Context *ctx,
     Xpost_Object privatestr;
     PrivateData private;
     unsigned char *data;
+    int rowbytes;
 #ifndef FAST_C_BUFFER
     Xpost_Object imgdata;
     int stride;
@@ -301,7 +474,7 @@ int _emit(Xpost_Context *ctx,
 #endif
 
     /* load private data struct from string */
-    privatestr = xpost_dict_get(ctx, devdic, namePrivate);
+    privatestr = xpost_dict_get(ctx, devdic, ctx->name_shortcuts.Private);
     if (xpost_object_get_type(privatestr) == invalidtype)
         return undefined;
     xpost_memory_get(xpost_context_select_memory(ctx, privatestr),
@@ -309,13 +482,15 @@ int _emit(Xpost_Context *ctx,
                      sizeof(private), &private);
 
 #ifdef FAST_C_BUFFER
-    data = (unsigned char *)private.buf->data;
+    data = private.data;
+    rowbytes = private.stride;
 #else
 
     stride = private.width;
     height = private.height;
 
-    data = malloc(stride * height * 3);
+    rowbytes = stride * 3;
+    data = malloc(rowbytes * height);
     imgdata = xpost_dict_get(ctx, devdic, xpost_name_cons(ctx, "ImgData"));
     if (xpost_object_get_type(imgdata) == invalidtype)
         return undefined;
@@ -350,6 +525,17 @@ int _emit(Xpost_Context *ctx,
     }
 #endif
 
+    ++private.page;
+    xpost_memory_put(xpost_context_select_memory(ctx, privatestr),
+                     xpost_object_get_ent(privatestr), 0,
+                     sizeof(private), &private);
+
+    /* lend the buffer to the page callback */
+    if (ctx->page_func)
+        ctx->page_func(ctx, private.page, data,
+                       private.width, private.height, rowbytes,
+                       XPOST_PIXEL_FORMAT_BGR, ctx->page_data);
+
     /*pass data back to client application */
     {
         Xpost_Object sd, outbufstr;
@@ -367,7 +553,6 @@ int _emit(Xpost_Context *ctx,
 }
 
 
-
 /* operator function to instantiate a new window device.
    installed in userdict by calling 'loadXXXdevice'.
  */
@@ -392,8 +577,6 @@ int newbgrdevice(Xpost_Context *ctx,
     return 0;
 }
 
-static
-unsigned int _loadbgrdevicecont_opcode;
 
 /* Specializes or sub-classes the PPMIMAGE device class.
    load PPMIMAGE
@@ -411,10 +594,10 @@ int loadbgrdevice(Xpost_Context *ctx)
         return ret;
     classdic = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 0);
     if (!xpost_stack_push(ctx->lo, ctx->es,
-                          xpost_operator_cons_opcode(_loadbgrdevicecont_opcode)))
+                          xpost_operator_cons_opcode(ctx->opcode_shortcuts.loadbgrdevicecont)))
         return execstackoverflow;
     if (!xpost_stack_push(ctx->lo, ctx->es,
-                          xpost_dict_get(ctx, classdic, namedotcopydict)))
+                          xpost_dict_get(ctx, classdic, ctx->name_shortcuts.dotcopydict)))
         return execstackoverflow;
 
     return 0;
@@ -432,10 +615,10 @@ int loadbgrdevicecont(Xpost_Context *ctx,
     Xpost_Object op;
     int ret;
 
-    ret = xpost_dict_put(ctx, classdic, namenativecolorspace, nameDeviceRGB);
+    ret = xpost_dict_put(ctx, classdic, ctx->name_shortcuts.nativecolorspace, ctx->name_shortcuts.DeviceRGB);
 
     op = xpost_operator_cons(ctx, "bgrCreateCont", (Xpost_Op_Func)_create_cont, 1, 3, integertype, integertype, dicttype);
-    _create_cont_opcode = op.mark_.padw;
+    ctx->opcode_shortcuts.bgr_create_cont = op.mark_.padw;
     op = xpost_operator_cons(ctx, "bgrCreate", (Xpost_Op_Func)_create, 1, 3, integertype, integertype, dicttype);
     ret = xpost_dict_put(ctx, classdic, xpost_name_cons(ctx, "Create"), op);
     if (ret)
@@ -449,6 +632,20 @@ int loadbgrdevicecont(Xpost_Context *ctx,
     ret = xpost_dict_put(ctx, classdic, xpost_name_cons(ctx, "PutPix"), op);
     if (ret)
         return ret;
+
+    op = xpost_operator_cons(ctx, "bgrFillRect", (Xpost_Op_Func)_fillrect, 0, 8,
+                             numbertype, numbertype, numbertype, /* r g b color values */
+                             numbertype, numbertype, /* x y */
+                             numbertype, numbertype, /* width height */
+                             dicttype); /* devdic */
+    ret = xpost_dict_put(ctx, classdic, xpost_name_cons(ctx, "FillRect"), op);
+    if (ret)
+        return ret;
+
+    op = xpost_operator_cons(ctx, "bgrDestroy", (Xpost_Op_Func)_destroy, 0, 1, dicttype);
+    ret = xpost_dict_put(ctx, classdic, xpost_name_cons(ctx, "Destroy"), op);
+    if (ret)
+        return ret;
 #endif
 
     op = xpost_operator_cons(ctx, "bgrEmit", (Xpost_Op_Func)_emit, 0, 1, dicttype);
@@ -487,17 +684,17 @@ int xpost_oper_init_bgr_device_ops(Xpost_Context *ctx,
     Xpost_Object n,op;
 
     /* factor-out name lookups from the operators (optimization) */
-    if (xpost_object_get_type((namePrivate = xpost_name_cons(ctx, "Private"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.Private = xpost_name_cons(ctx, "Private"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((namewidth = xpost_name_cons(ctx, "width"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.width = xpost_name_cons(ctx, "width"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((nameheight = xpost_name_cons(ctx, "height"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.height = xpost_name_cons(ctx, "height"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((namedotcopydict = xpost_name_cons(ctx, ".copydict"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.dotcopydict = xpost_name_cons(ctx, ".copydict"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((namenativecolorspace = xpost_name_cons(ctx, "nativecolorspace"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.nativecolorspace = xpost_name_cons(ctx, "nativecolorspace"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((nameDeviceRGB = xpost_name_cons(ctx, "DeviceRGB"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.DeviceRGB = xpost_name_cons(ctx, "DeviceRGB"))) == invalidtype)
         return VMerror;
 
     xpost_memory_table_get_addr(ctx->gl,
@@ -506,7 +703,7 @@ int xpost_oper_init_bgr_device_ops(Xpost_Context *ctx,
     optab = (Xpost_Operator *)(ctx->gl->base + optadr);
     op = xpost_operator_cons(ctx, "loadbgrdevice", (Xpost_Op_Func)loadbgrdevice, 1, 0); INSTALL;
     op = xpost_operator_cons(ctx, "loadbgrdevicecont", (Xpost_Op_Func)loadbgrdevicecont, 1, 1, dicttype);
-    _loadbgrdevicecont_opcode = op.mark_.padw;
+    ctx->opcode_shortcuts.loadbgrdevicecont = op.mark_.padw;
 
     return 0;
 }
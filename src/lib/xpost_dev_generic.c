@@ -65,6 +65,7 @@ void *alloca (size_t);
 
 #include "xpost.h"
 #include "xpost_log.h"
+#include "xpost_compat.h" /* XPOST_THREAD_LOCAL */
 #include "xpost_memory.h" /* access memory */
 #include "xpost_object.h" /* work with objects */
 #include "xpost_stack.h"  /* push results on stack */
@@ -84,19 +85,9 @@ struct point
     real x, y;
 };
 
-/* FIXME: re-entrancy */
-static Xpost_Context *localctx;
+/* the context of the sort comparison, one for each thread */
+static XPOST_THREAD_LOCAL Xpost_Context *localctx;
 
-static Xpost_Object namewidth;
-static Xpost_Object namenativecolorspace;
-static Xpost_Object nameDeviceGray;
-static Xpost_Object nameDeviceRGB;
-static Xpost_Object nameroll;
-static Xpost_Object nameDrawLine;
-static Xpost_Object nameexec;
-static Xpost_Object namerepeat;
-static Xpost_Object namecvx;
-static Xpost_Object nameRbracket;
 
 char *xpost_device_get_filename(Xpost_Context *ctx, Xpost_Object devdic)
 {
@@ -126,6 +117,41 @@ int xpost_device_set_filename(Xpost_Context *ctx, Xpost_Object devdic, char *fil
     return 0;
 }
 
+/* find a definition, as made by xpost_add_definitions,
+   in the dictionary stack without executing load */
+Xpost_Object xpost_device_get_definition(Xpost_Context *ctx, const char *key)
+{
+    Xpost_Object name;
+    Xpost_Object value;
+    int i, z;
+
+    name = xpost_name_cons(ctx, key);
+    if (xpost_object_get_type(name) == invalidtype)
+        return invalid;
+    z = xpost_stack_count(ctx->lo, ctx->ds);
+    for (i = 0; i < z; i++)
+    {
+        value = xpost_dict_get(ctx, xpost_stack_topdown_fetch(ctx->lo, ctx->ds, i), name);
+        if (xpost_object_get_type(value) != invalidtype)
+            return value;
+    }
+    return invalid;
+}
+
+/* retag the private data string of a device instance
+   so the collector calls finalize when the device becomes garbage */
+int xpost_device_set_private_finalizer(Xpost_Context *ctx, Xpost_Object privatestr,
+                                       unsigned int tag,
+                                       int (*finalize)(Xpost_Memory_File *mem, unsigned int ent))
+{
+    Xpost_Memory_File *mem;
+
+    mem = xpost_context_select_memory(ctx, privatestr);
+    if (!xpost_memory_register_finalize_function(mem, tag, finalize))
+        return 0;
+    return xpost_memory_table_set_tag(mem, xpost_object_get_ent(privatestr), tag);
+}
+
 static
 int _yxcomp(const void *left, const void *right)
 {
@@ -356,14 +382,14 @@ int _fillpoly(Xpost_Context *ctx,
 
     //printf("_fillpoly\n");
 
-    //width = xpost_dict_get(ctx, devdic, namewidth).int_.val;
-    colorspace = xpost_dict_get(ctx, devdic, namenativecolorspace);
-    if (xpost_dict_compare_objects(ctx, colorspace, nameDeviceGray) == 0)
+    //width = xpost_dict_get(ctx, devdic, ctx->name_shortcuts.width).int_.val;
+    colorspace = xpost_dict_get(ctx, devdic, ctx->name_shortcuts.nativecolorspace);
+    if (xpost_dict_compare_objects(ctx, colorspace, ctx->name_shortcuts.DeviceGray) == 0)
     {
         ncomp = 1;
         comp1 = xpost_stack_pop(ctx->lo, ctx->os);
     }
-    else if (xpost_dict_compare_objects(ctx, colorspace, nameDeviceRGB) == 0)
+    else if (xpost_dict_compare_objects(ctx, colorspace, ctx->name_shortcuts.DeviceRGB) == 0)
     {
         ncomp = 3;
         comp3 = xpost_stack_pop(ctx->lo, ctx->os);
@@ -492,7 +518,7 @@ int _fillpoly(Xpost_Context *ctx,
             xpost_stack_push(ctx->lo, ctx->os, xpost_int_cons(3)); /* color components to move */
             break;
     }
-    xpost_stack_push(ctx->lo, ctx->os, xpost_object_cvx( nameroll));
+    xpost_stack_push(ctx->lo, ctx->os, xpost_object_cvx( ctx->name_shortcuts.roll));
 
       /*at this point (in constructing the (color-space-generic) loop-body) we have the desired stack picture:
 
@@ -505,12 +531,12 @@ int _fillpoly(Xpost_Context *ctx,
        */
 
     xpost_stack_push(ctx->lo, ctx->os, devdic);
-    drawline = xpost_dict_get(ctx, devdic, nameDrawLine);
+    drawline = xpost_dict_get(ctx, devdic, ctx->name_shortcuts.DrawLine);
     xpost_stack_push(ctx->lo, ctx->os, drawline);
 
     /*if drawline is a procedure, we also need to call exec */
     if (xpost_object_get_type(drawline) == arraytype)
-        xpost_stack_push(ctx->lo, ctx->os, nameexec);
+        xpost_stack_push(ctx->lo, ctx->os, ctx->name_shortcuts.exec);
 
     /*--the rest of the code here calls-back to postscript (by "continuation")
         by pushing executable names on the execution-stack, and then returns.
@@ -544,9 +570,9 @@ int _fillpoly(Xpost_Context *ctx,
       So the sequence in C is:
      */
 
-    xpost_stack_push(ctx->lo, ctx->es, xpost_object_cvx( namerepeat));
-    xpost_stack_push(ctx->lo, ctx->es, xpost_object_cvx( namecvx));
-    xpost_stack_push(ctx->lo, ctx->es, xpost_object_cvx( nameRbracket));
+    xpost_stack_push(ctx->lo, ctx->es, xpost_object_cvx( ctx->name_shortcuts.repeat));
+    xpost_stack_push(ctx->lo, ctx->es, xpost_object_cvx( ctx->name_shortcuts.cvx));
+    xpost_stack_push(ctx->lo, ctx->es, xpost_object_cvx( ctx->name_shortcuts.Rbracket));
 
     /*performance could be increased by factoring-out calls to xpost_name_cons()  ... DONE!
       or using opcode shortcuts for Rbracket & cvx (or just the arrtomark() function) and repeat.
@@ -568,25 +594,25 @@ int xpost_oper_init_generic_device_ops(Xpost_Context *ctx,
 
     op = xpost_operator_cons(ctx, ".yxsort", (Xpost_Op_Func)_yxsort, 0, 1, arraytype); INSTALL;
     op = xpost_operator_cons(ctx, ".fillpoly", (Xpost_Op_Func)_fillpoly, 0, 2, arraytype, dicttype); INSTALL;
-    if (xpost_object_get_type((namewidth = xpost_name_cons(ctx, "width"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.width = xpost_name_cons(ctx, "width"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((namenativecolorspace = xpost_name_cons(ctx, "nativecolorspace"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.nativecolorspace = xpost_name_cons(ctx, "nativecolorspace"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((nameDeviceGray = xpost_name_cons(ctx, "DeviceGray"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.DeviceGray = xpost_name_cons(ctx, "DeviceGray"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((nameDeviceRGB = xpost_name_cons(ctx, "DeviceRGB"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.DeviceRGB = xpost_name_cons(ctx, "DeviceRGB"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((nameroll = xpost_name_cons(ctx, "roll"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.roll = xpost_name_cons(ctx, "roll"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((nameDrawLine = xpost_name_cons(ctx, "DrawLine"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.DrawLine = xpost_name_cons(ctx, "DrawLine"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((nameexec = xpost_name_cons(ctx, "exec"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.exec = xpost_name_cons(ctx, "exec"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((namerepeat = xpost_name_cons(ctx, "repeat"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.repeat = xpost_name_cons(ctx, "repeat"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((namecvx = xpost_name_cons(ctx, "cvx"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.cvx = xpost_name_cons(ctx, "cvx"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((nameRbracket = xpost_name_cons(ctx, "]"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.Rbracket = xpost_name_cons(ctx, "]"))) == invalidtype)
         return VMerror;
 
     return 0;
@@ -44,6 +44,19 @@
 #ifndef XPOST_DEV_GENERIC_H
 #define XPOST_DEV_GENERIC_H
 
+/**
+ * @brief allocation tags for the private data of native devices
+ *
+ * they follow the object types, so each may have its own finalizer.
+ */
+typedef enum
+{
+    XPOST_DEVICE_PRIVATE_TAG_PNG = XPOST_OBJECT_NTYPES,
+    XPOST_DEVICE_PRIVATE_TAG_XCB,
+    XPOST_DEVICE_PRIVATE_TAG_RASTER,
+    XPOST_DEVICE_PRIVATE_TAG_BGR
+} Xpost_Device_Private_Tag;
+
 /**
  * @brief convenience function to retrieve filename associated with device
  *
@@ -58,6 +71,26 @@ char *xpost_device_get_filename(Xpost_Context *ctx, Xpost_Object devdic);
  */
 int xpost_device_set_filename(Xpost_Context *ctx, Xpost_Object devdic, char *filename);
 
+/**
+ * @brief convenience function to retrieve a definition made for a device
+ *
+ * searches the dictionary stack for @p key, as given to
+ * xpost_add_definitions() or defined by the program.
+ * returns the value, or an invalid object if @p key is not defined.
+ */
+Xpost_Object xpost_device_get_definition(Xpost_Context *ctx, const char *key);
+
+/**
+ * @brief convenience function to finalize the private data of a device
+ *
+ * retags the private data string @p privatestr with @p tag, so that
+ * the collector calls @p finalize when the device becomes garbage.
+ * returns 1 on success, 0 otherwise.
+ */
+int xpost_device_set_private_finalizer(Xpost_Context *ctx, Xpost_Object privatestr,
+                                       unsigned int tag,
+                                       int (*finalize)(Xpost_Memory_File *mem, unsigned int ent));
+
 /**
  * @brief install operator .yxsort to improve performance of 'fill'
  *
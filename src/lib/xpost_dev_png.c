@@ -39,6 +39,7 @@
 #include <setjmp.h>
 
 #include "xpost.h"
+#include "xpost_compat.h" /* threads */
 #include "xpost_log.h"
 #include "xpost_memory.h" /* access memory */
 #include "xpost_object.h" /* work with objects */
@@ -55,8 +56,11 @@
 #include "xpost_dev_generic.h" /* get filename */
 #include "xpost_dev_png.h" /* check prototypes */
 
-/* FIXME: add interlaced feature */
-/* FIXME: add compress feature */
+#if defined(HAVE_ZLIB) && defined(XPOST_THREADS)
+# include <zlib.h>
+/* pages are deflated in bands on several threads */
+# define XPOST_PNG_BANDS 1
+#endif
 
 typedef struct
 {
@@ -69,6 +73,49 @@ typedef struct
     Xpost_Png_Pixel data[1];
 } Xpost_Png_Buffer;
 
+/* pages waiting for the encoder, including the one it writes */
+#define XPOST_PNG_QUEUE 2
+
+/* the most threads deflating a page, and the fewest rows of a band */
+#define XPOST_PNG_THREADS_MAX 16
+#define XPOST_PNG_BAND_ROWS 64
+
+/* the png options of a device, read from the definitions */
+typedef struct
+{
+    int compression_level; /* 0 to 9 */
+    int filters; /* mask of PNG_FILTER_* */
+    int strategy; /* a zlib strategy, or -1 to let libpng choose */
+    int interlaced;
+    int threads; /* deflating a page */
+} Xpost_Png_Options;
+
+/* the output stage of a png device. Emit copies the page into the
+   queue and returns, and a thread compresses and writes it, so that
+   the interpreter draws the next page meanwhile. without threads,
+   the page is written by Emit itself.
+   each page is a complete png file, named after the OutputFileName
+   pattern of the device. */
+typedef struct
+{
+    char *filename; /* the pattern, may contain %d */
+    int width;
+    int height;
+    size_t rowbytes;
+    Xpost_Png_Options options;
+    unsigned char *zero; /* the row above the first one */
+    unsigned char *pages[XPOST_PNG_QUEUE]; /* allocated when first needed */
+    int numbers[XPOST_PNG_QUEUE]; /* the page numbers of the slots */
+    int first; /* the slot of the next page to write */
+    int count; /* the pages in the queue */
+    int failed; /* a page could not be written, no more pages are written */
+    int quit; /* the thread ends once the queue is empty */
+    int threaded; /* the thread is running */
+    Xpost_Lock lock;
+    Xpost_Cond cond; /* a page was queued or written, or quit was set */
+    Xpost_Thread thread;
+} Xpost_Png_Encoder;
+
 typedef struct
 {
     int width;
@@ -76,23 +123,662 @@ typedef struct
     /*
      * add additional members to private struct
      */
-    FILE *f;
-    png_structp         png_ptr;
-    png_infop           info_ptr;
     Xpost_Png_Buffer *buf;
-    int compression_level;
-    unsigned int interlaced : 1;
+    Xpost_Png_Encoder *encoder;
+    int page; /* pages emitted */
 } PrivateData;
 
-static Xpost_Object namePrivate;
-static Xpost_Object namewidth;
-static Xpost_Object nameheight;
-static Xpost_Object namedotcopydict;
-static Xpost_Object namenativecolorspace;
-static Xpost_Object nameDeviceRGB;
 
+/* the file name of a page: the first %d of the pattern, or %0Nd,
+   is replaced by the page number and %% by %. the pattern is never
+   given to printf. a pattern without %d names every page the same,
+   so the file holds the last page. */
+static
+char *_xpost_png_filename(const char *pattern, int number)
+{
+    const char *p;
+    const char *s;
+    char *name;
+    char *q;
+    int width;
+    int done = 0;
+
+    name = malloc(strlen(pattern) + 32);
+    if (!name)
+        return NULL;
+
+    q = name;
+    for (p = pattern; *p; p++)
+    {
+        if (*p == '%' && p[1] == '%')
+        {
+            *q++ = '%';
+            p++;
+            continue;
+        }
+        if (*p == '%' && !done)
+        {
+            width = 0;
+            for (s = p + 1; *s >= '0' && *s <= '9' && width < 20; s++)
+                width = 10 * width + (*s - '0');
+            if (*s == 'd' && width < 20)
+            {
+                q += sprintf(q, "%0*d", width, number);
+                p = s;
+                done = 1;
+                continue;
+            }
+        }
+        *q++ = *p;
+    }
+    *q = '\0';
+
+    return name;
+}
+
+#ifdef XPOST_PNG_BANDS
+
+/* rows of a page deflated into a raw stream by one thread. the
+   streams of the bands of a page, with a zlib header and the
+   combined adler32, make the zlib stream of its IDAT chunks. */
+typedef struct
+{
+    const Xpost_Png_Encoder *enc;
+    const unsigned char *data;
+    int first; /* the rows of the band */
+    int last; /* excluded */
+    unsigned char *out; /* the raw deflate stream */
+    size_t size;
+    unsigned long adler; /* of the filtered rows */
+    size_t length; /* of the filtered rows */
+    int ok;
+    Xpost_Thread thread;
+} Xpost_Png_Band;
+
+/* write in out the filter type then the filtered row, as in the
+   PNG specification, with 3 bytes per pixel */
+static
+void _xpost_png_filter_row(unsigned char *out,
+                           int type,
+                           const unsigned char *row,
+                           const unsigned char *prior,
+                           size_t n)
+{
+    size_t i;
+    int a, b, c, p, pa, pb, pc;
+
+    *out++ = (unsigned char)type;
+    switch (type)
+    {
+        case PNG_FILTER_VALUE_NONE:
+            memcpy(out, row, n);
+            break;
+        case PNG_FILTER_VALUE_SUB:
+            memcpy(out, row, 3);
+            for (i = 3; i < n; i++)
+                out[i] = row[i] - row[i - 3];
+            break;
+        case PNG_FILTER_VALUE_UP:
+            for (i = 0; i < n; i++)
+                out[i] = row[i] - prior[i];
+            break;
+        case PNG_FILTER_VALUE_AVG:
+            for (i = 0; i < 3; i++)
+                out[i] = row[i] - (prior[i] >> 1);
+            for (i = 3; i < n; i++)
+                out[i] = row[i] - ((row[i - 3] + prior[i]) >> 1);
+            break;
+        default:
+            for (i = 0; i < n; i++)
+            {
+                a = (i >= 3) ? row[i - 3] : 0;
+                b = prior[i];
+                c = (i >= 3) ? prior[i - 3] : 0;
+                p = b - c;
+                pc = a - c;
+                pa = abs(p);
+                pb = abs(pc);
+                pc = abs(p + pc);
+                if (pa <= pb && pa <= pc)
+                    p = a;
+                else if (pb <= pc)
+                    p = b;
+                else
+                    p = c;
+                out[i] = row[i] - p;
+            }
+            break;
+    }
+}
+
+/* filter a row with the filters of the options. with several of
+   them, keep the one with the smallest sum of absolute differences,
+   as libpng does. scratch holds a filtered row. */
+static
+void _xpost_png_filter(const Xpost_Png_Encoder *enc,
+                       unsigned char *out,
+                       unsigned char *scratch,
+                       const unsigned char *data,
+                       int y)
+{
+    const unsigned char *row = data + y * enc->rowbytes;
+    const unsigned char *prior = y ? row - enc->rowbytes : enc->zero;
+    unsigned long sum;
+    unsigned long best = 0;
+    size_t i;
+    int type;
+    int found = 0;
+
+    for (type = PNG_FILTER_VALUE_NONE; type < PNG_FILTER_VALUE_LAST; type++)
+    {
+        if (!(enc->options.filters & (PNG_FILTER_NONE << type)))
+            continue;
+        if (enc->options.filters == (PNG_FILTER_NONE << type))
+        {
+            _xpost_png_filter_row(out, type, row, prior, enc->rowbytes);
+            return;
+        }
+        _xpost_png_filter_row(scratch, type, row, prior, enc->rowbytes);
+        sum = 0;
+        for (i = 1; i <= enc->rowbytes; i++)
+            sum += (scratch[i] < 128) ? scratch[i] : 256 - scratch[i];
+        if (!found || sum < best)
+        {
+            memcpy(out, scratch, enc->rowbytes + 1);
+            best = sum;
+            found = 1;
+        }
+    }
+}
+
+/* the zlib strategy of the options */
+static
+int _xpost_png_strategy(const Xpost_Png_Options *options)
+{
+    if (options->strategy >= 0)
+        return options->strategy;
+    return (options->filters == PNG_FILTER_NONE) ? Z_DEFAULT_STRATEGY : Z_FILTERED;
+}
+
+/* deflate the rows of a band. the rows before it, up to the size of
+   the window, are filtered again to preset the dictionary, so that
+   the band compresses as in a single stream */
+static
+void _xpost_png_band_main(void *data)
+{
+    Xpost_Png_Band *band = data;
+    const Xpost_Png_Encoder *enc = band->enc;
+    size_t stride = enc->rowbytes + 1;
+    unsigned char *filtered;
+    unsigned char *scratch;
+    unsigned char *rows;
+    unsigned char *out;
+    size_t dictlen;
+    size_t size;
+    z_stream zs;
+    int flush;
+    int first;
+    int ret;
+    int y;
+
+    band->ok = 0;
+    first = band->first - (int)((32768 + stride - 1) / stride);
+    if (first < 0)
+        first = 0;
+    filtered = malloc((band->last - first + 1) * stride);
+    if (!filtered)
+        return;
+    scratch = filtered + (band->last - first) * stride;
+    for (y = first; y < band->last; y++)
+        _xpost_png_filter(enc, filtered + (y - first) * stride, scratch, band->data, y);
+
+    rows = filtered + (band->first - first) * stride;
+    band->length = (band->last - band->first) * stride;
+    band->adler = adler32(adler32(0L, Z_NULL, 0), rows, (uInt)band->length);
+
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, enc->options.compression_level, Z_DEFLATED,
+                     -15, 8, _xpost_png_strategy(&enc->options)) != Z_OK)
+    {
+        free(filtered);
+        return;
+    }
+    dictlen = rows - filtered;
+    if (dictlen > 32768)
+        dictlen = 32768;
+    if (dictlen)
+        deflateSetDictionary(&zs, rows - dictlen, (uInt)dictlen);
+
+    /* all the bands but the last end on a byte boundary, not final */
+    flush = (band->last == enc->height) ? Z_FINISH : Z_SYNC_FLUSH;
+    size = deflateBound(&zs, (uLong)band->length) + 16;
+    band->out = malloc(size);
+    band->size = 0;
+    zs.next_in = rows;
+    zs.avail_in = (uInt)band->length;
+    for (;;)
+    {
+        if (!band->out)
+            break;
+        zs.next_out = band->out + band->size;
+        zs.avail_out = (uInt)(size - band->size);
+        ret = deflate(&zs, flush);
+        band->size = size - zs.avail_out;
+        if (ret == Z_STREAM_END ||
+            (flush == Z_SYNC_FLUSH && ret == Z_OK && zs.avail_out))
+        {
+            band->ok = 1;
+            break;
+        }
+        if (ret != Z_OK && ret != Z_BUF_ERROR)
+            break;
+        size *= 2;
+        out = realloc(band->out, size);
+        if (!out)
+            break;
+        band->out = out;
+    }
+    deflateEnd(&zs);
+    free(filtered);
+}
+/* the number of bands of a page, 1 if libpng writes it alone */
+static
+int _xpost_png_band_count(const Xpost_Png_Encoder *enc)
+{
+    int count;
+
+    if (enc->options.interlaced)
+        return 1;
+    count = enc->height / XPOST_PNG_BAND_ROWS;
+    if (count > enc->options.threads)
+        count = enc->options.threads;
+    return (count > 1) ? count : 1;
+}
+
+/* deflate a page in count bands, the first one on the calling thread.
+   return NULL on failure */
+static
+Xpost_Png_Band *_xpost_png_bands_new(const Xpost_Png_Encoder *enc,
+                                     const unsigned char *data,
+                                     int count)
+{
+    Xpost_Png_Band *bands;
+    int started[XPOST_PNG_THREADS_MAX];
+    int ok = 1;
+    int i;
+
+    bands = calloc(count, sizeof(Xpost_Png_Band));
+    if (!bands)
+        return NULL;
+
+    for (i = 0; i < count; i++)
+    {
+        bands[i].enc = enc;
+        bands[i].data = data;
+        bands[i].first = (int)((long)enc->height * i / count);
+        bands[i].last = (int)((long)enc->height * (i + 1) / count);
+        started[i] = (i > 0) &&
+            xpost_thread_start(&bands[i].thread, _xpost_png_band_main, &bands[i]);
+    }
+    for (i = 0; i < count; i++)
+    {
+        if (started[i])
+            xpost_thread_join(bands[i].thread);
+        else
+            _xpost_png_band_main(&bands[i]);
+        ok &= bands[i].ok;
+    }
+
+    if (!ok)
+    {
+        for (i = 0; i < count; i++)
+            free(bands[i].out);
+        free(bands);
+        return NULL;
+    }
+    return bands;
+}
+
+static
+void _xpost_png_bands_free(Xpost_Png_Band *bands, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+        free(bands[i].out);
+    free(bands);
+}
+
+/* write the bands as IDAT chunks, one per band: the zlib header,
+   the raw streams, then the adler32 of the whole page */
+static
+void _xpost_png_bands_write(const Xpost_Png_Encoder *enc,
+                            png_structp png_ptr,
+                            const Xpost_Png_Band *bands,
+                            int count)
+{
+    unsigned char header[2];
+    unsigned char trailer[4];
+    unsigned long adler;
+    unsigned int cmf;
+    int level;
+    int i;
+
+    level = enc->options.compression_level;
+    if (level < 2 || _xpost_png_strategy(&enc->options) >= Z_HUFFMAN_ONLY)
+        level = 0;
+    else if (level < 6)
+        level = 1;
+    else if (level == 6)
+        level = 2;
+    else
+        level = 3;
+    cmf = (0x78 << 8) | (level << 6);
+    cmf += 31 - cmf % 31;
+    header[0] = (unsigned char)(cmf >> 8);
+    header[1] = (unsigned char)cmf;
+
+    adler = bands[0].adler;
+    for (i = 1; i < count; i++)
+        adler = adler32_combine(adler, bands[i].adler, (z_off_t)bands[i].length);
+    trailer[0] = (unsigned char)(adler >> 24);
+    trailer[1] = (unsigned char)(adler >> 16);
+    trailer[2] = (unsigned char)(adler >> 8);
+    trailer[3] = (unsigned char)adler;
+
+    for (i = 0; i < count; i++)
+    {
+        png_write_chunk_start(png_ptr, (png_const_bytep)"IDAT",
+                              (png_uint_32)(bands[i].size +
+                                            ((i == 0) ? 2 : 0) +
+                                            ((i == count - 1) ? 4 : 0)));
+        if (i == 0)
+            png_write_chunk_data(png_ptr, header, 2);
+        png_write_chunk_data(png_ptr, bands[i].out, bands[i].size);
+        if (i == count - 1)
+            png_write_chunk_data(png_ptr, trailer, 4);
+        png_write_chunk_end(png_ptr);
+    }
+}
+
+#endif
+
+/* write the png stream of a page in f, with the deflated bands
+   or else with libpng. return 0 if libpng raised an error */
+static
+int _xpost_png_write_stream(const Xpost_Png_Encoder *enc,
+                            png_structp png_ptr,
+                            png_infop info_ptr,
+                            FILE *f,
+                            png_bytepp rows,
+                            void *bands,
+                            int count)
+{
+    png_color_8 sig_bit;
+
+    if (setjmp(png_jmpbuf(png_ptr)))
+        return 0;
+
+    png_init_io(png_ptr, f);
+    png_set_IHDR(png_ptr, info_ptr,
+                 enc->width, enc->height, 8,
+                 PNG_COLOR_TYPE_RGB,
+                 enc->options.interlaced ? PNG_INTERLACE_ADAM7 : PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+
+    sig_bit.red = 8;
+    sig_bit.green = 8;
+    sig_bit.blue = 8;
+    sig_bit.alpha = 8;
+    png_set_sBIT(png_ptr, info_ptr, &sig_bit);
+
+    png_set_compression_level(png_ptr, enc->options.compression_level);
+    if (enc->options.strategy >= 0)
+        png_set_compression_strategy(png_ptr, enc->options.strategy);
+    png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, enc->options.filters);
+    png_write_info(png_ptr, info_ptr);
+    png_set_shift(png_ptr, &sig_bit);
+    png_set_packing(png_ptr);
+
+#ifdef XPOST_PNG_BANDS
+    if (bands)
+    {
+        _xpost_png_bands_write(enc, png_ptr, bands, count);
+        png_write_chunk(png_ptr, (png_const_bytep)"IEND", NULL, 0);
+        return 1;
+    }
+#else
+    (void)bands;
+    (void)count;
+#endif
+
+    /* libpng handles the interlacing */
+    png_write_image(png_ptr, rows);
+    png_write_end(png_ptr, info_ptr);
+    return 1;
+}
+
+/* write a page in its file. return 0 on failure */
+static
+int _xpost_png_write_page(const Xpost_Png_Encoder *enc,
+                          unsigned char *data,
+                          int number)
+{
+    char *filename;
+    FILE *f;
+    png_structp png_ptr;
+    png_infop info_ptr = NULL;
+    png_bytepp rows = NULL;
+    void *bands = NULL;
+    int count = 1;
+    int ok = 0;
+    int y;
+
+#ifdef XPOST_PNG_BANDS
+    count = _xpost_png_band_count(enc);
+    if (count > 1)
+        bands = _xpost_png_bands_new(enc, data, count);
+#endif
+    if (!bands)
+    {
+        rows = malloc(enc->height * sizeof(png_bytep));
+        if (!rows)
+        {
+            XPOST_LOG_ERR("cannot allocate png rows");
+            return 0;
+        }
+        for (y = 0; y < enc->height; y++)
+            rows[y] = data + y * enc->rowbytes;
+    }
+
+    filename = _xpost_png_filename(enc->filename, number);
+    f = filename ? fopen(filename, "wb") : NULL;
+    if (!f)
+        XPOST_LOG_ERR("cannot open PNG file %s", filename ? filename : "");
+    free(filename);
+
+    if (f)
+    {
+        png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING,
+                                          NULL, NULL, NULL);
+        if (png_ptr)
+        {
+            info_ptr = png_create_info_struct(png_ptr);
+            if (info_ptr)
+                ok = _xpost_png_write_stream(enc, png_ptr, info_ptr, f,
+                                             rows, bands, count);
+            png_destroy_write_struct(&png_ptr,
+                                     (info_ptr) ? (png_infopp)&info_ptr : NULL);
+        }
+        if (fclose(f) != 0)
+            ok = 0;
+    }
+
+#ifdef XPOST_PNG_BANDS
+    if (bands)
+        _xpost_png_bands_free(bands, count);
+#endif
+    free(rows);
+    return ok;
+}
+
+/* the encoder thread: write the queued pages in order */
+static
+void _xpost_png_encoder_main(void *data)
+{
+    Xpost_Png_Encoder *enc = data;
+    unsigned char *page;
+    int number;
+    int failed;
 
-static unsigned int _create_cont_opcode;
+    xpost_lock(&enc->lock);
+    for (;;)
+    {
+        while (!enc->count && !enc->quit)
+            xpost_cond_wait(&enc->cond, &enc->lock);
+        if (!enc->count)
+            break;
+        page = enc->pages[enc->first];
+        number = enc->numbers[enc->first];
+        failed = enc->failed;
+        xpost_unlock(&enc->lock);
+
+        if (!failed && !_xpost_png_write_page(enc, page, number))
+            failed = 1;
+
+        xpost_lock(&enc->lock);
+        enc->failed = failed;
+        enc->first = (enc->first + 1) % XPOST_PNG_QUEUE;
+        --enc->count;
+        xpost_cond_broadcast(&enc->cond);
+    }
+    xpost_unlock(&enc->lock);
+}
+
+/* create the output stage of a device and start its thread */
+static
+Xpost_Png_Encoder *_xpost_png_encoder_new(const char *filename,
+                                          int width,
+                                          int height,
+                                          const Xpost_Png_Options *options)
+{
+    Xpost_Png_Encoder *enc;
+
+    enc = calloc(1, sizeof(Xpost_Png_Encoder));
+    if (!enc)
+        return NULL;
+    enc->filename = strdup(filename);
+    enc->zero = calloc(width ? width : 1, 3);
+    if (!enc->filename || !enc->zero)
+    {
+        free(enc->filename);
+        free(enc->zero);
+        free(enc);
+        return NULL;
+    }
+    enc->width = width;
+    enc->height = height;
+    enc->rowbytes = 3 * (size_t)width;
+    enc->options = *options;
+    xpost_lock_init(&enc->lock);
+    xpost_cond_init(&enc->cond);
+    enc->threaded = xpost_thread_start(&enc->thread, _xpost_png_encoder_main, enc);
+    if (!enc->threaded)
+        XPOST_LOG_INFO("png pages are written without a thread");
+    return enc;
+}
+
+/* give a page to the output stage, waiting for a free slot.
+   return a postscript error code, 0 == noerror */
+static
+int _xpost_png_encoder_put(Xpost_Png_Encoder *enc,
+                           const unsigned char *data,
+                           int number)
+{
+    int slot;
+    int failed;
+
+    if (!enc->threaded)
+    {
+        if (!enc->failed && !_xpost_png_write_page(enc, (unsigned char *)data, number))
+            enc->failed = 1;
+        return enc->failed ? ioerror : 0;
+    }
+
+    xpost_lock(&enc->lock);
+    while (enc->count == XPOST_PNG_QUEUE)
+        xpost_cond_wait(&enc->cond, &enc->lock);
+    slot = (enc->first + enc->count) % XPOST_PNG_QUEUE;
+    failed = enc->failed;
+    xpost_unlock(&enc->lock);
+    if (failed)
+        return ioerror;
+
+    /* the slot is not in the queue: the thread does not use it */
+    if (!enc->pages[slot])
+    {
+        enc->pages[slot] = malloc(enc->rowbytes * enc->height);
+        if (!enc->pages[slot])
+        {
+            XPOST_LOG_ERR("cannot allocate png page");
+            return VMerror;
+        }
+    }
+    memcpy(enc->pages[slot], data, enc->rowbytes * enc->height);
+    enc->numbers[slot] = number;
+
+    xpost_lock(&enc->lock);
+    ++enc->count;
+    xpost_cond_broadcast(&enc->cond);
+    xpost_unlock(&enc->lock);
+    return 0;
+}
+
+/* write the queued pages and stop the thread.
+   return 0 if a page could not be written */
+static
+int _xpost_png_encoder_free(Xpost_Png_Encoder *enc)
+{
+    int ok;
+    int i;
+
+    if (enc->threaded)
+    {
+        xpost_lock(&enc->lock);
+        enc->quit = 1;
+        xpost_cond_broadcast(&enc->cond);
+        xpost_unlock(&enc->lock);
+        xpost_thread_join(enc->thread);
+    }
+
+    ok = !enc->failed;
+    for (i = 0; i < XPOST_PNG_QUEUE; i++)
+        free(enc->pages[i]);
+    free(enc->zero);
+    free(enc->filename);
+    xpost_cond_fini(&enc->cond);
+    xpost_lock_fini(&enc->lock);
+    free(enc);
+    return ok;
+}
+
+/* release the native handles of a png device
+   which became garbage without being destroyed */
+static
+int _finalize(Xpost_Memory_File *mem,
+              unsigned int ent)
+{
+    PrivateData private;
+
+    if (!xpost_memory_get(mem, ent, 0, sizeof(private), &private))
+        return 0;
+
+    if (private.encoder)
+        (void)_xpost_png_encoder_free(private.encoder);
+    free(private.buf);
+
+    return 1;
+}
 
 /* create an instance of the device
    using the class .copydict procedure */
@@ -105,21 +791,126 @@ int _create(Xpost_Context *ctx,
     xpost_stack_push(ctx->lo, ctx->os, width);
     xpost_stack_push(ctx->lo, ctx->os, height);
     xpost_stack_push(ctx->lo, ctx->os, classdic);
-    xpost_dict_put(ctx, classdic, namewidth, width);
-    xpost_dict_put(ctx, classdic, nameheight, height);
+    xpost_dict_put(ctx, classdic, ctx->name_shortcuts.width, width);
+    xpost_dict_put(ctx, classdic, ctx->name_shortcuts.height, height);
 
     /* call device class's ps-level .copydict procedure,
        //call base-class's Create procedure (to initialize ImgData array)
        then call _create_cont, by continuation. */
-    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(_create_cont_opcode)))
+    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.png_create_cont)))
         return execstackoverflow;
 
-    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_dict_get(ctx, classdic, namedotcopydict)))
+    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_dict_get(ctx, classdic, ctx->name_shortcuts.dotcopydict)))
         return execstackoverflow;
 
     return 0;
 }
 
+/* the index of the name or string value in names, or -1 */
+static
+int _xpost_png_option_index(Xpost_Context *ctx,
+                            Xpost_Object value,
+                            const char *const *names)
+{
+    const char *str;
+    size_t len;
+    int i;
+
+    if (xpost_object_get_type(value) == nametype)
+        value = xpost_name_get_string(ctx, value);
+    if (xpost_object_get_type(value) != stringtype)
+        return -1;
+    str = xpost_string_get_pointer(ctx, value);
+    len = value.comp_.sz;
+    for (i = 0; names[i]; i++)
+    {
+        if (strlen(names[i]) == len && !memcmp(names[i], str, len))
+            return i;
+    }
+    return -1;
+}
+
+/* read the options of the device in the definitions:
+   /PNGCompressionLevel 0 to 9, default 3
+   /PNGFilter /none, /sub, /up, /average, /paeth or /all, the default
+   /PNGStrategy /default, /filtered, /huffman, /rle or /fixed
+   /PNGInterlace true for Adam7, default false
+   /PNGThreads deflating a page, default the number of processors.
+   a wrong value keeps the default, as an error while the device is
+   created cannot be handled */
+static
+void _xpost_png_options_get(Xpost_Context *ctx, Xpost_Png_Options *options)
+{
+    static const char *const filters[] = {
+        "none", "sub", "up", "average", "paeth", "all", NULL
+    };
+    static const char *const strategies[] = {
+        "default", "filtered", "huffman", "rle", "fixed", NULL
+    };
+    static const char *const booleans[] = { "false", "true", NULL };
+    Xpost_Object value;
+    int i;
+
+    options->compression_level = 3;
+    options->filters = PNG_ALL_FILTERS;
+    options->strategy = -1;
+    options->interlaced = 0;
+    options->threads = xpost_cpu_count();
+
+    value = xpost_device_get_definition(ctx, "PNGCompressionLevel");
+    if (xpost_object_get_type(value) == integertype &&
+        value.int_.val >= 0 && value.int_.val <= 9)
+        options->compression_level = value.int_.val;
+    else if (xpost_object_get_type(value) != invalidtype)
+        XPOST_LOG_ERR("wrong PNGCompressionLevel, 0 to 9");
+
+    value = xpost_device_get_definition(ctx, "PNGFilter");
+    if (xpost_object_get_type(value) != invalidtype)
+    {
+        i = _xpost_png_option_index(ctx, value, filters);
+        if (i == 5)
+            options->filters = PNG_ALL_FILTERS;
+        else if (i >= 0)
+            options->filters = PNG_FILTER_NONE << i;
+        else
+            XPOST_LOG_ERR("wrong PNGFilter");
+    }
+
+    value = xpost_device_get_definition(ctx, "PNGStrategy");
+    if (xpost_object_get_type(value) != invalidtype)
+    {
+        /* the index is the value of the zlib strategy */
+        i = _xpost_png_option_index(ctx, value, strategies);
+        if (i >= 0)
+            options->strategy = i;
+        else
+            XPOST_LOG_ERR("wrong PNGStrategy");
+    }
+
+    /* a definition without value, or the name true, counts as true */
+    value = xpost_device_get_definition(ctx, "PNGInterlace");
+    if (xpost_object_get_type(value) == booleantype)
+        options->interlaced = value.int_.val;
+    else if (xpost_object_get_type(value) == nulltype)
+        options->interlaced = 1;
+    else if (xpost_object_get_type(value) != invalidtype)
+    {
+        i = _xpost_png_option_index(ctx, value, booleans);
+        if (i >= 0)
+            options->interlaced = i;
+        else
+            XPOST_LOG_ERR("wrong PNGInterlace");
+    }
+
+    value = xpost_device_get_definition(ctx, "PNGThreads");
+    if (xpost_object_get_type(value) == integertype && value.int_.val >= 1)
+        options->threads = value.int_.val;
+    else if (xpost_object_get_type(value) != invalidtype)
+        XPOST_LOG_ERR("wrong PNGThreads");
+    if (options->threads > XPOST_PNG_THREADS_MAX)
+        options->threads = XPOST_PNG_THREADS_MAX;
+}
+
 /* initialize the C-level data
    and define in the device instance */
 static
@@ -130,12 +921,14 @@ int _create_cont(Xpost_Context *ctx,
 {
     Xpost_Object privatestr;
     PrivateData private;
+    Xpost_Png_Options options;
     char *filename;
-    png_color_8 sig_bit;
     integer width = w.int_.val;
     integer height = h.int_.val;
     //printf("create_cont\n");
 
+    _xpost_png_options_get(ctx, &options);
+
     /* create a string to contain device data structure */
     privatestr = xpost_string_cons(ctx, sizeof(PrivateData), NULL);
     if (xpost_object_get_type(privatestr) == invalidtype)
@@ -143,7 +936,7 @@ int _create_cont(Xpost_Context *ctx,
         XPOST_LOG_ERR("cannot allocat private data structure");
         return unregistered;
     }
-    xpost_dict_put(ctx, devdic, namePrivate, privatestr);
+    xpost_dict_put(ctx, devdic, ctx->name_shortcuts.Private, privatestr);
 
     private.width = width;
     private.height = height;
@@ -161,28 +954,7 @@ int _create_cont(Xpost_Context *ctx,
         return unregistered;
     }
 
-    private.f = fopen(filename, "wb");
-    free(filename);
-    if (!private.f)
-    {
-        XPOST_LOG_ERR("cannot retrieve PNG file name");
-        return unregistered;
-    }
-
-    private.compression_level = 3;
-    private.interlaced = PNG_INTERLACE_NONE;
-    private.info_ptr = NULL;
-    private.png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING,
-                                              NULL, NULL, NULL);
-    if (!private.png_ptr)
-        goto close_file;
-
-    private.info_ptr = png_create_info_struct(private.png_ptr);
-    if (!private.info_ptr)
-        goto destroy_png;
-
-    if (setjmp(png_jmpbuf(private.png_ptr)))
-        goto destroy_info;
+    private.page = 0;
 
     /* allocate buffer header and array */
     private.buf = malloc(sizeof(Xpost_Png_Buffer) +
@@ -190,44 +962,30 @@ int _create_cont(Xpost_Context *ctx,
     if (!private.buf)
     {
         XPOST_LOG_ERR("cannot allocate buffer memory");
-        goto destroy_info;
+        free(filename);
+        return unregistered;
     }
 
-	png_init_io(private.png_ptr, private.f);
-	png_set_IHDR(private.png_ptr, private.info_ptr,
-                 private.width, private.height, 8,
-                 PNG_COLOR_TYPE_RGB, private.interlaced,
-                 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
-
-    sig_bit.red = 8;
-    sig_bit.green = 8;
-    sig_bit.blue = 8;
-    sig_bit.alpha = 8;
-    png_set_sBIT(private.png_ptr, private.info_ptr, &sig_bit);
-
-    png_set_compression_level(private.png_ptr, private.compression_level);
-    png_write_info(private.png_ptr, private.info_ptr);
-    png_set_shift(private.png_ptr, &sig_bit);
-    png_set_packing(private.png_ptr);
+    /* the files are opened when the pages are written */
+    private.encoder = _xpost_png_encoder_new(filename, width, height, &options);
+    free(filename);
+    if (!private.encoder)
+    {
+        XPOST_LOG_ERR("cannot allocate png encoder");
+        free(private.buf);
+        return unregistered;
+    }
 
     /* save private data struct in string */
     xpost_memory_put(xpost_context_select_memory(ctx, privatestr),
                      xpost_object_get_ent(privatestr), 0,
                      sizeof(private), &private);
+    xpost_device_set_private_finalizer(ctx, privatestr,
+                                       XPOST_DEVICE_PRIVATE_TAG_PNG, _finalize);
 
     /* return device instance dictionary to ps */
     xpost_stack_push(ctx->lo, ctx->os, devdic);
     return 0;
-
-  destroy_info:
-	png_destroy_info_struct(private.png_ptr, (png_infopp) & private.info_ptr);
-  destroy_png:
-	png_destroy_write_struct(&private.png_ptr,
-                             (private.info_ptr) ? (png_infopp)&private.info_ptr : NULL);
-  close_file:
-    fclose(private.f);
-
-    return unregistered;
 }
 
 static
@@ -261,7 +1019,7 @@ int _putpix(Xpost_Context *ctx,
         y = xpost_int_cons(y.real_.val);
 
     /* load private data struct from string */
-    privatestr = xpost_dict_get(ctx, devdic, namePrivate);
+    privatestr = xpost_dict_get(ctx, devdic, ctx->name_shortcuts.Private);
     if (xpost_object_get_type(privatestr) == invalidtype)
         return undefined;
     xpost_memory_get(xpost_context_select_memory(ctx, privatestr),
@@ -298,23 +1056,30 @@ int _emit(Xpost_Context *ctx,
     Xpost_Object privatestr;
     PrivateData private;
     unsigned char *data;
-    png_bytep row_ptr;
-    int y;
+    int ret;
 
     /* load private data struct from string */
-    privatestr = xpost_dict_get(ctx, devdic, namePrivate);
+    privatestr = xpost_dict_get(ctx, devdic, ctx->name_shortcuts.Private);
     if (xpost_object_get_type(privatestr) == invalidtype)
         return undefined;
     xpost_memory_get(xpost_context_select_memory(ctx, privatestr),
             xpost_object_get_ent(privatestr), 0, sizeof private, &private);
 
     data = (unsigned char *)private.buf->data;
-    for (y = 0; y < private.height; y++)
-    {
-        row_ptr = (png_bytep)data;
-        png_write_rows(private.png_ptr, &row_ptr, 1);
-        data += 3 * private.width;
-    }
+    ret = _xpost_png_encoder_put(private.encoder, data, private.page + 1);
+    if (ret)
+        return ret;
+
+    ++private.page;
+    xpost_memory_put(xpost_context_select_memory(ctx, privatestr),
+                     xpost_object_get_ent(privatestr), 0,
+                     sizeof(private), &private);
+
+    /* lend the buffer to the page callback */
+    if (ctx->page_func)
+        ctx->page_func(ctx, private.page, data,
+                       private.width, private.height, 3 * private.width,
+                       XPOST_PIXEL_FORMAT_RGB, ctx->page_data);
 
     /*pass data back to client application */
     {
@@ -340,7 +1105,7 @@ int _destroy(Xpost_Context *ctx,
     PrivateData private;
 
     /* load private data struct from string */
-    privatestr = xpost_dict_get(ctx, devdic, namePrivate);
+    privatestr = xpost_dict_get(ctx, devdic, ctx->name_shortcuts.Private);
     if (xpost_object_get_type(privatestr) == invalidtype)
         return undefined;
     xpost_memory_get(xpost_context_select_memory(ctx, privatestr),
@@ -348,10 +1113,14 @@ int _destroy(Xpost_Context *ctx,
                      sizeof(private), &private);
 
     free(private.buf);
-    png_write_end(private.png_ptr, private.info_ptr);
-    png_destroy_write_struct(&private.png_ptr, (png_infopp) & private.info_ptr);
-    png_destroy_info_struct(private.png_ptr, (png_infopp) & private.info_ptr);
-    fclose(private.f);
+    if (!_xpost_png_encoder_free(private.encoder))
+        XPOST_LOG_ERR("cannot write PNG file");
+
+    /* leave nothing for the finalizer */
+    memset(&private, 0, sizeof(private));
+    xpost_memory_put(xpost_context_select_memory(ctx, privatestr),
+                     xpost_object_get_ent(privatestr), 0,
+                     sizeof(private), &private);
 
     return 0;
 }
@@ -379,8 +1148,6 @@ int newpngdevice(Xpost_Context *ctx,
     return 0;
 }
 
-static
-unsigned int _loadpngdevicecont_opcode;
 
 /* Specializes or sub-classes the PPMIMAGE device class.
    load PPMIMAGE
@@ -397,9 +1164,9 @@ int loadpngdevice(Xpost_Context *ctx)
     if (ret)
         return ret;
     classdic = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 0);
-    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(_loadpngdevicecont_opcode)))
+    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.loadpngdevicecont)))
         return execstackoverflow;
-    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_dict_get(ctx, classdic, namedotcopydict)))
+    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_dict_get(ctx, classdic, ctx->name_shortcuts.dotcopydict)))
         return execstackoverflow;
 
     return 0;
@@ -417,10 +1184,10 @@ int loadpngdevicecont(Xpost_Context *ctx,
     Xpost_Object op;
     int ret;
 
-    ret = xpost_dict_put(ctx, classdic, namenativecolorspace, nameDeviceRGB);
+    ret = xpost_dict_put(ctx, classdic, ctx->name_shortcuts.nativecolorspace, ctx->name_shortcuts.DeviceRGB);
 
     op = xpost_operator_cons(ctx, "pngCreateCont", (Xpost_Op_Func)_create_cont, 1, 3, integertype, integertype, dicttype);
-    _create_cont_opcode = op.mark_.padw;
+    ctx->opcode_shortcuts.png_create_cont = op.mark_.padw;
     op = xpost_operator_cons(ctx, "pngCreate", (Xpost_Op_Func)_create, 1, 3, integertype, integertype, dicttype);
     ret = xpost_dict_put(ctx, classdic, xpost_name_cons(ctx, "Create"), op);
     if (ret)
@@ -470,17 +1237,17 @@ int xpost_oper_init_png_device_ops(Xpost_Context *ctx,
     Xpost_Object n,op;
 
     /* factor-out name lookups from the operators (optimization) */
-    if (xpost_object_get_type((namePrivate = xpost_name_cons(ctx, "Private"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.Private = xpost_name_cons(ctx, "Private"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((namewidth = xpost_name_cons(ctx, "width"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.width = xpost_name_cons(ctx, "width"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((nameheight = xpost_name_cons(ctx, "height"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.height = xpost_name_cons(ctx, "height"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((namedotcopydict = xpost_name_cons(ctx, ".copydict"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.dotcopydict = xpost_name_cons(ctx, ".copydict"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((namenativecolorspace = xpost_name_cons(ctx, "nativecolorspace"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.nativecolorspace = xpost_name_cons(ctx, "nativecolorspace"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((nameDeviceRGB = xpost_name_cons(ctx, "DeviceRGB"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.DeviceRGB = xpost_name_cons(ctx, "DeviceRGB"))) == invalidtype)
         return VMerror;
 
     xpost_memory_table_get_addr(ctx->gl,
@@ -489,7 +1256,7 @@ int xpost_oper_init_png_device_ops(Xpost_Context *ctx,
     optab = (Xpost_Operator *)(ctx->gl->base + optadr);
     op = xpost_operator_cons(ctx, "loadpngdevice", (Xpost_Op_Func)loadpngdevice, 1, 0); INSTALL;
     op = xpost_operator_cons(ctx, "loadpngdevicecont", (Xpost_Op_Func)loadpngdevicecont, 1, 1, dicttype);
-    _loadpngdevicecont_opcode = op.mark_.padw;
+    ctx->opcode_shortcuts.loadpngdevicecont = op.mark_.padw;
 
     return 0;
 }
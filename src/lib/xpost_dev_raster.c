@@ -51,6 +51,7 @@
 
 #include "xpost_operator.h" /* create operators */
 #include "xpost_op_dict.h" /* call load operator for convenience */
+#include "xpost_dev_generic.h" /* finalize the private data */
 #include "xpost_dev_raster.h" /* check prototypes */
 
 enum Xpost_PixelFormat { RGB, ARGB, BGR, BGRA };
@@ -77,34 +78,60 @@ typedef struct
     unsigned char alpha, red, green, blue;
 } Xpost_Raster_ARGB_Pixel;
 
-typedef struct
-{
-    int width, height, byte_stride;
-    /*(Xpost_Raster_*_Pixel)*/ char *data[1];
-} Xpost_Raster_Buffer;
-
 typedef struct
 {
     int width, height;
     enum Xpost_PixelFormat pixelformat;
+    int page; /* pages emitted */
     /*
      * add additional members to private struct
      */
 #ifdef FAST_C_BUFFER
-    Xpost_Raster_Buffer *buf;
+    unsigned char *data; /* the page, rows from the top */
+    int stride; /* bytes per row */
+    int own; /* data was allocated by the device, not given by the client */
 #endif
 } PrivateData;
 
 
-static Xpost_Object namePrivate;
-static Xpost_Object namewidth;
-static Xpost_Object nameheight;
-static Xpost_Object namedotcopydict;
-static Xpost_Object namenativecolorspace;
-static Xpost_Object nameDeviceRGB;
+/* the size in bytes of a pixel of the format */
+static
+int _bpp(enum Xpost_PixelFormat pixelformat)
+{
+    switch(pixelformat)
+    {
+        case ARGB:
+            return sizeof(Xpost_Raster_ARGB_Pixel);
+        case BGR:
+            return sizeof(Xpost_Raster_BGR_Pixel);
+        case BGRA:
+            return sizeof(Xpost_Raster_BGRA_Pixel);
+        case RGB:
+        default:
+            return sizeof(Xpost_Raster_RGB_Pixel);
+    }
+}
+
+
+#ifdef FAST_C_BUFFER
+
+/* free the page of a device which became garbage */
+static
+int _finalize(Xpost_Memory_File *mem,
+              unsigned int ent)
+{
+    PrivateData private;
+
+    if (!xpost_memory_get(mem, ent, 0, sizeof(private), &private))
+        return 0;
+
+    if (private.own)
+        free(private.data);
 
+    return 1;
+}
 
-static unsigned int _create_cont_opcode;
+#endif
 
 /* create an instance of the device
    using the class .copydict procedure */
@@ -117,8 +144,8 @@ int _create(Xpost_Context *ctx,
     xpost_stack_push(ctx->lo, ctx->os, width);
     xpost_stack_push(ctx->lo, ctx->os, height);
     xpost_stack_push(ctx->lo, ctx->os, classdic);
-    xpost_dict_put(ctx, classdic, namewidth, width);
-    xpost_dict_put(ctx, classdic, nameheight, height);
+    xpost_dict_put(ctx, classdic, ctx->name_shortcuts.width, width);
+    xpost_dict_put(ctx, classdic, ctx->name_shortcuts.height, height);
 
     //printf("create\n");
     //fflush(0);
@@ -126,11 +153,11 @@ int _create(Xpost_Context *ctx,
        //call base-class's Create procedure (to initialize ImgData array)
        then call _create_cont, by continuation. */
     if (!xpost_stack_push(ctx->lo, ctx->es,
-                          xpost_operator_cons_opcode(_create_cont_opcode)))
+                          xpost_operator_cons_opcode(ctx->opcode_shortcuts.raster_create_cont)))
         return execstackoverflow;
 
     if (!xpost_stack_push(ctx->lo, ctx->es,
-                          xpost_dict_get(ctx, classdic, namedotcopydict)))
+                          xpost_dict_get(ctx, classdic, ctx->name_shortcuts.dotcopydict)))
         return execstackoverflow;
 
     return 0;
@@ -176,6 +203,11 @@ int _create_cont(Xpost_Context *ctx,
     {
         private.pixelformat = BGR;
     }
+    else
+    {
+        XPOST_LOG_ERR("unknown raster SUBDEVICE");
+        return unregistered;
+    }
 
     /* create a string to contain device data structure */
     privatestr = xpost_string_cons(ctx, sizeof(PrivateData), NULL);
@@ -184,10 +216,11 @@ int _create_cont(Xpost_Context *ctx,
         XPOST_LOG_ERR("cannot allocat private data structure");
         return unregistered;
     }
-    xpost_dict_put(ctx, devdic, namePrivate, privatestr);
+    xpost_dict_put(ctx, devdic, ctx->name_shortcuts.Private, privatestr);
 
     private.width = width;
     private.height = height;
+    private.page = 0;
 
     /*
      *
@@ -199,37 +232,53 @@ int _create_cont(Xpost_Context *ctx,
     inbufstr = xpost_dict_get(ctx, sd, xpost_name_cons(ctx, "OutputBufferIn"));
     if (xpost_object_get_type(inbufstr) == stringtype)
     {
-        unsigned char *inbuf;
+        Xpost_Output_Buffer inbuf;
 
+        /* draw into the client's memory, in its format */
         memcpy(&inbuf, xpost_string_get_pointer(ctx, inbufstr), sizeof(inbuf));
-        private.buf = (Xpost_Raster_Buffer *)inbuf;
-    }
-    else
-    {
-        /* allocate buffer header and array */
-        switch(private.pixelformat)
+        switch(inbuf.format)
         {
-            default:
-                return unregistered;
-            case ARGB:
-                private.buf = malloc(sizeof(Xpost_Raster_Buffer) +
-                                     sizeof(Xpost_Raster_ARGB_Pixel) * width * height);
+            case XPOST_PIXEL_FORMAT_RGB:
+                private.pixelformat = RGB;
                 break;
-            case RGB:
-                private.buf = malloc(sizeof(Xpost_Raster_Buffer) +
-                                     sizeof(Xpost_Raster_RGB_Pixel) * width * height);
+            case XPOST_PIXEL_FORMAT_ARGB:
+                private.pixelformat = ARGB;
                 break;
-            case BGRA:
-                private.buf = malloc(sizeof(Xpost_Raster_Buffer) +
-                                     sizeof(Xpost_Raster_BGRA_Pixel) * width * height);
+            case XPOST_PIXEL_FORMAT_BGR:
+                private.pixelformat = BGR;
                 break;
-            case BGR:
-                private.buf = malloc(sizeof(Xpost_Raster_Buffer) +
-                                     sizeof(Xpost_Raster_BGR_Pixel) * width * height);
+            case XPOST_PIXEL_FORMAT_BGRA:
+                private.pixelformat = BGRA;
                 break;
+            default:
+                XPOST_LOG_ERR("unknown output buffer format");
+                return unregistered;
+        }
+        if (inbuf.stride < inbuf.width * _bpp(private.pixelformat))
+        {
+            XPOST_LOG_ERR("output buffer stride too small");
+            return unregistered;
         }
-        private.buf->height = height;
-        private.buf->width = width;
+        private.data = inbuf.pixels;
+        private.stride = inbuf.stride;
+        private.own = 0;
+
+        /* a device made by the program may not draw past the buffer */
+        if (private.width > inbuf.width)
+            private.width = inbuf.width;
+        if (private.height > inbuf.height)
+            private.height = inbuf.height;
+    }
+    else
+    {
+        private.stride = width * _bpp(private.pixelformat);
+        private.data = malloc(private.stride * height);
+        if (!private.data)
+        {
+            XPOST_LOG_ERR("cannot allocate buffer memory");
+            return unregistered;
+        }
+        private.own = 1;
     }
 #else
     { /*
@@ -273,6 +322,11 @@ int _create_cont(Xpost_Context *ctx,
     xpost_memory_put(xpost_context_select_memory(ctx, privatestr),
                      xpost_object_get_ent(privatestr), 0,
                      sizeof(private), &private);
+#ifdef FAST_C_BUFFER
+    if (private.own)
+        xpost_device_set_private_finalizer(ctx, privatestr,
+                                           XPOST_DEVICE_PRIVATE_TAG_RASTER, _finalize);
+#endif
 
     /* return device instance dictionary to ps */
     xpost_stack_push(ctx->lo, ctx->os, devdic);
@@ -281,6 +335,57 @@ int _create_cont(Xpost_Context *ctx,
 
 #ifdef FAST_C_BUFFER
 
+/* store the color in the pixel at p */
+static
+void _store(unsigned char *p,
+            enum Xpost_PixelFormat pixelformat,
+            int red,
+            int green,
+            int blue)
+{
+    switch(pixelformat)
+    {
+        case BGRA:
+        {
+            Xpost_Raster_BGRA_Pixel *pixel = (Xpost_Raster_BGRA_Pixel *)p;
+
+            pixel->blue = blue;
+            pixel->green = green;
+            pixel->red = red;
+            pixel->alpha = 255;
+        }
+        break;
+        case BGR:
+        {
+            Xpost_Raster_BGR_Pixel *pixel = (Xpost_Raster_BGR_Pixel *)p;
+
+            pixel->blue = blue;
+            pixel->green = green;
+            pixel->red = red;
+        }
+        break;
+        case ARGB:
+        {
+            Xpost_Raster_ARGB_Pixel *pixel = (Xpost_Raster_ARGB_Pixel *)p;
+
+            pixel->alpha = 255;
+            pixel->red = red;
+            pixel->green = green;
+            pixel->blue = blue;
+        }
+        break;
+        case RGB:
+        {
+            Xpost_Raster_RGB_Pixel *pixel = (Xpost_Raster_RGB_Pixel *)p;
+
+            pixel->red = red;
+            pixel->green = green;
+            pixel->blue = blue;
+        }
+        break;
+    }
+}
+
 static
 int _putpix(Xpost_Context *ctx,
             Xpost_Object red,
@@ -312,7 +417,7 @@ int _putpix(Xpost_Context *ctx,
         y = xpost_int_cons((integer)y.real_.val);
 
     /* load private data struct from string */
-    privatestr = xpost_dict_get(ctx, devdic, namePrivate);
+    privatestr = xpost_dict_get(ctx, devdic, ctx->name_shortcuts.Private);
     if (xpost_object_get_type(privatestr) == invalidtype)
         return undefined;
     xpost_memory_get(xpost_context_select_memory(ctx, privatestr),
@@ -320,58 +425,134 @@ int _putpix(Xpost_Context *ctx,
                      sizeof(private), &private);
 
     /* check bounds */
-    if (x.int_.val < 0 || x.int_.val >= xpost_dict_get(ctx, devdic, namewidth).int_.val)
+    if (x.int_.val < 0 || x.int_.val >= private.width)
         return 0;
-    if (y.int_.val < 0 || y.int_.val >= xpost_dict_get(ctx, devdic, nameheight).int_.val)
+    if (y.int_.val < 0 || y.int_.val >= private.height)
         return 0;
 
-    switch(private.pixelformat)
-    {
-        case BGRA:
-        {
-            Xpost_Raster_BGRA_Pixel pixel;
+    _store(private.data + y.int_.val * private.stride
+                        + x.int_.val * _bpp(private.pixelformat),
+           private.pixelformat,
+           red.int_.val, green.int_.val, blue.int_.val);
 
-            pixel.blue = blue.int_.val;
-            pixel.green = green.int_.val;
-            pixel.red = red.int_.val;
-            pixel.alpha = 255;
-            ((Xpost_Raster_BGRA_Pixel*)private.buf->data)[y.int_.val * private.buf->width + x.int_.val] = pixel;
-        }
-        break;
-        case BGR:
-        {
-            Xpost_Raster_BGR_Pixel pixel;
+    return 0;
+}
 
-            pixel.blue = blue.int_.val;
-            pixel.green = green.int_.val;
-            pixel.red = red.int_.val;
-            ((Xpost_Raster_BGR_Pixel*)private.buf->data)[y.int_.val * private.buf->width + x.int_.val] = pixel;
-        }
-        break;
-        case ARGB:
-        {
-            Xpost_Raster_ARGB_Pixel pixel;
+/* fill the rectangle in place, rather than with PutPix for each pixel.
+   the far edges are inclusive, as in the PPMIMAGE FillRect */
+static
+int _fillrect(Xpost_Context *ctx,
+              Xpost_Object red,
+              Xpost_Object green,
+              Xpost_Object blue,
+              Xpost_Object x,
+              Xpost_Object y,
+              Xpost_Object width,
+              Xpost_Object height,
+              Xpost_Object devdic)
+{
+    Xpost_Object privatestr;
+    PrivateData private;
+    unsigned char *row;
+    int bpp;
+    int x0, y0, x1, y1;
+    int i;
 
-            pixel.alpha = 255;
-            pixel.red = red.int_.val;
-            pixel.green = green.int_.val;
-            pixel.blue = blue.int_.val;
-            ((Xpost_Raster_ARGB_Pixel*)private.buf->data)[y.int_.val * private.buf->width + x.int_.val] = pixel;
-        }
-        break;
-        case RGB:
-        {
-            Xpost_Raster_RGB_Pixel pixel;
+    /* fold numbers to integertype */
+    if (xpost_object_get_type(red) == realtype)
+        red = xpost_int_cons((integer)(red.real_.val * 255.0));
+    else
+        red.int_.val *= 255;
+    if (xpost_object_get_type(green) == realtype)
+        green = xpost_int_cons((integer)(green.real_.val * 255.0));
+    else
+        green.int_.val *= 255;
+    if (xpost_object_get_type(blue) == realtype)
+        blue = xpost_int_cons((integer)(blue.real_.val * 255.0));
+    else
+        blue.int_.val *= 255;
+    if (xpost_object_get_type(x) == realtype)
+        x = xpost_int_cons((integer)x.real_.val);
+    if (xpost_object_get_type(y) == realtype)
+        y = xpost_int_cons((integer)y.real_.val);
+    if (xpost_object_get_type(width) == realtype)
+        width = xpost_int_cons((integer)width.real_.val);
+    if (xpost_object_get_type(height) == realtype)
+        height = xpost_int_cons((integer)height.real_.val);
 
-            pixel.red = red.int_.val;
-            pixel.green = green.int_.val;
-            pixel.blue = blue.int_.val;
-            ((Xpost_Raster_RGB_Pixel*)private.buf->data)[y.int_.val * private.buf->width + x.int_.val] = pixel;
-        }
-        break;
+    /* adjust ranges */
+    if (width.int_.val < 0)
+    {
+        width.int_.val = abs(width.int_.val);
+        x.int_.val -= width.int_.val;
+    }
+    if (height.int_.val < 0)
+    {
+        height.int_.val = abs(height.int_.val);
+        y.int_.val -= height.int_.val;
     }
 
-    /* save private data struct in string */
+    /* load private data struct from string */
+    privatestr = xpost_dict_get(ctx, devdic, ctx->name_shortcuts.Private);
+    if (xpost_object_get_type(privatestr) == invalidtype)
+        return undefined;
+    xpost_memory_get(xpost_context_select_memory(ctx, privatestr),
+                     xpost_object_get_ent(privatestr), 0,
+                     sizeof(private), &private);
+
+    /* clip */
+    x0 = x.int_.val < 0 ? 0 : x.int_.val;
+    y0 = y.int_.val < 0 ? 0 : y.int_.val;
+    x1 = x.int_.val + width.int_.val;
+    y1 = y.int_.val + height.int_.val;
+    if (x1 >= private.width)
+        x1 = private.width - 1;
+    if (y1 >= private.height)
+        y1 = private.height - 1;
+    if (x0 > x1 || y0 > y1)
+        return 0;
+
+    /* paint the first row, and copy it to the others */
+    bpp = _bpp(private.pixelformat);
+    row = private.data + y0 * private.stride + x0 * bpp;
+    for (i = 0; i <= x1 - x0; i++)
+    {
+        _store(row + i * bpp, private.pixelformat,
+               red.int_.val, green.int_.val, blue.int_.val);
+    }
+    for (i = 1; i <= y1 - y0; i++)
+    {
+        memcpy(row + i * private.stride, row, (x1 - x0 + 1) * bpp);
+    }
+
+    return 0;
+}
+
+#endif
+
+#ifdef FAST_C_BUFFER
+
+static
+int _destroy(Xpost_Context *ctx,
+             Xpost_Object devdic)
+{
+    Xpost_Object privatestr;
+    PrivateData private;
+
+    /* load private data struct from string */
+    privatestr = xpost_dict_get(ctx, devdic, ctx->name_shortcuts.Private);
+    if (xpost_object_get_type(privatestr) == invalidtype)
+        return undefined;
+    xpost_memory_get(xpost_context_select_memory(ctx, privatestr),
+                     xpost_object_get_ent(privatestr), 0,
+                     sizeof(private), &private);
+
+    if (private.own)
+        free(private.data);
+
+    /* leave nothing for the finalizer */
+    private.data = NULL;
+    private.own = 0;
     xpost_memory_put(xpost_context_select_memory(ctx, privatestr),
                      xpost_object_get_ent(privatestr), 0,
                      sizeof(private), &private);
@@ -389,7 +570,7 @@ int _flush(Xpost_Context *ctx,
     PrivateData private;
 
     /* load private data struct from string */
-    privatestr = xpost_dict_get(ctx, devdic, namePrivate);
+    privatestr = xpost_dict_get(ctx, devdic, ctx->name_shortcuts.Private);
     if (xpost_object_get_type(privatestr) == invalidtype)
         return undefined;
     xpost_memory_get(xpost_context_select_memory(ctx, privatestr),
@@ -407,6 +588,7 @@ int _emit(Xpost_Context *ctx,
     Xpost_Object privatestr;
     PrivateData private;
     unsigned char *data;
+    int rowbytes;
 #ifndef FAST_C_BUFFER
     Xpost_Object imgdata;
     int stride;
@@ -414,7 +596,7 @@ int _emit(Xpost_Context *ctx,
 #endif
 
     /* load private data struct from string */
-    privatestr = xpost_dict_get(ctx, devdic, namePrivate);
+    privatestr = xpost_dict_get(ctx, devdic, ctx->name_shortcuts.Private);
     if (xpost_object_get_type(privatestr) == invalidtype)
         return undefined;
     xpost_memory_get(xpost_context_select_memory(ctx, privatestr),
@@ -422,24 +604,15 @@ int _emit(Xpost_Context *ctx,
                      sizeof(private), &private);
 
 #ifdef FAST_C_BUFFER
-    data = (unsigned char *)private.buf->data;
+    data = private.data;
+    rowbytes = private.stride;
 #else
 
     stride = private.width;
     height = private.height;
 
-    inbufstr = xpost_dict_get(ctx, sd, xpost_name_cons(ctx, "OutputBufferIn"));
-    if (xpost_object_get_type(inbufstr) == stringtype)
-    {
-        Xpost_Raster_Buffer *inbuf;
-
-        memcpy(&inbuf, xpost_string_get_pointer(ctx, inbufstr), sizeof(inbuf));
-        data = inbuf->data;
-    }
-    else
-    {
-        data = malloc(stride * height * ((private.pixelformat == ARGB) || (private.pixelformat == BGRA)) ? 4 : 3);
-    }
+    rowbytes = stride * _bpp(private.pixelformat);
+    data = malloc(rowbytes * height);
     imgdata = xpost_dict_get(ctx, devdic, xpost_name_cons(ctx, "ImgData"));
     if (xpost_object_get_type(imgdata) == invalidtype)
         return undefined;
@@ -496,6 +669,37 @@ int _emit(Xpost_Context *ctx,
     }
 #endif
 
+    ++private.page;
+    xpost_memory_put(xpost_context_select_memory(ctx, privatestr),
+                     xpost_object_get_ent(privatestr), 0,
+                     sizeof(private), &private);
+
+    /* lend the buffer to the page callback */
+    if (ctx->page_func)
+    {
+        Xpost_Pixel_Format format;
+
+        switch(private.pixelformat)
+        {
+            default:
+            case RGB:
+                format = XPOST_PIXEL_FORMAT_RGB;
+                break;
+            case ARGB:
+                format = XPOST_PIXEL_FORMAT_ARGB;
+                break;
+            case BGR:
+                format = XPOST_PIXEL_FORMAT_BGR;
+                break;
+            case BGRA:
+                format = XPOST_PIXEL_FORMAT_BGRA;
+                break;
+        }
+        ctx->page_func(ctx, private.page, data,
+                       private.width, private.height, rowbytes,
+                       format, ctx->page_data);
+    }
+
     /*pass data back to client application */
     {
         Xpost_Object sd, outbufstr;
@@ -515,7 +719,6 @@ int _emit(Xpost_Context *ctx,
 }
 
 
-
 /* operator function to instantiate a new window device.
    installed in userdict by calling 'loadXXXdevice'.
  */
@@ -540,8 +743,6 @@ int newrasterdevice(Xpost_Context *ctx,
     return 0;
 }
 
-static
-unsigned int _loadrasterdevicecont_opcode;
 
 /* Specializes or sub-classes the PPMIMAGE device class.
    load PPMIMAGE
@@ -559,10 +760,10 @@ int loadrasterdevice (Xpost_Context *ctx)
         return ret;
     classdic = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 0);
     if (!xpost_stack_push(ctx->lo, ctx->es,
-                          xpost_operator_cons_opcode(_loadrasterdevicecont_opcode)))
+                          xpost_operator_cons_opcode(ctx->opcode_shortcuts.loadrasterdevicecont)))
         return execstackoverflow;
     if (!xpost_stack_push(ctx->lo, ctx->es,
-                          xpost_dict_get(ctx, classdic, namedotcopydict)))
+                          xpost_dict_get(ctx, classdic, ctx->name_shortcuts.dotcopydict)))
         return execstackoverflow;
 
     return 0;
@@ -580,10 +781,10 @@ int loadrasterdevicecont(Xpost_Context *ctx,
     Xpost_Object op;
     int ret;
 
-    ret = xpost_dict_put(ctx, classdic, namenativecolorspace, nameDeviceRGB);
+    ret = xpost_dict_put(ctx, classdic, ctx->name_shortcuts.nativecolorspace, ctx->name_shortcuts.DeviceRGB);
 
     op = xpost_operator_cons(ctx, "rasterCreateCont", (Xpost_Op_Func)_create_cont, 1, 3, integertype, integertype, dicttype);
-    _create_cont_opcode = op.mark_.padw;
+    ctx->opcode_shortcuts.raster_create_cont = op.mark_.padw;
     op = xpost_operator_cons(ctx, "rasterCreate", (Xpost_Op_Func)_create, 1, 3, integertype, integertype, dicttype);
     ret = xpost_dict_put(ctx, classdic, xpost_name_cons(ctx, "Create"), op);
     if (ret)
@@ -597,6 +798,20 @@ int loadrasterdevicecont(Xpost_Context *ctx,
     ret = xpost_dict_put(ctx, classdic, xpost_name_cons(ctx, "PutPix"), op);
     if (ret)
         return ret;
+
+    op = xpost_operator_cons(ctx, "rasterFillRect", (Xpost_Op_Func)_fillrect, 0, 8,
+                             numbertype, numbertype, numbertype, /* r g b color values */
+                             numbertype, numbertype, /* x y */
+                             numbertype, numbertype, /* width height */
+                             dicttype); /* devdic */
+    ret = xpost_dict_put(ctx, classdic, xpost_name_cons(ctx, "FillRect"), op);
+    if (ret)
+        return ret;
+
+    op = xpost_operator_cons(ctx, "rasterDestroy", (Xpost_Op_Func)_destroy, 0, 1, dicttype);
+    ret = xpost_dict_put(ctx, classdic, xpost_name_cons(ctx, "Destroy"), op);
+    if (ret)
+        return ret;
 #endif
 
     op = xpost_operator_cons(ctx, "rasterEmit", (Xpost_Op_Func)_emit, 0, 1, dicttype);
@@ -635,17 +850,17 @@ int xpost_oper_init_raster_device_ops (Xpost_Context *ctx,
     Xpost_Object n,op;
 
     /* factor-out name lookups from the operators (optimization) */
-    if (xpost_object_get_type((namePrivate = xpost_name_cons(ctx, "Private"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.Private = xpost_name_cons(ctx, "Private"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((namewidth = xpost_name_cons(ctx, "width"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.width = xpost_name_cons(ctx, "width"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((nameheight = xpost_name_cons(ctx, "height"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.height = xpost_name_cons(ctx, "height"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((namedotcopydict = xpost_name_cons(ctx, ".copydict"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.dotcopydict = xpost_name_cons(ctx, ".copydict"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((namenativecolorspace = xpost_name_cons(ctx, "nativecolorspace"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.nativecolorspace = xpost_name_cons(ctx, "nativecolorspace"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((nameDeviceRGB = xpost_name_cons(ctx, "DeviceRGB"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.DeviceRGB = xpost_name_cons(ctx, "DeviceRGB"))) == invalidtype)
         return VMerror;
 
     xpost_memory_table_get_addr(ctx->gl,
@@ -654,7 +869,7 @@ int xpost_oper_init_raster_device_ops (Xpost_Context *ctx,
     optab = (Xpost_Operator *)(ctx->gl->base + optadr);
     op = xpost_operator_cons(ctx, "loadrasterdevice", (Xpost_Op_Func)loadrasterdevice, 1, 0); INSTALL;
     op = xpost_operator_cons(ctx, "loadrasterdevicecont", (Xpost_Op_Func)loadrasterdevicecont, 1, 1, dicttype);
-    _loadrasterdevicecont_opcode = op.mark_.padw;
+    ctx->opcode_shortcuts.loadrasterdevicecont = op.mark_.padw;
 
     return 0;
 }
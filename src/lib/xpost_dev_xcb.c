@@ -82,6 +82,7 @@ void *alloca (size_t);
 
 #include "xpost_operator.h" /* create operators */
 #include "xpost_op_dict.h" /* call xpost_op_any_load operator for convenience */
+#include "xpost_dev_generic.h" /* finalize private data */
 #include "xpost_dev_xcb.h" /* check prototypes */
 
 #define XCB_ALL_PLANES ~0
@@ -99,15 +100,6 @@ typedef struct
 
 static int _flush(Xpost_Context *ctx, Xpost_Object devdic);
 
-static
-unsigned int _event_handler_opcode;
-
-static Xpost_Object namePrivate;
-static Xpost_Object namewidth;
-static Xpost_Object nameheight;
-static Xpost_Object namedotcopydict;
-static Xpost_Object namenativecolorspace;
-static Xpost_Object nameDeviceRGB;
 
 static
 int _event_handler(Xpost_Context *ctx,
@@ -119,7 +111,7 @@ int _event_handler(Xpost_Context *ctx,
 
 
     /* load private data struct from string */
-    privatestr = xpost_dict_get(ctx, devdic, namePrivate);
+    privatestr = xpost_dict_get(ctx, devdic, ctx->name_shortcuts.Private);
     if (xpost_object_get_type(privatestr) == invalidtype)
         return undefined;
     xpost_memory_get(xpost_context_select_memory(ctx, privatestr),
@@ -146,9 +138,6 @@ int _event_handler(Xpost_Context *ctx,
 }
 
 
-static
-unsigned int _create_cont_opcode;
-
 /* create an instance of the device
    using the class .copydict procedure */
 static
@@ -160,22 +149,39 @@ int _create(Xpost_Context *ctx,
     xpost_stack_push(ctx->lo, ctx->os, width);
     xpost_stack_push(ctx->lo, ctx->os, height);
     xpost_stack_push(ctx->lo, ctx->os, classdic);
-    xpost_dict_put(ctx, classdic, namewidth, width);
-    xpost_dict_put(ctx, classdic, nameheight, height);
+    xpost_dict_put(ctx, classdic, ctx->name_shortcuts.width, width);
+    xpost_dict_put(ctx, classdic, ctx->name_shortcuts.height, height);
 
     /* call device class's ps-level .copydict procedure,
        then call _create_cont, by continuation. */
-    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(_create_cont_opcode)))
+    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.xcb_create_cont)))
         return execstackoverflow;
     if (!xpost_stack_push(ctx->lo, ctx->es,
                           xpost_dict_get(ctx, classdic,
                                          //xpost_name_cons(ctx, ".copydict")
-                                         namedotcopydict)))
+                                         ctx->name_shortcuts.dotcopydict)))
         return execstackoverflow;
 
     return 0;
 }
 
+/* close the connection of an xcb device
+   which became garbage without being destroyed */
+static
+int _finalize(Xpost_Memory_File *mem,
+              unsigned int ent)
+{
+    PrivateData private;
+
+    if (!xpost_memory_get(mem, ent, 0, sizeof(private), &private))
+        return 0;
+
+    if (private.c)
+        xcb_disconnect(private.c);
+
+    return 1;
+}
+
 /* initialize the C-level data
    and define in the device instance */
 static
@@ -200,7 +206,7 @@ int _create_cont(Xpost_Context *ctx,
         XPOST_LOG_ERR("cannot allocat private data structure");
         return unregistered;
     }
-    xpost_dict_put(ctx, devdic, namePrivate, privatestr);
+    xpost_dict_put(ctx, devdic, ctx->name_shortcuts.Private, privatestr);
 
     private.width = width;
     private.height = height;
@@ -292,7 +298,7 @@ int _create_cont(Xpost_Context *ctx,
                         private.win, private.scr->root_visual);
 
     xpost_context_install_event_handler(ctx,
-                                        xpost_operator_cons_opcode(_event_handler_opcode),
+                                        xpost_operator_cons_opcode(ctx->opcode_shortcuts.xcb_event_handler),
                                         devdic);
 
 
@@ -300,6 +306,8 @@ int _create_cont(Xpost_Context *ctx,
     xpost_memory_put(xpost_context_select_memory(ctx, privatestr),
                      xpost_object_get_ent(privatestr), 0,
                      sizeof(private), &private);
+    xpost_device_set_private_finalizer(ctx, privatestr,
+                                       XPOST_DEVICE_PRIVATE_TAG_XCB, _finalize);
 
     /* return device instance dictionary to ps */
     xpost_stack_push(ctx->lo, ctx->os, devdic);
@@ -337,7 +345,7 @@ int _putpix(Xpost_Context *ctx,
         y = xpost_int_cons(y.real_.val);
 
     /* load private data struct from string */
-    privatestr = xpost_dict_get(ctx, devdic, namePrivate);
+    privatestr = xpost_dict_get(ctx, devdic, ctx->name_shortcuts.Private);
     if (xpost_object_get_type(privatestr) == invalidtype)
         return undefined;
     xpost_memory_get(xpost_context_select_memory(ctx, privatestr),
@@ -392,7 +400,7 @@ int _getpix(Xpost_Context *ctx,
     PrivateData private;
 
     /* load private data struct from string */
-    privatestr = xpost_dict_get(ctx, devdic, namePrivate);
+    privatestr = xpost_dict_get(ctx, devdic, ctx->name_shortcuts.Private);
     if (xpost_object_get_type(privatestr) == invalidtype)
         return undefined;
     xpost_memory_get(xpost_context_select_memory(ctx, privatestr),
@@ -444,7 +452,7 @@ int _drawline(Xpost_Context *ctx,
                    x1.int_.val, y1.int_.val, x2.int_.val, y2.int_.val);
 
     /* load private data struct from string */
-    privatestr = xpost_dict_get(ctx, devdic, namePrivate);
+    privatestr = xpost_dict_get(ctx, devdic, ctx->name_shortcuts.Private);
     if (xpost_object_get_type(privatestr) == invalidtype)
         return undefined;
     xpost_memory_get(xpost_context_select_memory(ctx, privatestr),
@@ -534,7 +542,7 @@ int _fillrect(Xpost_Context *ctx,
     if (y.int_.val < 0) y.int_.val = 0;
 
     /* load private data struct from string */
-    privatestr = xpost_dict_get(ctx, devdic, namePrivate);
+    privatestr = xpost_dict_get(ctx, devdic, ctx->name_shortcuts.Private);
     if (xpost_object_get_type(privatestr) == invalidtype)
         return undefined;
     xpost_memory_get(xpost_context_select_memory(ctx, privatestr),
@@ -607,7 +615,7 @@ int _fillpoly(Xpost_Context *ctx,
         blue.int_.val *= 65535;
 
     /* load private data struct from string */
-    privatestr = xpost_dict_get(ctx, devdic, namePrivate);
+    privatestr = xpost_dict_get(ctx, devdic, ctx->name_shortcuts.Private);
     xpost_memory_get(xpost_context_select_memory(ctx, privatestr),
                      xpost_object_get_ent(privatestr), 0,
                      sizeof(private), &private);
@@ -669,7 +677,7 @@ int _flush(Xpost_Context *ctx,
     PrivateData private;
 
     /* load private data struct from string */
-    privatestr = xpost_dict_get(ctx, devdic, namePrivate);
+    privatestr = xpost_dict_get(ctx, devdic, ctx->name_shortcuts.Private);
     if (xpost_object_get_type(privatestr) == invalidtype)
         return undefined;
     xpost_memory_get(xpost_context_select_memory(ctx, privatestr),
@@ -697,7 +705,7 @@ int _destroy(Xpost_Context *ctx,
     Xpost_Object privatestr;
     PrivateData private;
 
-    privatestr = xpost_dict_get(ctx, devdic, namePrivate);
+    privatestr = xpost_dict_get(ctx, devdic, ctx->name_shortcuts.Private);
     if (xpost_object_get_type(privatestr) == invalidtype)
         return undefined;
     xpost_memory_get(xpost_context_select_memory(ctx, privatestr),
@@ -708,11 +716,16 @@ int _destroy(Xpost_Context *ctx,
 
     xcb_disconnect(private.c);
 
+    /* leave nothing for the finalizer */
+    memset(&private, 0, sizeof(private));
+    xpost_memory_put(xpost_context_select_memory(ctx, privatestr),
+                     xpost_object_get_ent(privatestr), 0,
+                     sizeof(private), &private);
+
     return 0;
 }
 
 
-
 /* operator function to instantiate a new window device.
    installed in userdict by calling 'loadXXXdevice'.
  */
@@ -736,8 +749,6 @@ int newxcbdevice(Xpost_Context *ctx,
     return 0;
 }
 
-static
-unsigned int _loadxcbdevicecont_opcode;
 
 /* Specializes or sub-classes the PPMIMAGE device class.
    load PPMIMAGE
@@ -754,12 +765,12 @@ int loadxcbdevice(Xpost_Context *ctx)
     if (ret)
         return ret;
     classdic = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 0);
-    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(_loadxcbdevicecont_opcode)))
+    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.loadxcbdevicecont)))
         return execstackoverflow;
     if (!xpost_stack_push(ctx->lo, ctx->es,
                           xpost_dict_get(ctx, classdic,
                                          //xpost_name_cons(ctx, ".copydict")
-                                         namedotcopydict)))
+                                         ctx->name_shortcuts.dotcopydict)))
         return execstackoverflow;
 
     return 0;
@@ -779,13 +790,13 @@ int loadxcbdevicecont(Xpost_Context *ctx,
 
     ret = xpost_dict_put(ctx, classdic,
                          //xpost_name_cons(ctx, "nativecolorspace"),
-                         namenativecolorspace,
+                         ctx->name_shortcuts.nativecolorspace,
                          //xpost_name_cons(ctx, "DeviceRGB")
-                         nameDeviceRGB);
+                         ctx->name_shortcuts.DeviceRGB);
 
     op = xpost_operator_cons(ctx, "xcbCreateCont", (Xpost_Op_Func)_create_cont, 1, 3,
                              integertype, integertype, dicttype);
-    _create_cont_opcode = op.mark_.padw;
+    ctx->opcode_shortcuts.xcb_create_cont = op.mark_.padw;
     op = xpost_operator_cons(ctx, "xcbCreate", (Xpost_Op_Func)_create, 1, 3,
                              integertype, integertype, dicttype);
     ret = xpost_dict_put(ctx, classdic, xpost_name_cons(ctx, "Create"), op);
@@ -857,7 +868,7 @@ int loadxcbdevicecont(Xpost_Context *ctx,
         return ret;
 
     op = xpost_operator_cons(ctx, "xcbEventHandler", (Xpost_Op_Func)_event_handler, 0, 1, dicttype);
-    _event_handler_opcode = op.mark_.padw;
+    ctx->opcode_shortcuts.xcb_event_handler = op.mark_.padw;
 
     return 0;
 }
@@ -873,17 +884,17 @@ int xpost_oper_init_xcb_device_ops (Xpost_Context *ctx,
     Xpost_Operator *optab;
     Xpost_Object n,op;
 
-    if (xpost_object_get_type((namePrivate = xpost_name_cons(ctx, "Private"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.Private = xpost_name_cons(ctx, "Private"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((namewidth = xpost_name_cons(ctx, "width"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.width = xpost_name_cons(ctx, "width"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((nameheight = xpost_name_cons(ctx, "height"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.height = xpost_name_cons(ctx, "height"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((namedotcopydict = xpost_name_cons(ctx, ".copydict"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.dotcopydict = xpost_name_cons(ctx, ".copydict"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((namenativecolorspace = xpost_name_cons(ctx, "nativecolorspace"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.nativecolorspace = xpost_name_cons(ctx, "nativecolorspace"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((nameDeviceRGB = xpost_name_cons(ctx, "DeviceRGB"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.DeviceRGB = xpost_name_cons(ctx, "DeviceRGB"))) == invalidtype)
         return VMerror;
 
     xpost_memory_table_get_addr(ctx->gl,
@@ -892,7 +903,7 @@ int xpost_oper_init_xcb_device_ops (Xpost_Context *ctx,
     optab = (Xpost_Operator *)(ctx->gl->base + optadr);
     op = xpost_operator_cons(ctx, "loadxcbdevice", (Xpost_Op_Func)loadxcbdevice, 1, 0); INSTALL;
     op = xpost_operator_cons(ctx, "loadxcbdevicecont", (Xpost_Op_Func)loadxcbdevicecont, 1, 1, dicttype);
-    _loadxcbdevicecont_opcode = op.mark_.padw;
+    ctx->opcode_shortcuts.loadxcbdevicecont = op.mark_.padw;
     //printf("initxcbops\n");
 
     return 0;
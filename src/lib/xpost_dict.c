@@ -274,10 +274,9 @@ Xpost_Object xpost_dict_cons_memory (Xpost_Memory_File *mem,
     rent = ent;
     xpost_memory_table_get_addr(mem, XPOST_MEMORY_TABLE_SPECIAL_SAVE_STACK, &vs);
     cnt = xpost_stack_count(mem, vs);
-    tab->tab[rent].mark = ( (0 << XPOST_MEMORY_TABLE_MARK_DATA_MARK_OFFSET)
-            | (0 << XPOST_MEMORY_TABLE_MARK_DATA_REFCOUNT_OFFSET)
-            | (cnt << XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_OFFSET)
-            | (cnt << XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_OFFSET) );
+    tab->lev[rent] = ( (0 << XPOST_MEMORY_TABLE_LEVEL_DATA_REFCOUNT_OFFSET)
+            | (cnt << XPOST_MEMORY_TABLE_LEVEL_DATA_LOWLEVEL_OFFSET)
+            | (cnt << XPOST_MEMORY_TABLE_LEVEL_DATA_TOPLEVEL_OFFSET) );
 
     xpost_memory_table_get_addr(mem, ent, &ad);
     dp = (void *)(mem->base + ad); /* clear header */
@@ -398,14 +397,14 @@ int dicgrow(Xpost_Context *ctx,
         nent = xpost_object_get_ent(n);
 
         /* exchange adrs */
-        hold = tab->tab[dent].adr;
-               tab->tab[dent].adr = tab->tab[nent].adr;
-                                    tab->tab[nent].adr = hold;
+        hold = tab->adr[dent];
+               tab->adr[dent] = tab->adr[nent];
+                                    tab->adr[nent] = hold;
 
         /* exchange sizes */
-        hold = tab->tab[dent].sz;
-               tab->tab[dent].sz = tab->tab[nent].sz;
-                                   tab->tab[nent].sz = hold;
+        hold = tab->sz[dent];
+               tab->sz[dent] = tab->sz[nent];
+                                   tab->sz[nent] = hold;
 
 #if 0
         if (xpost_free_memory_ent(mem, nent) < 0)
@@ -666,12 +665,12 @@ int xpost_dict_put_memory(Xpost_Context *ctx,
     unsigned int ad;
     int ret;
 
-    if (!ctx->gl->interpreter_get_initializing())
+    if (!ctx->gl->initializing)
         if (!xpost_object_is_writeable(ctx, d))
             return invalidaccess;
 
     if (!xpost_save_ent_is_saved(mem, xpost_object_get_ent(d)))
-        if (!xpost_save_save_ent(mem, dicttype, 0, xpost_object_get_ent(d)))
+        if (!xpost_save_save_ent(mem, dicttype, xpost_object_get_ent(d)))
             return VMerror;
 
     r = diclookup(ctx, mem, d, k);
@@ -783,7 +782,7 @@ int xpost_dict_undef_memory(Xpost_Context *ctx,
     int found = 0;
 
     if (!xpost_save_ent_is_saved(mem, xpost_object_get_ent(d)))
-        if (!xpost_save_save_ent(mem, dicttype, 0, xpost_object_get_ent(d)))
+        if (!xpost_save_save_ent(mem, dicttype, xpost_object_get_ent(d)))
             return VMerror;
 
     xpost_memory_table_get_addr(mem, xpost_object_get_ent(d), &ad);
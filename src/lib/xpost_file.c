@@ -65,6 +65,15 @@ void *alloca (size_t);
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <fcntl.h> /* open */
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h> /* close */
+#endif
+
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h> /* mmap munmap */
+#endif
 
 #include "xpost.h"
 #include "xpost_log.h"
@@ -74,8 +83,25 @@ void *alloca (size_t);
 #include "xpost_context.h"
 
 #include "xpost_error.h"  /* file functions may throw errors */
+#include "xpost_rom.h"  /* built-in files */
 #include "xpost_file.h"  /* double-check prototypes */
 
+/* files read from memory need streams with custom functions,
+   and mappings for the files on disk */
+#if defined (HAVE_FOPENCOOKIE) || defined (HAVE_FUNOPEN)
+# define XPOST_FILE_SPAN
+# if defined (HAVE_MMAP) && !defined (_WIN32)
+#  define XPOST_FILE_MMAP
+# endif
+# if defined (HAVE_POLL_H) && !defined (_WIN32)
+#  define XPOST_FILE_POLL
+# endif
+#endif
+
+#ifdef XPOST_FILE_POLL
+# include <poll.h>
+#endif
+
 #ifdef _WIN32
 /*
  * FIXME: maybe use a WIN32 API for all this. See FIXME in xpost_op_file.c
@@ -118,13 +144,24 @@ f_tmpfile(void)
 # define f_tmpfile tmpfile
 #endif
 
+/* a temporary file, for the filters decoded at once */
+FILE *xpost_file_tmpfile(void)
+{
+    return f_tmpfile();
+}
+
 /* interface fgetc
    in preparation for more elaborate cross-platform non-blocking mechanisms
 cf. http://stackoverflow.com/questions/20428616/how-to-handle-window-events-while-waiting-for-terminal-input
 and http://stackoverflow.com/questions/25506324/how-to-do-pollstdin-or-selectstdin-when-stdin-is-a-windows-console
    */
 int xpost_file_getc(FILE *in){
+#ifdef HAVE_GETC_UNLOCKED
+    /* a file is only read by the context owning it */
+    return getc_unlocked(in);
+#else
     return fgetc(in);
+#endif
 }
 
 /* filetype objects use a slightly different interpretation
@@ -134,10 +171,23 @@ int xpost_file_getc(FILE *in){
    XPOST_OBJECT_TAG_ACCESS_FLAG_READ designates a readable file
    */
 
+/* the record of a file in VM.
+   the FILE * comes first, so it can be read and written alone.
+   a filter also holds its source file (or null), which the
+   garbage collector marks, and whether closing the filter
+   closes the source. */
+typedef struct
+{
+    FILE *fp;
+    Xpost_Object src;
+    int closesrc;
+    Xpost_File_Map *map;
+} Xpost_File_Record;
+
 /* construct a file object.
    set the tag,
    use the "doubleword" field as a "pointer" (ent),
-   allocate a FILE *,
+   allocate a file record,
    install the FILE *,
    return object.
    caller must set access for a readable file,
@@ -148,8 +198,19 @@ int xpost_file_getc(FILE *in){
  */
 Xpost_Object xpost_file_cons(Xpost_Memory_File *mem,
                              /*@NULL@*/ const FILE *fp)
+{
+    return xpost_file_cons_filter(mem, fp, null, 0);
+}
+
+/* construct a file object for a filter reading from (or writing to)
+   the file src, which may be null. */
+Xpost_Object xpost_file_cons_filter(Xpost_Memory_File *mem,
+                                    /*@NULL@*/ const FILE *fp,
+                                    Xpost_Object src,
+                                    int closesrc)
 {
     Xpost_Object f;
+    Xpost_File_Record rec;
     unsigned int ent;
     int ret;
 
@@ -158,13 +219,17 @@ Xpost_Object xpost_file_cons(Xpost_Memory_File *mem,
 #endif
     f.tag = filetype /*| (XPOST_OBJECT_TAG_ACCESS_UNLIMITED << XPOST_OBJECT_TAG_DATA_FLAG_ACCESS_OFFSET)*/;
     /* xpost_memory_table_alloc(mem, sizeof(FILE *), 0, &f.mark_.padw); */
-    if (!xpost_memory_table_alloc(mem, sizeof(FILE *), filetype, &ent))
+    if (!xpost_memory_table_alloc(mem, sizeof rec, filetype, &ent))
     {
         XPOST_LOG_ERR("cannot allocate file record");
         return invalid;
     }
     f.mark_.padw = ent;
-    ret = xpost_memory_put(mem, f.mark_.padw, 0, sizeof(FILE *), &fp);
+    rec.fp = (FILE *)fp;
+    rec.src = src;
+    rec.closesrc = closesrc;
+    rec.map = NULL;
+    ret = xpost_memory_put(mem, f.mark_.padw, 0, sizeof rec, &rec);
     if (!ret)
     {
         XPOST_LOG_ERR("cannot save FILE* in VM");
@@ -173,6 +238,79 @@ Xpost_Object xpost_file_cons(Xpost_Memory_File *mem,
     return f;
 }
 
+/* record the span a file reads from */
+static
+int _xpost_file_set_map(Xpost_Memory_File *mem,
+                        Xpost_Object f,
+                        Xpost_File_Map *map)
+{
+    Xpost_File_Record rec;
+
+    if (!xpost_memory_get(mem, f.mark_.padw, 0, sizeof rec, &rec))
+        return 0;
+    rec.map = map;
+    return xpost_memory_put(mem, f.mark_.padw, 0, sizeof rec, &rec);
+}
+
+/* yield the span of a file read from memory, if still open */
+Xpost_File_Map *xpost_file_get_map(Xpost_Memory_File *mem,
+                                   Xpost_Object f)
+{
+    Xpost_File_Record rec;
+
+    if (!xpost_memory_get(mem, f.mark_.padw, 0, sizeof rec, &rec) || !rec.fp)
+        return NULL;
+    return rec.map;
+}
+
+/* yield the source of a filter, null for other files */
+Xpost_Object xpost_file_get_source(Xpost_Memory_File *mem,
+                                   Xpost_Object f)
+{
+    Xpost_File_Record rec;
+
+    if (!xpost_memory_get(mem, f.mark_.padw, 0, sizeof rec, &rec))
+        return null;
+    return rec.src;
+}
+
+/*
+   release the FILE * of an unreachable (or freed) file record.
+   installed as the finalizer for the filetype tag.
+ */
+int xpost_file_finalize(Xpost_Memory_File *mem,
+                        unsigned int ent)
+{
+    FILE *fp;
+    int ret;
+
+    ret = xpost_memory_get(mem, ent, 0, sizeof(FILE *), &fp);
+    if (!ret)
+    {
+        XPOST_LOG_ERR("cannot load FILE* from VM");
+        return 0;
+    }
+    if (fp &&
+        fp != stdin &&
+        fp != stdout &&
+        fp != stderr)
+    {
+#ifdef DEBUG_FILE
+        printf("gc:xpost_file_finalize closing FILE* %p\n", fp);
+        fflush(stdout);
+#endif
+        fclose(fp);
+        fp = NULL;
+        ret = xpost_memory_put(mem, ent, 0, sizeof(FILE *), &fp);
+        if (!ret)
+        {
+            XPOST_LOG_ERR("cannot write NULL over FILE* in VM");
+            return 0;
+        }
+    }
+    return 1;
+}
+
 /* pinch-off a tmpfile containing one line from file. */
 /*@null@*/
 static
@@ -284,6 +422,399 @@ done:
     return 0;
 }
 
+/* a span of size bytes at base, not growing */
+static
+Xpost_File_Map *_xpost_file_span_new(const void *base, size_t size)
+{
+    Xpost_File_Map *map;
+
+    map = malloc(sizeof *map);
+    if (!map)
+        return NULL;
+    map->base = base;
+    map->size = size;
+    map->pos = 0;
+    map->unmap = 0;
+    map->copy = 0;
+    map->ended = 1;
+    map->cap = size;
+    map->more = NULL;
+    map->data = NULL;
+    map->fd = -1;
+    return map;
+}
+
+int xpost_file_map_more(Xpost_File_Map *map)
+{
+    unsigned char *buf = (unsigned char *)map->base;
+    long n;
+
+    if (map->ended)
+        return 0;
+    /* drop what was read */
+    if (map->pos > 0)
+    {
+        memmove(buf, buf + map->pos, map->size - map->pos);
+        map->size -= map->pos;
+        map->pos = 0;
+    }
+    if (map->cap - map->size < BUFSIZ)
+    {
+        size_t cap = map->cap ? map->cap * 2 : BUFSIZ;
+        if (cap - map->size < BUFSIZ)
+            cap = map->size + BUFSIZ;
+        buf = realloc(buf, cap);
+        if (!buf)
+        {
+            XPOST_LOG_ERR("cannot grow input buffer");
+            map->ended = 1;
+            return 0;
+        }
+        map->base = buf;
+        map->cap = cap;
+    }
+    n = map->more(map->data, buf + map->size, map->cap - map->size);
+    if (n < 0)
+        return -1;
+    if (n == 0)
+    {
+        map->ended = 1;
+        return 0;
+    }
+    map->size += (size_t)n;
+    return 1;
+}
+
+/* take all of the bytes of a callback for the filter f,
+   which reads them through stdio */
+int xpost_file_fill_source(Xpost_Memory_File *mem,
+                           Xpost_Object f)
+{
+    Xpost_File_Map *map = NULL;
+
+    /* the span at the end of the chain of sources */
+    while (xpost_object_get_type(f) == filetype &&
+           !(map = xpost_file_get_map(mem, f)))
+        f = xpost_file_get_source(mem, f);
+    /* a fifo is polled, stdio waits for it */
+    if (!map || map->fd >= 0)
+        return 0;
+    while (!map->ended)
+        if (xpost_file_map_more(map) < 0)
+            return -1;
+    return 0;
+}
+
+#ifdef XPOST_FILE_SPAN
+
+/* a stream reading a span of memory.
+   it is unbuffered, so the position of the FILE is always map->pos,
+   and the span may also be read directly. */
+static
+long _xpost_file_span_read(Xpost_File_Map *map, char *buf, size_t size)
+{
+    size_t n;
+
+    /* no way to return to the caller from here */
+    while (map->pos == map->size && xpost_file_map_more(map) < 0)
+    {
+#ifdef XPOST_FILE_POLL
+        if (map->fd >= 0)
+        {
+            struct pollfd p;
+
+            p.fd = map->fd;
+            p.events = POLLIN;
+            (void)poll(&p, 1, -1);
+            continue;
+        }
+#endif
+        /* the readers of a callback take all of its bytes first
+           (xpost_file_fill_source): fail rather than spin on it */
+        XPOST_LOG_ERR("no bytes from the input callback");
+        return -1;
+    }
+    n = map->size - map->pos;
+    if (n > size)
+        n = size;
+    memcpy(buf, map->base + map->pos, n);
+    map->pos += n;
+    return (long)n;
+}
+
+static
+int _xpost_file_span_seek(Xpost_File_Map *map, long off, int whence)
+{
+    long pos;
+
+    /* a growing span drops what was read, like a pipe */
+    if (map->more)
+        return -1;
+    switch (whence)
+    {
+        case SEEK_SET: pos = off; break;
+        case SEEK_CUR: pos = (long)map->pos + off; break;
+        case SEEK_END: pos = (long)map->size + off; break;
+        default: return -1;
+    }
+    if (pos < 0 || (size_t)pos > map->size)
+        return -1;
+    map->pos = (size_t)pos;
+    return 0;
+}
+
+static
+int _xpost_file_span_close(void *cookie)
+{
+    Xpost_File_Map *map = cookie;
+
+#ifdef XPOST_FILE_MMAP
+    if (map->unmap)
+        munmap((void *)map->base, map->size);
+#endif
+    if (map->copy)
+        free((void *)map->base);
+#ifdef XPOST_FILE_POLL
+    if (map->fd >= 0)
+        close(map->fd);
+#endif
+    free(map);
+    return 0;
+}
+
+# ifdef HAVE_FOPENCOOKIE
+
+static
+ssize_t _xpost_file_span_cookie_read(void *cookie, char *buf, size_t size)
+{
+    return (ssize_t)_xpost_file_span_read(cookie, buf, size);
+}
+
+static
+int _xpost_file_span_cookie_seek(void *cookie, off64_t *off, int whence)
+{
+    Xpost_File_Map *map = cookie;
+
+    if (_xpost_file_span_seek(map, (long)*off, whence))
+        return -1;
+    *off = (off64_t)map->pos;
+    return 0;
+}
+
+static
+FILE *spanopen(Xpost_File_Map *map)
+{
+    cookie_io_functions_t io;
+    FILE *fp;
+
+    io.read = _xpost_file_span_cookie_read;
+    io.write = NULL;
+    io.seek = _xpost_file_span_cookie_seek;
+    io.close = _xpost_file_span_close;
+    fp = fopencookie(map, "r", io);
+    if (fp)
+        setvbuf(fp, NULL, _IONBF, 0);
+    return fp;
+}
+
+# else
+
+static
+int _xpost_file_span_cookie_read(void *cookie, char *buf, int size)
+{
+    return (int)_xpost_file_span_read(cookie, buf, (size_t)size);
+}
+
+static
+fpos_t _xpost_file_span_cookie_seek(void *cookie, fpos_t off, int whence)
+{
+    Xpost_File_Map *map = cookie;
+
+    if (_xpost_file_span_seek(map, (long)off, whence))
+        return -1;
+    return (fpos_t)map->pos;
+}
+
+static
+FILE *spanopen(Xpost_File_Map *map)
+{
+    FILE *fp;
+
+    fp = funopen(map, _xpost_file_span_cookie_read, NULL,
+                 _xpost_file_span_cookie_seek, _xpost_file_span_close);
+    if (fp)
+        setvbuf(fp, NULL, _IONBF, 0);
+    return fp;
+}
+
+# endif
+
+#endif
+
+#ifdef XPOST_FILE_MMAP
+/* map a regular file for reading.
+   return 0 if it cannot be, so it is read with stdio. */
+static
+int mapopen(const char *fn, FILE **out, Xpost_File_Map **outmap)
+{
+    Xpost_File_Map *map;
+    struct stat sb;
+    void *base;
+    int fd;
+
+    fd = open(fn, O_RDONLY);
+    if (fd < 0)
+        return 0;
+    if (fstat(fd, &sb) != 0 ||
+        !S_ISREG(sb.st_mode) ||
+        sb.st_size <= 0 ||
+        (unsigned long long)sb.st_size > (unsigned long long)LONG_MAX)
+    {
+        close(fd);
+        return 0;
+    }
+    base = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return 0;
+    map = _xpost_file_span_new(base, (size_t)sb.st_size);
+    if (!map)
+    {
+        munmap(base, (size_t)sb.st_size);
+        return 0;
+    }
+    map->unmap = 1;
+    *out = spanopen(map);
+    if (!*out)
+    {
+        _xpost_file_span_close(map);
+        return 0;
+    }
+    *outmap = map;
+    return 1;
+}
+#endif
+
+#ifdef XPOST_FILE_POLL
+/* the next bytes of a fifo, -1 if none has come yet */
+static
+long _xpost_file_pipe_read(void *data, void *buf, size_t len)
+{
+    Xpost_File_Map *map = data;
+    ssize_t n;
+
+    n = read(map->fd, buf, len);
+    if (n < 0)
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            return -1;
+        XPOST_LOG_ERR("cannot read fifo: %s", strerror(errno));
+        return 0;
+    }
+    return (long)n;
+}
+
+/* open a fifo for reading in a growing span, without blocking.
+   return 0 if it is not a fifo, so it is read with stdio. */
+static
+int pipeopen(const char *fn, FILE **out, Xpost_File_Map **outmap)
+{
+    Xpost_File_Map *map;
+    struct stat sb;
+    int flags;
+    int fd;
+
+    if (stat(fn, &sb) != 0 || !S_ISFIFO(sb.st_mode))
+        return 0;
+    /* wait for a writer, like fopen(): opened without it,
+       the fifo would read as ended */
+    fd = open(fn, O_RDONLY);
+    if (fd < 0)
+        return 0;
+    flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+    {
+        close(fd);
+        return 0;
+    }
+    map = _xpost_file_span_new(NULL, 0);
+    if (!map)
+    {
+        close(fd);
+        return 0;
+    }
+    map->copy = 1;
+    map->ended = 0;
+    map->more = _xpost_file_pipe_read;
+    map->data = map;
+    map->fd = fd;
+    *out = spanopen(map);
+    if (!*out)
+    {
+        _xpost_file_span_close(map);
+        return 0;
+    }
+    *outmap = map;
+    return 1;
+}
+#endif
+
+/* open a built-in file for reading,
+   from its memory if possible, else from a copy in a tmpfile. */
+static
+int romopen(const char *fn, FILE **out, Xpost_File_Map **outmap)
+{
+    const char *data;
+    size_t size;
+    FILE *fp;
+
+    data = xpost_rom_find(fn, &size);
+    if (data == NULL)
+    {
+        return undefinedfilename;
+    }
+#ifdef XPOST_FILE_SPAN
+    {
+        Xpost_File_Map *map = _xpost_file_span_new(data, size);
+        if (map)
+        {
+            fp = spanopen(map);
+            if (fp != NULL)
+            {
+                *out = fp;
+                *outmap = map;
+                return 0;
+            }
+            free(map);
+        }
+    }
+#endif
+#ifdef HAVE_FMEMOPEN
+    if (size > 0)
+    {
+        fp = fmemopen((void *)data, size, "r");
+        if (fp != NULL)
+        {
+            *out = fp;
+            return 0;
+        }
+    }
+#endif
+    fp = f_tmpfile();
+    if (fp == NULL) {
+        XPOST_LOG_ERR("tmpfile() returned NULL");
+        return ioerror;
+    }
+    if (fwrite(data, 1, size, fp) != size)
+    {
+        fclose(fp);
+        return ioerror;
+    }
+    fseek(fp, 0, SEEK_SET);
+    *out = fp;
+    return 0;
+}
+
 /* Open a file object,
    check for "special" filenames,
    fallback to fopen. */
@@ -294,6 +825,7 @@ int xpost_file_open(Xpost_Memory_File *mem,
 {
     Xpost_Object f;
     FILE *fp;
+    Xpost_File_Map *map = NULL;
     int ret;
 
     f.tag = filetype;
@@ -338,11 +870,47 @@ int xpost_file_open(Xpost_Memory_File *mem,
         f = xpost_file_cons(mem, fp);
         f.tag &= ~XPOST_OBJECT_TAG_DATA_FLAG_ACCESS_MASK;
         f.tag |= (XPOST_OBJECT_TAG_ACCESS_FILE_READ << XPOST_OBJECT_TAG_DATA_FLAG_ACCESS_OFFSET);
+    } else if (strncmp(fn, XPOST_ROM_DEVICE, strlen(XPOST_ROM_DEVICE))==0) {
+        if (strcmp(mode, "r")!=0)
+        {
+            return invalidfileaccess;
+        }
+        ret = romopen(fn, &fp, &map);
+        if (ret)
+        {
+            return ret;
+        }
+        f = xpost_file_cons(mem, fp);
+        if (map)
+            (void)_xpost_file_set_map(mem, f, map);
+        f.tag &= ~XPOST_OBJECT_TAG_DATA_FLAG_ACCESS_MASK;
+        f.tag |= (XPOST_OBJECT_TAG_ACCESS_FILE_READ << XPOST_OBJECT_TAG_DATA_FLAG_ACCESS_OFFSET);
     } else {
 #ifdef DEBUG_FILE
         printf("fopen\n");
 #endif
-        fp = fopen(fn, mode);
+        fp = NULL;
+#ifdef XPOST_FILE_POLL
+        if (strcmp(mode, "r")==0)
+            (void)pipeopen(fn, &fp, &map);
+#endif
+#ifdef XPOST_FILE_MMAP
+        if (fp == NULL && strcmp(mode, "r")==0)
+            (void)mapopen(fn, &fp, &map);
+#endif
+        if (fp == NULL)
+            fp = fopen(fn, mode);
+#ifdef EMFILE
+        /* out of descriptors: collect to finalize unreachable files, retry */
+        if (fp == NULL &&
+            errno == EMFILE &&
+            mem->garbage_collect_is_installed &&
+            !mem->initializing)
+        {
+            if (mem->garbage_collect(mem, 1, 1) > 0)
+                fp = fopen(fn, mode);
+        }
+#endif
         if (fp == NULL) {
             switch (errno) {
             case EACCES:
@@ -357,6 +925,8 @@ int xpost_file_open(Xpost_Memory_File *mem,
             }
         }
         f = xpost_file_cons(mem, fp);
+        if (map)
+            (void)_xpost_file_set_map(mem, f, map);
         if (strcmp(mode, "r")==0){
             f.tag &= ~XPOST_OBJECT_TAG_DATA_FLAG_ACCESS_MASK;
             f.tag |= (XPOST_OBJECT_TAG_ACCESS_FILE_READ << XPOST_OBJECT_TAG_DATA_FLAG_ACCESS_OFFSET);
@@ -381,6 +951,121 @@ int xpost_file_open(Xpost_Memory_File *mem,
     return 0;
 }
 
+/* open a program held in memory for reading,
+   in place if possible, else from a copy in a tmpfile. */
+int xpost_file_open_buffer(Xpost_Memory_File *mem,
+                           const void *buf,
+                           size_t len,
+                           int copy,
+                           Xpost_Object *retval)
+{
+    Xpost_Object f;
+    FILE *fp = NULL;
+    Xpost_File_Map *map = NULL;
+
+#ifdef XPOST_FILE_SPAN
+    map = _xpost_file_span_new(buf, len);
+    if (!map)
+        return VMerror;
+    if (copy && len > 0)
+    {
+        void *dup = malloc(len);
+        if (!dup)
+        {
+            free(map);
+            return VMerror;
+        }
+        memcpy(dup, buf, len);
+        map->base = dup;
+        map->copy = 1;
+    }
+    fp = spanopen(map);
+    if (fp == NULL)
+    {
+        _xpost_file_span_close(map);
+        map = NULL;
+    }
+#else
+    (void)copy;
+#endif
+    if (fp == NULL)
+    {
+        fp = f_tmpfile();
+        if (fp == NULL)
+        {
+            XPOST_LOG_ERR("tmpfile() returned NULL");
+            return ioerror;
+        }
+        if (fwrite(buf, 1, len, fp) != len)
+        {
+            fclose(fp);
+            return ioerror;
+        }
+        rewind(fp);
+    }
+
+    f = xpost_file_cons(mem, fp);
+    if (xpost_object_get_type(f) == invalidtype)
+    {
+        fclose(fp);
+        return VMerror;
+    }
+    if (map)
+        (void)_xpost_file_set_map(mem, f, map);
+    f.tag &= ~XPOST_OBJECT_TAG_DATA_FLAG_ACCESS_MASK;
+    f.tag |= (XPOST_OBJECT_TAG_ACCESS_FILE_READ << XPOST_OBJECT_TAG_DATA_FLAG_ACCESS_OFFSET);
+    f.tag |= XPOST_OBJECT_TAG_DATA_FLAG_LIT;
+    *retval = f;
+    return 0;
+}
+
+/* open a program returned by a function for reading.
+   the bytes are read in a growing span, so they need the span stream. */
+int xpost_file_open_callback(Xpost_Memory_File *mem,
+                             Xpost_Input_Read_Func read,
+                             void *data,
+                             Xpost_Object *retval)
+{
+#ifdef XPOST_FILE_SPAN
+    Xpost_Object f;
+    Xpost_File_Map *map;
+    FILE *fp;
+
+    map = _xpost_file_span_new(NULL, 0);
+    if (!map)
+        return VMerror;
+    map->copy = 1;
+    map->ended = 0;
+    map->more = read;
+    map->data = data;
+    fp = spanopen(map);
+    if (fp == NULL)
+    {
+        _xpost_file_span_close(map);
+        return ioerror;
+    }
+    f = xpost_file_cons(mem, fp);
+    if (xpost_object_get_type(f) == invalidtype)
+    {
+        fclose(fp);
+        return VMerror;
+    }
+    (void)_xpost_file_set_map(mem, f, map);
+    f.tag &= ~XPOST_OBJECT_TAG_DATA_FLAG_ACCESS_MASK;
+    f.tag |= (XPOST_OBJECT_TAG_ACCESS_FILE_READ << XPOST_OBJECT_TAG_DATA_FLAG_ACCESS_OFFSET);
+    f.tag |= XPOST_OBJECT_TAG_DATA_FLAG_LIT;
+    *retval = f;
+    return 0;
+#else
+    (void)mem;
+    (void)read;
+    (void)data;
+    (void)retval;
+    XPOST_LOG_ERR("input callbacks need fopencookie or funopen");
+    return unregistered;
+#endif
+}
+
 /* adapter:
            FILE* <- filetype object
    yield the FILE* from a filetype object */
@@ -415,8 +1100,22 @@ int xpost_file_get_bytes_available(Xpost_Memory_File *mem,
     struct stat sb;
     long sz, pos;
 
+    Xpost_File_Map *map;
+
     fp = xpost_file_get_file_pointer(mem, f);
     if (!fp) return ioerror;
+    if ((map = xpost_file_get_map(mem, f)))
+    {
+        if (map->size - map->pos > INT_MAX)
+            return rangecheck;
+        *retval = (int)(map->size - map->pos);
+        return 0;
+    }
+    if (fileno(fp) < 0) /* a filter: unknown */
+    {
+        *retval = -1;
+        return 0;
+    }
     ret = fstat(fileno(fp), &sb);
     if (ret != 0)
     {
@@ -459,6 +1158,15 @@ int xpost_file_close(Xpost_Memory_File *mem,
             XPOST_LOG_ERR("cannot write NULL over FILE* in VM");
             return VMerror;
         }
+
+        /* a filter with CloseSource closes its source too */
+        {
+            Xpost_File_Record rec;
+            if (xpost_memory_get(mem, f.mark_.padw, 0, sizeof rec, &rec) &&
+                rec.closesrc &&
+                xpost_object_get_type(rec.src) == filetype)
+                return xpost_file_close(mem, rec.src);
+        }
     }
     return 0;
 }
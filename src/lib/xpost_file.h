@@ -46,11 +46,100 @@
    for the FILE *
    */
 
+/**
+ * @brief the contents of a file read from memory
+ *
+ * A regular file opened for reading is mapped in memory when
+ * possible, a built-in file is read from the library's data, and a
+ * program given to xpost_run() is read from its buffer.
+ * Its FILE* reads the span without buffering, so the position of
+ * the file is always pos, and the span may be read directly by
+ * advancing pos, for instance to scan tokens in place.
+ *
+ * The span of a program read with a callback grows: until ended is
+ * set, reaching its end only means that xpost_file_map_more() must
+ * be called for the next bytes.
+ *
+ * A fifo is read in a growing span too, with a descriptor that does
+ * not block: while it has no bytes, the reads of the file block the
+ * context instead of the thread, and the scheduler polls fd.
+ */
+typedef struct
+{
+    const unsigned char *base; /**< the contents */
+    size_t size; /**< their size */
+    size_t pos; /**< the position in the span */
+    int unmap; /**< the span is a mapping to remove when the file is closed */
+    int copy; /**< the span is a copy to free when the file is closed */
+    int ended; /**< no bytes will be added to the span */
+    size_t cap; /**< the allocated size of a growing span */
+    Xpost_Input_Read_Func more; /**< the function returning the next bytes */
+    void *data; /**< its data */
+    int fd; /**< the descriptor of a fifo, closed with the file, -1 if none */
+} Xpost_File_Map;
+
+/**
+ * @brief Read the next bytes of a growing span.
+ *
+ * The bytes before pos are dropped.
+ * @return 1 if bytes were added, 0 at the end of the input,
+ * -1 if none are available yet.
+ */
+int xpost_file_map_more(Xpost_File_Map *map);
+
+/**
+ * @brief Take all of the bytes of a callback read by a filter.
+ *
+ * A filter reads its source through stdio, which cannot return to
+ * the caller to wait for the bytes of a growing span: before f is
+ * read, the whole program read with a callback is taken from it.
+ * @return 0 when it is, or if f does not read such a span,
+ * -1 if the callback has no bytes yet.
+ */
+int xpost_file_fill_source(Xpost_Memory_File *mem, Xpost_Object f);
+
 /**
  * @brief Construct a file object given a FILE*.
  */
 Xpost_Object xpost_file_cons(Xpost_Memory_File *mem, /*@NULL@*/ const FILE *fp);
 
+/**
+ * @brief Construct a file object for a filter given a FILE*.
+ *
+ * src is the source (or target) file of the filter, or null if the
+ * filter reads from a string. It is kept reachable as long as the
+ * filter is, and closed with the filter if closesrc is not 0.
+ */
+Xpost_Object xpost_file_cons_filter(Xpost_Memory_File *mem, /*@NULL@*/ const FILE *fp,
+                                    Xpost_Object src, int closesrc);
+
+/**
+ * @brief Return the source file of a filter, null for other files.
+ */
+Xpost_Object xpost_file_get_source(Xpost_Memory_File *mem, Xpost_Object f);
+
+/**
+ * @brief Return the contents of a file read from memory, or NULL.
+ *
+ * NULL is returned for a closed file, or a file read with stdio
+ * (pipes, terminals, files which cannot be mapped).
+ */
+Xpost_File_Map *xpost_file_get_map(Xpost_Memory_File *mem, Xpost_Object f);
+
+/**
+ * @brief Open a temporary file, removed when it is closed.
+ */
+FILE *xpost_file_tmpfile(void);
+
+/**
+ * @brief Finalizer for filetype ents, closes the FILE*.
+ *
+ * Installed for the filetype tag with
+ * xpost_memory_register_finalize_function(). Standard files are
+ * never closed.
+ */
+int xpost_file_finalize(Xpost_Memory_File *mem, unsigned int ent);
+
 /**
  * @brief Read a byte from FILE*.
  */
@@ -61,6 +150,19 @@ int xpost_file_getc(FILE *in);
  */
 int xpost_file_open(Xpost_Memory_File *mem, char *fn, char *mode, Xpost_Object *retval);
 
+/**
+ * @brief Construct a read-only file object reading len bytes at buf.
+ *
+ * If copy is 0, the bytes are read in place, and must stay valid
+ * until the file is closed. Otherwise they are copied first.
+ */
+int xpost_file_open_buffer(Xpost_Memory_File *mem, const void *buf, size_t len, int copy, Xpost_Object *retval);
+
+/**
+ * @brief Construct a read-only file object reading the bytes returned by read.
+ */
+int xpost_file_open_callback(Xpost_Memory_File *mem, Xpost_Input_Read_Func read, void *data, Xpost_Object *retval);
+
 /**
  * @brief Return the FILE* from the file object.
  */
@@ -0,0 +1,755 @@
+/*
+ * Xpost - a Level-2 Postscript interpreter
+ * Copyright (C) 2013-2016, Michael Joshua Ryan
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the Xpost software product nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#ifdef HAVE_ZLIB
+# include <zlib.h>
+#endif
+
+#include "xpost.h"
+#include "xpost_log.h"
+#include "xpost_memory.h"
+#include "xpost_object.h"
+#include "xpost_error.h"
+#include "xpost_file.h"
+#include "xpost_filter.h"
+
+/* the state of a filter, the cookie of its FILE *.
+   the source is read through an input buffer, and the decoders write
+   into the caller's buffer, spilling what does not fit into q,
+   which is emptied first at the next read. a decoding step spills
+   at most an LZW string, or twice the EODString of SubFileDecode. */
+typedef struct Xpost_Filter
+{
+    int (*decode)(struct Xpost_Filter *f, unsigned char *out, int n);
+    void (*finish)(struct Xpost_Filter *f);
+
+    Xpost_Memory_File *mem;
+    Xpost_Object src;     /* source file, or null */
+    unsigned char *str;   /* or source string */
+    int seekable;         /* source can be read ahead, and sought back at EOD */
+    int done;             /* the decoder has met the end of its data */
+    int eod;              /* and all of it has been read */
+
+    const unsigned char *in;  /* input buffer */
+    unsigned int inpos, inlen;
+    unsigned char buf[BUFSIZ];
+
+    unsigned char *q;     /* qbuf, or allocated for a long EODString */
+    unsigned char qbuf[4096];
+    int qpos, qlen;
+
+    union
+    {
+        struct { unsigned int sum; int n; } a85;
+        struct { int copy, repeat, c; } rl;
+        struct
+        {
+            int early;
+            int width;
+            int next;
+            int prev;
+            unsigned int bits;
+            int nbits;
+            unsigned short prefix[4096];
+            unsigned char suffix[4096];
+            unsigned char first[4096];
+        } lzw;
+#ifdef HAVE_ZLIB
+        z_stream z;
+#endif
+        struct
+        {
+            int count;
+            unsigned char *pat;
+            int len;
+            int match;
+            int *fail;
+        } sub;
+    } s;
+} Xpost_Filter;
+
+/* refill the input buffer from the source.
+   a seekable source is read by blocks, the others a byte at a time,
+   so no byte after the EOD is taken from them. */
+static
+int _xpost_filter_fill(Xpost_Filter *f)
+{
+    FILE *fp;
+    size_t n;
+    int c;
+
+    if (f->str)
+        return 0; /* the whole string is the input buffer */
+    fp = xpost_file_get_file_pointer(f->mem, f->src);
+    if (!fp)
+        return 0;
+    f->in = f->buf;
+    f->inpos = 0;
+    if (f->seekable)
+    {
+        n = fread(f->buf, 1, sizeof f->buf, fp);
+        f->inlen = (unsigned int)n;
+        return n > 0;
+    }
+    c = xpost_file_getc(fp);
+    if (c == EOF)
+    {
+        f->inlen = 0;
+        return 0;
+    }
+    f->buf[0] = (unsigned char)c;
+    f->inlen = 1;
+    return 1;
+}
+
+#define NEXTBYTE(f) \
+    ((f)->inpos < (f)->inlen || _xpost_filter_fill(f) ? (f)->in[(f)->inpos++] : EOF)
+
+/* give back to a seekable source the bytes read ahead */
+static
+void _xpost_filter_unread(Xpost_Filter *f)
+{
+    FILE *fp;
+
+    if (f->str || !f->seekable || f->inpos == f->inlen)
+        return;
+    fp = xpost_file_get_file_pointer(f->mem, f->src);
+    if (fp)
+        (void)fseek(fp, -(long)(f->inlen - f->inpos), SEEK_CUR);
+    f->inpos = f->inlen;
+}
+
+#define PUT(c) \
+    (k < n ? (void)(out[k++] = (unsigned char)(c)) : (void)(f->q[f->qlen++] = (unsigned char)(c)))
+
+#define IS_SPACE(c) \
+    ((c) == ' ' || (c) == '\t' || (c) == '\n' || (c) == '\r' || (c) == '\f' || (c) == '\0')
+
+static
+int _xpost_filter_hex_value(int c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/* ASCIIHexDecode: pairs of hex digits, white space ignored, > ends */
+static
+int _xpost_filter_ahx(Xpost_Filter *f, unsigned char *out, int n)
+{
+    int k = 0;
+    int c, hi, lo;
+
+    while (k < n)
+    {
+        do c = NEXTBYTE(f); while (c != EOF && IS_SPACE(c));
+        if (c == EOF || c == '>')
+        {
+            f->done = 1;
+            break;
+        }
+        if ((hi = _xpost_filter_hex_value(c)) < 0)
+            return -1;
+        do c = NEXTBYTE(f); while (c != EOF && IS_SPACE(c));
+        if (c == EOF || c == '>')
+        {
+            out[k++] = hi << 4; /* odd final digit */
+            f->done = 1;
+            break;
+        }
+        if ((lo = _xpost_filter_hex_value(c)) < 0)
+            return -1;
+        out[k++] = (hi << 4) | lo;
+    }
+    return k;
+}
+
+/* ASCII85Decode: groups of 5 characters ! to u for 4 bytes,
+   z for 4 zeros, ~> ends */
+static
+int _xpost_filter_a85(Xpost_Filter *f, unsigned char *out, int n)
+{
+    int k = 0;
+    int c;
+
+    while (k < n)
+    {
+        c = NEXTBYTE(f);
+        if (c == EOF)
+        {
+            f->done = 1;
+            break;
+        }
+        if (IS_SPACE(c))
+            continue;
+        if (c == 'z' && f->s.a85.n == 0)
+        {
+            PUT(0); PUT(0); PUT(0); PUT(0);
+            continue;
+        }
+        if (c == '~')
+        {
+            int m = f->s.a85.n;
+            c = NEXTBYTE(f);
+            if (c != '>')
+                return -1;
+            if (m == 1)
+                return -1;
+            if (m > 1)
+            {
+                int i;
+                for (i = m; i < 5; i++) /* pad with u */
+                    f->s.a85.sum = f->s.a85.sum * 85 + 84;
+                for (i = 0; i < m - 1; i++)
+                    PUT(f->s.a85.sum >> (24 - 8 * i));
+            }
+            f->s.a85.n = 0;
+            f->done = 1;
+            break;
+        }
+        if (c < '!' || c > 'u')
+            return -1;
+        f->s.a85.sum = f->s.a85.sum * 85 + (c - '!');
+        if (++f->s.a85.n == 5)
+        {
+            unsigned int v = f->s.a85.sum;
+            PUT(v >> 24); PUT(v >> 16); PUT(v >> 8); PUT(v);
+            f->s.a85.sum = 0;
+            f->s.a85.n = 0;
+        }
+    }
+    return k;
+}
+
+/* RunLengthDecode: a length byte L, then L+1 bytes to copy if L < 128,
+   or one byte to repeat 257-L times if L > 128. 128 ends. */
+static
+int _xpost_filter_rl(Xpost_Filter *f, unsigned char *out, int n)
+{
+    int k = 0;
+    int c;
+
+    while (k < n)
+    {
+        if (f->s.rl.copy)
+        {
+            if ((c = NEXTBYTE(f)) == EOF)
+                return -1;
+            out[k++] = c;
+            --f->s.rl.copy;
+            continue;
+        }
+        if (f->s.rl.repeat)
+        {
+            int m = f->s.rl.repeat < n - k ? f->s.rl.repeat : n - k;
+            memset(out + k, f->s.rl.c, m);
+            k += m;
+            f->s.rl.repeat -= m;
+            continue;
+        }
+        if ((c = NEXTBYTE(f)) == EOF || c == 128)
+        {
+            f->done = 1;
+            break;
+        }
+        if (c < 128)
+            f->s.rl.copy = c + 1;
+        else
+        {
+            if ((f->s.rl.c = NEXTBYTE(f)) == EOF)
+                return -1;
+            f->s.rl.repeat = 257 - c;
+        }
+    }
+    return k;
+}
+
+/* LZWDecode: codes of 9 to 12 bits, high-order bit first.
+   256 clears the table, 257 ends. With EarlyChange, the code
+   width increases one code early. */
+static
+int _xpost_filter_lzw_code(Xpost_Filter *f)
+{
+    int c;
+
+    while (f->s.lzw.nbits < f->s.lzw.width)
+    {
+        if ((c = NEXTBYTE(f)) == EOF)
+            return 257;
+        f->s.lzw.bits = (f->s.lzw.bits << 8) | c;
+        f->s.lzw.nbits += 8;
+    }
+    f->s.lzw.nbits -= f->s.lzw.width;
+    return (f->s.lzw.bits >> f->s.lzw.nbits) & ((1 << f->s.lzw.width) - 1);
+}
+
+static
+int _xpost_filter_lzw(Xpost_Filter *f, unsigned char *out, int n)
+{
+    int k = 0;
+
+    while (k < n)
+    {
+        unsigned char str[4096];
+        int code, c, len, i;
+
+        code = _xpost_filter_lzw_code(f);
+        if (code == 257)
+        {
+            f->done = 1;
+            break;
+        }
+        if (code == 256)
+        {
+            f->s.lzw.width = 9;
+            f->s.lzw.next = 258;
+            f->s.lzw.prev = -1;
+            continue;
+        }
+        if (f->s.lzw.prev == -1)
+        {
+            if (code > 255)
+                return -1;
+            PUT(code);
+            f->s.lzw.prev = code;
+            continue;
+        }
+        if (code > f->s.lzw.next)
+            return -1;
+
+        /* expand the code, backwards */
+        c = code == f->s.lzw.next ? f->s.lzw.prev : code;
+        len = 0;
+        if (code == f->s.lzw.next)
+            str[sizeof str - ++len] = f->s.lzw.first[f->s.lzw.prev];
+        while (c > 257)
+        {
+            str[sizeof str - ++len] = f->s.lzw.suffix[c];
+            c = f->s.lzw.prefix[c];
+        }
+        str[sizeof str - ++len] = c;
+        for (i = sizeof str - len; i < (int)sizeof str; i++)
+            PUT(str[i]);
+
+        if (f->s.lzw.next < 4096)
+        {
+            int e = f->s.lzw.next++;
+            f->s.lzw.prefix[e] = f->s.lzw.prev;
+            f->s.lzw.suffix[e] = str[sizeof str - len];
+            f->s.lzw.first[e] = f->s.lzw.first[f->s.lzw.prev];
+            if (f->s.lzw.next + f->s.lzw.early >= (1 << f->s.lzw.width) &&
+                f->s.lzw.width < 12)
+                f->s.lzw.width++;
+        }
+        f->s.lzw.prev = code;
+    }
+    return k;
+}
+
+#ifdef HAVE_ZLIB
+/* FlateDecode: zlib inflates straight into the caller's buffer */
+static
+int _xpost_filter_flate(Xpost_Filter *f, unsigned char *out, int n)
+{
+    int ret;
+
+    f->s.z.next_out = out;
+    f->s.z.avail_out = n;
+    while (f->s.z.avail_out)
+    {
+        if (f->inpos == f->inlen && !_xpost_filter_fill(f))
+        {
+            f->done = 1;
+            break;
+        }
+        f->s.z.next_in = (Bytef *)f->in + f->inpos;
+        f->s.z.avail_in = f->inlen - f->inpos;
+        ret = inflate(&f->s.z, Z_NO_FLUSH);
+        f->inpos = f->inlen - f->s.z.avail_in;
+        if (ret == Z_STREAM_END)
+        {
+            f->done = 1;
+            break;
+        }
+        if (ret != Z_OK && ret != Z_BUF_ERROR)
+        {
+            XPOST_LOG_ERR("inflate error %d", ret);
+            return -1;
+        }
+    }
+    return n - f->s.z.avail_out;
+}
+
+static
+void _xpost_filter_flate_finish(Xpost_Filter *f)
+{
+    inflateEnd(&f->s.z);
+}
+#endif
+
+/* SubFileDecode: the source up to the EODCount+1th occurrence of
+   EODString, or EODCount bytes if EODString is empty (all of the
+   source if EODCount is also 0). The string is matched with its
+   failure function (KMP), so no occurrence is missed. */
+static
+int _xpost_filter_sub(Xpost_Filter *f, unsigned char *out, int n)
+{
+    int k = 0;
+    int c;
+
+    if (!f->s.sub.len)
+    {
+        while (k < n)
+        {
+            if ((c = NEXTBYTE(f)) == EOF)
+            {
+                f->done = 1;
+                break;
+            }
+            out[k++] = c;
+            if (f->s.sub.count && !--f->s.sub.count)
+            {
+                f->done = 1;
+                break;
+            }
+        }
+        return k;
+    }
+
+    while (k < n)
+    {
+        int j = f->s.sub.match;
+        if ((c = NEXTBYTE(f)) == EOF)
+        {
+            int i;
+            for (i = 0; i < j; i++)
+                PUT(f->s.sub.pat[i]);
+            f->s.sub.match = 0;
+            f->done = 1;
+            break;
+        }
+        while (j > 0 && f->s.sub.pat[j] != c)
+        {
+            int i, back = f->s.sub.fail[j - 1];
+            for (i = 0; i < j - back; i++)
+                PUT(f->s.sub.pat[i]);
+            j = back;
+        }
+        if (f->s.sub.pat[j] == c)
+            ++j;
+        else
+            PUT(c);
+        if (j == f->s.sub.len)
+        {
+            if (!f->s.sub.count--)
+            {
+                f->s.sub.match = 0;
+                f->done = 1;
+                break;
+            }
+            { /* passed through */
+                int i;
+                for (i = 0; i < j; i++)
+                    PUT(f->s.sub.pat[i]);
+            }
+            j = 0;
+        }
+        f->s.sub.match = j;
+    }
+    return k;
+}
+
+static
+void _xpost_filter_sub_finish(Xpost_Filter *f)
+{
+    free(f->s.sub.pat);
+    free(f->s.sub.fail);
+}
+
+/* read decoded data: the spilled bytes, then the decoder's output.
+   at EOD, the bytes read ahead are given back to the source. */
+static
+int _xpost_filter_read(Xpost_Filter *f, unsigned char *out, int n)
+{
+    int k = 0;
+    int ret;
+
+    if (f->qpos < f->qlen)
+    {
+        k = f->qlen - f->qpos < n ? f->qlen - f->qpos : n;
+        memcpy(out, f->q + f->qpos, k);
+        f->qpos += k;
+        if (f->qpos < f->qlen)
+            return k;
+    }
+    f->qpos = f->qlen = 0;
+    if (f->eod || k == n)
+        return k;
+    ret = f->done ? 0 : f->decode(f, out + k, n - k);
+    if (ret < 0)
+    {
+        XPOST_LOG_ERR("filter: bad data");
+        f->done = f->eod = 1;
+        _xpost_filter_unread(f);
+        return k ? k : -1;
+    }
+    if (f->done)
+        _xpost_filter_unread(f);
+    if (ret == 0)
+        f->eod = 1;
+    return k + ret;
+}
+
+static
+void _xpost_filter_free(Xpost_Filter *f)
+{
+    _xpost_filter_unread(f);
+    if (f->finish)
+        f->finish(f);
+    if (f->q != f->qbuf)
+        free(f->q);
+    free(f->str);
+    free(f);
+}
+
+#if defined HAVE_FOPENCOOKIE
+
+static
+ssize_t _xpost_filter_cookie_read(void *cookie, char *buf, size_t size)
+{
+    return _xpost_filter_read(cookie, (unsigned char *)buf,
+                              size > INT_MAX ? INT_MAX : (int)size);
+}
+
+static
+int _xpost_filter_cookie_close(void *cookie)
+{
+    _xpost_filter_free(cookie);
+    return 0;
+}
+
+static
+FILE *_xpost_filter_fopen(Xpost_Filter *f)
+{
+    cookie_io_functions_t io;
+
+    io.read = _xpost_filter_cookie_read;
+    io.write = NULL;
+    io.seek = NULL;
+    io.close = _xpost_filter_cookie_close;
+    return fopencookie(f, "r", io);
+}
+
+#elif defined HAVE_FUNOPEN
+
+static
+int _xpost_filter_cookie_read(void *cookie, char *buf, int size)
+{
+    return _xpost_filter_read(cookie, (unsigned char *)buf, size);
+}
+
+static
+int _xpost_filter_cookie_close(void *cookie)
+{
+    _xpost_filter_free(cookie);
+    return 0;
+}
+
+static
+FILE *_xpost_filter_fopen(Xpost_Filter *f)
+{
+    return funopen(f, _xpost_filter_cookie_read, NULL, NULL,
+                   _xpost_filter_cookie_close);
+}
+
+#else
+
+/* no custom streams: decode everything into a temporary file */
+static
+FILE *_xpost_filter_fopen(Xpost_Filter *f)
+{
+    unsigned char buf[BUFSIZ];
+    FILE *fp;
+    int n;
+
+    fp = xpost_file_tmpfile();
+    if (fp)
+    {
+        while ((n = _xpost_filter_read(f, buf, sizeof buf)) > 0)
+            if (fwrite(buf, 1, n, fp) != (size_t)n)
+                break;
+        rewind(fp);
+    }
+    _xpost_filter_free(f);
+    return fp;
+}
+
+#endif
+
+int xpost_filter_open(Xpost_Memory_File *mem,
+                      const char *name,
+                      Xpost_Object src,
+                      const char *str,
+                      unsigned int len,
+                      const Xpost_Filter_Params *par,
+                      Xpost_Object *retval)
+{
+    Xpost_Filter *f;
+    Xpost_Object fo;
+    FILE *fp;
+
+    f = calloc(1, sizeof *f);
+    if (!f)
+        return VMerror;
+    f->mem = mem;
+    f->src = src;
+    f->q = f->qbuf;
+
+    if (xpost_object_get_type(src) == filetype)
+    {
+        fp = xpost_file_get_file_pointer(mem, src);
+        if (!fp)
+        {
+            free(f);
+            return ioerror;
+        }
+        f->seekable = ftell(fp) >= 0 && fseek(fp, 0, SEEK_CUR) == 0;
+        f->in = f->buf;
+    }
+    else
+    {
+        f->str = malloc(len ? len : 1);
+        if (!f->str)
+        {
+            free(f);
+            return VMerror;
+        }
+        memcpy(f->str, str, len);
+        f->in = f->str;
+        f->inlen = len;
+    }
+
+    if (!strcmp(name, "ASCIIHexDecode"))
+        f->decode = _xpost_filter_ahx;
+    else if (!strcmp(name, "ASCII85Decode"))
+        f->decode = _xpost_filter_a85;
+    else if (!strcmp(name, "RunLengthDecode"))
+        f->decode = _xpost_filter_rl;
+    else if (!strcmp(name, "LZWDecode"))
+    {
+        f->decode = _xpost_filter_lzw;
+        f->s.lzw.early = par->earlychange;
+        f->s.lzw.width = 9;
+        f->s.lzw.next = 258;
+        f->s.lzw.prev = -1;
+        {
+            int i;
+            for (i = 0; i < 256; i++)
+                f->s.lzw.first[i] = i;
+        }
+    }
+#ifdef HAVE_ZLIB
+    else if (!strcmp(name, "FlateDecode"))
+    {
+        f->decode = _xpost_filter_flate;
+        f->finish = _xpost_filter_flate_finish;
+        if (inflateInit(&f->s.z) != Z_OK)
+        {
+            free(f->str);
+            free(f);
+            return VMerror;
+        }
+    }
+#endif
+    else if (!strcmp(name, "SubFileDecode"))
+    {
+        int i, j;
+
+        f->decode = _xpost_filter_sub;
+        f->finish = _xpost_filter_sub_finish;
+        f->s.sub.count = par->eodcount;
+        f->s.sub.len = par->eodlength;
+        f->s.sub.pat = malloc(par->eodlength + 1);
+        f->s.sub.fail = malloc((par->eodlength + 1) * sizeof(int));
+        if (2 * par->eodlength > sizeof f->qbuf)
+            f->q = malloc(2 * par->eodlength);
+        if (!f->s.sub.pat || !f->s.sub.fail || !f->q)
+        {
+            _xpost_filter_free(f);
+            return VMerror;
+        }
+        memcpy(f->s.sub.pat, par->eodstring, par->eodlength);
+        if (f->s.sub.len)
+            f->s.sub.fail[0] = 0;
+        for (i = 1, j = 0; i < f->s.sub.len; i++)
+        {
+            while (j > 0 && f->s.sub.pat[i] != f->s.sub.pat[j])
+                j = f->s.sub.fail[j - 1];
+            if (f->s.sub.pat[i] == f->s.sub.pat[j])
+                ++j;
+            f->s.sub.fail[i] = j;
+        }
+    }
+    else
+    {
+        XPOST_LOG_ERR("unknown filter %s", name);
+        free(f->str);
+        free(f);
+        return undefined;
+    }
+
+    fp = _xpost_filter_fopen(f);
+    if (!fp)
+    {
+        XPOST_LOG_ERR("cannot open filter %s", name);
+        return ioerror;
+    }
+    fo = xpost_file_cons_filter(mem, fp, src, par->closesrc);
+    if (xpost_object_get_type(fo) == invalidtype)
+    {
+        fclose(fp);
+        return VMerror;
+    }
+    fo.tag &= ~XPOST_OBJECT_TAG_DATA_FLAG_ACCESS_MASK;
+    fo.tag |= (XPOST_OBJECT_TAG_ACCESS_FILE_READ << XPOST_OBJECT_TAG_DATA_FLAG_ACCESS_OFFSET);
+    *retval = xpost_object_cvlit(fo);
+    return 0;
+}
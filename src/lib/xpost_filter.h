@@ -0,0 +1,89 @@
+/*
+ * Xpost - a Level-2 Postscript interpreter
+ * Copyright (C) 2013-2016, Michael Joshua Ryan
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the Xpost software product nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef XPOST_FILTER_H
+#define XPOST_FILTER_H
+
+/**
+ * @file xpost_filter.h
+ * @brief decode filters
+ *
+ * A filter is a file object whose FILE* decodes the data of its
+ * source as it is read, so it can be read with read, readstring,
+ * token, exec, or used as an image data source like any other file.
+ * The source is a file (possibly another filter) or a string.
+ *
+ * Where the C library can create a FILE* with custom read functions
+ * (fopencookie() or funopen()), the data is decoded on demand from
+ * internal buffers. Otherwise the whole data is decoded into a
+ * temporary file when the filter is created.
+ *
+ * A filter stops reading its source at the end of its data (EOD),
+ * so the source may be read again after it, as with
+ *     currentfile /ASCII85Decode filter
+ *
+ * @{
+ */
+
+/**
+ * @brief parameters of a filter
+ */
+typedef struct
+{
+    int closesrc;     /**< CloseSource: closing the filter closes its source */
+    int earlychange;  /**< EarlyChange of LZWDecode, default 1 */
+    int eodcount;     /**< EODCount of SubFileDecode */
+    const char *eodstring;    /**< EODString of SubFileDecode */
+    unsigned int eodlength;   /**< length of EODString */
+} Xpost_Filter_Params;
+
+/**
+ * @brief open a decode filter
+ *
+ * name is the name of the filter: ASCIIHexDecode, ASCII85Decode,
+ * RunLengthDecode, LZWDecode, FlateDecode (if built with zlib) or
+ * SubFileDecode. The source is the file src in mem, or if src is
+ * null, the len bytes at str, which are copied. On success the new
+ * readable file object is stored in retval and 0 is returned,
+ * otherwise the error code (undefined for an unknown filter).
+ */
+int xpost_filter_open(Xpost_Memory_File *mem,
+                      const char *name,
+                      Xpost_Object src,
+                      const char *str,
+                      unsigned int len,
+                      const Xpost_Filter_Params *par,
+                      Xpost_Object *retval);
+
+/**
+ * @}
+ */
+
+#endif
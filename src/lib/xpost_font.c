@@ -46,6 +46,7 @@
 
 #include "xpost.h"
 #include "xpost_log.h"
+#include "xpost_compat.h" /* Xpost_Lock */
 #include "xpost_object.h"
 #include "xpost_font.h"
 
@@ -55,6 +56,8 @@ static FcConfig *_xpost_font_fc_config = NULL;
 
 #ifdef HAVE_FREETYPE
 static FT_Library _xpost_font_ft_library = NULL;
+/* faces are created and freed in the library, shared by parallel jobs */
+static Xpost_Lock _xpost_font_ft_lock = XPOST_LOCK_INIT;
 #endif
 
 int
@@ -172,11 +175,16 @@ xpost_font_face_new_from_name(const char *name)
     char *filename;
     int idx;
 
+    xpost_lock(&_xpost_font_ft_lock);
     filename = _xpost_font_face_filename_and_index_get(name, &idx);
     if (!filename)
+    {
+        xpost_unlock(&_xpost_font_ft_lock);
         return NULL;
+    }
 
     err = FT_New_Face(_xpost_font_ft_library, filename, idx, &face) ;
+    xpost_unlock(&_xpost_font_ft_lock);
     if (err == FT_Err_Unknown_File_Format)
     {
         XPOST_LOG_ERR("Font format unsupported");
@@ -207,7 +215,9 @@ xpost_font_face_free(void *face)
     if (!face)
         return;
 
+    xpost_lock(&_xpost_font_ft_lock);
     FT_Done_Face(face);
+    xpost_unlock(&_xpost_font_ft_lock);
 #else
     (void)face;
 #endif
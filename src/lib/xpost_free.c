@@ -47,7 +47,7 @@
    initialize the free-list in the memory file.
    free list head is in slot zero
    sz is 0 so gc will ignore it */
-int xpost_free_init(Xpost_Memory_File *mem)
+XPCHECKAPI int xpost_free_init(Xpost_Memory_File *mem)
 {
     unsigned int ent;
     unsigned int val = 0;
@@ -77,7 +77,7 @@ int xpost_free_init(Xpost_Memory_File *mem)
     /* set zero size to enable guards against NULL writes */
     {
         Xpost_Memory_Table *tab = &mem->table;
-        tab->tab[XPOST_MEMORY_TABLE_SPECIAL_FREE].sz = 0;
+        tab->sz[XPOST_MEMORY_TABLE_SPECIAL_FREE] = 0;
     }
 
     /* make free list available for general memory allocations */
@@ -89,8 +89,8 @@ int xpost_free_init(Xpost_Memory_File *mem)
 }
 
 /* free this ent! returns reclaimed size or -1 on error */
-int xpost_free_memory_ent(Xpost_Memory_File *mem,
-                          unsigned int ent)
+XPCHECKAPI int xpost_free_memory_ent(Xpost_Memory_File *mem,
+                                     unsigned int ent)
 {
     Xpost_Memory_Table *tab;
     unsigned int rent = ent; /* relative ent index */
@@ -109,42 +109,30 @@ int xpost_free_memory_ent(Xpost_Memory_File *mem,
         return -1;
     }
     tab = &mem->table;
-    a = tab->tab[rent].adr;
-    sz = tab->tab[rent].sz;
+    a = tab->adr[rent];
+    sz = tab->sz[rent];
     if (sz == 0) return 0; /* do not add zero-size allocations to list */
 
-    if (tab->tab[rent].tag == filetype)
+    /* release external resources, eg. close FILE* for filetype */
+    if (tab->tag[rent] < XPOST_MEMORY_FINALIZE_TAGS &&
+        mem->finalize[tab->tag[rent]])
     {
-        FILE *fp;
-        ret = xpost_memory_get(mem, ent, 0, sizeof(FILE *), &fp);
+        /* the frozen image comes back at reset and its clones share
+           it: keep its resources, and the ent, until then */
+        if (mem->frozen &&
+            rent < mem->frozen_table.nextent &&
+            tab->adr[rent] == mem->frozen_table.adr[rent] &&
+            tab->tag[rent] == mem->frozen_table.tag[rent])
+            return 0;
+
+        ret = mem->finalize[tab->tag[rent]](mem, ent);
         if (!ret)
         {
-            XPOST_LOG_ERR("cannot load FILE* from VM");
+            XPOST_LOG_ERR("cannot finalize ent %u", ent);
             return -1;
         }
-        if (fp &&
-            fp != stdin &&
-            fp != stdout &&
-            fp != stderr)
-        {
-            tab->tab[rent].tag = 0;
-#ifdef DEBUG_FILE
-            printf("gc:xpost_free_memory_ent closing FILE* %p\n", fp);
-            fflush(stdout);
-            /* if (fp < 0x1000) return 0; */
-            printf("fclose");
-#endif
-            fclose(fp);
-            fp = NULL;
-            ret = xpost_memory_put(mem, ent, 0, sizeof(FILE *), &fp);
-            if (!ret)
-            {
-                XPOST_LOG_ERR("cannot write NULL over FILE* in VM");
-                return -1;
-            }
-        }
     }
-    tab->tab[rent].tag = 0;
+    tab->tag[rent] = 0;
 
     ret = xpost_memory_table_get_addr(mem, XPOST_MEMORY_TABLE_SPECIAL_FREE, &z);
     if (!ret)
@@ -247,7 +235,7 @@ int xpost_free_alloc(Xpost_Memory_File *mem,
     //static int threshold = XPOST_GARBAGE_COLLECTION_THRESHOLD;
     int ret;
 
-    if (!mem->interpreter_get_initializing())
+    if (!mem->initializing)
     {
 #ifdef XPOST_USE_THRESHOLD
         //(void)period;
@@ -322,7 +310,11 @@ int xpost_free_alloc(Xpost_Memory_File *mem,
                 XPOST_LOG_ERR("cannot find table for ent %u", e);
                 return 0;
             }
-            tab->tab[ent].tag = tag;
+            tab->tag[ent] = tag;
+            tab->cow[ent] = 0;
+            /* the size of the previous use is stale: save and
+               the collector read the length of arrays from it */
+            tab->used[ent] = sz;
             *entity = e;
             return 1; /* found, return SUCCESS */
         }
@@ -380,14 +372,14 @@ unsigned int xpost_free_realloc(Xpost_Memory_File *mem,
     }
 
     /* steal its adr */
-    newadr = tab->tab[rent].adr;
+    newadr = tab->adr[rent];
 
     /* copy data */
     memcpy(mem->base + newadr, mem->base + oldadr, oldsize);
 
     /* stash old adr */
-    tab->tab[rent].adr = oldadr;
-    tab->tab[rent].sz = oldsize;
+    tab->adr[rent] = oldadr;
+    tab->sz[rent] = oldsize;
 
     /* free it */
     (void) xpost_free_memory_ent(mem, ent);
@@ -90,7 +90,7 @@ typedef enum
  * @brief  initialize the FREE special entity which points
  *         to the head of the free list
  */
-int xpost_free_init(Xpost_Memory_File *mem);
+XPCHECKAPI int xpost_free_init(Xpost_Memory_File *mem);
 
 /**
  * @brief  print a dump of the free list
@@ -108,8 +108,8 @@ int xpost_free_alloc(Xpost_Memory_File *mem,
 /**
  * @brief  explicitly add ent to free list
  */
-int xpost_free_memory_ent(Xpost_Memory_File *mem,
-                          unsigned int ent);
+XPCHECKAPI int xpost_free_memory_ent(Xpost_Memory_File *mem,
+                                     unsigned int ent);
 
 /**
  * @brief reallocate data, preserving original contents
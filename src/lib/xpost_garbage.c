@@ -55,6 +55,7 @@
 #include "xpost_dict.h"
 #include "xpost_save.h"
 #include "xpost_name.h"
+#include "xpost_file.h"
 
 //#include "xpost_interpreter.h"
 #include "xpost_garbage.h"
@@ -64,22 +65,17 @@
 #endif
 
 
-/* iterate through all tables,
-    clear the MARK in the mark. */
+/* clear the mark bitmap. */
 static
 void _xpost_garbage_unmark(Xpost_Memory_File *mem)
 {
-    unsigned int i;
-
     if (!mem) return;
 
-    for (i = mem->start; i < mem->table.nextent; i++)
-    {
-        mem->table.tab[i].mark &= ~XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK;
-    }
+    memset(mem->table.marks, 0,
+           XPOST_MEMORY_TABLE_MARK_WORDS(mem->table.nextent) * sizeof(unsigned int));
 }
 
-/* set the MARK in the mark in the tab[ent] */
+/* set the mark bit for ent */
 static
 int _xpost_garbage_mark_ent(Xpost_Memory_File *mem,
                             unsigned int ent)
@@ -97,7 +93,8 @@ int _xpost_garbage_mark_ent(Xpost_Memory_File *mem,
         XPOST_LOG_ERR("cannot find ent %u", ent);
         return 0;
     }
-    mem->table.tab[ent].mark |= XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK;
+    mem->table.marks[ent / XPOST_MEMORY_TABLE_MARK_BITS] |=
+        1U << (ent % XPOST_MEMORY_TABLE_MARK_BITS);
     return 1;
 }
 
@@ -114,8 +111,8 @@ int _xpost_garbage_ent_is_marked(Xpost_Memory_File *mem,
         XPOST_LOG_ERR("cannot find table for ent %u", ent);
         return 0;
     }
-    *retval = (mem->table.tab[ent].mark & XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK)
-        >> XPOST_MEMORY_TABLE_MARK_DATA_MARK_OFFSET;
+    *retval = (mem->table.marks[ent / XPOST_MEMORY_TABLE_MARK_BITS]
+               >> (ent % XPOST_MEMORY_TABLE_MARK_BITS)) & 1;
 
     return 1;
 }
@@ -235,18 +232,20 @@ int _xpost_garbage_mark_object(Xpost_Context *ctx,
 
     if (!mem) return 0;
 
-    if (!xpost_object_is_composite(o))
-        return 1;
-
-    ent = xpost_object_get_ent(o);
     type = xpost_object_get_type(o);
+    if (type == filetype) /* not composite, but owns an ent */
+        ent = o.mark_.padw;
+    else if (!xpost_object_is_composite(o))
+        return 1;
+    else
+        ent = xpost_object_get_ent(o);
 
 #ifdef DEBUG_GC
             printf("markobject: ent %d, addr %u, %s (size %d)\n",
                    ent,
                    xpost_context_select_memory(ctx,o)==mem?
                        (ent >= mem->table.nextent?
-                        (unsigned)-1: mem->table.tab[ent].adr) : 0,
+                        (unsigned)-1: mem->table.adr[ent]) : 0,
                    xpost_object_type_names[type],
                    o.comp_.sz);
 #endif
@@ -295,13 +294,13 @@ int _xpost_garbage_mark_object(Xpost_Context *ctx,
                     XPOST_LOG_ERR("cannot retrieve tag for array ent %u", ent);
                     return 0;
                 }
-                if (o.comp_.sz != objmem->table.tab[ent].used/sizeof(Xpost_Object))
+                if (o.comp_.sz != objmem->table.used[ent]/sizeof(Xpost_Object))
                 {
-                    XPOST_LOG_INFO("o.comp_.sz %u != tab[ent].used/obj %u",
-                            o.comp_.sz, objmem->table.tab[ent].used/sizeof(Xpost_Object));
+                    XPOST_LOG_INFO("o.comp_.sz %u != table.used[ent]/obj %u",
+                            o.comp_.sz, objmem->table.used[ent]/sizeof(Xpost_Object));
                 }
                 if (!_xpost_garbage_mark_array(ctx, objmem, ad,
-                            //mem->table.tab[ent].used/sizeof(Xpost_Object)
+                            //mem->table.used[ent]/sizeof(Xpost_Object)
                             o.comp_.sz
                             , markall))
                     return 0;
@@ -372,7 +371,16 @@ int _xpost_garbage_mark_object(Xpost_Context *ctx,
             break;
 
         case filetype:
+            /* global vm is never swept (see xpost_garbage_collect),
+               so global files are not finalized: they stay open
+               until the program closes them */
             objmem = xpost_context_select_memory(ctx, o);
+            if (objmem != mem)
+            {
+                if (!markall)
+                    break;
+            }
+
             if (ent < objmem->start)
             {
                 XPOST_LOG_ERR("attempt to mark %s object %d",
@@ -380,17 +388,20 @@ int _xpost_garbage_mark_object(Xpost_Context *ctx,
                         ent);
                 return 0;
             }
-            if (objmem == ctx->gl)
+            if (!_xpost_garbage_ent_is_marked(objmem, ent, &ret))
+                return 0;
+            if (ret)
+                break;
+            ret = _xpost_garbage_mark_ent(objmem, ent);
+            if (!ret)
             {
-                printf("file found in global vm\n");
-            } else {
-                ret = _xpost_garbage_mark_ent(objmem, o.mark_.padw);
-                if (!ret)
-                {
-                    XPOST_LOG_ERR("cannot mark file");
-                    return 0;
-                }
+                XPOST_LOG_ERR("cannot mark file");
+                return 0;
             }
+            /* a filter keeps its source file */
+            if (!_xpost_garbage_mark_object(ctx, mem,
+                        xpost_file_get_source(objmem, o), markall))
+                return 0;
             break;
     }
 
@@ -474,6 +485,31 @@ next:
     return 1;
 }
 
+/* mark ent and the objects in it */
+static
+int _xpost_garbage_mark_saved_array(Xpost_Context *ctx,
+                                    Xpost_Memory_File *mem,
+                                    unsigned int ent)
+{
+    unsigned int ad;
+    int ret;
+
+    ret = _xpost_garbage_mark_ent(mem, ent);
+    if (!ret)
+    {
+        XPOST_LOG_ERR("cannot mark array");
+        return 0;
+    }
+    ret = xpost_memory_table_get_addr(mem, ent, &ad);
+    if (!ret)
+    {
+        XPOST_LOG_ERR("cannot retrieve address for array ent %u", ent);
+        return 0;
+    }
+    return _xpost_garbage_mark_array(ctx, mem, ad,
+                                     mem->table.used[ent] / sizeof(Xpost_Object), 0);
+}
+
 /* mark all allocations referred to by objects in save object's stack of saverec_'s */
 static
 int _xpost_garbage_mark_save_stack(Xpost_Context *ctx,
@@ -533,25 +569,29 @@ next:
             }
             if (s->data[i].saverec_.tag == arraytype)
             {
-                unsigned int sz = s->data[i].saverec_.pad;
-                ret = xpost_memory_table_get_addr(mem, s->data[i].saverec_.src, &ad);
-                if (!ret)
-                {
-                    XPOST_LOG_ERR("cannot retrieve address for array ent %u",
-                                  s->data[i].saverec_.src);
-                    return 0;
-                }
-                if (!_xpost_garbage_mark_array(ctx, mem, ad, sz, 0))
+                /* src array, and the chunks saved in its chunk map */
+                if (!_xpost_garbage_mark_saved_array(ctx, mem, s->data[i].saverec_.src))
                     return 0;
                 ret = xpost_memory_table_get_addr(mem, s->data[i].saverec_.cpy, &ad);
                 if (!ret)
                 {
-                    XPOST_LOG_ERR("cannot retrieve address for array ent %u",
+                    XPOST_LOG_ERR("cannot retrieve address for chunk map ent %u",
                                   s->data[i].saverec_.cpy);
                     return 0;
                 }
-                if (!_xpost_garbage_mark_array(ctx, mem, ad, sz, 0))
-                    return 0;
+                {
+                    unsigned int n = mem->table.used[s->data[i].saverec_.cpy] / sizeof(unsigned int);
+                    unsigned int j;
+                    unsigned int chunk;
+
+                    for (j = 1; j < n; j++)
+                    {
+                        memcpy(&chunk, mem->base + ad + j * sizeof(unsigned int), sizeof chunk);
+                        if (chunk &&
+                            !_xpost_garbage_mark_saved_array(ctx, mem, chunk))
+                            return 0;
+                    }
+                }
             }
         }
         if (i == XPOST_STACK_SEGMENT_SIZE) /* ie. s->top == XPOST_STACK_SEGMENT_SIZE */
@@ -597,17 +637,43 @@ int _xpost_garbage_mark_save(Xpost_Context *ctx,
 }
 
 /* discard the free list.
-   iterate through tables,
+   scan the mark bitmap a word at a time,
         if element is unmarked and not zero-sized,
             free it.
    return reclaimed size
  */
+/* defer an unreachable ent with a finalizer until the end of the sweep.
+   return 0 if the queue cannot grow, and the ent is freed at once. */
+static
+int _xpost_garbage_finalize_queue_add(Xpost_Memory_File *mem,
+                                      unsigned int ent)
+{
+    if (mem->finalize_count == mem->finalize_max)
+    {
+        unsigned int max = mem->finalize_max ? mem->finalize_max * 2 : 16;
+        unsigned int *tmp;
+
+        tmp = realloc(mem->finalize_queue, max * sizeof *tmp);
+        if (!tmp)
+        {
+            XPOST_LOG_ERR("cannot grow finalization queue");
+            return 0;
+        }
+        mem->finalize_queue = tmp;
+        mem->finalize_max = max;
+    }
+    mem->finalize_queue[mem->finalize_count++] = ent;
+    return 1;
+}
+
 static
 unsigned int _xpost_garbage_sweep(Xpost_Memory_File *mem)
 {
     unsigned int zero = 0;
     unsigned int z;
     unsigned int i;
+    unsigned int w;
+    unsigned int bits;
     unsigned int sz = 0;
     int ret;
 
@@ -624,16 +690,25 @@ unsigned int _xpost_garbage_sweep(Xpost_Memory_File *mem)
 #ifdef DEBUG_GC
     printf("freeing ");
 #endif
-    /* scan table */
-    for (i = mem->start; i < mem->table.nextent; i++)
+    /* scan bitmap, skipping fully-marked words */
+    for (w = mem->start / XPOST_MEMORY_TABLE_MARK_BITS;
+         w < XPOST_MEMORY_TABLE_MARK_WORDS(mem->table.nextent);
+         w++)
     {
-        if (((mem->table.tab[i].mark & XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK) == 0) &&
-            (mem->table.tab[i].sz != 0))
+        bits = ~mem->table.marks[w];
+        for (i = w * XPOST_MEMORY_TABLE_MARK_BITS; bits; i++, bits >>= 1)
         {
+            if (!(bits & 1) ||
+                i < mem->start ||
+                i >= mem->table.nextent ||
+                mem->table.sz[i] == 0)
+                continue;
 #ifdef DEBUG_GC
             printf("%u ", i);
 #endif
-            if (mem->table.tab[i].tag == filetype)
+            if (mem->table.tag[i] < XPOST_MEMORY_FINALIZE_TAGS &&
+                mem->finalize[mem->table.tag[i]] &&
+                _xpost_garbage_finalize_queue_add(mem, i))
                 continue;
             ret = xpost_free_memory_ent(mem, i);
             if (ret < 0)
@@ -648,6 +723,20 @@ unsigned int _xpost_garbage_sweep(Xpost_Memory_File *mem)
     printf("\n");
 #endif
 
+    /* finalize and free the queued ents,
+       now that the whole table has been scanned */
+    for (i = 0; i < mem->finalize_count; i++)
+    {
+        ret = xpost_free_memory_ent(mem, mem->finalize_queue[i]);
+        if (ret < 0)
+        {
+            XPOST_LOG_ERR("cannot finalize ent");
+            continue;
+        }
+        sz += (unsigned int)ret;
+    }
+    mem->finalize_count = 0;
+
     return sz;
 }
 
@@ -668,7 +757,7 @@ int xpost_garbage_collect(Xpost_Memory_File *mem, int dosweep, int markall)
     unsigned int ad;
     int ret;
 
-    if (mem->interpreter_get_initializing()) /* do not collect while initializing */
+    if (mem->initializing) /* do not collect while initializing */
         return 0;
 
     /* printf("\ncollect:\n"); */
@@ -683,7 +772,7 @@ int xpost_garbage_collect(Xpost_Memory_File *mem, int dosweep, int markall)
         return -1;
     }
     cid = (void *)(mem->base + ad);
-    for (i = 0; i < MAXCONTEXT && cid[i]; i++)
+    for (i = 0; cid[i]; i++)
     {
         ctx = mem->interpreter_cid_get_context(cid[i]);
         if (ctx->state != 0)
@@ -730,7 +819,7 @@ int xpost_garbage_collect(Xpost_Memory_File *mem, int dosweep, int markall)
         if (!_xpost_garbage_mark_names(ctx, mem, ad, markall))
             return -1;
 
-        for (i = 0; i < MAXCONTEXT && cid[i]; i++)
+        for (i = 0; cid[i]; i++)
         {
             ctx = mem->interpreter_cid_get_context(cid[i]);
             xpost_garbage_collect(ctx->lo, 0, markall);
@@ -766,7 +855,7 @@ int xpost_garbage_collect(Xpost_Memory_File *mem, int dosweep, int markall)
         if (!_xpost_garbage_mark_names(ctx, mem, ad, markall))
             return -1;
 
-        for (i = 0; i < MAXCONTEXT && cid[i]; i++)
+        for (i = 0; cid[i]; i++)
         {
             ctx = mem->interpreter_cid_get_context(cid[i]);
 
@@ -815,7 +904,7 @@ int xpost_garbage_collect(Xpost_Memory_File *mem, int dosweep, int markall)
         sz += _xpost_garbage_sweep(mem);
         if (isglobal)
         {
-            for (i = 0; i < MAXCONTEXT && cid[i]; i++)
+            for (i = 0; cid[i]; i++)
             {
 #ifdef DEBUG_GC
                 printf("sweep context(%d)->gl\n", cid[i]);
@@ -826,7 +915,7 @@ int xpost_garbage_collect(Xpost_Memory_File *mem, int dosweep, int markall)
         }
     }
 
-    printf("collect recovered %u bytes\n", sz);
+    XPOST_LOG_INFO("collect recovered %u bytes", sz);
     return sz;
 }
 
@@ -838,8 +927,6 @@ Xpost_Context *ctx;
 static
 int init_test_garbage(int (*xpost_interpreter_cid_init)(unsigned int *cid),
                       Xpost_Context *(*xpost_interpreter_cid_get_context)(unsigned int cid),
-                      int (*xpost_interpreter_get_initializing)(void),
-                      void (*xpost_interpreter_set_initializing)(int),
                       Xpost_Memory_File *(*xpost_interpreter_alloc_global_memory)(void),
                       Xpost_Memory_File *(*xpost_interpreter_alloc_local_memory)(void))
 {
@@ -867,8 +954,7 @@ int init_test_garbage(int (*xpost_interpreter_cid_init)(unsigned int *cid),
         return 0;
     }
     fd = mkstemp(fname);
-    ret = xpost_memory_file_init(ctx->gl, fname, fd, xpost_interpreter_cid_get_context,
-            xpost_interpreter_get_initializing, xpost_interpreter_set_initializing);
+    ret = xpost_memory_file_init(ctx->gl, fname, fd, xpost_interpreter_cid_get_context);
     if (!ret)
     {
         close(fd);
@@ -910,8 +996,7 @@ int init_test_garbage(int (*xpost_interpreter_cid_init)(unsigned int *cid),
     }
     strcpy(fname, "xmemXXXXXX");
     fd = mkstemp(fname);
-    ret = xpost_memory_file_init(ctx->lo, fname, fd, xpost_interpreter_cid_get_context,
-            xpost_interpreter_get_initializing, xpost_interpreter_set_initializing);
+    ret = xpost_memory_file_init(ctx->lo, fname, fd, xpost_interpreter_cid_get_context);
     if (!ret)
     {
         close(fd);
@@ -975,7 +1060,9 @@ int init_test_garbage(int (*xpost_interpreter_cid_init)(unsigned int *cid),
     xpost_stack_init(ctx->lo, &ctx->hold);
     ctx->os = ctx->ds = ctx->es = ctx->hold;
 
-    ctx->gl->interpreter_set_initializing(0); /* garbage collector won't run otherwise */
+    /* garbage collector won't run otherwise */
+    ctx->gl->initializing = 0;
+    ctx->lo->initializing = 0;
 
     return 1;
 }
@@ -987,8 +1074,6 @@ void exit_test_garbage(void)
     xpost_memory_file_exit(ctx->gl);
     free(itpdata);
     itpdata = NULL;
-
-    ctx->gl->interpreter_set_initializing(1);
 }
 
 static
@@ -1002,15 +1087,11 @@ int _clear_hold(Xpost_Context *_ctx)
 
 int test_garbage_collect(int (*xpost_interpreter_cid_init)(unsigned int *cid),
                          Xpost_Context *(*xpost_interpreter_cid_get_context)(unsigned int cid),
-                         int (*xpost_interpreter_get_initializing)(void),
-                         void (*xpost_interpreter_set_initializing)(int),
                          Xpost_Memory_File *(*xpost_interpreter_alloc_local_memory)(void),
                          Xpost_Memory_File *(*xpost_interpreter_alloc_global_memory)(void))
 {
     if (!init_test_garbage(xpost_interpreter_cid_init,
                            xpost_interpreter_cid_get_context,
-                           xpost_interpreter_get_initializing,
-                           xpost_interpreter_set_initializing,
                            xpost_interpreter_alloc_local_memory,
                            xpost_interpreter_alloc_global_memory))
         return 0;
@@ -1098,7 +1179,7 @@ unsigned int stac;
 /*     xpost_context_init_ctxlist(&mem); */
 /*     Xpost_Memory_Table *tab = &mem->table; */
 /*     unsigned int ent = xpost_memory_table_alloc(&mem, 0, 0); */
-/*     stac = mem->table.tab[ent].adr = initstack(&mem); */
+/*     stac = mem->table.adr[ent] = initstack(&mem); */
 /*     /\* mem.roots[0] = XPOST_MEMORY_TABLE_SPECIAL_SAVE_STACK; *\/ */
 /*     /\* mem.roots[1] = ent; *\/ */
 /*     mem.start = ent+1; */
@@ -61,8 +61,6 @@ int xpost_garbage_collect(Xpost_Memory_File *mem, int dosweep, int markall);
  */
 int test_garbage_collect(int (*xpost_interpreter_cid_init)(unsigned int *cid),
                          Xpost_Context *(*xpost_interpreter_cid_get_context)(unsigned int cid),
-                         int (*xpost_interpreter_get_initializing)(void),
-                         void (*xpost_interpreter_set_initializing)(int),
                          Xpost_Memory_File *(*xpost_interpreter_alloc_local_memory)(void),
                          Xpost_Memory_File *(*xpost_interpreter_alloc_global_memory)(void));
 #endif
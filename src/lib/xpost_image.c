@@ -0,0 +1,410 @@
+/*
+ * Xpost - a Level-2 Postscript interpreter
+ * Copyright (C) 2013-2016, Michael Joshua Ryan
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the Xpost software product nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <errno.h>
+#include <stdlib.h> /* free getenv malloc */
+#include <stdio.h> /* remove rename */
+#include <string.h> /* memcmp memcpy memset strerror strlen strncmp strncpy */
+
+#include <sys/types.h>
+#include <sys/stat.h> /* fchmod stat */
+#include <fcntl.h> /* open */
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h> /* close read write */
+#endif
+
+#include "xpost.h"
+#include "xpost_log.h"
+#include "xpost_compat.h" /* mkstemp XPOST_PATH_MAX */
+#include "xpost_memory.h"
+#include "xpost_object.h"
+#include "xpost_context.h"
+#include "xpost_operator.h"
+#include "xpost_rom.h"
+
+#include "xpost_image.h"
+
+/* image file set by xpost_image_set(), "" if unset */
+static char _xpost_image_file[XPOST_PATH_MAX];
+
+#define XPOST_IMAGE_MAGIC "XPOSTIMG"
+
+/* the header of an image, followed by the local then the global vm */
+typedef struct
+{
+    char magic[8];
+    unsigned int version;
+    char package[16];
+    unsigned int sizes[4];
+    Xpost_Image_Stamp stamp;
+    char init_ps[XPOST_PATH_MAX];
+    long init_ps_mtime;
+    long init_ps_size;
+
+    /* context fields which init.ps may change */
+    Xpost_Object currentobject;
+    Xpost_Object event_handler;
+    Xpost_Object window_device;
+    unsigned long rand_next;
+    unsigned int vmmode;
+} Xpost_Image_Header;
+
+XPAPI void
+xpost_image_set(const char *filename)
+{
+    if (!filename)
+    {
+        _xpost_image_file[0] = '\0';
+        return;
+    }
+    strncpy(_xpost_image_file, filename, sizeof(_xpost_image_file));
+    _xpost_image_file[sizeof(_xpost_image_file) - 1] = '\0';
+}
+
+const char *
+xpost_image_get(void)
+{
+    const char *filename;
+
+    if (_xpost_image_file[0])
+        return _xpost_image_file;
+    filename = getenv("XPOST_IMAGE");
+    if (filename && *filename)
+        return filename;
+    return NULL;
+}
+
+void
+xpost_image_stamp(Xpost_Context *ctx,
+                  Xpost_Image_Stamp *stamp)
+{
+    memset(stamp, 0, sizeof *stamp);
+    stamp->id = ctx->id;
+    stamp->lo_used = ctx->lo->used;
+    stamp->lo_nextent = ctx->lo->table.nextent;
+    stamp->gl_used = ctx->gl->used;
+    stamp->gl_nextent = ctx->gl->table.nextent;
+}
+
+#if defined (HAVE_MMAP) && !defined (_WIN32)
+
+/* fill the parts of the header which identify this build and init.ps */
+static int
+_xpost_image_header_init(Xpost_Image_Header *head,
+                         const Xpost_Image_Stamp *stamp,
+                         const char *init_ps)
+{
+    struct stat st;
+    size_t size;
+    long mtime;
+
+    /* a built-in init.ps is identified by its hash instead of its date */
+    if (strncmp(init_ps, XPOST_ROM_DEVICE, strlen(XPOST_ROM_DEVICE)) == 0)
+    {
+        if (!xpost_rom_find(init_ps, &size))
+            return 0;
+        mtime = (long)xpost_rom_hash(init_ps);
+    }
+    else
+    {
+        if (stat(init_ps, &st) != 0)
+            return 0;
+        mtime = (long)st.st_mtime;
+        size = (size_t)st.st_size;
+    }
+
+    memset(head, 0, sizeof *head);
+    memcpy(head->magic, XPOST_IMAGE_MAGIC, sizeof head->magic);
+    head->version = XPOST_IMAGE_VERSION;
+    strncpy(head->package, PACKAGE_VERSION, sizeof(head->package) - 1);
+    head->sizes[0] = sizeof(Xpost_Object);
+    head->sizes[1] = sizeof(Xpost_Context);
+    head->sizes[2] = sizeof(Xpost_Memory_File);
+    head->sizes[3] = sizeof(void *);
+    head->stamp = *stamp;
+    strncpy(head->init_ps, init_ps, sizeof(head->init_ps) - 1);
+    head->init_ps_mtime = mtime;
+    head->init_ps_size = (long)size;
+    return 1;
+}
+
+/* the code stored in an image for the FILE * of a file record */
+static FILE *
+_xpost_image_file_code(FILE *fp)
+{
+    if (fp == stdin)
+        return (FILE *)1;
+    if (fp == stdout)
+        return (FILE *)2;
+    if (fp == stderr)
+        return (FILE *)3;
+    return NULL;
+}
+
+/* the FILE * of a file record for the code stored in an image */
+static FILE *
+_xpost_image_file_pointer(FILE *code)
+{
+    if (code == (FILE *)1)
+        return stdin;
+    if (code == (FILE *)2)
+        return stdout;
+    if (code == (FILE *)3)
+        return stderr;
+    return NULL;
+}
+
+/*
+   replace the FILE * of the file records of mem by their codes,
+   keeping the pointers in saved, or back from saved if decode.
+ */
+static void
+_xpost_image_swap_files(Xpost_Memory_File *mem,
+                        FILE **saved,
+                        int decode)
+{
+    Xpost_Memory_Table *tab = &mem->table;
+    FILE *fp;
+    unsigned int i;
+
+    for (i = mem->start; i < tab->nextent; i++)
+    {
+        if (tab->tag[i] != filetype)
+            continue;
+        if (decode)
+            fp = saved ? saved[i] : _xpost_image_file_pointer(*(FILE **)(mem->base + tab->adr[i]));
+        else
+        {
+            fp = *(FILE **)(mem->base + tab->adr[i]);
+            saved[i] = fp;
+            fp = _xpost_image_file_code(fp);
+        }
+        memcpy(mem->base + tab->adr[i], &fp, sizeof fp);
+    }
+}
+
+/* write one memory file, with its file records coded */
+static int
+_xpost_image_save_memory(Xpost_Memory_File *mem,
+                         int fd)
+{
+    FILE **saved;
+    int ret;
+
+    saved = calloc(mem->table.nextent ? mem->table.nextent : 1, sizeof *saved);
+    if (!saved)
+        return 0;
+    _xpost_image_swap_files(mem, saved, 0);
+    ret = xpost_memory_file_save_image(mem, fd);
+    _xpost_image_swap_files(mem, saved, 1);
+    free(saved);
+    return ret;
+}
+
+int
+xpost_image_save(Xpost_Context *ctx,
+                 const char *filename,
+                 const Xpost_Image_Stamp *stamp,
+                 const char *init_ps)
+{
+    Xpost_Image_Header head;
+    char tmpname[XPOST_PATH_MAX];
+    int fd;
+
+    if (!_xpost_image_header_init(&head, stamp, init_ps))
+    {
+        XPOST_LOG_ERR("cannot stat %s", init_ps);
+        return 0;
+    }
+    head.currentobject = ctx->currentobject;
+    head.event_handler = ctx->event_handler;
+    head.window_device = ctx->window_device;
+    head.rand_next = ctx->rand_next;
+    head.vmmode = ctx->vmmode;
+
+    if (snprintf(tmpname, sizeof tmpname, "%s.XXXXXX", filename) >= (int)sizeof tmpname)
+    {
+        XPOST_LOG_ERR("image file name too long");
+        return 0;
+    }
+    fd = mkstemp(tmpname);
+    if (fd == -1)
+    {
+        XPOST_LOG_ERR("cannot create image %s (error: %s)",
+                      tmpname, strerror(errno));
+        return 0;
+    }
+    (void)fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+
+    if (write(fd, &head, sizeof head) != (ssize_t)sizeof head ||
+        !_xpost_image_save_memory(ctx->lo, fd) ||
+        !_xpost_image_save_memory(ctx->gl, fd))
+    {
+        XPOST_LOG_ERR("cannot write image %s", tmpname);
+        close(fd);
+        remove(tmpname);
+        return 0;
+    }
+    if (close(fd) == -1 || rename(tmpname, filename) == -1)
+    {
+        XPOST_LOG_ERR("cannot install image %s (error: %s)",
+                      filename, strerror(errno));
+        remove(tmpname);
+        return 0;
+    }
+
+    XPOST_LOG_INFO("wrote image %s", filename);
+    return 1;
+}
+
+int
+xpost_image_load(Xpost_Context *ctx,
+                 const char *filename,
+                 const Xpost_Image_Stamp *stamp,
+                 const char *init_ps)
+{
+    Xpost_Image_Header expect;
+    Xpost_Image_Header head;
+    unsigned char *old;
+    unsigned int oldsz;
+    unsigned int id;
+    int fd;
+    int ret = -1;
+
+    fd = open(filename, O_RDONLY);
+    if (fd == -1)
+    {
+        XPOST_LOG_INFO("no image %s", filename);
+        return 0;
+    }
+    if (!_xpost_image_header_init(&expect, stamp, init_ps) ||
+        read(fd, &head, sizeof head) != (ssize_t)sizeof head)
+    {
+        XPOST_LOG_INFO("image %s is out of date", filename);
+        close(fd);
+        return 0;
+    }
+    /* the image may have been saved by a context with another cid */
+    id = head.stamp.id;
+    head.stamp.id = expect.stamp.id;
+    if (memcmp(head.magic, expect.magic, sizeof head.magic) != 0 ||
+        head.version != expect.version ||
+        memcmp(head.package, expect.package, sizeof head.package) != 0 ||
+        memcmp(head.sizes, expect.sizes, sizeof head.sizes) != 0 ||
+        memcmp(&head.stamp, &expect.stamp, sizeof head.stamp) != 0 ||
+        strcmp(head.init_ps, expect.init_ps) != 0 ||
+        head.init_ps_mtime != expect.init_ps_mtime ||
+        head.init_ps_size != expect.init_ps_size)
+    {
+        XPOST_LOG_INFO("image %s is out of date", filename);
+        close(fd);
+        return 0;
+    }
+
+    /* keep the freshly installed operators, to relink the image */
+    oldsz = ctx->gl->used;
+    old = malloc(oldsz);
+    if (!old)
+    {
+        close(fd);
+        return 0;
+    }
+    memcpy(old, ctx->gl->base, oldsz);
+
+    if (!xpost_memory_file_load_image(ctx->lo, fd))
+    {
+        free(old);
+        close(fd);
+        return 0;
+    }
+    if (!xpost_memory_file_load_image(ctx->gl, fd))
+        goto end;
+    if (!xpost_operator_relink(ctx, old, oldsz))
+    {
+        XPOST_LOG_ERR("operators of image %s do not match", filename);
+        goto end;
+    }
+    _xpost_image_swap_files(ctx->lo, NULL, 1);
+    _xpost_image_swap_files(ctx->gl, NULL, 1);
+    if (id != ctx->id)
+    {
+        xpost_context_replace_ctxlist(ctx->lo, id, ctx->id);
+        xpost_context_replace_ctxlist(ctx->gl, id, ctx->id);
+    }
+
+    ctx->currentobject = head.currentobject;
+    ctx->event_handler = head.event_handler;
+    ctx->window_device = head.window_device;
+    ctx->rand_next = head.rand_next;
+    ctx->vmmode = head.vmmode;
+    ret = 1;
+    XPOST_LOG_INFO("loaded image %s", filename);
+
+  end:
+    free(old);
+    close(fd);
+    return ret;
+}
+
+#else
+
+int
+xpost_image_save(Xpost_Context *ctx,
+                 const char *filename,
+                 const Xpost_Image_Stamp *stamp,
+                 const char *init_ps)
+{
+    (void)ctx;
+    (void)filename;
+    (void)stamp;
+    (void)init_ps;
+    XPOST_LOG_ERR("images need mmap");
+    return 0;
+}
+
+int
+xpost_image_load(Xpost_Context *ctx,
+                 const char *filename,
+                 const Xpost_Image_Stamp *stamp,
+                 const char *init_ps)
+{
+    (void)ctx;
+    (void)filename;
+    (void)stamp;
+    (void)init_ps;
+    return 0;
+}
+
+#endif
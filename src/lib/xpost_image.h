@@ -0,0 +1,110 @@
+/*
+ * Xpost - a Level-2 Postscript interpreter
+ * Copyright (C) 2013-2016, Michael Joshua Ryan
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the Xpost software product nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef XPOST_IMAGE_H
+#define XPOST_IMAGE_H
+
+/**
+ * @file xpost_image.h
+ * @brief quick-launch images of the initialized virtual memory
+ *
+ * An image holds the local and global memory files of the first
+ * context as they are after init.ps has run, so that xpost_create()
+ * can map them instead of interpreting init.ps again.
+ *
+ * The operators and the C variables caching names and opcodes are
+ * still initialized by xpost_oplib_init_ops(), which is cheap and
+ * deterministic. An image is only accepted if that initialization
+ * produced exactly the memory layout recorded in its stamp, and the
+ * function-pointers of the operators are then copied from the fresh
+ * operator table (see xpost_operator_relink()).
+ *
+ * The FILE * of the standard streams are stored as small codes,
+ * other files are stored closed.
+ *
+ * An image is rebuilt when its version, stamp or init.ps does not
+ * match. It is replaced atomically, so concurrent processes may
+ * share it.
+ */
+
+/**
+ * @brief version of the image format
+ */
+#define XPOST_IMAGE_VERSION 2
+
+/**
+ * @brief memory layout of a context after the operators are installed
+ */
+typedef struct
+{
+    unsigned int id; /**< cid of the context, replaced in the vm of another context loading it */
+    unsigned int lo_used; /**< used size of local vm */
+    unsigned int lo_nextent; /**< number of entities in local vm */
+    unsigned int gl_used; /**< used size of global vm */
+    unsigned int gl_nextent; /**< number of entities in global vm */
+} Xpost_Image_Stamp;
+
+/**
+ * @brief record the layout of the vm of ctx in stamp
+ */
+void xpost_image_stamp(Xpost_Context *ctx, Xpost_Image_Stamp *stamp);
+
+/**
+ * @brief return the image file set with xpost_image_set(), or the
+ * XPOST_IMAGE environment variable, or NULL
+ */
+const char *xpost_image_get(void);
+
+/**
+ * @brief write the vm of ctx to an image file
+ *
+ * stamp is the layout recorded before init_ps was run.
+ * Return 1 on success, 0 on failure.
+ */
+int xpost_image_save(Xpost_Context *ctx,
+                     const char *filename,
+                     const Xpost_Image_Stamp *stamp,
+                     const char *init_ps);
+
+/**
+ * @brief replace the vm of ctx by an image file
+ *
+ * ctx must have just been initialized, with the layout in stamp.
+ * Return 1 on success, 0 if the image is missing or does not
+ * match, in which case ctx is left unchanged, and -1 if loading
+ * failed after ctx was changed, in which case ctx must be
+ * initialized again.
+ */
+int xpost_image_load(Xpost_Context *ctx,
+                     const char *filename,
+                     const Xpost_Image_Stamp *stamp,
+                     const char *init_ps);
+
+#endif
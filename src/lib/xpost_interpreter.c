@@ -34,15 +34,32 @@
 #endif
 
 #include <assert.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <fcntl.h>
 #include <sys/stat.h>
 
+#ifdef TIME_WITH_SYS_TIME
+# include <sys/time.h>
+# include <time.h>
+#else
+# ifdef HAVE_SYS_TIME_H
+#  include <sys/time.h>
+# else
+#  include <time.h>
+# endif
+#endif
+
+#if defined (HAVE_POLL_H) && !defined (_WIN32)
+# include <poll.h>
+# define XPOST_INTERPRETER_POLL
+#endif
+
 #include "xpost.h"
 #include "xpost_log.h"
-#include "xpost_compat.h" /* mkstemp, xpost_isatty */
+#include "xpost_compat.h" /* mkstemp, xpost_isatty, Xpost_Lock */
 #include "xpost_memory.h"  // itp contexts contain mfiles and mtabs
 #include "xpost_object.h"  // eval functions examine objects
 #include "xpost_stack.h"  // eval functions manipulate stacks
@@ -55,40 +72,24 @@
 #include "xpost_dict.h"  // eval functions examine dicts
 #include "xpost_file.h"  // eval functions examine files
 
-#include "xpost_interpreter.h" // uses: context itp MAXCONTEXT MAXMFILE
+#include "xpost_interpreter.h" // uses: context itp CTABSEGSIZE MAXMFILE
 #include "xpost_garbage.h"  //  test gc, install collect() in context's memory files
 #include "xpost_operator.h"  // eval functions call operators
 #include "xpost_oplib.h"
+#include "xpost_image.h"  // quick-launch images of the initialized vm
+#include "xpost_rom.h"  // built-in init.ps and the files it runs
 
-static
-Xpost_Object namedollarerror; /* cached result of xpost_name_cons(ctx, "$error")
-                                 to reduce time in error handler */
-static Xpost_Object nameerrordict;
-
-int _xpost_interpreter_is_tracing = 0;             /* output trace log */
-Xpost_Interpreter *itpdata;  /* the global interpreter instance, containing all contexts and memory files */
-static int _initializing = 1;  /* garbage collect does not run while _initializing is true.
-                                  a getter function is exported in the memory file struct
-                                  for the gc to access this global without #include'ing interpreter.h
-                                  which would create a circular dependency. */
+/* the tables of contexts and memory files, shared by all the interpreters
+   made by xpost_create(): an entry is taken and given back under a lock,
+   and is then used by its interpreter only */
+static Xpost_Interpreter _xpost_interpreter_tables;
+Xpost_Interpreter *itpdata = &_xpost_interpreter_tables;
 
 int eval(Xpost_Context *ctx);
 int mainloop(Xpost_Context *ctx);
 void init(void);
 void xit(void);
 
-/* getter function for _initializing, for export */
-int xpost_interpreter_get_initializing(void)
-{
-    return _initializing;
-}
-
-/* setter function for _initializing, for consistency */
-void xpost_interpreter_set_initializing(int i)
-{
-    _initializing = i;
-}
-
 /*  allocate a global memory file
     find the next unused mfile in the global memory table */
 static Xpost_Memory_File *xpost_interpreter_alloc_global_memory(void)
@@ -97,8 +98,10 @@ static Xpost_Memory_File *xpost_interpreter_alloc_global_memory(void)
 
     for (i = 0; i < MAXMFILE; i++)
     {
-        if (itpdata->gtab[i].base == NULL)
+        if (!itpdata->gtab[i].in_use)
         {
+            /* the entry may have held a file which was exited */
+            memset(&itpdata->gtab[i], 0, sizeof itpdata->gtab[i]);
             return &itpdata->gtab[i];
         }
     }
@@ -113,8 +116,10 @@ static Xpost_Memory_File *xpost_interpreter_alloc_local_memory(void)
     int i;
     for (i = 0; i < MAXMFILE; i++)
     {
-        if (itpdata->ltab[i].base == NULL)
+        if (!itpdata->ltab[i].in_use)
         {
+            /* the entry may have held a file which was exited */
+            memset(&itpdata->ltab[i], 0, sizeof itpdata->ltab[i]);
             return &itpdata->ltab[i];
         }
     }
@@ -123,31 +128,90 @@ static Xpost_Memory_File *xpost_interpreter_alloc_local_memory(void)
 }
 
 
-/* cursor to next cid number to try to allocate */
+/* taken to allocate contexts,
+   as jobs may run in parallel threads (xpost_context_pool_run()) */
 static
-unsigned int nextid = 0;
+Xpost_Lock _xpost_interpreter_ctab_lock = XPOST_LOCK_INIT;
+
+/* taken to allocate and free memory files */
+static
+Xpost_Lock _xpost_interpreter_mtab_lock = XPOST_LOCK_INIT;
+
+/* the link of a released cid in the list of released cids */
+static unsigned int *_xpost_interpreter_cid_next_free(unsigned int cid)
+{
+    return &itpdata->ctab[ (cid - 1) / CTABSEGSIZE ]->next_free[ (cid - 1) % CTABSEGSIZE ];
+}
 
 /* allocate a context-id and associated context struct
    returns cid;
-   a context in state zero is considered available for allocation,
-   this corresponds to the C_FREE enumeration constant.
+   a slot is allocated until xpost_interpreter_cid_release(),
+   apart from the state of the context, which its own thread changes.
+   the context is reserved in the C_IDLE state.
+   new cids are handed out while the last segment has room,
+   then the released ones, oldest first, so that a cid is not
+   reused right after its release. a segment is added
+   when none is released.
  */
 static int xpost_interpreter_cid_init(unsigned int *cid)
 {
-    unsigned int startid = nextid;
+    unsigned int id;
+    unsigned int seg;
+    Xpost_Context *ctx;
+
+    xpost_lock(&_xpost_interpreter_ctab_lock);
     //printf("cid_init\n");
-    while ( xpost_interpreter_cid_get_context(++nextid)->state != 0 )
+    if (itpdata->cid_top % CTABSEGSIZE == 0 && itpdata->cid_free_head)
+    {
+        id = itpdata->cid_free_head;
+        itpdata->cid_free_head = *_xpost_interpreter_cid_next_free(id);
+        if (!itpdata->cid_free_head)
+            itpdata->cid_free_tail = 0;
+    }
+    else
     {
-        if (nextid == startid + MAXCONTEXT)
+        seg = itpdata->cid_top / CTABSEGSIZE;
+        if (seg == MAXCTABSEG)
         {
+            xpost_unlock(&_xpost_interpreter_ctab_lock);
             XPOST_LOG_ERR("ctab full. cannot create new process");
             return 0;
         }
+        if (!itpdata->ctab[seg])
+        {
+            itpdata->ctab[seg] = calloc(1, sizeof(Xpost_Context_Segment));
+            if (!itpdata->ctab[seg])
+            {
+                xpost_unlock(&_xpost_interpreter_ctab_lock);
+                XPOST_LOG_ERR("cannot allocate context table segment");
+                return 0;
+            }
+        }
+        id = ++itpdata->cid_top;
     }
-    *cid = nextid;
+    ctx = xpost_interpreter_cid_get_context(id);
+    /* not of any job until it is initialized */
+    ctx->lo = NULL;
+    ctx->state = C_IDLE;
+    *cid = id;
+    xpost_unlock(&_xpost_interpreter_ctab_lock);
     return 1;
 }
 
+/* return a context-id to the table, its context is C_FREE */
+static void xpost_interpreter_cid_release(unsigned int cid)
+{
+    xpost_lock(&_xpost_interpreter_ctab_lock);
+    xpost_interpreter_cid_get_context(cid)->state = C_FREE;
+    *_xpost_interpreter_cid_next_free(cid) = 0;
+    if (itpdata->cid_free_tail)
+        *_xpost_interpreter_cid_next_free(itpdata->cid_free_tail) = cid;
+    else
+        itpdata->cid_free_head = cid;
+    itpdata->cid_free_tail = cid;
+    xpost_unlock(&_xpost_interpreter_ctab_lock);
+}
+
 /* adapter:
            ctx <- cid
    yield pointer to context struct given cid
@@ -157,7 +221,24 @@ static int xpost_interpreter_cid_init(unsigned int *cid)
 Xpost_Context *xpost_interpreter_cid_get_context(unsigned int cid)
 {
     //TODO reject cid 0
-    return &itpdata->ctab[ (cid - 1) % MAXCONTEXT ];
+    return &itpdata->ctab[ (cid - 1) / CTABSEGSIZE ]->ctx[ (cid - 1) % CTABSEGSIZE ];
+}
+
+/* free the segments of the context table */
+void xpost_interpreter_quit(void)
+{
+    unsigned int i;
+
+    xpost_lock(&_xpost_interpreter_ctab_lock);
+    for (i = 0; i < MAXCTABSEG && itpdata->ctab[i]; i++)
+    {
+        free(itpdata->ctab[i]);
+        itpdata->ctab[i] = NULL;
+    }
+    itpdata->cid_top = 0;
+    itpdata->cid_free_head = 0;
+    itpdata->cid_free_tail = 0;
+    xpost_unlock(&_xpost_interpreter_ctab_lock);
 }
 
 
@@ -167,7 +248,7 @@ Xpost_Context *xpost_interpreter_cid_get_context(unsigned int cid)
    push systemdict on dict stack.
    allocate and push globaldict on dict stack.
    allocate and push userdict on dict stack.
-   return 1 on success, 0 on failure
+   return 1 on success, 0 on failure, leaving the memory files to the caller
  */
 static
 int _xpost_interpreter_extra_context_init(Xpost_Context *ctx, const char *device)
@@ -175,20 +256,12 @@ int _xpost_interpreter_extra_context_init(Xpost_Context *ctx, const char *device
     int ret;
     ret = xpost_name_init(ctx); /* NAMES NAMET */
     if (!ret)
-    {
-        xpost_memory_file_exit(ctx->lo);
-        xpost_memory_file_exit(ctx->gl);
         return 0;
-    }
     ctx->vmmode = GLOBAL;
 
     ret = xpost_operator_init_optab(ctx); /* allocate and zero the optab structure */
     if (!ret)
-    {
-        xpost_memory_file_exit(ctx->lo);
-        xpost_memory_file_exit(ctx->gl);
         return 0;
-    }
 
     /* seed the tree with a word from the middle of the alphabet */
     /* middle of the start */
@@ -199,9 +272,9 @@ int _xpost_interpreter_extra_context_init(Xpost_Context *ctx, const char *device
         return 0;
     if (xpost_object_get_type(xpost_name_cons(ctx, "setmiterlimit")) == invalidtype)
         return 0;
-    if (xpost_object_get_type((namedollarerror = xpost_name_cons(ctx, "$error"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.dollarerror = xpost_name_cons(ctx, "$error"))) == invalidtype)
         return 0;
-    if (xpost_object_get_type((nameerrordict = xpost_name_cons(ctx, "errordict"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.errordict = xpost_name_cons(ctx, "errordict"))) == invalidtype)
         return 0;
 
     xpost_oplib_init_ops(ctx); /* populate the optab (and systemdict) with operators */
@@ -250,40 +323,45 @@ int _xpost_interpreter_extra_context_init(Xpost_Context *ctx, const char *device
 }
 
 
-/* initialize itpdata.
-   create and initialize a single context in ctab[0]
+/* destroy a context made by xpost_interpreter_init and its memory files */
+void xpost_interpreter_exit(Xpost_Context *ctx)
+{
+    xpost_lock(&_xpost_interpreter_mtab_lock);
+    xpost_context_exit(ctx);
+    xpost_unlock(&_xpost_interpreter_mtab_lock);
+    xpost_interpreter_cid_release(ctx->id);
+}
+
+/* create and initialize a new context, with its own memory files,
+   in the tables shared by all interpreters
  */
-int xpost_interpreter_init(Xpost_Interpreter *itpptr, const char *device)
+Xpost_Context *xpost_interpreter_init(const char *device)
 {
+    Xpost_Context *ctx;
+    unsigned int cid;
     int ret;
 
-    ret = xpost_context_init(&itpptr->ctab[0],
-                             xpost_interpreter_cid_init,
+    xpost_lock(&_xpost_interpreter_mtab_lock);
+    cid = xpost_context_init(xpost_interpreter_cid_init,
+                             xpost_interpreter_cid_release,
                              xpost_interpreter_cid_get_context,
-                             xpost_interpreter_get_initializing,
-                             xpost_interpreter_set_initializing,
                              xpost_interpreter_alloc_local_memory,
                              xpost_interpreter_alloc_global_memory,
                              xpost_garbage_collect);
-    if (!ret)
+    xpost_unlock(&_xpost_interpreter_mtab_lock);
+    if (!cid)
     {
-        return 0;
+        return NULL;
     }
-    ret = _xpost_interpreter_extra_context_init(&itpptr->ctab[0], device);
+    ctx = xpost_interpreter_cid_get_context(cid);
+    ret = _xpost_interpreter_extra_context_init(ctx, device);
     if (!ret)
     {
-        return 0;
+        xpost_interpreter_exit(ctx);
+        return NULL;
     }
 
-    itpptr->cid = itpptr->ctab[0].id;
-
-    return 1;
-}
-
-/* destroy context in ctab[0] */
-void xpost_interpreter_exit(Xpost_Interpreter *itpptr)
-{
-    xpost_context_exit(&itpptr->ctab[0]);
+    return ctx;
 }
 
 
@@ -328,7 +406,7 @@ static
 int evalload(Xpost_Context *ctx)
 {
     int ret;
-    if (_xpost_interpreter_is_tracing)
+    if (ctx->tracing)
     {
         Xpost_Object s = xpost_name_get_string(ctx, xpost_stack_topdown_fetch(ctx->lo, ctx->es, 0));
         XPOST_LOG_DUMP("evalload <name \"%*s\">", s.comp_.sz, xpost_string_get_pointer(ctx, s));
@@ -363,7 +441,7 @@ int evaloperator(Xpost_Context *ctx)
     if (xpost_object_get_type(op) == invalidtype)
         return stackunderflow;
 
-    if (_xpost_interpreter_is_tracing)
+    if (ctx->tracing)
         xpost_operator_dump(ctx, op.mark_.padw);
     ret = xpost_operator_exec(ctx, op.mark_.padw);
     if (ret)
@@ -438,7 +516,8 @@ int evalstring(Xpost_Context *ctx)
             return stackunderflow;
         if (!xpost_stack_push(ctx->lo, ctx->es, s))
             return execstackoverflow;
-        if (xpost_object_get_type(t)==arraytype)
+        /* a procedure is pushed, a binary object sequence is executed */
+        if (xpost_object_get_type(t)==arraytype && !ctx->binseq)
         {
             if (!xpost_stack_push(ctx->lo, ctx->os , t))
                 return stackoverflow;
@@ -465,6 +544,16 @@ int evalfile(Xpost_Context *ctx)
     assert(ctx->gl->base);
     //xpost_operator_exec(ctx, xpost_operator_cons(ctx, "token",NULL,0,0).mark_.padw);
     ret = xpost_operator_exec(ctx, ctx->opcode_shortcuts.token);
+    if (ret == ioblock)
+    {
+        /* token scheduled its own retry with the file:
+           retry executing the file instead */
+        (void)xpost_stack_pop(ctx->lo, ctx->es);
+        (void)xpost_stack_pop(ctx->lo, ctx->os);
+        if (!xpost_stack_push(ctx->lo, ctx->es, f))
+            return execstackoverflow;
+        return ioblock;
+    }
     if (ret)
         return ret;
     b = xpost_stack_pop(ctx->lo, ctx->os);
@@ -473,7 +562,7 @@ int evalfile(Xpost_Context *ctx)
         t = xpost_stack_pop(ctx->lo, ctx->os);
         if (!xpost_stack_push(ctx->lo, ctx->es, f))
             return execstackoverflow;
-        if (xpost_object_get_type(t)==arraytype)
+        if (xpost_object_get_type(t)==arraytype && !ctx->binseq)
         {
             if (!xpost_stack_push(ctx->lo, ctx->os, t))
                 return stackoverflow;
@@ -494,33 +583,29 @@ int evalfile(Xpost_Context *ctx)
 }
 
 /* interpreter actions for executable types */
-evalfunc *evalinvalid = evalquit;
-evalfunc *evalmark = evalpush;
-evalfunc *evalnull = evalpop;
-evalfunc *evalinteger = evalpush;
-evalfunc *evalboolean = evalpush;
-evalfunc *evalreal = evalpush;
-evalfunc *evalsave = evalpush;
-evalfunc *evaldict = evalpush;
-evalfunc *evalextended = evalquit;
-evalfunc *evalglob = evalpush;
-evalfunc *evalmagic = evalquit;
-
-evalfunc *evalcontext = evalpush;
-evalfunc *evalname = evalload;
-
-/* install the evaltype functions (possibly via pointers) in the jump table */
-evalfunc *evaltype[XPOST_OBJECT_NTYPES + 1];
-#define AS_EVALINIT(_) evaltype[ _ ## type ] = eval ## _ ;
-
-/* use above macro to initialize function table
-   keyed by enum types;
- */
+#define evalinvalid evalquit
+#define evalmark evalpush
+#define evalnull evalpop
+#define evalinteger evalpush
+#define evalboolean evalpush
+#define evalreal evalpush
+#define evalsave evalpush
+#define evaldict evalpush
+#define evalextended evalquit
+#define evalglob evalpush
+#define evalmagic evalquit
+
+#define evalcontext evalpush
+#define evalname evalload
+
+/* the evaltype functions in a jump table keyed by enum types,
+   constant so that it is shared by all interpreters */
+#define AS_EVALINIT(_) eval ## _ ,
 static
-void initevaltype(void)
+evalfunc *const evaltype[XPOST_OBJECT_NTYPES + 1] =
 {
     XPOST_OBJECT_TYPES(AS_EVALINIT)
-}
+};
 
 
 /*
@@ -613,7 +698,7 @@ int eval(Xpost_Context *ctx)
     if (!validate_context(ctx))
         return unregistered;
 
-    if (_xpost_interpreter_is_tracing)
+    if (ctx->tracing)
     {
         XPOST_LOG_DUMP("eval(): Executing: ");
         xpost_object_dump(t);
@@ -659,14 +744,14 @@ void _onerror(Xpost_Context *ctx,
     if (!validate_context(ctx))
         XPOST_LOG_ERR("context not valid");
 
-    if (itpdata->in_onerror > 5)
+    if (ctx->in_onerror > 5)
     {
         fprintf(stderr, "LOOP in error handler\nabort\n");
         ++ctx->quit;
         //exit(undefinedresult);
     }
 
-    ++itpdata->in_onerror;
+    ++ctx->in_onerror;
 
 #ifdef EMITONERROR
     fprintf(stderr, "err: %s\n", errorname[err]);
@@ -689,14 +774,14 @@ void _onerror(Xpost_Context *ctx,
     sd = xpost_stack_bottomup_fetch(ctx->lo, ctx->ds, 0);
 
     /* printf("2\n"); */
-    dollarerror = xpost_dict_get(ctx, sd, namedollarerror);
+    dollarerror = xpost_dict_get(ctx, sd, ctx->name_shortcuts.dollarerror);
     if (xpost_object_get_type(dollarerror) == invalidtype)
     {
         XPOST_LOG_ERR("cannot load $error dict for error: %s",
                 errorname[err]);
         xpost_stack_push(ctx->lo, ctx->es,
                 xpost_object_cvx(xpost_name_cons(ctx, "stop")));
-        //itpdata->in_onerror = 0;
+        //ctx->in_onerror = 0;
         return;
     }
 
@@ -711,105 +796,309 @@ void _onerror(Xpost_Context *ctx,
     /* printf("7\n"); */
     xpost_stack_push(ctx->lo, ctx->es, xpost_object_cvx(xpost_name_cons(ctx, "signalerror")));
 #endif
-    ed = xpost_dict_get(ctx, sd, nameerrordict);
+    ed = xpost_dict_get(ctx, sd, ctx->name_shortcuts.errordict);
     xpost_stack_push(ctx->lo, ctx->es,
             xpost_dict_get(ctx, ed,
                 xpost_name_cons(ctx, errorname[err])));
 
     /* printf("8\n"); */
-    itpdata->in_onerror = 0;
+    ctx->in_onerror = 0;
 }
 
 
+/* number of evals a context may run before the next runnable context gets its turn */
+#define XPOST_INTERPRETER_QUANTUM 1000
+
+/* number of evals between two looks at the clock for the time budget of xpost_step() */
+#define XPOST_INTERPRETER_STEP_CLOCK 64
+
+/* the time in microseconds */
+static
+double _xpost_interpreter_now(void)
+{
+#ifdef HAVE_GETTIMEOFDAY
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec * 1000000.0 + (double)tv.tv_usec;
+#else
+    return (double)time(NULL) * 1000000.0;
+#endif
+}
+
+/* cids of the runnable contexts of the job, in turn order.
+   it lasts for one call of mainloop(): the contexts that can run
+   are found again in the context list when the job is resumed.
+   Xpost_Context::queued tells which contexts are in it. */
+typedef struct
+{
+    unsigned int *cid;
+    unsigned int head;
+    unsigned int len;
+    unsigned int max;
+} Xpost_Run_Queue;
+
+static
+void _xpost_interpreter_runq_push(Xpost_Run_Queue *q, Xpost_Context *ctx)
+{
+    unsigned int *cid;
+    unsigned int i;
+
+    if (ctx->queued)
+        return;
+    if (q->len == q->max)
+    {
+        /* grow, unwrapping the ring */
+        cid = malloc((q->max ? 2 * q->max : CTXLISTSIZE) * sizeof(unsigned int));
+        if (!cid)
+        {
+            /* it is queued again at a later switch */
+            XPOST_LOG_ERR("cannot grow run queue");
+            return;
+        }
+        for (i = 0; i < q->len; i++)
+            cid[i] = q->cid[(q->head + i) % q->max];
+        free(q->cid);
+        q->cid = cid;
+        q->head = 0;
+        q->max = q->max ? 2 * q->max : CTXLISTSIZE;
+    }
+    q->cid[(q->head + q->len++) % q->max] = ctx->id;
+    ctx->queued = 1;
+}
+
+/* a queued context is C_RUN, it can only change state when it runs,
+   so it is not ended while it waits in the queue */
+static
+Xpost_Context *_xpost_interpreter_runq_pop(Xpost_Run_Queue *q)
+{
+    Xpost_Context *ctx;
+
+    while (q->len)
+    {
+        ctx = xpost_interpreter_cid_get_context(q->cid[q->head]);
+        q->head = (q->head + 1) % q->max;
+        --q->len;
+        ctx->queued = 0;
+        if (ctx->state == C_RUN)
+            return ctx;
+    }
+    return NULL;
+}
+
+static
+void _xpost_interpreter_wake(Xpost_Run_Queue *q, Xpost_Context *c)
+{
+    c->state = C_RUN;
+    c->iofd = -1;
+    _xpost_interpreter_runq_push(q, c);
+}
+
 /*
-   select a new context to execute and return it
-   scan for the next context in the C_RUN state
-   along the way, change C_WAIT contexts to C_RUN
-   to retry wait conditions.
+   queue the contexts of the job blocked on a read that can go on.
+   a read waiting on a descriptor goes on when poll() finds bytes
+   (or the end) on it. if no context can run, the thread waits for
+   one in poll(), unless a read waits on the caller of xpost_run().
+   a read without a descriptor is retried in its turn.
  */
 static
-Xpost_Context *_switch_context(Xpost_Context *ctx)
+void _xpost_interpreter_job_poll(Xpost_Run_Queue *q, Xpost_Context *root)
 {
+    unsigned int *ctxlist = xpost_context_get_ctxlist(root->lo);
+    Xpost_Context *c;
+    int yield = 0;
+    int n = 0;
     int i;
 
-    return ctx;
+    for (i = 0; ctxlist[i]; i++)
+    {
+        c = xpost_interpreter_cid_get_context(ctxlist[i]);
+        if (c->state != C_IOBLOCK)
+            continue;
+        if (c->iofd >= 0)
+            n++;
+        else if (c->ioyield)
+            yield = 1;
+        else
+            _xpost_interpreter_wake(q, c);
+    }
+    if (n == 0)
+        return;
 
-    // return next context to execute
-    printf("--switching contexts--\n");
-    //putchar('.'); fflush(0);
-    for (i = (ctx - itpdata->ctab) + 1; i < MAXCONTEXT; i++)
+#ifdef XPOST_INTERPRETER_POLL
     {
-        //printf("--%d-- %d\n", itpdata->ctab[i].id, itpdata->ctab[i].state);
-        if (itpdata->ctab[i].state == C_RUN)
-        {
-            return &itpdata->ctab[i];
-        }
-        if (itpdata->ctab[i].state == C_WAIT || itpdata->ctab[i].state == C_IOBLOCK)
+        struct pollfd *pfd;
+        int j;
+        int ret;
+
+        pfd = malloc(n * sizeof *pfd);
+        if (pfd)
         {
-            itpdata->ctab[i].state = C_RUN;
+            for (i = j = 0; ctxlist[i]; i++)
+            {
+                c = xpost_interpreter_cid_get_context(ctxlist[i]);
+                if (c->state == C_IOBLOCK && c->iofd >= 0)
+                {
+                    pfd[j].fd = c->iofd;
+                    pfd[j].events = POLLIN;
+                    pfd[j].revents = 0;
+                    j++;
+                }
+            }
+            do
+                ret = poll(pfd, n, (q->len || yield) ? 0 : -1);
+            while (ret < 0 && errno == EINTR);
+            if (ret >= 0)
+            {
+                /* the list is not changed by waking its contexts */
+                for (i = j = 0; ctxlist[i]; i++)
+                {
+                    c = xpost_interpreter_cid_get_context(ctxlist[i]);
+                    if (c->state == C_IOBLOCK && c->iofd >= 0)
+                    {
+                        if (pfd[j].revents)
+                            _xpost_interpreter_wake(q, c);
+                        j++;
+                    }
+                }
+                free(pfd);
+                return;
+            }
+            XPOST_LOG_ERR("poll failed: %s", strerror(errno));
+            free(pfd);
         }
     }
-    for (i = 0; i <= ctx-itpdata->ctab; i++)
+#endif
+    /* cannot wait: retry them all */
+    for (i = 0; ctxlist[i]; i++)
     {
-        //printf("--%d-- %d\n", itpdata->ctab[i].id, itpdata->ctab[i].state);
-        if (itpdata->ctab[i].state == C_RUN)
-        {
-            return &itpdata->ctab[i];
-        }
-        if (itpdata->ctab[i].state == C_WAIT || itpdata->ctab[i].state == C_IOBLOCK)
-        {
-            itpdata->ctab[i].state = C_RUN;
-        }
+        c = xpost_interpreter_cid_get_context(ctxlist[i]);
+        if (c->state == C_IOBLOCK && c->iofd >= 0)
+            _xpost_interpreter_wake(q, c);
     }
-    for (i = (ctx - itpdata->ctab) + 1; i < MAXCONTEXT; i++)
+}
+
+/*
+   select a new context to execute and return it, NULL if none can run.
+   contexts of the job made runnable since the last switch
+   (by fork, or by the end of a context they join) are queued first,
+   then the current context goes to the back of the queue if it can
+   still run, then the contexts whose blocked read can go on.
+   a detached context is freed when it is done.
+ */
+static
+Xpost_Context *_switch_context(Xpost_Run_Queue *q, Xpost_Context *root, Xpost_Context *ctx)
+{
+    unsigned int *ctxlist = xpost_context_get_ctxlist(root->lo);
+    Xpost_Context *c;
+    int i;
+
+    for (i = 0; ctxlist[i]; i++)
     {
-        //printf("--%d-- %d\n", itpdata->ctab[i].id, itpdata->ctab[i].state);
-        if (itpdata->ctab[i].state == C_RUN)
-        {
-            return &itpdata->ctab[i];
-        }
+        c = xpost_interpreter_cid_get_context(ctxlist[i]);
+        if (c != ctx && c->state == C_RUN)
+            _xpost_interpreter_runq_push(q, c);
     }
-    for (i = 0; i <= ctx-itpdata->ctab; i++)
+    if (ctx->state == C_ZOMB && ctx->detached)
+        xpost_context_fork_free(ctx);
+    if (ctx->state == C_RUN)
+        _xpost_interpreter_runq_push(q, ctx);
+    _xpost_interpreter_job_poll(q, root);
+
+    return _xpost_interpreter_runq_pop(q);
+}
+
+/* tell if a context of the job is blocked on a read,
+   and make them all runnable again if wake is set */
+static
+int _xpost_interpreter_job_ioblock(Xpost_Context *root, int wake)
+{
+    unsigned int *ctxlist = xpost_context_get_ctxlist(root->lo);
+    Xpost_Context *c;
+    int blocked = 0;
+    int i;
+
+    for (i = 0; ctxlist[i]; i++)
     {
-        //printf("--%d-- %d\n", itpdata->ctab[i].id, itpdata->ctab[i].state);
-        if (itpdata->ctab[i].state == C_RUN)
+        c = xpost_interpreter_cid_get_context(ctxlist[i]);
+        if (c->state == C_IOBLOCK)
         {
-            return &itpdata->ctab[i];
+            blocked = 1;
+            if (wake)
+                c->state = C_RUN;
         }
     }
-
-    return ctx;
+    return blocked;
 }
 
+/* end the contexts the job left behind */
+static
+void _xpost_interpreter_end_job(Xpost_Context *root)
+{
+    unsigned int *ctxlist = xpost_context_get_ctxlist(root->lo);
+    int i = 0;
+
+    /* freeing one moves the last of the list in its place */
+    while (ctxlist[i])
+    {
+        if (ctxlist[i] == root->id)
+            i++;
+        else
+            xpost_context_fork_free(xpost_interpreter_cid_get_context(ctxlist[i]));
+    }
+}
 
-/*
-   global shortcut for a single-threaded interpreter
-FIXME: "static context pointer". s.b. changed to a returned
-   value from xpost_create()
-   // value now returned. this variable should be removed
- */
-Xpost_Context *xpost_ctx;
 
+/* the public value must follow the error code */
+typedef char _xpost_run_ioblock_check[XPOST_RUN_IOBLOCK == ioblock ? 1 : -1];
 
 /*
    the big main central interpreter loop.
    processes return codes from eval().
    0 indicate noerror
    yieldtocaller indicates `showpage` has been called using SHOWPAGE_RETURN semantics.
-   ioblock indicates a blocked io operation.
-   contextswitch indicates the `yield` operator has been called.
+   ioblock indicates a blocked io operation,
+   returned to the caller if the job is read with a callback.
+   contextswitch indicates the current context has yielded, waits or ended.
    all other values indicate an error condition to be returned to postscript.
+   the runnable contexts of the job take turns of at most
+   XPOST_INTERPRETER_QUANTUM evals; the job ends when one of them quits.
+   the job stops, to go on at the next call, when the budget of
+   xpost_step() in the root context is spent.
  */
-int mainloop(Xpost_Context *ctx)
+static
+int _xpost_interpreter_run_job(Xpost_Run_Queue *q, Xpost_Context *ctx)
 {
+    Xpost_Context *root = ctx;
+    unsigned int clock = 0;
     int ret;
+    int n;
+
+    /* the context given is run, even before xpost_run() */
+    if (root->state == C_IDLE)
+        root->state = C_RUN;
+    /* a resumed job retries the reads that blocked it */
+    (void)_xpost_interpreter_job_ioblock(root, 1);
 
 ctxswitch:
-    xpost_ctx = ctx = _switch_context(ctx);
-    itpdata->cid = ctx->id;
+    ctx = _switch_context(q, root, ctx);
+    if (!ctx)
+    {
+        if (_xpost_interpreter_job_ioblock(root, 0))
+            return 2;
+        XPOST_LOG_ERR("no context can run, all are waiting");
+        _xpost_interpreter_end_job(root);
+        return 0;
+    }
 
-    while(!ctx->quit)
+    for (n = XPOST_INTERPRETER_QUANTUM; !ctx->quit; )
     {
+        if (root->step_ops >= 0 && root->step_ops-- == 0)
+            return 3;
+        if (root->step_end > 0 &&
+            ++clock % XPOST_INTERPRETER_STEP_CLOCK == 0 &&
+            _xpost_interpreter_now() >= root->step_end)
+            return 3;
         ret = eval(ctx);
         if (ret)
             switch (ret)
@@ -817,17 +1106,36 @@ ctxswitch:
             case yieldtocaller:
                 return 1;
             case ioblock:
-                ctx->state = C_IOBLOCK; /* fallthrough */
+                ctx->state = C_IOBLOCK;
+                /* fallthrough */
             case contextswitch:
                 goto ctxswitch;
             default:
                 _onerror(ctx, ret);
             }
+        if (--n == 0)
+            goto ctxswitch;
     }
 
+    _xpost_interpreter_end_job(root);
     return 0;
 }
 
+/* run the job of ctx, queueing its contexts for this call */
+int mainloop(Xpost_Context *ctx)
+{
+    Xpost_Run_Queue q = { NULL, 0, 0, 0 };
+    unsigned int *ctxlist = xpost_context_get_ctxlist(ctx->lo);
+    int ret;
+    int i;
+
+    for (i = 0; ctxlist[i]; i++)
+        xpost_interpreter_cid_get_context(ctxlist[i])->queued = 0;
+    ret = _xpost_interpreter_run_job(&q, ctx);
+    free(q.cid);
+    return ret;
+}
+
 
 
 
@@ -839,52 +1147,6 @@ ctxswitch:
  */
 #define CNT_STR(s) sizeof(s) - 1, s
 
-/*
-   set global pagesize,
-   initialize eval's jump-tabl
-   allocate global itpdata interpreter instance
-   call xpost_interpreter_init
-        which initializes the first context
- */
-static
-int initalldata(const char *device)
-{
-    int ret;
-
-    initevaltype();
-    xpost_object_install_dict_get_access(xpost_dict_get_access);
-    xpost_object_install_dict_set_access(xpost_dict_set_access);
-
-    /* allocate the top-level itpdata data structure. */
-    null = xpost_object_cvlit(null);
-    itpdata = malloc(sizeof*itpdata);
-    if (!itpdata)
-    {
-        XPOST_LOG_ERR("itpdata=malloc failed");
-        return 0;
-    }
-    memset(itpdata, 0, sizeof*itpdata);
-
-    /* allocate and initialize the first context structure
-       and associated memory structures.
-       populate OPTAB and systemdict with operators.
-       push systemdict, globaldict, and userdict on dict stack
-     */
-    ret = xpost_interpreter_init(itpdata, device);
-    if (!ret)
-    {
-        return 0;
-    }
-
-    /* set global shortcut to context_0
-       (the only context in a single-threaded interpreter)
-       TODO remove this variable
-     */
-    xpost_ctx = &itpdata->ctab[0];
-
-    return 1;
-}
-
 /* FIXME remove duplication of effort here and in bin/xpost_main.c
          (ie. there should be 1 table, not 2)
 
@@ -907,7 +1169,7 @@ void setlocalconfig(Xpost_Context *ctx,
                     Xpost_Object sd,
                     const char *device,
                     const char *outfile,
-                    const char *bufferin,
+                    const Xpost_Output_Buffer *bufferin,
                     char **bufferout,
                     Xpost_Showpage_Semantics semantics)
 {
@@ -925,10 +1187,11 @@ void setlocalconfig(Xpost_Context *ctx,
         { NULL, NULL, NULL }
     };
     const char *strtemplate = "currentglobal false setglobal "
-                        "%s userdict /DEVICE 612 792 %s put "
+                        "%s userdict /DEVICE %s %s put "
                         "setglobal";
     Xpost_Object namenewdev;
     Xpost_Object newdevstr;
+    char dimensions[32] = "612 792";
     int i;
     char *devstr;
     char *subdevice;
@@ -954,13 +1217,17 @@ void setlocalconfig(Xpost_Context *ctx,
             break;
         }
     }
+    /* a device rendering into the client's memory has its size */
+    if (bufferin)
+        sprintf(dimensions, "%d %d", bufferin->width, bufferin->height);
     newdevstr = xpost_string_cons(ctx,
-                                  strlen(strtemplate) - 4
+                                  strlen(strtemplate) - 6
                                   + strlen(device_strings[i][1])
+                                  + strlen(dimensions)
                                   + strlen(device_strings[i][2]) + 1,
                                   NULL);
     sprintf(xpost_string_get_pointer(ctx, newdevstr), strtemplate,
-            device_strings[i][1], device_strings[i][2]);
+            device_strings[i][1], dimensions, device_strings[i][2]);
     --newdevstr.comp_.sz; /* trim the '\0' */
 
     namenewdev = xpost_name_cons(ctx, "newdefaultdevice");
@@ -977,9 +1244,9 @@ void setlocalconfig(Xpost_Context *ctx,
 
     if (bufferin)
     {
-        Xpost_Object s = xpost_object_cvlit(xpost_string_cons(ctx, sizeof(bufferin), NULL));
+        Xpost_Object s = xpost_object_cvlit(xpost_string_cons(ctx, sizeof(*bufferin), NULL));
         xpost_object_set_access(ctx, s, XPOST_OBJECT_TAG_ACCESS_NONE);
-        memcpy(xpost_string_get_pointer(ctx, s), &bufferin, sizeof(bufferin));
+        memcpy(xpost_string_get_pointer(ctx, s), bufferin, sizeof(*bufferin));
         xpost_dict_put(ctx, sd, xpost_name_cons(ctx, "OutputBufferIn"), s);
     }
 
@@ -996,31 +1263,25 @@ void setlocalconfig(Xpost_Context *ctx,
 }
 
 /*
-   load init.ps (which also loads err.ps) while systemdict is writeable
-   ignore invalidaccess errors.
+   find init.ps in XPOST_DATA_DIR, the built-in files, the directory
+   of the shared library or PACKAGE_DATA_DIR. store its path in
+   path_init_ps and the directory in path_init.
+   return 1 on success, 0 on failure
  */
 static
-void loadinitps(Xpost_Context *ctx)
+int findinitps(char *path_init_ps, size_t sz, const char **path_init)
 {
-    char buf[1024];
-    char path_init_ps[XPOST_PATH_MAX];
     struct stat statbuf;
-    char *path_init;
-    char *path;
-    int n;
-
-    assert(ctx->gl->base);
-    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons(ctx, "quit", NULL,0,0));
-    ctx->ignoreinvalidaccess = 1;
+    const char *path;
 
 #define XPOST_PATH_INIT \
     do \
     { \
-        snprintf(path_init_ps, sizeof(path_init_ps), "%s/init.ps", path); \
+        snprintf(path_init_ps, sz, "%s/init.ps", path); \
         if (stat(path_init_ps, &statbuf) == 0) \
         { \
-            path_init = path; \
-            goto load_init_ps; \
+            *path_init = path; \
+            return 1; \
         } \
         else \
             XPOST_LOG_DBG("init.ps not present in", path_init_ps); \
@@ -1029,9 +1290,15 @@ void loadinitps(Xpost_Context *ctx)
     /* environment variable XPOST_DATA_DIR */
     if ((path = getenv("XPOST_DATA_DIR")))
         XPOST_PATH_INIT;
+    else if (xpost_rom_find("init.ps", NULL))
+    {
+        snprintf(path_init_ps, sz, "%s/init.ps", XPOST_ROM_DEVICE);
+        *path_init = XPOST_ROM_DEVICE;
+        return 1;
+    }
 
     /* directory of the shared library */
-    path = (char *)xpost_data_dir_get(); /* always well-defined */
+    path = xpost_data_dir_get(); /* always well-defined */
     XPOST_PATH_INIT;
 
 #ifdef PACKAGE_DATA_DIR
@@ -1039,18 +1306,37 @@ void loadinitps(Xpost_Context *ctx)
     XPOST_PATH_INIT;
 #endif
 
+#undef XPOST_PATH_INIT
+
     XPOST_LOG_ERR("init.ps can not be found");
 
-    return;
+    return 0;
+}
+
+/*
+   load init.ps (which also loads err.ps) while systemdict is writeable
+   ignore invalidaccess errors.
+ */
+static
+void loadinitps(Xpost_Context *ctx, const char *path_init_ps, const char *path_init)
+{
+    char buf[1024];
+    int n;
+
+    assert(ctx->gl->base);
+    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons(ctx, "quit", NULL,0,0));
+    ctx->ignoreinvalidaccess = 1;
 
-  load_init_ps:
     /* backslashes are not supported in path because they are inserted in
     * PostScript files, and PostScript */
 #ifdef _WIN32
-    path = path_init_ps;
-    while (*path++) if (*path == '\\') *path = '/';
-    path = path_init;
-    while (*path++) if (*path == '\\') *path = '/';
+    {
+        char *path;
+        path = (char *)path_init_ps;
+        while (*path++) if (*path == '\\') *path = '/';
+        path = (char *)path_init;
+        while (*path++) if (*path == '\\') *path = '/';
+    }
 #endif
     n = snprintf(buf, sizeof(buf),
                  "(%s) (r) file cvx "
@@ -1088,6 +1374,48 @@ static int copyudtosd(Xpost_Context *ctx, Xpost_Object ud, Xpost_Object sd)
     return 0;
 }
 
+/* the devices reject an output buffer they cannot render into only
+   once the interpreter runs, in the middle of its initialization:
+   check it before, like they do */
+static int _xpost_interpreter_bufferin_check(const char *device,
+                                             const Xpost_Output_Buffer *bufferin)
+{
+    size_t len = strcspn(device, ":");
+    int bpp;
+
+    if (!bufferin || !bufferin->pixels ||
+        bufferin->width <= 0 || bufferin->height <= 0)
+    {
+        XPOST_LOG_ERR("Wrong output buffer");
+        return 0;
+    }
+    switch (bufferin->format)
+    {
+        case XPOST_PIXEL_FORMAT_RGB:
+        case XPOST_PIXEL_FORMAT_BGR:
+            bpp = 3;
+            break;
+        case XPOST_PIXEL_FORMAT_ARGB:
+        case XPOST_PIXEL_FORMAT_BGRA:
+            bpp = 4;
+            break;
+        default:
+            XPOST_LOG_ERR("unknown output buffer format");
+            return 0;
+    }
+    if (bufferin->stride / bpp < bufferin->width)
+    {
+        XPOST_LOG_ERR("output buffer stride too small");
+        return 0;
+    }
+    if (len == strlen("bgr") && strncmp(device, "bgr", len) == 0 &&
+        bufferin->format != XPOST_PIXEL_FORMAT_BGR)
+    {
+        XPOST_LOG_ERR("bgr device needs a bgr output buffer");
+        return 0;
+    }
+    return 1;
+}
 
 /*
    create an executable context using the given device,
@@ -1102,26 +1430,33 @@ XPAPI Xpost_Context *xpost_create(const char *device,
                                   int width,
                                   int height)
 {
+    Xpost_Context *ctx;
     Xpost_Object sd, ud;
+    Xpost_Image_Stamp stamp;
+    char path_init_ps[XPOST_PATH_MAX];
+    const char *path_init;
+    const char *image;
+    int loaded;
     int ret;
     const char *outfile = NULL;
-    const char *bufferin = NULL;
+    const Xpost_Output_Buffer *bufferin = NULL;
     char **bufferout = NULL;
     int quiet;
+    int tracing;
 
     switch (output_msg)
     {
         case XPOST_OUTPUT_MESSAGE_QUIET:
             quiet = 1;
-            _xpost_interpreter_is_tracing = 0;
+            tracing = 0;
             break;
         case XPOST_OUTPUT_MESSAGE_VERBOSE:
             quiet = 0;
-            _xpost_interpreter_is_tracing = 0;
+            tracing = 0;
             break;
         case XPOST_OUTPUT_MESSAGE_TRACING:
             quiet = 0;
-            _xpost_interpreter_is_tracing = 1;
+            tracing = 1;
             break;
         default:
             XPOST_LOG_ERR("Wrong output message value");
@@ -1136,6 +1471,8 @@ XPAPI Xpost_Context *xpost_create(const char *device,
             break;
         case XPOST_OUTPUT_BUFFERIN:
             bufferin = outputptr;
+            if (!_xpost_interpreter_bufferin_check(device, bufferin))
+                return NULL;
             break;
         case XPOST_OUTPUT_BUFFEROUT:
             bufferout = (char **)outputptr;
@@ -1148,63 +1485,113 @@ XPAPI Xpost_Context *xpost_create(const char *device,
     test_memory();
     if (!test_garbage_collect(xpost_interpreter_cid_init,
                               xpost_interpreter_cid_get_context,
-                              xpost_interpreter_get_initializing,
-                              xpost_interpreter_set_initializing,
                               xpost_interpreter_alloc_local_memory,
                               xpost_interpreter_alloc_global_memory))
         return NULL;
 #endif
 
-    nextid = 0; //reset process counter
+    /* allocate and initialize the context and its memory files.
+       populate OPTAB and systemdict with operators.
+       push systemdict, globaldict, and userdict on dict stack
+     */
+    ctx = xpost_interpreter_init(device);
+    if (!ctx)
+    {
+        return NULL;
+    }
+    ctx->tracing = tracing;
 
-    /* Allocate and initialize all interpreter data structures. */
-    ret = initalldata(device);
-    if (!ret)
+    if (!findinitps(path_init_ps, sizeof(path_init_ps), &path_init))
     {
         return NULL;
     }
 
-    /* extract systemdict and userdict for additional definitions */
-    sd = xpost_stack_bottomup_fetch(xpost_ctx->lo, xpost_ctx->ds, 0);
-    ud = xpost_stack_bottomup_fetch(xpost_ctx->lo, xpost_ctx->ds, 2);
+    /* map the vm initialized by a previous run, if there is an image */
+    loaded = 0;
+    image = xpost_image_get();
+    if (image)
+    {
+        xpost_image_stamp(ctx, &stamp);
+        loaded = xpost_image_load(ctx, image, &stamp, path_init_ps);
+        if (loaded == -1)
+        {
+            /* the image was only partially loaded: start again */
+            xpost_interpreter_exit(ctx);
+            ctx = xpost_interpreter_init(device);
+            if (!ctx)
+            {
+                return NULL;
+            }
+            ctx->tracing = tracing;
+            loaded = 0;
+        }
+    }
 
-    setlocalconfig(xpost_ctx, sd,
-                   device, outfile, bufferin, bufferout,
-                   semantics);
+    /* extract systemdict and userdict for additional definitions */
+    sd = xpost_stack_bottomup_fetch(ctx->lo, ctx->ds, 0);
+    ud = xpost_stack_bottomup_fetch(ctx->lo, ctx->ds, 2);
 
-    if (quiet)
+    if (loaded)
     {
-        xpost_dict_put(xpost_ctx,
-                       sd /*xpost_stack_bottomup_fetch(ctx->lo, ctx->ds, 0)*/ ,
-                       xpost_name_cons(xpost_ctx, "QUIET"),
-                       null);
+        /* the image may have been written with a different verbosity */
+        if (quiet && !xpost_dict_known_key(ctx, ctx->gl, sd, xpost_name_cons(ctx, "QUIET")))
+        {
+            xpost_dict_put(ctx, sd, xpost_name_cons(ctx, "QUIET"), null);
+        }
+        else if (!quiet && xpost_dict_known_key(ctx, ctx->gl, sd, xpost_name_cons(ctx, "QUIET")))
+        {
+            xpost_dict_undef(ctx, sd, xpost_name_cons(ctx, "QUIET"));
+        }
     }
+    else
+    {
+        if (quiet)
+        {
+            xpost_dict_put(ctx,
+                           sd /*xpost_stack_bottomup_fetch(ctx->lo, ctx->ds, 0)*/ ,
+                           xpost_name_cons(ctx, "QUIET"),
+                           null);
+        }
 
-    xpost_stack_clear(xpost_ctx->lo, xpost_ctx->hold);
-    xpost_interpreter_set_initializing(0);
-    loadinitps(xpost_ctx);
+        xpost_stack_clear(ctx->lo, ctx->hold);
+        ctx->gl->initializing = 0;
+        ctx->lo->initializing = 0;
+        loadinitps(ctx, path_init_ps, path_init);
 
-    ret = copyudtosd(xpost_ctx, ud, sd);
-    if (ret)
-    {
-        XPOST_LOG_ERR("%s error in copyudtosd", errorname[ret]);
-        return NULL;
+        ret = copyudtosd(ctx, ud, sd);
+        if (ret)
+        {
+            XPOST_LOG_ERR("%s error in copyudtosd", errorname[ret]);
+            return NULL;
+        }
+
+        if (image)
+        {
+            (void)xpost_image_save(ctx, image, &stamp, path_init_ps);
+        }
     }
 
+    /* the configuration is not part of the image */
+    setlocalconfig(ctx, sd,
+                   device, outfile, bufferin, bufferout,
+                   semantics);
+    xpost_stack_clear(ctx->lo, ctx->hold);
+
     /* make systemdict readonly FIXME: use new access semantics */
-    xpost_dict_put(xpost_ctx, sd, xpost_name_cons(xpost_ctx, "systemdict"), sd);
-    xpost_object_set_access(xpost_ctx, sd, XPOST_OBJECT_TAG_ACCESS_READ_ONLY);
+    xpost_dict_put(ctx, sd, xpost_name_cons(ctx, "systemdict"), sd);
+    xpost_object_set_access(ctx, sd, XPOST_OBJECT_TAG_ACCESS_READ_ONLY);
 #if 0
-    if (!xpost_stack_bottomup_replace(xpost_ctx->lo, xpost_ctx->ds, 0, xpost_object_set_access(xpost_ctx, sd, XPOST_OBJECT_TAG_ACCESS_READ_ONLY)))
+    if (!xpost_stack_bottomup_replace(ctx->lo, ctx->ds, 0, xpost_object_set_access(ctx, sd, XPOST_OBJECT_TAG_ACCESS_READ_ONLY)))
     {
         XPOST_LOG_ERR("cannot replace systemdict in dict stack");
         return NULL;
     }
 #endif
 
-    xpost_interpreter_set_initializing(0);
+    ctx->gl->initializing = 0;
+    ctx->lo->initializing = 0;
 
-    return xpost_ctx;
+    return ctx;
 }
 
 static
@@ -1253,20 +1640,37 @@ XPAPI int xpost_add_definitions(Xpost_Context *ctx, int cnt, char *defs[])
     return 1;
 }
 
+XPAPI void xpost_page_callback_set(Xpost_Context *ctx,
+                                   Xpost_Page_Func func,
+                                   void *data)
+{
+    if (!ctx) return;
+    ctx->page_func = func;
+    ctx->page_data = data;
+
+    /* a host setting, not a state of the vm: survive xpost_reset */
+    if (ctx->snapshot)
+    {
+        ctx->snapshot->page_func = func;
+        ctx->snapshot->page_data = data;
+    }
+}
+
 /*
-   execute ps program until quit, fall-through to quit,
-   SHOWPAGE_RETURN semantic, or error (default action: message, purge and quit).
+   schedule a ps program for execution, without running it.
+   a program in memory is len bytes at inputptr, copied if copy is set.
  */
-XPAPI int xpost_run(Xpost_Context *ctx, Xpost_Input_Type input_type, const void *inputptr)
+static
+int _xpost_run_start(Xpost_Context *ctx,
+                     Xpost_Input_Type input_type,
+                     const void *inputptr,
+                     size_t len,
+                     int copy)
 {
-    Xpost_Object lsav = null;
-    int llev = 0;
-    unsigned int vs;
-    const char *ps_str = NULL;
     const char *ps_file = NULL;
     const FILE *ps_file_ptr = NULL;
+    Xpost_Object ps_buf = null;
     int ret;
-    Xpost_Object device;
 
     switch(input_type)
     {
@@ -1274,16 +1678,31 @@ XPAPI int xpost_run(Xpost_Context *ctx, Xpost_Input_Type input_type, const void
             ps_file = inputptr;
             break;
         case XPOST_INPUT_STRING:
-            ps_str = inputptr;
-            ps_file_ptr = tmpfile();
-            fwrite(ps_str, 1, strlen(ps_str), (FILE*)ps_file_ptr);
-            rewind((FILE*)ps_file_ptr);
+            /* read the program in place, without a temporary file */
+            ret = xpost_file_open_buffer(ctx->lo, inputptr, len, copy, &ps_buf);
+            if (ret)
+            {
+                XPOST_LOG_ERR("%s error opening program buffer", errorname[ret]);
+                return ret;
+            }
             break;
         case XPOST_INPUT_FILEPTR:
             ps_file_ptr = inputptr;
             break;
-        case XPOST_INPUT_RESUME: /* resuming a returned session, skip startup */
-            goto run;
+        case XPOST_INPUT_CALLBACK:
+        {
+            const Xpost_Input_Callback *cb = inputptr;
+            ret = xpost_file_open_callback(ctx->lo, cb->read, cb->data, &ps_buf);
+            if (ret)
+            {
+                XPOST_LOG_ERR("%s error opening program callback", errorname[ret]);
+                return ret;
+            }
+            break;
+        }
+        case XPOST_INPUT_RESUME: /* nothing to schedule */
+            XPOST_LOG_ERR("no program to start");
+            return unregistered;
     }
 
     /* prime the exec stack
@@ -1313,6 +1732,11 @@ XPAPI int xpost_run(Xpost_Context *ctx, Xpost_Input_Type input_type, const void
         xpost_stack_push(ctx->lo, ctx->os, xpost_object_cvlit(xpost_file_cons(ctx->lo, ps_file_ptr)));
         xpost_stack_push(ctx->lo, ctx->es, xpost_object_cvx(xpost_name_cons(ctx, "startfile")));
     }
+    else if (xpost_object_get_type(ps_buf) == filetype)
+    {
+        xpost_stack_push(ctx->lo, ctx->os, ps_buf);
+        xpost_stack_push(ctx->lo, ctx->es, xpost_object_cvx(xpost_name_cons(ctx, "startfile")));
+    }
     else
     {
         if (xpost_isatty(fileno(stdin)))
@@ -1321,15 +1745,46 @@ XPAPI int xpost_run(Xpost_Context *ctx, Xpost_Input_Type input_type, const void
             xpost_stack_push(ctx->lo, ctx->es, xpost_object_cvx(xpost_name_cons(ctx, "startstdin")));
     }
 
-    (void) xpost_save_create_snapshot_object(ctx->gl);
-    lsav = xpost_save_create_snapshot_object(ctx->lo);
+    /* frozen vm is reverted by xpost_reset() instead */
+    if (!ctx->gl->frozen)
+        (void) xpost_save_create_snapshot_object(ctx->gl);
+    ctx->jobsave = null;
+    if (!ctx->lo->frozen)
+        ctx->jobsave = xpost_save_create_snapshot_object(ctx->lo);
+
+    /* a job read with a callback returns to the caller when it blocks */
+    ctx->ioyield = (input_type == XPOST_INPUT_CALLBACK);
 
-    /* Run! */
-run:
-    ctx->quit = 0;
     ctx->state = C_RUN;
+    ctx->running = 1;
+    return noerror;
+}
+
+/*
+   execute the scheduled ps program until quit, fall-through to quit,
+   SHOWPAGE_RETURN semantic, or error (default action: message, purge and quit).
+   contextswitch means the budget of xpost_step() is spent.
+ */
+static
+int _xpost_run_resume(Xpost_Context *ctx)
+{
+    int llev = 0;
+    unsigned int vs;
+    int ret;
+    Xpost_Object device;
+
+    ctx->quit = 0;
+    /* a job stopped by xpost_step() may be joining a context */
+    if (ctx->state != C_WAIT)
+        ctx->state = C_RUN;
     ret = mainloop(ctx);
 
+    if (ret == 2)
+        return XPOST_RUN_IOBLOCK;
+
+    if (ret == 3)
+        return contextswitch;
+
     if (ret == 1)
     {
         Xpost_Object sem = xpost_dict_get(ctx,
@@ -1339,10 +1794,14 @@ run:
             return yieldtocaller;
     }
 
+    /* the job is done: the device is destroyed whatever the budget */
+    ctx->step_ops = -1;
+    ctx->step_end = 0;
+
     XPOST_LOG_INFO("destroying device");
-    device = xpost_dict_get(xpost_ctx,
-            xpost_stack_bottomup_fetch(xpost_ctx->lo, xpost_ctx->ds, 2),
-            xpost_name_cons(xpost_ctx, "DEVICE"));
+    device = xpost_dict_get(ctx,
+            xpost_stack_bottomup_fetch(ctx->lo, ctx->ds, 2),
+            xpost_name_cons(ctx, "DEVICE"));
     XPOST_LOG_INFO("device type=%s", xpost_object_type_names[xpost_object_get_type(device)]);
     //xpost_operator_dump(ctx, 1); // is this pointer value constant?
     if (xpost_object_get_type(device) == arraytype){
@@ -1359,12 +1818,12 @@ run:
     {
         Xpost_Object Destroy;
         XPOST_LOG_INFO("destroying device dict");
-        Destroy = xpost_dict_get(xpost_ctx, device, xpost_name_cons(xpost_ctx, "Destroy"));
+        Destroy = xpost_dict_get(ctx, device, xpost_name_cons(ctx, "Destroy"));
         if (xpost_object_get_type(Destroy) == operatortype)
         {
             int res;
-            xpost_stack_push(xpost_ctx->lo, xpost_ctx->os, device);
-            res = xpost_operator_exec(xpost_ctx, Destroy.mark_.padw);
+            xpost_stack_push(ctx->lo, ctx->os, device);
+            res = xpost_operator_exec(ctx, Destroy.mark_.padw);
             if (res)
                 XPOST_LOG_ERR("%s error destroying device", errorname[res]);
             else
@@ -1372,28 +1831,196 @@ run:
         }
     }
 
-    xpost_save_restore_snapshot(ctx->gl);
+    if (!ctx->gl->frozen)
+        xpost_save_restore_snapshot(ctx->gl);
     xpost_memory_table_get_addr(ctx->lo,
                                 XPOST_MEMORY_TABLE_SPECIAL_SAVE_STACK, &vs);
-    if (xpost_object_get_type(lsav) == savetype)
+    if (xpost_object_get_type(ctx->jobsave) == savetype)
     {
         for ( llev = xpost_stack_count(ctx->lo, vs);
-                llev > lsav.save_.lev;
+                llev > ctx->jobsave.save_.lev;
                 llev-- )
         {
             xpost_save_restore_snapshot(ctx->lo);
         }
     }
 
+    ctx->jobsave = null;
+    ctx->running = 0;
     return noerror;
 }
 
+static
+int _xpost_run(Xpost_Context *ctx,
+               Xpost_Input_Type input_type,
+               const void *inputptr,
+               size_t len,
+               int copy)
+{
+    int ret;
+
+    /* resuming a returned session skips startup */
+    if (input_type != XPOST_INPUT_RESUME)
+    {
+        ret = _xpost_run_start(ctx, input_type, inputptr, len, copy);
+        if (ret)
+            return ret;
+    }
+    return _xpost_run_resume(ctx);
+}
+
+XPAPI int xpost_run(Xpost_Context *ctx, Xpost_Input_Type input_type, const void *inputptr)
+{
+    /* the string is copied, it need not outlive a returned session */
+    if (input_type == XPOST_INPUT_STRING)
+        return _xpost_run(ctx, input_type, inputptr, strlen(inputptr), 1);
+    return _xpost_run(ctx, input_type, inputptr, 0, 0);
+}
+
+XPAPI int xpost_run_buffer(Xpost_Context *ctx, const void *buf, size_t len)
+{
+    return _xpost_run(ctx, XPOST_INPUT_STRING, buf, len, 0);
+}
+
+XPAPI int xpost_start(Xpost_Context *ctx, Xpost_Input_Type input_type, const void *inputptr)
+{
+    if (input_type == XPOST_INPUT_STRING)
+        return _xpost_run_start(ctx, input_type, inputptr, strlen(inputptr), 1);
+    return _xpost_run_start(ctx, input_type, inputptr, 0, 0);
+}
+
+/*
+   run the started job for at most max_ops evals and max_us microseconds.
+ */
+XPAPI Xpost_Step_Status xpost_step(Xpost_Context *ctx, long max_ops, long max_us)
+{
+    int ret;
+
+    if (!ctx->running)
+    {
+        XPOST_LOG_ERR("no job started to step");
+        return XPOST_STEP_ERROR;
+    }
+    ctx->step_ops = (max_ops > 0) ? max_ops : -1;
+    ctx->step_end = (max_us > 0) ? _xpost_interpreter_now() + (double)max_us : 0;
+    ret = _xpost_run_resume(ctx);
+    ctx->step_ops = -1;
+    ctx->step_end = 0;
+
+    switch (ret)
+    {
+        case contextswitch:
+            return XPOST_STEP_RUNNING;
+        case yieldtocaller:
+            return XPOST_STEP_PAGE;
+        case XPOST_RUN_IOBLOCK:
+            return XPOST_STEP_INPUT;
+        case noerror:
+            return XPOST_STEP_DONE;
+        default:
+            return XPOST_STEP_ERROR;
+    }
+}
+
+/*
+   freeze local (and global) vm into copy-on-write mappings
+   and remember the context state to go with it.
+ */
+XPAPI int xpost_freeze(Xpost_Context *ctx, int global)
+{
+    Xpost_Context *snapshot;
+
+    snapshot = malloc(sizeof *snapshot);
+    if (!snapshot)
+    {
+        XPOST_LOG_ERR("cannot allocate context snapshot");
+        return 0;
+    }
+    if (!xpost_memory_file_freeze(ctx->lo) ||
+        (global && !xpost_memory_file_freeze(ctx->gl)))
+    {
+        XPOST_LOG_ERR("cannot freeze context memory");
+        free(snapshot);
+        return 0;
+    }
+    free(ctx->snapshot);
+    ctx->snapshot = snapshot;
+    *snapshot = *ctx;
+    return 1;
+}
+
+/*
+   drop everything done since xpost_freeze.
+ */
+XPAPI int xpost_reset(Xpost_Context *ctx)
+{
+    if (!ctx->snapshot)
+    {
+        XPOST_LOG_ERR("context is not frozen");
+        return 0;
+    }
+    if (!xpost_memory_file_reset(ctx->lo))
+        return 0;
+    if (ctx->gl->frozen && !xpost_memory_file_reset(ctx->gl))
+        return 0;
+    *ctx = *ctx->snapshot;
+
+    /* the frozen vm of a clone lists the context it was cloned from */
+    if (ctx->origin)
+    {
+        xpost_context_replace_ctxlist(ctx->lo, ctx->origin, ctx->id);
+        xpost_context_replace_ctxlist(ctx->gl, ctx->origin, ctx->id);
+    }
+    return 1;
+}
+
+/*
+   make a new context from the frozen state of ctx.
+ */
+XPAPI Xpost_Context *xpost_clone(Xpost_Context *ctx)
+{
+    unsigned int cid;
+
+    if (!ctx->snapshot)
+    {
+        XPOST_LOG_ERR("context is not frozen");
+        return NULL;
+    }
+    if (!ctx->gl->frozen)
+    {
+        XPOST_LOG_ERR("global vm is not frozen");
+        return NULL;
+    }
+    xpost_lock(&_xpost_interpreter_mtab_lock);
+    cid = xpost_context_clone(ctx,
+                              xpost_interpreter_cid_init,
+                              xpost_interpreter_cid_get_context,
+                              xpost_interpreter_alloc_local_memory,
+                              xpost_interpreter_alloc_global_memory);
+    xpost_unlock(&_xpost_interpreter_mtab_lock);
+    if (!cid)
+    {
+        XPOST_LOG_ERR("cannot clone context");
+        return NULL;
+    }
+    return xpost_interpreter_cid_get_context(cid);
+}
+
 /*
    destroy the given context and associated memory files (if not in use by a shared context)
-   exit interpreter if all contexts are destroyed.
+   and give back its entries of the tables.
  */
 XPAPI void xpost_destroy(Xpost_Context *ctx)
 {
+    /* a clone owns its memory files */
+    if (ctx->origin)
+    {
+        xpost_lock(&_xpost_interpreter_mtab_lock);
+        xpost_context_exit(ctx);
+        xpost_unlock(&_xpost_interpreter_mtab_lock);
+        xpost_interpreter_cid_release(ctx->id);
+        return;
+    }
 
     if (!xpost_dict_known_key(ctx, ctx->gl, xpost_stack_bottomup_fetch(ctx->lo, ctx->ds, 0), xpost_name_cons(ctx, "QUIET")))
     {
@@ -1409,7 +2036,6 @@ XPAPI void xpost_destroy(Xpost_Context *ctx)
 #endif
 #endif
 
-    /* exit if all contexts are destroyed */
-    //xpost_interpreter_exit(itpdata);
-    //free(itpdata);
+    /* the contexts forked by its jobs have ended with them */
+    xpost_interpreter_exit(ctx);
 }
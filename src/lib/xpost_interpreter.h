@@ -38,8 +38,9 @@
  *
  * The interpreter module manages the itpdata structure, allocating
  * contexts from a table, and allocating memory files to the contexts
- * also from tables. The itpdata structure thus encapsulates the entire
- * dynamic state of the interpreter as a whole.
+ * also from tables. The tables are shared by all the interpreters made
+ * by xpost_create(), each entry being taken and given back under a lock;
+ * the rest of the state of an interpreter is in its contexts.
  *
  * The interpreter module also contains functions for eval actions,
  * the core interpreter loop,
@@ -47,26 +48,44 @@
  * @{
  */
 
-/*# define MAXCONTEXT 10 // moved to xpost_context.h. <- must include first!
- */
 #define MAXMFILE 10
 
+/**
+ * @brief number of contexts in a segment of the context table
+ */
+#define CTABSEGSIZE 64
+
+/**
+ * @brief maximum number of segments of the context table
+ */
+#define MAXCTABSEG 1024
+
+/**
+ * @brief a segment of the context table
+ *
+ * Segments are allocated as the table grows and are not moved
+ * or freed before xpost_quit(), so the address of a context
+ * does not change while other threads look up theirs.
+ */
+typedef struct
+{
+    Xpost_Context ctx[CTABSEGSIZE];
+    unsigned int next_free[CTABSEGSIZE]; /* links of the list of released cids */
+} Xpost_Context_Segment;
+
 typedef struct
 {
-    Xpost_Context ctab[MAXCONTEXT];
-    unsigned int cid;
+    Xpost_Context_Segment *ctab[MAXCTABSEG]; /* cid - 1 splits into segment and index */
+    unsigned int cid_top; /* highest cid handed out, under the ctab lock */
+    unsigned int cid_free_head; /* oldest released cid, 0 if none, under the ctab lock */
+    unsigned int cid_free_tail; /* last released cid */
     Xpost_Memory_File gtab[MAXMFILE];
     Xpost_Memory_File ltab[MAXMFILE];
-    int in_onerror;
 } Xpost_Interpreter;
 
 
 extern Xpost_Interpreter *itpdata;
 
-/* garbage collection does not run during initializing */
-int xpost_interpreter_get_initializing(void);
-void xpost_interpreter_set_initializing(int i);
-
 Xpost_Context *xpost_interpreter_cid_get_context(unsigned int cid);
 
 /**
@@ -77,10 +96,13 @@ Xpost_Context *xpost_interpreter_cid_get_context(unsigned int cid);
  */
 int idleproc(Xpost_Context *ctx);
 
-extern int _xpost_interpreter_is_tracing;
+Xpost_Context *xpost_interpreter_init(const char *device);
 
-int xpost_interpreter_init(Xpost_Interpreter *itp, const char *device);
-void xpost_interpreter_exit(Xpost_Interpreter *itp);
+/**
+ * @brief free the segments of the context table, when no context is left
+ */
+void xpost_interpreter_quit(void);
+void xpost_interpreter_exit(Xpost_Context *ctx);
 
 /**
  * @}
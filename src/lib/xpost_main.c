@@ -59,6 +59,9 @@
 #include "xpost_compat.h"
 #include "xpost_object.h"
 #include "xpost_memory.h"
+#include "xpost_context.h"
+#include "xpost_dict.h" /* access of dicts, set in the object module */
+#include "xpost_interpreter.h" /* frees the context table */
 #include "xpost_font.h"
 #include "xpost_main.h"
 #include "xpost_private.h"
@@ -122,6 +125,11 @@ xpost_init(void)
     if (!xpost_font_init())
         return --_xpost_init_count;
 
+    /* shared by all the interpreters */
+    xpost_object_install_dict_get_access(xpost_dict_get_access);
+    xpost_object_install_dict_set_access(xpost_dict_set_access);
+    null = xpost_object_cvlit(null);
+
 #ifdef _WIN32
     if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0)
         return --_xpost_init_count;
@@ -153,6 +161,7 @@ xpost_quit(void)
     WSACleanup();
 #endif
 
+    xpost_interpreter_quit();
     xpost_font_quit();
     xpost_log_quit();
 
@@ -113,9 +113,7 @@ XPCHECKAPI int
 xpost_memory_file_init(Xpost_Memory_File *mem,
                        const char *fname,
                        int fd,
-                       struct _Xpost_Context *(*xpost_interpreter_cid_get_context)(unsigned int cid),
-                       int (*xpost_interpreter_get_initializing)(void),
-                       void (*xpost_interpreter_set_initializing)(int))
+                       struct _Xpost_Context *(*xpost_interpreter_cid_get_context)(unsigned int cid))
 {
     struct stat buf;
     size_t sz = xpost_memory_page_size;
@@ -133,8 +131,7 @@ xpost_memory_file_init(Xpost_Memory_File *mem,
                    fname ? " for " : "", fname ? fname : "");
 
     mem->interpreter_cid_get_context = xpost_interpreter_cid_get_context;
-    mem->interpreter_get_initializing = xpost_interpreter_get_initializing;
-    mem->interpreter_set_initializing = xpost_interpreter_set_initializing;
+    mem->initializing = 1;
 
     if(fname)
     {
@@ -227,6 +224,7 @@ xpost_memory_file_init(Xpost_Memory_File *mem,
 #endif
     if (fd == -1)
         memset(mem->base, 0, mem->max);
+    mem->in_use = 1;
 
     return 1;
 }
@@ -242,6 +240,7 @@ xpost_memory_file_exit(Xpost_Memory_File *mem)
         XPOST_LOG_ERR("%d mem pointer is NULL", VMerror);
         return 0;
     }
+    mem->in_use = 0;
 
     if (mem->base == NULL)
     {
@@ -268,6 +267,22 @@ xpost_memory_file_exit(Xpost_Memory_File *mem)
     mem->used = 0;
     mem->max = 0;
 
+    xpost_memory_table_exit(mem);
+    free(mem->frozen_table.adr);
+    free(mem->frozen_table.used);
+    free(mem->frozen_table.sz);
+    free(mem->frozen_table.lev);
+    free(mem->frozen_table.tag);
+    free(mem->frozen_table.cow);
+    free(mem->frozen_table.marks);
+    memset(&mem->frozen_table, 0, sizeof mem->frozen_table);
+    mem->frozen = 0;
+    mem->image = 0;
+    free(mem->finalize_queue);
+    mem->finalize_queue = NULL;
+    mem->finalize_count = 0;
+    mem->finalize_max = 0;
+
     if (mem->fd != -1)
     {
         close(mem->fd);
@@ -284,6 +299,77 @@ xpost_memory_file_exit(Xpost_Memory_File *mem)
     return 1;
 }
 
+#if defined (HAVE_MMAP) && !defined (_WIN32)
+/* read or write exactly n bytes */
+static int
+_xpost_memory_io(int fd, void *buf, size_t n, int wr)
+{
+    unsigned char *p = buf;
+    ssize_t r;
+
+    while (n)
+    {
+        r = wr ? write(fd, p, n) : read(fd, p, n);
+        if (r <= 0)
+        {
+            if (r == -1 && errno == EINTR)
+                continue;
+            return 0;
+        }
+        p += r;
+        n -= r;
+    }
+    return 1;
+}
+
+/*
+   move a memory file mapped from an image onto its own file,
+   resized to sz bytes. the image is copied once, here.
+ */
+static int
+_xpost_memory_file_detach_image(Xpost_Memory_File *mem,
+                                size_t sz)
+{
+    void *tmp;
+
+    if (mem->fd != -1)
+    {
+        if (ftruncate(mem->fd, sz) == -1 ||
+            lseek(mem->fd, 0, SEEK_SET) == -1 ||
+            !_xpost_memory_io(mem->fd, mem->base, mem->max, 1))
+        {
+            XPOST_LOG_ERR("%d unable to write memory file (error: %s)",
+                          VMerror, strerror(errno));
+            return 0;
+        }
+        tmp = mmap(NULL, sz,
+                   PROT_READ | PROT_WRITE,
+                   MAP_SHARED,
+                   mem->fd, 0);
+    }
+    else
+    {
+        tmp = mmap(NULL, sz,
+                   PROT_READ | PROT_WRITE,
+                   MAP_ANONYMOUS | MAP_PRIVATE,
+                   -1, 0);
+        if (tmp != MAP_FAILED)
+            memcpy(tmp, mem->base, mem->max);
+    }
+    if (tmp == MAP_FAILED)
+    {
+        XPOST_LOG_ERR("%d unable to map memory file (error: %s)",
+                      VMerror, strerror(errno));
+        return 0;
+    }
+    munmap((void *)mem->base, mem->max);
+    mem->base = (unsigned char *)tmp;
+    mem->max = sz;
+    mem->image = 0;
+    return 1;
+}
+#endif
+
 /* grow memory file by sz bytes, rounded up to the nearest system page size.
    return 1 on success, 0 on failure.
  */
@@ -320,6 +406,37 @@ xpost_memory_file_grow(Xpost_Memory_File *mem,
                    mem->fname ? " for " : "", mem->fname ? mem->fname : "",
                    mem->max, sz);
 
+#if defined (HAVE_MMAP) && !defined (_WIN32)
+    if (mem->image)
+    {
+        if (!_xpost_memory_file_detach_image(mem, sz))
+        {
+            XPOST_LOG_ERR("%d unable to grow memory", VMerror);
+            return 0;
+        }
+        return 1;
+    }
+    if (mem->frozen)
+    {
+        /* the frozen file may be shared by clones: leave it as it is
+           and continue on an anonymous copy */
+        tmp = mmap(NULL, sz,
+                   PROT_READ | PROT_WRITE,
+                   MAP_ANONYMOUS | MAP_PRIVATE,
+                   -1, 0);
+        if (tmp == MAP_FAILED)
+        {
+            XPOST_LOG_ERR("%d unable to grow memory", VMerror);
+            return 0;
+        }
+        memcpy(tmp, mem->base, mem->used);
+        munmap((void *)mem->base, mem->max);
+        mem->base = (unsigned char *)tmp;
+        mem->max = sz;
+        return 1;
+    }
+#endif
+
 #ifdef _WIN32
     if (mem->fd != -1)
     {
@@ -375,7 +492,7 @@ xpost_memory_file_grow(Xpost_Memory_File *mem,
 # ifdef HAVE_MREMAP
     tmp = mremap(mem->base, mem->max, sz, MREMAP_MAYMOVE);
 # else
-    if (mem->fd != -1)
+    if (mem->fd != -1 && !mem->frozen)
     {
         msync((void *)mem->base, mem->used, MS_SYNC);
         munmap((void *)mem->base, mem->max);
@@ -523,22 +640,461 @@ xpost_memory_file_dump(const Xpost_Memory_File *mem)
 }
 
 
+/*
+ * (re)allocate the parallel arrays of the memory table to hold max entries.
+ * on failure, the previous arrays are left intact.
+ */
+static int
+_xpost_memory_table_resize(Xpost_Memory_Table *tab,
+                           unsigned int max)
+{
+    unsigned int **fields[6];
+    unsigned int i;
+    void *tmp;
+
+    fields[0] = &tab->adr;
+    fields[1] = &tab->used;
+    fields[2] = &tab->sz;
+    fields[3] = &tab->lev;
+    fields[4] = &tab->tag;
+    fields[5] = &tab->cow;
+    for (i = 0; i < sizeof fields / sizeof *fields; i++)
+    {
+        tmp = realloc(*fields[i], max * sizeof(unsigned int));
+        if (!tmp)
+            return 0;
+        *fields[i] = tmp;
+    }
+
+    tmp = realloc(tab->marks, XPOST_MEMORY_TABLE_MARK_WORDS(max) * sizeof(unsigned int));
+    if (!tmp)
+        return 0;
+    tab->marks = tmp;
+    memset(tab->marks + XPOST_MEMORY_TABLE_MARK_WORDS(tab->max), 0,
+           (XPOST_MEMORY_TABLE_MARK_WORDS(max) - XPOST_MEMORY_TABLE_MARK_WORDS(tab->max))
+           * sizeof(unsigned int));
+
+    tab->max = max;
+    return 1;
+}
+
 /*
  * allocate and initialize a memory table data structure
  */
 XPCHECKAPI int
 xpost_memory_table_init(Xpost_Memory_File *mem)
 {
-    mem->table.tab = malloc( (mem->table.max = 1000) * sizeof(*mem->table.tab));
-    if (!mem->table.tab)
+    memset(&mem->table, 0, sizeof mem->table);
+    if (!_xpost_memory_table_resize(&mem->table, 1000))
     {
         XPOST_LOG_ERR("%d unable to initialize memory table", VMerror);
+        xpost_memory_table_exit(mem);
         return 0;
     }
     mem->table.nextent = 0;
     return 1;
 }
 
+/*
+ * deallocate the memory table data structure
+ */
+XPCHECKAPI void
+xpost_memory_table_exit(Xpost_Memory_File *mem)
+{
+    free(mem->table.adr);
+    free(mem->table.used);
+    free(mem->table.sz);
+    free(mem->table.lev);
+    free(mem->table.tag);
+    free(mem->table.cow);
+    free(mem->table.marks);
+    memset(&mem->table, 0, sizeof mem->table);
+}
+
+
+#if defined (HAVE_MMAP) && !defined (_WIN32)
+/* copy the first max entries of table src into dst */
+static void
+_xpost_memory_table_copy(Xpost_Memory_Table *dst,
+                         const Xpost_Memory_Table *src,
+                         unsigned int max)
+{
+    dst->nextent = src->nextent;
+    memcpy(dst->adr, src->adr, max * sizeof(unsigned int));
+    memcpy(dst->used, src->used, max * sizeof(unsigned int));
+    memcpy(dst->sz, src->sz, max * sizeof(unsigned int));
+    memcpy(dst->lev, src->lev, max * sizeof(unsigned int));
+    memcpy(dst->tag, src->tag, max * sizeof(unsigned int));
+    memcpy(dst->cow, src->cow, max * sizeof(unsigned int));
+}
+#endif
+
+/*
+   write memory file to its fd and continue on a private
+   copy-on-write mapping of it.
+ */
+XPCHECKAPI int
+xpost_memory_file_freeze(Xpost_Memory_File *mem)
+{
+#if defined (HAVE_MMAP) && !defined (_WIN32)
+    void *tmp;
+
+    if (!mem || mem->base == NULL || mem->fd == -1)
+    {
+        XPOST_LOG_ERR("%d memory file has no file to freeze to", VMerror);
+        return 0;
+    }
+    if (mem->frozen)
+        return 1;
+    if (mem->image && !_xpost_memory_file_detach_image(mem, mem->max))
+        return 0;
+
+    if (msync((void *)mem->base, mem->max, MS_SYNC) == -1)
+    {
+        XPOST_LOG_ERR("%d unable to write memory file (error: %s)",
+                      VMerror, strerror(errno));
+        return 0;
+    }
+    tmp = mmap(NULL, mem->max,
+               PROT_READ | PROT_WRITE,
+               MAP_PRIVATE,
+               mem->fd, 0);
+    if (tmp == MAP_FAILED)
+    {
+        XPOST_LOG_ERR("%d unable to map frozen memory file (error: %s)",
+                      VMerror, strerror(errno));
+        return 0;
+    }
+    munmap((void *)mem->base, mem->max);
+    mem->base = (unsigned char *)tmp;
+
+    memset(&mem->frozen_table, 0, sizeof mem->frozen_table);
+    if (!_xpost_memory_table_resize(&mem->frozen_table, mem->table.max))
+    {
+        XPOST_LOG_ERR("%d unable to copy memory table", VMerror);
+        return 0;
+    }
+    _xpost_memory_table_copy(&mem->frozen_table, &mem->table, mem->table.max);
+
+    mem->frozen_used = mem->used;
+    mem->frozen_max = mem->max;
+    mem->frozen = 1;
+    return 1;
+#else
+    (void)mem;
+    XPOST_LOG_ERR("%d freezing memory files needs mmap", VMerror);
+    return 0;
+#endif
+}
+
+/*
+   drop the private mapping and map the frozen image again.
+ */
+XPCHECKAPI int
+xpost_memory_file_reset(Xpost_Memory_File *mem)
+{
+#if defined (HAVE_MMAP) && !defined (_WIN32)
+    Xpost_Memory_Table *tab;
+    Xpost_Memory_Table *fro;
+    unsigned int i;
+    void *tmp;
+
+    if (!mem || !mem->frozen)
+    {
+        XPOST_LOG_ERR("%d memory file is not frozen", VMerror);
+        return 0;
+    }
+
+    /* release external resources acquired since freezing */
+    tab = &mem->table;
+    fro = &mem->frozen_table;
+    for (i = mem->start; i < tab->nextent; i++)
+    {
+        if (tab->tag[i] < XPOST_MEMORY_FINALIZE_TAGS &&
+            mem->finalize[tab->tag[i]] &&
+            tab->sz[i] != 0 &&
+            (i >= fro->nextent ||
+             tab->adr[i] != fro->adr[i] ||
+             tab->tag[i] != fro->tag[i]))
+        {
+            (void)mem->finalize[tab->tag[i]](mem, i);
+        }
+    }
+    mem->finalize_count = 0;
+
+    munmap((void *)mem->base, mem->max);
+    tmp = mmap(NULL, mem->frozen_max,
+               PROT_READ | PROT_WRITE,
+               MAP_PRIVATE,
+               mem->fd, 0);
+    if (tmp == MAP_FAILED)
+    {
+        XPOST_LOG_ERR("%d unable to map frozen memory file (error: %s)",
+                      VMerror, strerror(errno));
+        mem->base = NULL;
+        return 0;
+    }
+    mem->base = (unsigned char *)tmp;
+    mem->used = mem->frozen_used;
+    mem->max = mem->frozen_max;
+
+    if (tab->max < fro->max &&
+        !_xpost_memory_table_resize(tab, fro->max))
+    {
+        XPOST_LOG_ERR("%d unable to restore memory table", VMerror);
+        return 0;
+    }
+    _xpost_memory_table_copy(tab, fro, fro->max);
+
+    return 1;
+#else
+    (void)mem;
+    XPOST_LOG_ERR("%d freezing memory files needs mmap", VMerror);
+    return 0;
+#endif
+}
+
+/*
+   initialize mem as a copy of the frozen image of src,
+   on a private mapping of the same file.
+ */
+XPCHECKAPI int
+xpost_memory_file_clone(Xpost_Memory_File *mem,
+                        const Xpost_Memory_File *src)
+{
+#if defined (HAVE_MMAP) && !defined (_WIN32)
+    void *tmp;
+    int fd;
+
+    if (!mem || !src || !src->frozen)
+    {
+        XPOST_LOG_ERR("%d memory file is not frozen", VMerror);
+        return 0;
+    }
+
+    fd = dup(src->fd);
+    if (fd == -1)
+    {
+        XPOST_LOG_ERR("%d unable to share frozen memory file (error: %s)",
+                      VMerror, strerror(errno));
+        return 0;
+    }
+    tmp = mmap(NULL, src->frozen_max,
+               PROT_READ | PROT_WRITE,
+               MAP_PRIVATE,
+               fd, 0);
+    if (tmp == MAP_FAILED)
+    {
+        XPOST_LOG_ERR("%d unable to map frozen memory file (error: %s)",
+                      VMerror, strerror(errno));
+        close(fd);
+        return 0;
+    }
+
+    /* the installed functions and collector settings are shared */
+    *mem = *src;
+    mem->fd = fd;
+    mem->fname[0] = '\0'; /* the file is removed with src */
+    mem->base = (unsigned char *)tmp;
+    mem->used = src->frozen_used;
+    mem->max = src->frozen_max;
+    mem->image = 0;
+    mem->finalize_queue = NULL;
+    mem->finalize_count = 0;
+    mem->finalize_max = 0;
+
+    memset(&mem->table, 0, sizeof mem->table);
+    memset(&mem->frozen_table, 0, sizeof mem->frozen_table);
+    if (!_xpost_memory_table_resize(&mem->table, src->frozen_table.max) ||
+        !_xpost_memory_table_resize(&mem->frozen_table, src->frozen_table.max))
+    {
+        XPOST_LOG_ERR("%d unable to copy memory table", VMerror);
+        xpost_memory_file_exit(mem);
+        return 0;
+    }
+    _xpost_memory_table_copy(&mem->table, &src->frozen_table, src->frozen_table.max);
+    _xpost_memory_table_copy(&mem->frozen_table, &src->frozen_table, src->frozen_table.max);
+
+    return 1;
+#else
+    (void)mem;
+    (void)src;
+    XPOST_LOG_ERR("%d cloning memory files needs mmap", VMerror);
+    return 0;
+#endif
+}
+
+/*
+   append the used memory table and the contents to an image.
+   the contents start on a page boundary, to be mapped back.
+ */
+XPCHECKAPI int
+xpost_memory_file_save_image(Xpost_Memory_File *mem,
+                             int fd)
+{
+#if defined (HAVE_MMAP) && !defined (_WIN32)
+    unsigned int head[4];
+    unsigned int *fields[6];
+    unsigned int i;
+    off_t off;
+
+    if (!mem || mem->base == NULL)
+    {
+        XPOST_LOG_ERR("%d mem not initialized", VMerror);
+        return 0;
+    }
+
+    head[0] = mem->used;
+    head[1] = mem->max;
+    head[2] = mem->table.nextent;
+    head[3] = mem->table.max;
+    fields[0] = mem->table.adr;
+    fields[1] = mem->table.used;
+    fields[2] = mem->table.sz;
+    fields[3] = mem->table.lev;
+    fields[4] = mem->table.tag;
+    fields[5] = mem->table.cow;
+
+    if (!_xpost_memory_io(fd, head, sizeof head, 1))
+        goto write_error;
+    for (i = 0; i < sizeof fields / sizeof *fields; i++)
+    {
+        if (!_xpost_memory_io(fd, fields[i],
+                              mem->table.nextent * sizeof(unsigned int), 1))
+            goto write_error;
+    }
+
+    off = lseek(fd, 0, SEEK_CUR);
+    if (off == -1)
+        goto write_error;
+    off = (off + xpost_memory_page_size - 1)
+        / xpost_memory_page_size * xpost_memory_page_size;
+    if (lseek(fd, off, SEEK_SET) == -1 ||
+        !_xpost_memory_io(fd, mem->base, mem->max, 1))
+        goto write_error;
+
+    return 1;
+
+  write_error:
+    XPOST_LOG_ERR("%d unable to write memory image (error: %s)",
+                  VMerror, strerror(errno));
+    return 0;
+#else
+    (void)mem;
+    (void)fd;
+    XPOST_LOG_ERR("%d memory images need mmap", VMerror);
+    return 0;
+#endif
+}
+
+/*
+   read the memory table from an image and map the contents
+   copy-on-write in place of the current ones.
+ */
+XPCHECKAPI int
+xpost_memory_file_load_image(Xpost_Memory_File *mem,
+                             int fd)
+{
+#if defined (HAVE_MMAP) && !defined (_WIN32)
+    Xpost_Memory_Table tab;
+    unsigned int head[4];
+    unsigned int *fields[6];
+    unsigned int i;
+    off_t off;
+    void *tmp;
+
+    if (!mem || mem->base == NULL)
+    {
+        XPOST_LOG_ERR("%d mem not initialized", VMerror);
+        return 0;
+    }
+
+    if (!_xpost_memory_io(fd, head, sizeof head, 0))
+        goto read_error;
+    if (head[0] > head[1] ||
+        head[1] == 0 ||
+        head[1] % xpost_memory_page_size != 0 ||
+        head[2] > head[3])
+    {
+        XPOST_LOG_ERR("%d corrupt memory image", VMerror);
+        return 0;
+    }
+
+    memset(&tab, 0, sizeof tab);
+    if (!_xpost_memory_table_resize(&tab, head[3]))
+    {
+        XPOST_LOG_ERR("%d unable to allocate memory table", VMerror);
+        goto table_error;
+    }
+    tab.nextent = head[2];
+    fields[0] = tab.adr;
+    fields[1] = tab.used;
+    fields[2] = tab.sz;
+    fields[3] = tab.lev;
+    fields[4] = tab.tag;
+    fields[5] = tab.cow;
+    for (i = 0; i < sizeof fields / sizeof *fields; i++)
+    {
+        if (!_xpost_memory_io(fd, fields[i],
+                              tab.nextent * sizeof(unsigned int), 0))
+        {
+            XPOST_LOG_ERR("%d unable to read memory image (error: %s)",
+                          VMerror, strerror(errno));
+            goto table_error;
+        }
+    }
+
+    off = lseek(fd, 0, SEEK_CUR);
+    if (off == -1)
+    {
+        XPOST_LOG_ERR("%d unable to read memory image (error: %s)",
+                      VMerror, strerror(errno));
+        goto table_error;
+    }
+    off = (off + xpost_memory_page_size - 1)
+        / xpost_memory_page_size * xpost_memory_page_size;
+    tmp = mmap(NULL, head[1],
+               PROT_READ | PROT_WRITE,
+               MAP_PRIVATE,
+               fd, off);
+    if (tmp == MAP_FAILED)
+    {
+        XPOST_LOG_ERR("%d unable to map memory image (error: %s)",
+                      VMerror, strerror(errno));
+        goto table_error;
+    }
+    (void)lseek(fd, off + head[1], SEEK_SET);
+
+    munmap((void *)mem->base, mem->max);
+    mem->base = (unsigned char *)tmp;
+    mem->used = head[0];
+    mem->max = head[1];
+    xpost_memory_table_exit(mem);
+    mem->table = tab;
+    mem->image = 1;
+    return 1;
+
+  table_error:
+    free(tab.adr);
+    free(tab.used);
+    free(tab.sz);
+    free(tab.lev);
+    free(tab.tag);
+    free(tab.cow);
+    free(tab.marks);
+    return 0;
+
+  read_error:
+    XPOST_LOG_ERR("%d unable to read memory image (error: %s)",
+                  VMerror, strerror(errno));
+    return 0;
+#else
+    (void)mem;
+    (void)fd;
+    XPOST_LOG_ERR("%d memory images need mmap", VMerror);
+    return 0;
+#endif
+}
 
 /* install free-list function into memory file */
 int
@@ -565,6 +1121,22 @@ xpost_memory_register_garbage_collect_function(Xpost_Memory_File *mem,
     return 1;
 }
 
+/* install finalizer for a tag into memory file */
+XPCHECKAPI int
+xpost_memory_register_finalize_function(Xpost_Memory_File *mem,
+                                        unsigned int tag,
+                                        int (*finalize)(struct Xpost_Memory_File *mem,
+                                                        unsigned int ent))
+{
+    if (tag >= XPOST_MEMORY_FINALIZE_TAGS)
+    {
+        XPOST_LOG_ERR("cannot install finalizer for tag %u", tag);
+        return 0;
+    }
+    mem->finalize[tag] = finalize;
+    return 1;
+}
+
 /*
    allocate sz bytes as an 'ent' in the memory table
    */
@@ -597,20 +1169,19 @@ _xpost_memory_table_alloc_new(Xpost_Memory_File *mem,
         return 0;
     }
 
-    mem->table.tab[ent].adr = adr;
-    mem->table.tab[ent].sz = sz;
-    mem->table.tab[ent].tag = tag;
+    mem->table.adr[ent] = adr;
+    mem->table.sz[ent] = sz;
+    mem->table.lev[ent] = 0;
+    mem->table.tag[ent] = tag;
+    mem->table.cow[ent] = 0;
 
     if (mem->table.nextent == mem->table.max)
     {
-        void *tmp = realloc(mem->table.tab, (mem->table.max*=2) * sizeof(*mem->table.tab));
-        if (!tmp)
+        if (!_xpost_memory_table_resize(&mem->table, mem->table.max * 2))
         {
             XPOST_LOG_ERR("%d unable to grow memory table", VMerror);
-            mem->table.max/=2;
             return 0;
         }
-        mem->table.tab = tmp;
     }
 
     *entity = ent;
@@ -639,7 +1210,7 @@ xpost_memory_table_alloc(Xpost_Memory_File *mem,
         else if (ret == 2)
         {
             if (mem->garbage_collect_is_installed &&
-                    !mem->interpreter_get_initializing())
+                    !mem->initializing)
             {
                 int sz_reclaimed;
 
@@ -658,8 +1229,9 @@ xpost_memory_table_alloc(Xpost_Memory_File *mem,
         }
     }
     ret = _xpost_memory_table_alloc_new(mem, sz, tag, entity);
-    //XPOST_LOG_INFO("allocated %u(%u) bytes with tag %u as ent %u at %u in %s", sz, mem->table.tab[*entity].sz, tag, *entity, mem->table.tab[*entity].adr, mem->fname);
-    mem->table.tab[*entity].used = sz;
+    //XPOST_LOG_INFO("allocated %u(%u) bytes with tag %u as ent %u at %u in %s", sz, mem->table.sz[*entity], tag, *entity, mem->table.adr[*entity], mem->fname);
+    if (ret)
+        mem->table.used[*entity] = sz;
     return ret;
 }
 
@@ -682,7 +1254,7 @@ xpost_memory_table_get_addr(Xpost_Memory_File *mem,
         XPOST_LOG_ERR("%d entity not found %u", VMerror, ent);
         return 0;
     }
-    *retaddr = mem->table.tab[ent].adr;
+    *retaddr = mem->table.adr[ent];
     return 1;
 }
 
@@ -692,7 +1264,7 @@ int xpost_memory_table_set_addr(Xpost_Memory_File *mem,
                                 unsigned int setaddr)
 {
     CHECK_VALID_ENT(ent,mem,0)
-    mem->table.tab[ent].adr = setaddr;
+    mem->table.adr[ent] = setaddr;
     return 1;
 }
 
@@ -704,7 +1276,7 @@ xpost_memory_table_get_size(Xpost_Memory_File *mem,
                             unsigned int *sz)
 {
     CHECK_VALID_ENT(ent,mem,0)
-    *sz = mem->table.tab[ent].sz;
+    *sz = mem->table.sz[ent];
     return 1;
 }
 
@@ -715,30 +1287,30 @@ xpost_memory_table_set_size(Xpost_Memory_File *mem,
                             unsigned int size)
 {
     CHECK_VALID_ENT(ent,mem,0)
-    mem->table.tab[ent].sz = size;
+    mem->table.sz[ent] = size;
     return 1;
 }
 
-/* get the mark field of an allocation from the memory table */
-int
-xpost_memory_table_get_mark(Xpost_Memory_File *mem,
-                            unsigned int ent,
-                            unsigned int *retmark)
+/* get the save level field of an allocation from the memory table */
+XPCHECKAPI int
+xpost_memory_table_get_lev(Xpost_Memory_File *mem,
+                           unsigned int ent,
+                           unsigned int *retlev)
 {
     CHECK_VALID_ENT(ent,mem,0)
-    *retmark = mem->table.tab[ent].mark;
+    *retlev = mem->table.lev[ent];
     return 1;
 }
 
 
-/* change the mark field of an allocation in the memory table */
-int
-xpost_memory_table_set_mark(Xpost_Memory_File *mem,
-                            unsigned int ent,
-                            unsigned int setmark)
+/* change the save level field of an allocation in the memory table */
+XPCHECKAPI int
+xpost_memory_table_set_lev(Xpost_Memory_File *mem,
+                           unsigned int ent,
+                           unsigned int setlev)
 {
     CHECK_VALID_ENT(ent,mem,0)
-    mem->table.tab[ent].mark = setmark;
+    mem->table.lev[ent] = setlev;
     return 1;
 }
 
@@ -750,7 +1322,7 @@ xpost_memory_table_get_tag(Xpost_Memory_File *mem,
                            unsigned int *tag)
 {
     CHECK_VALID_ENT(ent,mem,0)
-    *tag = mem->table.tab[ent].tag;
+    *tag = mem->table.tag[ent];
     return 1;
 }
 
@@ -761,7 +1333,7 @@ xpost_memory_table_set_tag(Xpost_Memory_File *mem,
                            unsigned int tag)
 {
     CHECK_VALID_ENT(ent,mem,0)
-    mem->table.tab[ent].tag = tag;
+    mem->table.tag[ent] = tag;
     return 1;
 }
 
@@ -776,14 +1348,14 @@ xpost_memory_get(Xpost_Memory_File *mem,
 {
     CHECK_VALID_ENT(ent,mem,0)
 
-    if (offset * sz > mem->table.tab[ent].sz)
+    if (offset * sz > mem->table.sz[ent])
     {
         XPOST_LOG_ERR("%d out of bounds memory %u * %u > %u", rangecheck,
-                offset, sz, mem->table.tab[ent].sz);
+                offset, sz, mem->table.sz[ent]);
         return 0;
     }
 
-    memcpy(dest, mem->base + mem->table.tab[ent].adr + offset * sz, sz);
+    memcpy(dest, mem->base + mem->table.adr[ent] + offset * sz, sz);
     return 1;
 }
 
@@ -797,14 +1369,14 @@ xpost_memory_put(Xpost_Memory_File *mem,
 {
     CHECK_VALID_ENT(ent,mem,0)
 
-    if (offset * sz > mem->table.tab[ent].sz)
+    if (offset * sz > mem->table.sz[ent])
     {
         XPOST_LOG_ERR("%d out of bounds memory %u * %u > %u", rangecheck,
-                offset, sz, mem->table.tab[ent].sz);
+                offset, sz, mem->table.sz[ent]);
         return 0;
     }
 
-    memcpy(mem->base + mem->table.tab[ent].adr + offset * sz, src, sz);
+    memcpy(mem->base + mem->table.adr[ent] + offset * sz, src, sz);
     return 1;
 }
 
@@ -822,25 +1394,25 @@ xpost_memory_table_dump_ent(Xpost_Memory_File *mem,
             "sz [%u], "
             "mark %s rfct %d llev %d tlev %d\n",
             e, i,
-            mem->table.tab[i].adr, mem->table.tab[i].adr,
-            mem->table.tab[i].sz,
-            mem->table.tab[i].mark
-                & XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK ? "#" : "_",
-            (mem->table.tab[i].mark
-                & XPOST_MEMORY_TABLE_MARK_DATA_REFCOUNT_MASK)
-                >> XPOST_MEMORY_TABLE_MARK_DATA_REFCOUNT_OFFSET,
-            (mem->table.tab[i].mark
-                & XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_MASK)
-                >> XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_OFFSET,
-            (mem->table.tab[i].mark
-                & XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_MASK)
-                >> XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_OFFSET);
-        for (u = 0; u < mem->table.tab[i].sz; u++)
+            mem->table.adr[i], mem->table.adr[i],
+            mem->table.sz[i],
+            (mem->table.marks[i / XPOST_MEMORY_TABLE_MARK_BITS]
+                >> (i % XPOST_MEMORY_TABLE_MARK_BITS)) & 1 ? "#" : "_",
+            (mem->table.lev[i]
+                & XPOST_MEMORY_TABLE_LEVEL_DATA_REFCOUNT_MASK)
+                >> XPOST_MEMORY_TABLE_LEVEL_DATA_REFCOUNT_OFFSET,
+            (mem->table.lev[i]
+                & XPOST_MEMORY_TABLE_LEVEL_DATA_LOWLEVEL_MASK)
+                >> XPOST_MEMORY_TABLE_LEVEL_DATA_LOWLEVEL_OFFSET,
+            (mem->table.lev[i]
+                & XPOST_MEMORY_TABLE_LEVEL_DATA_TOPLEVEL_MASK)
+                >> XPOST_MEMORY_TABLE_LEVEL_DATA_TOPLEVEL_OFFSET);
+        for (u = 0; u < mem->table.sz[i]; u++)
         {
             XPOST_LOG_DUMP(" %02x%c",
-                    mem->base[ mem->table.tab[i].adr + u ],
-                    isprint(mem->base[ mem->table.tab[i].adr + u]) ?
-                        mem->base[ mem->table.tab[i].adr + u ] :
+                    mem->base[ mem->table.adr[i] + u ],
+                    isprint(mem->base[ mem->table.adr[i] + u]) ?
+                        mem->base[ mem->table.adr[i] + u ] :
                         ' ');
         }
 }
@@ -860,25 +1432,25 @@ xpost_memory_table_dump(const Xpost_Memory_File *mem)
                 "sz [%u], "
                 "mark %s rfct %d llev %d tlev %d\n",
                 e, i,
-                mem->table.tab[i].adr, mem->table.tab[i].adr,
-                mem->table.tab[i].sz,
-                mem->table.tab[i].mark
-                    & XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK ? "#" : "_",
-                (mem->table.tab[i].mark
-                    & XPOST_MEMORY_TABLE_MARK_DATA_REFCOUNT_MASK)
-                    >> XPOST_MEMORY_TABLE_MARK_DATA_REFCOUNT_OFFSET,
-                (mem->table.tab[i].mark
-                    & XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_MASK)
-                    >> XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_OFFSET,
-                (mem->table.tab[i].mark
-                    & XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_MASK)
-                    >> XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_OFFSET);
-        for (u = 0; u < mem->table.tab[i].sz; u++)
+                mem->table.adr[i], mem->table.adr[i],
+                mem->table.sz[i],
+                (mem->table.marks[i / XPOST_MEMORY_TABLE_MARK_BITS]
+                    >> (i % XPOST_MEMORY_TABLE_MARK_BITS)) & 1 ? "#" : "_",
+                (mem->table.lev[i]
+                    & XPOST_MEMORY_TABLE_LEVEL_DATA_REFCOUNT_MASK)
+                    >> XPOST_MEMORY_TABLE_LEVEL_DATA_REFCOUNT_OFFSET,
+                (mem->table.lev[i]
+                    & XPOST_MEMORY_TABLE_LEVEL_DATA_LOWLEVEL_MASK)
+                    >> XPOST_MEMORY_TABLE_LEVEL_DATA_LOWLEVEL_OFFSET,
+                (mem->table.lev[i]
+                    & XPOST_MEMORY_TABLE_LEVEL_DATA_TOPLEVEL_MASK)
+                    >> XPOST_MEMORY_TABLE_LEVEL_DATA_TOPLEVEL_OFFSET);
+        for (u = 0; u < mem->table.sz[i]; u++)
         {
             XPOST_LOG_DUMP(" %02x%c",
-                    mem->base[ mem->table.tab[i].adr + u ],
-                    isprint(mem->base[ mem->table.tab[i].adr + u]) ?
-                        mem->base[ mem->table.tab[i].adr + u ] :
+                    mem->base[ mem->table.adr[i] + u ],
+                    isprint(mem->base[ mem->table.adr[i] + u]) ?
+                        mem->base[ mem->table.adr[i] + u ] :
                         ' ');
         }
         XPOST_LOG_DUMP("\n");
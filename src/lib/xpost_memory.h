@@ -64,6 +64,20 @@
  */
 #define XPOST_MEMORY_TABLE_SIZE 2000
 
+/**
+ * @def XPOST_MEMORY_TABLE_MARK_BITS
+ * @brief Number of entries covered by one word of the
+ * #Xpost_Memory_Table mark bitmap.
+ */
+#define XPOST_MEMORY_TABLE_MARK_BITS (8 * sizeof(unsigned int))
+
+/**
+ * @def XPOST_MEMORY_TABLE_MARK_WORDS
+ * @brief Number of words of mark bitmap needed to cover @p n entries.
+ */
+#define XPOST_MEMORY_TABLE_MARK_WORDS(n) \
+    (((n) + XPOST_MEMORY_TABLE_MARK_BITS - 1) / XPOST_MEMORY_TABLE_MARK_BITS)
+
 
 /*
  *
@@ -72,24 +86,23 @@
  */
 
 /**
- * @typedef Xpost_Memory_Table_Mark_Data
+ * @typedef Xpost_Memory_Table_Level_Data
  *
- * There are 4 "virtual" bitfields packed in what is assumed to be a
+ * There are 3 "virtual" bitfields packed in what is assumed to be a
  * 32-bit unsigned field. These values are used in masking and
  * shifting operations to access the fields in a direct, portable
- * manner.
+ * manner. The garbage collection mark is not stored here, but in
+ * the separate mark bitmap of the #Xpost_Memory_Table.
  */
 typedef enum
 {
-    XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK       = 0x7F000000,
-    XPOST_MEMORY_TABLE_MARK_DATA_MARK_OFFSET     =     24,
-    XPOST_MEMORY_TABLE_MARK_DATA_REFCOUNT_MASK   = 0x00FF0000,
-    XPOST_MEMORY_TABLE_MARK_DATA_REFCOUNT_OFFSET =       16,
-    XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_MASK   = 0x0000FF00,
-    XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_OFFSET =         8,
-    XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_MASK   = 0x000000FF,
-    XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_OFFSET =           0
-} Xpost_Memory_Table_Mark_Data;
+    XPOST_MEMORY_TABLE_LEVEL_DATA_REFCOUNT_MASK   = 0x00FF0000,
+    XPOST_MEMORY_TABLE_LEVEL_DATA_REFCOUNT_OFFSET =       16,
+    XPOST_MEMORY_TABLE_LEVEL_DATA_LOWLEVEL_MASK   = 0x0000FF00,
+    XPOST_MEMORY_TABLE_LEVEL_DATA_LOWLEVEL_OFFSET =         8,
+    XPOST_MEMORY_TABLE_LEVEL_DATA_TOPLEVEL_MASK   = 0x000000FF,
+    XPOST_MEMORY_TABLE_LEVEL_DATA_TOPLEVEL_OFFSET =           0
+} Xpost_Memory_Table_Level_Data;
 
 /**
  * @typedef Xpost_Memory_Table_Special
@@ -116,22 +129,32 @@ typedef enum
 
 /**
  * @struct Xpost_Memory_Table
- * @brief The segmented Memory Table structure.
+ * @brief The Memory Table structure.
+ *
+ * The table is stored as parallel arrays indexed by entity number,
+ * so that each operation only touches the fields it needs: address
+ * lookup reads only @c adr, and the garbage collector scans the dense
+ * @c marks bitmap, one bit per entry.
  */
 typedef struct Xpost_Memory_Table
 {
     unsigned int nextent; /**< next slot in table */
     unsigned int max; /**< allocated size */
-    struct
-    {
-        unsigned int adr; /**< allocation address */
-        unsigned int used; /**< size in use */
-        unsigned int sz; /**< size of allocation */
-        unsigned int mark; /**< garbage collection metadata */
-        unsigned int tag; /**< type of object using this allocation, if needed */
-    } *tab; /**< table entries */
+    unsigned int *adr; /**< allocation addresses */
+    unsigned int *used; /**< sizes in use */
+    unsigned int *sz; /**< sizes of allocations */
+    unsigned int *lev; /**< save level data, see #Xpost_Memory_Table_Level_Data */
+    unsigned int *tag; /**< types of objects using the allocations, if needed */
+    unsigned int *cow; /**< chunk map of an array saved at its TOPLEVEL, see xpost_save.h */
+    unsigned int *marks; /**< garbage collection mark bitmap */
 } Xpost_Memory_Table;
 
+/**
+ * @def XPOST_MEMORY_FINALIZE_TAGS
+ * @brief Number of allocation tags which may have a finalizer installed.
+ */
+#define XPOST_MEMORY_FINALIZE_TAGS 32
+
 /**
  * @struct Xpost_Memory_File
  * @brief A memory region that may be suballocated. Bookkeeping data
@@ -149,6 +172,8 @@ typedef struct Xpost_Memory_File
     unsigned char *base; /**< pointer to mapped memory */
     unsigned int used;  /**< size used, cursor to free space */
     unsigned int max; /**< size available in memory pointed to by base */
+    int in_use; /**< set from a successful init to the exit, unlike base
+                     it does not change while the file grows */
 
     struct Xpost_Memory_Table table;
 
@@ -169,8 +194,21 @@ typedef struct Xpost_Memory_File
                            int markall);
     int interpreter_cid_get_context_is_installed;
     struct _Xpost_Context *(*interpreter_cid_get_context)(unsigned int cid);
-    int (*interpreter_get_initializing)(void);
-    void (*interpreter_set_initializing)(int);
+    int initializing; /**< garbage collection does not run while the vm is initialized */
+
+    int (*finalize[XPOST_MEMORY_FINALIZE_TAGS])(struct Xpost_Memory_File *mem,
+                                                unsigned int ent);
+        /**< per-tag functions releasing the external resources of an ent */
+    unsigned int *finalize_queue; /**< unreachable ents awaiting finalization */
+    unsigned int finalize_count; /**< number of ents in the queue */
+    unsigned int finalize_max; /**< allocated size of the queue */
+
+    int frozen; /**< base is a private copy-on-write mapping of the image in fd */
+    unsigned int frozen_used; /**< used when the image was frozen */
+    unsigned int frozen_max; /**< max when the image was frozen */
+    struct Xpost_Memory_Table frozen_table; /**< the table when the image was frozen */
+
+    int image; /**< base is a private mapping of a quick-launch image, not of fd */
 } Xpost_Memory_File;
 
 /*
@@ -220,9 +258,7 @@ int xpost_memory_init(void);
 XPCHECKAPI int xpost_memory_file_init(Xpost_Memory_File *mem,
                                       const char *fname,
                                       int fd,
-                                      struct _Xpost_Context *(*xpost_interpreter_cid_get_context)(unsigned int cid),
-                                      int (*xpost_interpreter_get_initializing)(void),
-                                      void (*xpost_interpreter_set_initializing)(int));
+                                      struct _Xpost_Context *(*xpost_interpreter_cid_get_context)(unsigned int cid));
 
 
 /**
@@ -249,6 +285,81 @@ XPCHECKAPI int xpost_memory_file_exit(Xpost_Memory_File *mem);
 XPCHECKAPI int xpost_memory_file_grow(Xpost_Memory_File *mem,
                                       size_t sz);
 
+/**
+ * @brief Freeze the contents of the given memory file.
+ *
+ * @param[in,out] mem The memory file.
+ * @return 1 on success, 0 on failure.
+ *
+ * This function writes the contents of @p mem to its file and
+ * replaces the shared mapping by a private copy-on-write mapping of
+ * that file, keeping a copy of the memory table. Later changes are
+ * discarded by xpost_memory_file_reset(). @p mem must be backed by a
+ * file descriptor, and the platform must provide mmap().
+ */
+XPCHECKAPI int xpost_memory_file_freeze(Xpost_Memory_File *mem);
+
+/**
+ * @brief Revert the given memory file to its frozen contents.
+ *
+ * @param[in,out] mem The memory file.
+ * @return 1 on success, 0 on failure.
+ *
+ * This function drops the private mapping of @p mem, with every
+ * change made since xpost_memory_file_freeze(), and maps the frozen
+ * image again. Entities created since then which have a finalizer
+ * are finalized first. The cost does not depend on the amount of
+ * changes in the memory file.
+ * MUST recalculate all VM pointers after this function.
+ */
+XPCHECKAPI int xpost_memory_file_reset(Xpost_Memory_File *mem);
+
+/**
+ * @brief Initialize a memory file as a copy of a frozen one.
+ *
+ * @param[out] mem The memory file to initialize.
+ * @param[in] src The frozen memory file.
+ * @return 1 on success, 0 on failure.
+ *
+ * This function maps the frozen image of @p src privately into
+ * @p mem, so the copy costs no more than freezing: pages are only
+ * copied when one of the memory files writes to them. @p mem is
+ * itself frozen to that image, and xpost_memory_file_reset()
+ * reverts it to the state of @p src when it was frozen.
+ */
+XPCHECKAPI int xpost_memory_file_clone(Xpost_Memory_File *mem,
+                                       const Xpost_Memory_File *src);
+
+/**
+ * @brief Append the given memory file to an image file.
+ *
+ * @param[in] mem The memory file.
+ * @param[in] fd The file descriptor of the image, positioned at the end.
+ * @return 1 on success, 0 on failure.
+ *
+ * This function writes the used part of the memory table of @p mem,
+ * then its contents starting at a page boundary, so that
+ * xpost_memory_file_load_image() can map them back.
+ */
+XPCHECKAPI int xpost_memory_file_save_image(Xpost_Memory_File *mem, int fd);
+
+/**
+ * @brief Replace the contents of the given memory file by an image.
+ *
+ * @param[in,out] mem The memory file.
+ * @param[in] fd The file descriptor of the image, positioned at the
+ * data written by xpost_memory_file_save_image().
+ * @return 1 on success, 0 on failure.
+ *
+ * This function reads the memory table from @p fd and maps the
+ * contents with a private copy-on-write mapping, so pages are only
+ * read when touched. The image is copied to the file of @p mem the
+ * first time @p mem grows or is frozen. On failure, @p mem is left
+ * unchanged. The platform must provide mmap().
+ * MUST recalculate all VM pointers after this function.
+ */
+XPCHECKAPI int xpost_memory_file_load_image(Xpost_Memory_File *mem, int fd);
+
 /**
  * @brief Allocate memory in the given memory file and return offset.
  *
@@ -301,6 +412,16 @@ void xpost_memory_file_dump(const Xpost_Memory_File *mem);
  */
 XPCHECKAPI int xpost_memory_table_init(Xpost_Memory_File *mem);
 
+/**
+ * @brief Deallocate the table of the given memory file.
+ *
+ * @param[in,out] mem The memory file.
+ *
+ * This function frees the arrays of the memory table of @p mem. It
+ * is called by xpost_memory_file_exit().
+ */
+XPCHECKAPI void xpost_memory_table_exit(Xpost_Memory_File *mem);
+
 int xpost_memory_register_free_list_alloc_function(Xpost_Memory_File *mem,
                                                    int (*free_list_alloc)(struct Xpost_Memory_File *mem,
                                                                           unsigned int sz,
@@ -312,6 +433,25 @@ int xpost_memory_register_garbage_collect_function(Xpost_Memory_File *mem,
                                                                           int dosweep,
                                                                           int markall));
 
+/**
+ * @brief Install a finalizer for allocations with the given tag.
+ *
+ * @param[in,out] mem The memory file.
+ * @param[in] tag The allocation tag, less than XPOST_MEMORY_FINALIZE_TAGS.
+ * @param[in] finalize The finalizer, or NULL to remove it.
+ * @return 1 on success, 0 on failure.
+ *
+ * The finalizer is called when an entity with tag @p tag is freed,
+ * either explicitly or by the garbage collector, before its memory is
+ * returned to the free list. It releases resources held outside of
+ * VM, like FILE pointers or device handles, and returns 1 on success,
+ * 0 on failure.
+ */
+XPCHECKAPI int xpost_memory_register_finalize_function(Xpost_Memory_File *mem,
+                                                       unsigned int tag,
+                                                       int (*finalize)(struct Xpost_Memory_File *mem,
+                                                                       unsigned int ent));
+
 /**
  * @brief Allocate memory, returns table index.
  *
@@ -394,34 +534,34 @@ int xpost_memory_table_set_size(Xpost_Memory_File *mem,
                                 unsigned int size);
 
 /**
- * @brief Get the mark field of an entity.
+ * @brief Get the save level field of an entity.
  *
  * @param[in] mem The memory file.
  * @param[in] ent The entity.
- * @param[out] mark The mark field.
+ * @param[out] lev The save level field.
  * @return 1 on success, 0 on failure.
  *
- * If successful, this function stores the mark field
- * of the entity @p ent in @p mem through the @p mark pointer.
+ * If successful, this function stores the save level field
+ * of the entity @p ent in @p mem through the @p lev pointer.
  */
-int xpost_memory_table_get_mark(Xpost_Memory_File *mem,
-                                unsigned int ent,
-                                unsigned int *mark);
+XPCHECKAPI int xpost_memory_table_get_lev(Xpost_Memory_File *mem,
+                                          unsigned int ent,
+                                          unsigned int *lev);
 
 /**
- * @brief Set the mark field for an entity.
+ * @brief Set the save level field for an entity.
  *
  * @param[in] mem The memory file.
  * @param[in] ent The entity.
- * @param[in] mark The new mark field.
+ * @param[in] lev The new save level field.
  * @return 1 on success, 0 on failure.
  *
- * If successful, this function replaces the mark field
- * of the entity @p ent in @p mem with the new value @p mark.
+ * If successful, this function replaces the save level field
+ * of the entity @p ent in @p mem with the new value @p lev.
  */
-int xpost_memory_table_set_mark(Xpost_Memory_File *mem,
-                                unsigned int ent,
-                                unsigned int mark);
+XPCHECKAPI int xpost_memory_table_set_lev(Xpost_Memory_File *mem,
+                                          unsigned int ent,
+                                          unsigned int lev);
 
 /**
  * @brief Get the tag of an entity.
@@ -110,8 +110,8 @@ int xpost_name_init(Xpost_Context *ctx)
 
     xpost_stack_init(ctx->gl, &t);
     tab = &ctx->gl->table; //recalc pointer
-    tab->tab[XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK].adr = t;
-    tab->tab[XPOST_MEMORY_TABLE_SPECIAL_NAME_TREE].adr = 0;
+    tab->adr[XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK] = t;
+    tab->adr[XPOST_MEMORY_TABLE_SPECIAL_NAME_TREE] = 0;
     xpost_memory_table_get_addr(ctx->gl,
             XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK, &nstk);
     xpost_stack_push(ctx->gl, nstk, xpost_string_cons(ctx, CNT_STR("_not_a_name_")));
@@ -137,8 +137,8 @@ int xpost_name_init(Xpost_Context *ctx)
 
     xpost_stack_init(ctx->lo, &t);
     tab = &ctx->lo->table; //recalc pointer
-    tab->tab[XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK].adr = t;
-    tab->tab[XPOST_MEMORY_TABLE_SPECIAL_NAME_TREE].adr = 0;
+    tab->adr[XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK] = t;
+    tab->adr[XPOST_MEMORY_TABLE_SPECIAL_NAME_TREE] = 0;
     xpost_memory_table_get_addr(ctx->lo,
             XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK, &nstk);
     xpost_stack_push(ctx->lo, nstk, xpost_string_cons(ctx, CNT_STR("_not_a_name_")));
@@ -281,14 +281,14 @@ Xpost_Object xpost_name_cons(Xpost_Context *ctx,
         if (!u) {
             Xpost_Memory_File *mem = ctx->vmmode==GLOBAL?ctx->gl:ctx->lo;
             Xpost_Memory_Table *tab = &mem->table;
-            ret = tstinsert(mem, tab->tab[XPOST_MEMORY_TABLE_SPECIAL_NAME_TREE].adr, s, &t);
+            ret = tstinsert(mem, tab->adr[XPOST_MEMORY_TABLE_SPECIAL_NAME_TREE], s, &t);
             if (ret)
             {
                 //this can only be a VMerror
                 return invalid;
             }
             tab = &mem->table; //recalc pointer
-            tab->tab[XPOST_MEMORY_TABLE_SPECIAL_NAME_TREE].adr = t;
+            tab->adr[XPOST_MEMORY_TABLE_SPECIAL_NAME_TREE] = t;
             u = addname(ctx, s); // obeys vmmode
             o.mark_.tag = nametype | (ctx->vmmode==GLOBAL?XPOST_OBJECT_TAG_DATA_FLAG_BANK:0);
             o.mark_.pad0 = 0;
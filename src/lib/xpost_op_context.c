@@ -37,6 +37,7 @@
 #include <stdlib.h> /* NULL */
 
 #include "xpost.h"
+#include "xpost_log.h"
 #include "xpost_memory.h"
 #include "xpost_object.h"
 #include "xpost_stack.h"
@@ -70,27 +71,37 @@ int xpost_op_currentcontext (Xpost_Context *ctx)
 static
 int xpost_op_fork (Xpost_Context *ctx, Xpost_Object proc)
 {
-    int cid, n;
+    int cid, n, ret;
     Xpost_Context *newctx;
 
+    ret = xpost_op_counttomark(ctx);
+    if (ret)
+        return ret;
+    n = xpost_stack_pop(ctx->lo, ctx->os).int_.val;
+
     cid = xpost_context_fork3(ctx,
                               ctx->xpost_interpreter_cid_init,
                               ctx->gl->interpreter_cid_get_context,
                               ctx->xpost_interpreter_alloc_local_memory,
                               ctx->xpost_interpreter_alloc_global_memory,
                               ctx->garbage_collect_function);
+    if (!cid)
+        return limitcheck;
     newctx = ctx->gl->interpreter_cid_get_context(cid);
-    printf("op_fork ctx->id %u, cid %u, newctx->id %u\n", ctx->id, cid, newctx->id);
+    XPOST_LOG_INFO("fork context %u from %u", newctx->id, ctx->id);
+    newctx->quit = 0;
+    newctx->joiner = 0;
+    newctx->detached = 0;
 
-    (void)xpost_op_counttomark(ctx);
-    n = xpost_stack_pop(ctx->lo, ctx->os).int_.val;
     /* copy n objects to new context's operand stack */
     while (n--)
         xpost_stack_push(newctx->lo, newctx->os,
                          xpost_stack_topdown_fetch(ctx->lo, ctx->os, n));
     (void)xpost_op_cleartomark(ctx);
 
+    /* run proc in a stopped context, so an error ends the context */
     xpost_stack_push(newctx->lo, newctx->es, xpost_operator_cons(newctx, "_i_am_zombie_", NULL,0,0));
+    xpost_stack_push(newctx->lo, newctx->es, xpost_bool_cons(0));
     xpost_stack_push(newctx->lo, newctx->es, proc);
     //xpost_op_currentcontext(newctx);
     newctx->state = C_RUN;
@@ -103,20 +114,46 @@ int xpost_op_fork (Xpost_Context *ctx, Xpost_Object proc)
     return contextswitch;
 }
 
+/* report the error which stopped the context, then end it */
 static
-int _i_am_zombie_ (Xpost_Context *ctx)
+int _xpost_op_context_stopped (Xpost_Context *ctx)
 {
+    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons(ctx, "_i_am_zombie_", NULL,0,0));
+    xpost_stack_push(ctx->lo, ctx->es, xpost_bool_cons(0));
+    xpost_stack_push(ctx->lo, ctx->es,
+                     xpost_object_cvx(xpost_name_cons(ctx, "handleerror")));
+    return 0;
+}
+
+static
+int _i_am_zombie_ (Xpost_Context *ctx, Xpost_Object stopped)
+{
+    if (stopped.int_.val)
+        return _xpost_op_context_stopped(ctx);
+    /* a detached context is freed by the scheduler */
     ctx->state = C_ZOMB;
-    printf("I AM ZOMBIE\n");
+    /* wake the context waiting in join */
+    if (ctx->joiner)
+    {
+        Xpost_Context *parent = ctx->gl->interpreter_cid_get_context(ctx->joiner);
+        if (parent->state == C_WAIT)
+            parent->state = C_RUN;
+    }
     return contextswitch;
 }
 
+/* the context of the job (sharing local vm) named by a context object,
+   NULL if there is none */
 static
-int _i_am_free_ (Xpost_Context *ctx)
+Xpost_Context *_xpost_op_context_of_job (Xpost_Context *ctx, Xpost_Object context)
 {
-    ctx->state = C_FREE;
-    printf("I AM FREE\n");
-    return contextswitch;
+    unsigned int *ctxlist = xpost_context_get_ctxlist(ctx->lo);
+    int i;
+
+    for (i = 0; ctxlist[i]; i++)
+        if (ctxlist[i] == context.mark_.padw)
+            return ctx->gl->interpreter_cid_get_context(ctxlist[i]);
+    return NULL;
 }
 
 /*
@@ -126,11 +163,13 @@ int _i_am_free_ (Xpost_Context *ctx)
 static
 int xpost_op_join (Xpost_Context *ctx, Xpost_Object context)
 {
-    //(void)context;
-    Xpost_Context *child = ctx->gl->interpreter_cid_get_context(context.mark_.padw);
+    Xpost_Context *child = _xpost_op_context_of_job(ctx, context);
+
+    if (!child || child == ctx || child->detached
+        || (child->joiner && child->joiner != ctx->id))
+        return invalidaccess;
     if (child->state == C_ZOMB) {
         int i,n;
-        printf("found zombie child\n");
         xpost_stack_push(ctx->lo, ctx->os, mark);
         // Copy operand stack
         n = xpost_stack_count(child->lo, child->os);
@@ -138,12 +177,12 @@ int xpost_op_join (Xpost_Context *ctx, Xpost_Object context)
             xpost_stack_push(ctx->lo, ctx->os,
                     xpost_stack_bottomup_fetch(child->lo, child->os, i));
         // Cleanup child
-        child->state = C_FREE;
+        xpost_context_fork_free(child);
         return 0;
     }
 
-    /* continue */
-    printf("waiting for child %u ==%u\n", context.mark_.padw, child->state);
+    /* wait to be woken by the end of the child, then retry */
+    child->joiner = ctx->id;
     xpost_stack_push(ctx->lo, ctx->os, context);
     xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons(ctx, "join", NULL,0,0));
     ctx->state = C_WAIT;
@@ -169,9 +208,17 @@ int xpost_op_yield (Xpost_Context *ctx)
 static
 int xpost_op_detach (Xpost_Context *ctx, Xpost_Object context)
 {
-    Xpost_Context *child = ctx->gl->interpreter_cid_get_context(context.mark_.padw);
-    xpost_stack_bottomup_replace(child->lo, child->es, 0,
-                                 xpost_operator_cons(child, "_i_am_free_", NULL,0,0));
+    Xpost_Context *child = _xpost_op_context_of_job(ctx, context);
+
+    if (!child || child == ctx || child->detached || child->joiner)
+        return invalidaccess;
+    /* already done: nothing is left to wait for */
+    if (child->state == C_ZOMB)
+    {
+        xpost_context_fork_free(child);
+        return 0;
+    }
+    child->detached = 1;
     return contextswitch;
 }
 
@@ -207,9 +254,7 @@ int xpost_oper_init_context_ops (Xpost_Context *ctx,
     INSTALL;
     op = xpost_operator_cons(ctx, "fork", (Xpost_Op_Func)xpost_op_fork, 1, 1, proctype);
     INSTALL;
-    op = xpost_operator_cons(ctx, "_i_am_zombie_", (Xpost_Op_Func)_i_am_zombie_, 0, 0);
-    INSTALL;
-    op = xpost_operator_cons(ctx, "_i_am_free_", (Xpost_Op_Func)_i_am_free_, 0, 0);
+    op = xpost_operator_cons(ctx, "_i_am_zombie_", (Xpost_Op_Func)_i_am_zombie_, 0, 1, booleantype);
     INSTALL;
     op = xpost_operator_cons(ctx, "join", (Xpost_Op_Func)xpost_op_join, 1, 1, contexttype);
     INSTALL;
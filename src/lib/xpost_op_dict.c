@@ -53,7 +53,6 @@
 #include "xpost_op_stack.h"
 #include "xpost_op_dict.h"
 
-int DEBUGLOAD = 0;
 int xpost_op_any_where (Xpost_Context *ctx, Xpost_Object K); /* forward decl.
                                                    store uses where */
 
@@ -182,7 +181,7 @@ int xpost_op_any_load(Xpost_Context *ctx,
 {
     int i;
     int z = xpost_stack_count(ctx->lo, ctx->ds);
-    if (DEBUGLOAD)
+    if (ctx->debugload)
     {
         printf("\nload:");
         xpost_object_dump(K);
@@ -196,7 +195,7 @@ int xpost_op_any_load(Xpost_Context *ctx,
         Xpost_Object x;
         Xpost_Object D = xpost_stack_topdown_fetch(ctx->lo,ctx->ds,i);
 
-        if (DEBUGLOAD)
+        if (ctx->debugload)
         {
             xpost_dict_dump_memory (xpost_context_select_memory(ctx, D), D);
             (void)puts("");
@@ -210,7 +209,7 @@ int xpost_op_any_load(Xpost_Context *ctx,
         }
     }
 
-    if (DEBUGLOAD)
+    if (ctx->debugload)
     {
         unsigned int names;
         xpost_memory_file_dump(ctx->lo);
@@ -33,8 +33,6 @@
 
 /* dictionary operators */
 
-extern int DEBUGLOAD;
-
 int xpost_op_any_load(Xpost_Context *ctx, Xpost_Object K);
 int xpost_oper_init_dict_ops(Xpost_Context *ctx, Xpost_Object sd);
 
@@ -59,7 +59,6 @@ void *alloca (size_t);
 #endif
 
 #include <assert.h>
-#include <ctype.h>
 #include <errno.h>
 //#include <poll.h>
 #include <stdio.h>
@@ -90,6 +89,7 @@ void *alloca (size_t);
 #include "xpost_array.h"
 #include "xpost_dict.h"
 #include "xpost_file.h"
+#include "xpost_filter.h"
 
 //#include "xpost_interpreter.h"
 #include "xpost_operator.h"
@@ -124,6 +124,122 @@ int xpost_op_string_mode_file (Xpost_Context *ctx,
     return 0;
 }
 
+/* fetch an optional entry of a filter's parameter dictionary */
+static
+int _xpost_op_filter_param(Xpost_Context *ctx,
+                           Xpost_Object d,
+                           const char *key,
+                           Xpost_Object_Type type,
+                           Xpost_Object *retval)
+{
+    Xpost_Object k = xpost_name_cons(ctx, key);
+
+    if (!xpost_dict_known_key(ctx, xpost_context_select_memory(ctx, d), d, k))
+        return 0;
+    *retval = xpost_dict_get(ctx, d, k);
+    if (xpost_object_get_type(*retval) != type)
+        return typecheck;
+    return 0;
+}
+
+/* src name  filter  file
+   src dict name  filter  file
+   src EODCount EODString /SubFileDecode  filter  file
+   create a decode filter reading from the file or string src */
+static
+int xpost_op_filter (Xpost_Context *ctx,
+                     Xpost_Object P,
+                     Xpost_Object N)
+{
+    Xpost_Filter_Params par;
+    Xpost_Object src = P;
+    Xpost_Object o, f;
+    Xpost_Object ns;
+    char *cname;
+    int extra = 0;
+    int ret;
+
+    ns = xpost_name_get_string(ctx, N);
+    cname = alloca(ns.comp_.sz + 1);
+    memcpy(cname, xpost_string_get_pointer(ctx, ns), ns.comp_.sz);
+    cname[ns.comp_.sz] = '\0';
+
+    par.closesrc = 0;
+    par.earlychange = 1;
+    par.eodcount = 0;
+    par.eodstring = NULL;
+    par.eodlength = 0;
+
+    if (xpost_object_get_type(P) == dicttype)
+    {
+        o = xpost_bool_cons(0);
+        if ((ret = _xpost_op_filter_param(ctx, P, "CloseSource", booleantype, &o)))
+            return ret;
+        par.closesrc = o.int_.val;
+        o = xpost_int_cons(1);
+        if ((ret = _xpost_op_filter_param(ctx, P, "EarlyChange", integertype, &o)))
+            return ret;
+        par.earlychange = o.int_.val;
+        o = xpost_int_cons(0);
+        if ((ret = _xpost_op_filter_param(ctx, P, "EODCount", integertype, &o)))
+            return ret;
+        par.eodcount = o.int_.val;
+        o = null;
+        if ((ret = _xpost_op_filter_param(ctx, P, "EODString", stringtype, &o)))
+            return ret;
+        if (xpost_object_get_type(o) == stringtype)
+        {
+            par.eodstring = xpost_string_get_pointer(ctx, o);
+            par.eodlength = o.comp_.sz;
+        }
+        extra = 1;
+    }
+    else if (!strcmp(cname, "SubFileDecode"))
+    {
+        if (xpost_object_get_type(P) != stringtype)
+            return typecheck;
+        par.eodstring = xpost_string_get_pointer(ctx, P);
+        par.eodlength = P.comp_.sz;
+        if (xpost_stack_count(ctx->lo, ctx->os) < 2)
+            return stackunderflow;
+        o = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 0);
+        if (xpost_object_get_type(o) != integertype)
+            return typecheck;
+        par.eodcount = o.int_.val;
+        extra = 2;
+    }
+    if (extra)
+    {
+        if (xpost_stack_count(ctx->lo, ctx->os) < extra)
+            return stackunderflow;
+        src = xpost_stack_topdown_fetch(ctx->lo, ctx->os, extra - 1);
+    }
+    if (par.eodcount < 0)
+        return rangecheck;
+
+    switch (xpost_object_get_type(src))
+    {
+        case filetype:
+            if (!xpost_object_is_readable(ctx, src))
+                return invalidaccess;
+            ret = xpost_filter_open(ctx->lo, cname, src, NULL, 0, &par, &f);
+            break;
+        case stringtype:
+            ret = xpost_filter_open(ctx->lo, cname, null,
+                                    xpost_string_get_pointer(ctx, src), src.comp_.sz,
+                                    &par, &f);
+            break;
+        default: /* procedure data sources are not supported */
+            return typecheck;
+    }
+    if (ret)
+        return ret;
+    while (extra--)
+        (void)xpost_stack_pop(ctx->lo, ctx->os);
+    xpost_stack_push(ctx->lo, ctx->os, f);
+    return 0;
+}
+
 /* file  closefile  -
    close file object */
 static
@@ -137,6 +253,26 @@ int xpost_op_file_closefile (Xpost_Context *ctx,
     return 0;
 }
 
+/* no bytes yet in the growing span of a file read with a callback,
+   or of a fifo: push retry with the n operands,
+   and request eval() to block this context on the fifo, if any */
+static
+int _xpost_op_file_retry(Xpost_Context *ctx,
+                         const char *name,
+                         int n,
+                         Xpost_Object F,
+                         Xpost_Object S)
+{
+    Xpost_File_Map *map = xpost_file_get_map(ctx->lo, F);
+
+    ctx->iofd = map ? map->fd : -1;
+    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons(ctx, name, NULL,0,0));
+    xpost_stack_push(ctx->lo, ctx->os, F);
+    if (n > 1)
+        xpost_stack_push(ctx->lo, ctx->os, S);
+    return ioblock;
+}
+
 /* file  read  int true
                false
    read a byte from file */
@@ -145,8 +281,17 @@ int xpost_op_file_read(Xpost_Context *ctx,
                        Xpost_Object f)
 {
     Xpost_Object b;
+    Xpost_File_Map *map;
     if (!xpost_object_is_readable(ctx,f))
         return invalidaccess;
+    if ((map = xpost_file_get_map(ctx->lo, f)))
+    {
+        if (map->pos == map->size && !map->ended &&
+            xpost_file_map_more(map) < 0)
+            return _xpost_op_file_retry(ctx, "read", 1, f, null);
+    }
+    else if (xpost_file_fill_source(ctx->lo, f) < 0)
+        return _xpost_op_file_retry(ctx, "read", 1, f, null);
     /*
      * FIXME: check if this work on Windows
      * indeed, on Windows, select() needs a socket, not a fd, and fileno() returns a fd
@@ -161,21 +306,26 @@ int xpost_op_file_read(Xpost_Context *ctx,
         int ret;
         struct timeval tv_timeout;
         fp = xpost_file_get_file_pointer(ctx->lo, f);
-        FD_ZERO(&reads);
-        FD_ZERO(&writes);
-        FD_ZERO(&excepts);
-        FD_SET(fileno(fp), &reads);
-        tv_timeout.tv_sec = 0;
-        tv_timeout.tv_usec = 0;
+        /* files read from memory, and filters, have no descriptor to poll */
+        if (fp && fileno(fp) >= 0)
+        {
+            FD_ZERO(&reads);
+            FD_ZERO(&writes);
+            FD_ZERO(&excepts);
+            FD_SET(fileno(fp), &reads);
+            tv_timeout.tv_sec = 0;
+            tv_timeout.tv_usec = 0;
 
-        ret = select(fileno(fp) + 1, &reads, &writes, &excepts, &tv_timeout);
+            ret = select(fileno(fp) + 1, &reads, &writes, &excepts, &tv_timeout);
 
-        if (ret <= 0 || !FD_ISSET(fileno(fp), &reads))
-        {
-            /* byte not available, push retry, and request eval() to block this thread */
-            xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons(ctx, "read", NULL,0,0));
-            xpost_stack_push(ctx->lo, ctx->os, f);
-            return ioblock;
+            if (ret <= 0 || !FD_ISSET(fileno(fp), &reads))
+            {
+                /* byte not available, push retry, and request eval() to block this context */
+                ctx->iofd = fileno(fp);
+                xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons(ctx, "read", NULL,0,0));
+                xpost_stack_push(ctx->lo, ctx->os, f);
+                return ioblock;
+            }
         }
     }
 #endif
@@ -212,6 +362,79 @@ int xpost_op_file_write (Xpost_Context *ctx,
 
 const char *hex = "0123456789" "ABCDEF" "abcdef";
 
+/* value of each byte as a hex digit, -1 if it is not one */
+static
+const signed char _xpost_op_file_hex_value[256] =
+{
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+     0, 1, 2, 3, 4, 5, 6, 7, 8, 9,-1,-1,-1,-1,-1,-1,
+    -1,10,11,12,13,14,15,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,10,11,12,13,14,15,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1
+};
+
+/* decode hex digits from src[0..n) into dst, until want bytes are
+   written. other characters are skipped. *hi is the pending high
+   digit (-1 if none) across calls. the count of bytes written is
+   returned, and *used is the count of characters consumed, so that
+   the file stops right after the last digit of the last byte. */
+static
+size_t _xpost_op_file_unhex(const unsigned char *src,
+                            size_t n,
+                            unsigned char *dst,
+                            size_t want,
+                            int *hi,
+                            size_t *used)
+{
+    const unsigned char *p = src;
+    const unsigned char *end = src + n;
+    unsigned char *d = dst;
+    unsigned char *dend = dst + want;
+    int v;
+
+    while (d < dend && p < end)
+    {
+        if (*hi < 0)
+        {
+            /* whole pairs of digits, the common case of image data */
+            while (d < dend && end - p >= 2)
+            {
+                int a = _xpost_op_file_hex_value[p[0]];
+                int b = _xpost_op_file_hex_value[p[1]];
+                if ((a | b) < 0)
+                    break;
+                *d++ = (unsigned char)(a << 4 | b);
+                p += 2;
+            }
+            if (d == dend || p == end)
+                break;
+        }
+        v = _xpost_op_file_hex_value[*p++];
+        if (v < 0)
+            continue;
+        if (*hi < 0)
+            *hi = v;
+        else
+        {
+            *d++ = (unsigned char)(*hi << 4 | v);
+            *hi = -1;
+        }
+    }
+    *used = p - src;
+    return d - dst;
+}
+
 /* file string  readhexstring  substring true
                                false
    read hex-encoded data from file into string */
@@ -220,40 +443,65 @@ int xpost_op_file_readhexstring (Xpost_Context *ctx,
                                  Xpost_Object F,
                                  Xpost_Object S)
 {
-    int n;
-    int c[2];
+    size_t n;
+    int hi = -1;
     int eof = 0;
     FILE *f;
-    char *s;
+    unsigned char *s;
+    Xpost_File_Map *map;
     if (!xpost_file_get_status(ctx->lo, F))
         return ioerror;
     if (!xpost_object_is_readable(ctx,F))
         return invalidaccess;
     f = xpost_file_get_file_pointer(ctx->lo, F);
-    s = xpost_string_get_pointer(ctx, S);
+    s = (unsigned char *)xpost_string_get_pointer(ctx, S);
 
-    for (n = 0; !eof && n < S.comp_.sz; n++)
+    if ((map = xpost_file_get_map(ctx->lo, F)))
     {
-        do
-        {
-            c[0] = xpost_file_getc(f);
-            if (c[0] == EOF) ++eof;
-        } while(!eof && strchr(hex, c[0]) != NULL);
-        if (!eof)
+        /* decode straight from the span,
+           again with more bytes if it grows and was too short */
+        size_t used;
+        for (;;)
         {
-            do
-            {
-                c[1] = xpost_file_getc(f);
-                if (c[1] == EOF) ++eof;
-            } while(!eof && strchr(hex, c[1]) != NULL);
+            hi = -1;
+            n = _xpost_op_file_unhex(map->base + map->pos, map->size - map->pos,
+                                     s, S.comp_.sz, &hi, &used);
+            if (n == S.comp_.sz || map->ended)
+                break;
+            if (xpost_file_map_more(map) < 0)
+                return _xpost_op_file_retry(ctx, "readhexstring", 2, F, S);
         }
-        else
+        map->pos += used;
+        eof = n < S.comp_.sz;
+    }
+    else
+    {
+        int c, v;
+        if (xpost_file_fill_source(ctx->lo, F) < 0)
+            return _xpost_op_file_retry(ctx, "readhexstring", 2, F, S);
+        for (n = 0; n < S.comp_.sz; )
         {
-            c[1] = '0';
+            c = xpost_file_getc(f);
+            if (c == EOF)
+            {
+                ++eof;
+                break;
+            }
+            v = _xpost_op_file_hex_value[c];
+            if (v < 0)
+                continue;
+            if (hi < 0)
+                hi = v;
+            else
+            {
+                s[n++] = (unsigned char)(hi << 4 | v);
+                hi = -1;
+            }
         }
-        s[n] = ((strchr(hex, toupper(c[0])) - hex) << 4)
-             | (strchr(hex, toupper(c[1])) - hex);
     }
+    /* an odd digit at the end is followed by 0 */
+    if (eof && hi >= 0)
+        s[n++] = (unsigned char)(hi << 4);
     S.comp_.sz = n;
     xpost_stack_push(ctx->lo, ctx->os, S);
     xpost_stack_push(ctx->lo, ctx->os, xpost_bool_cons(!eof));
@@ -267,21 +515,26 @@ int xpost_op_file_writehexstring (Xpost_Context *ctx,
                                   Xpost_Object F,
                                   Xpost_Object S)
 {
-    int n;
+    unsigned int n, k;
     FILE *f;
-    char *s;
+    unsigned char *s;
+    char buf[BUFSIZ];
     if (!xpost_file_get_status(ctx->lo, F))
         return ioerror;
     if (!xpost_object_is_writeable(ctx, F))
         return invalidaccess;
     f = xpost_file_get_file_pointer(ctx->lo, F);
-    s = xpost_string_get_pointer(ctx, S);
+    s = (unsigned char *)xpost_string_get_pointer(ctx, S);
 
-    for (n = 0; n < S.comp_.sz; n++)
+    /* encode a block at a time */
+    for (n = 0; n < S.comp_.sz; )
     {
-        if (fputc(hex[s[n] / 16], f) == EOF)
-            return ioerror;
-        if (fputc(hex[s[n] % 16], f) == EOF)
+        for (k = 0; k < sizeof buf && n < S.comp_.sz; n++)
+        {
+            buf[k++] = hex[s[n] >> 4];
+            buf[k++] = hex[s[n] & 15];
+        }
+        if (fwrite(buf, 1, k, f) != k)
             return ioerror;
     }
     return 0;
@@ -298,13 +551,31 @@ int xpost_op_file_readstring (Xpost_Context *ctx,
     int n;
     FILE *f;
     char *s;
+    Xpost_File_Map *map;
     if (!xpost_file_get_status(ctx->lo, F))
         return ioerror;
     if (!xpost_object_is_readable(ctx,F))
         return invalidaccess;
     f = xpost_file_get_file_pointer(ctx->lo, F);
     s = xpost_string_get_pointer(ctx, S);
-    n = fread(s, 1, S.comp_.sz, f);
+    if ((map = xpost_file_get_map(ctx->lo, F)))
+    {
+        /* copy straight from the span */
+        while (map->size - map->pos < S.comp_.sz && !map->ended)
+            if (xpost_file_map_more(map) < 0)
+                return _xpost_op_file_retry(ctx, "readstring", 2, F, S);
+        n = S.comp_.sz;
+        if ((size_t)n > map->size - map->pos)
+            n = (int)(map->size - map->pos);
+        memcpy(s, map->base + map->pos, n);
+        map->pos += n;
+    }
+    else
+    {
+        if (xpost_file_fill_source(ctx->lo, F) < 0)
+            return _xpost_op_file_retry(ctx, "readstring", 2, F, S);
+        n = fread(s, 1, S.comp_.sz, f);
+    }
     if (n == S.comp_.sz)
     {
         xpost_stack_push(ctx->lo, ctx->os, S);
@@ -350,18 +621,53 @@ int xpost_op_file_readline (Xpost_Context *ctx,
     FILE *f;
     char *s;
     int n, c = ' ';
+    Xpost_File_Map *map;
     if (!xpost_file_get_status(ctx->lo, F))
         return ioerror;
     if (!xpost_object_is_readable(ctx,F))
         return invalidaccess;
     f = xpost_file_get_file_pointer(ctx->lo, F);
     s = xpost_string_get_pointer(ctx, S);
-    for (n = 0; n < S.comp_.sz; n++)
+    if ((map = xpost_file_get_map(ctx->lo, F)))
     {
-        c = xpost_file_getc(f);
-        if (c == EOF || c == '\n')
-            break;
-        s[n] = c;
+        /* find the end of the line in the span */
+        size_t len;
+        const unsigned char *nl;
+        for (;;)
+        {
+            len = map->size - map->pos;
+            if (len > S.comp_.sz)
+                len = S.comp_.sz;
+            nl = len ? memchr(map->base + map->pos, '\n', len) : NULL;
+            if (nl || len == S.comp_.sz || map->ended)
+                break;
+            if (xpost_file_map_more(map) < 0)
+                return _xpost_op_file_retry(ctx, "readline", 2, F, S);
+        }
+        if (nl)
+        {
+            n = (int)(nl - (map->base + map->pos));
+            c = '\n';
+        }
+        else
+        {
+            n = (int)len;
+            c = (n == S.comp_.sz) ? ' ' : EOF;
+        }
+        memcpy(s, map->base + map->pos, n);
+        map->pos += n + (c == '\n');
+    }
+    else
+    {
+        if (xpost_file_fill_source(ctx->lo, F) < 0)
+            return _xpost_op_file_retry(ctx, "readline", 2, F, S);
+        for (n = 0; n < S.comp_.sz; n++)
+        {
+            c = xpost_file_getc(f);
+            if (c == EOF || c == '\n')
+                break;
+            s[n] = c;
+        }
     }
     if (n == S.comp_.sz && c != '\n')
         return rangecheck;
@@ -407,6 +713,7 @@ int xpost_op_file_flushfile (Xpost_Context *ctx,
 {
     int ret;
     FILE *f;
+    Xpost_File_Map *map;
     if (!xpost_file_get_status(ctx->lo, F)) return 0;
     f = xpost_file_get_file_pointer(ctx->lo, F);
     if (xpost_object_is_writeable(ctx, F))
@@ -418,6 +725,21 @@ int xpost_op_file_flushfile (Xpost_Context *ctx,
     else if (xpost_object_is_readable(ctx,F))
     { /* flush input file. yes yes I know ... but it's in the spec! */
         int c;
+        if ((map = xpost_file_get_map(ctx->lo, F)))
+        {
+            /* skip the span, and its next bytes until the end */
+            for (;;)
+            {
+                map->pos = map->size;
+                if (map->ended)
+                    break;
+                if (xpost_file_map_more(map) < 0)
+                    return _xpost_op_file_retry(ctx, "flushfile", 1, F, null);
+            }
+            return 0;
+        }
+        if (xpost_file_fill_source(ctx->lo, F) < 0)
+            return _xpost_op_file_retry(ctx, "flushfile", 1, F, null);
         while ((c = xpost_file_getc(f)) != EOF)
             /**/;
     }
@@ -677,7 +999,8 @@ int xpost_oper_init_file_ops (Xpost_Context *ctx,
 
     op = xpost_operator_cons(ctx, "file", (Xpost_Op_Func)xpost_op_string_mode_file, 1, 2, stringtype, stringtype);
     INSTALL;
-    /* filter */
+    op = xpost_operator_cons(ctx, "filter", (Xpost_Op_Func)xpost_op_filter, 1, 2, anytype, nametype);
+    INSTALL;
     op = xpost_operator_cons(ctx, "closefile", (Xpost_Op_Func)xpost_op_file_closefile, 0, 1, filetype);
     INSTALL;
     op = xpost_operator_cons(ctx, "read", (Xpost_Op_Func)xpost_op_file_read, 1, 1, filetype);
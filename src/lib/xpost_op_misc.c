@@ -255,15 +255,13 @@ int _array_swap(Xpost_Context *ctx,
 static
 int traceon (Xpost_Context *ctx)
 {
-    (void)ctx;
-    _xpost_interpreter_is_tracing = 1;
+    ctx->tracing = 1;
     return 0;
 }
 static
 int traceoff(Xpost_Context *ctx)
 {
-    (void)ctx;
-    _xpost_interpreter_is_tracing = 0;
+    ctx->tracing = 0;
     return 0;
 }
 #endif
@@ -271,15 +269,13 @@ int traceoff(Xpost_Context *ctx)
 static
 int debugloadon(Xpost_Context *ctx)
 {
-    (void)ctx;
-    DEBUGLOAD = 1;
+    ctx->debugload = 1;
     return 0;
 }
 static
 int debugloadoff(Xpost_Context *ctx)
 {
-    (void)ctx;
-    DEBUGLOAD = 0;
+    ctx->debugload = 0;
     return 0;
 }
 
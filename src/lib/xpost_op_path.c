@@ -83,35 +83,6 @@
 //#define RAD_PER_DEG (M_PI / 180.0)
 #define RAD_PER_DEG (0.0174533)
 
-/*name objects*/
-static Xpost_Object namegraphicsdict;
-static Xpost_Object namecurrgstate;
-static Xpost_Object namecurrpath;
-static Xpost_Object namecmd;
-static Xpost_Object namedata;
-static Xpost_Object namemove;
-static Xpost_Object nameline;
-static Xpost_Object namecurve;
-static Xpost_Object nameclose;
-
-/*opcodes*/
-static unsigned int _currentpoint_opcode;
-static unsigned int _moveto_opcode;
-static unsigned int _moveto_cont_opcode;
-static unsigned int _rmoveto_cont_opcode;
-static unsigned int _lineto_opcode;
-static unsigned int _lineto_cont_opcode;
-static unsigned int _rlineto_cont_opcode;
-static unsigned int _curveto_opcode;
-static unsigned int _curveto_cont1_opcode;
-static unsigned int _curveto_cont2_opcode;
-static unsigned int _curveto_cont3_opcode;
-static unsigned int _rcurveto_cont_opcode;
-
-/*matrices*/
-static Xpost_Object _mat;
-static Xpost_Object _mat1;
-
 static
 int _newpath(Xpost_Context *ctx)
 {
@@ -119,12 +90,12 @@ int _newpath(Xpost_Context *ctx)
     int ret;
 
     /* graphicsdict /currgstate get /currpath 1 dict put */
-    ret = xpost_op_any_load(ctx, namegraphicsdict);
+    ret = xpost_op_any_load(ctx, ctx->name_shortcuts.graphicsdict);
     if (ret) return ret;
     gd = xpost_stack_pop(ctx->lo, ctx->os);
-    gstate = xpost_dict_get(ctx, gd, namecurrgstate);
+    gstate = xpost_dict_get(ctx, gd, ctx->name_shortcuts.currgstate);
     ret = xpost_dict_put(ctx, gstate,
-                         namecurrpath,
+                         ctx->name_shortcuts.currpath,
                          xpost_dict_cons(ctx, 1));
     if (ret) return ret;
     return 0;
@@ -137,15 +108,15 @@ Xpost_Object _cpath(Xpost_Context *ctx)
     int ret;
 
     /* graphicsdict /currgstate get /currpath get */
-    ret = xpost_op_any_load(ctx, namegraphicsdict);
+    ret = xpost_op_any_load(ctx, ctx->name_shortcuts.graphicsdict);
     if (ret) return invalid;
     gd = xpost_stack_pop(ctx->lo, ctx->os);
     if (xpost_object_get_type(gd) == invalidtype)
         return invalid;
-    gstate = xpost_dict_get(ctx, gd, namecurrgstate);
+    gstate = xpost_dict_get(ctx, gd, ctx->name_shortcuts.currgstate);
     if (xpost_object_get_type(gstate) == invalidtype)
         return invalid;
-    path = xpost_dict_get(ctx, gstate, namecurrpath);
+    path = xpost_dict_get(ctx, gstate, ctx->name_shortcuts.currpath);
     return path;
 }
 
@@ -173,7 +144,7 @@ int _currentpoint(Xpost_Context *ctx)
     subpath = xpost_dict_get(ctx, path, xpost_int_cons(pathlen - 1));
     subpathlen = xpost_dict_length_memory(xpost_context_select_memory(ctx, subpath), subpath);
     elem = xpost_dict_get(ctx, subpath, xpost_int_cons(subpathlen - 1));
-    data = xpost_dict_get(ctx, elem, namedata);
+    data = xpost_dict_get(ctx, elem, ctx->name_shortcuts.data);
     datalen = data.comp_.sz;
     xpost_stack_push(ctx->lo, ctx->os, xpost_array_get(ctx, data, datalen - 2));
     xpost_stack_push(ctx->lo, ctx->os, xpost_array_get(ctx, data, datalen - 1));
@@ -226,8 +197,8 @@ int _addtopath(Xpost_Context *ctx, Xpost_Object elem, Xpost_Object path)
     pathlen = xpost_dict_length_memory(xpost_context_select_memory(ctx, path), path);
     if (pathlen == 0)
     {
-        cmd = xpost_dict_get(ctx, elem, namecmd);
-        if (xpost_dict_compare_objects(ctx, cmd, namemove) == 0)
+        cmd = xpost_dict_get(ctx, elem, ctx->name_shortcuts.cmd);
+        if (xpost_dict_compare_objects(ctx, cmd, ctx->name_shortcuts.move) == 0)
         {
             /* New Path */
             subpath = xpost_dict_cons(ctx, 10);
@@ -241,20 +212,20 @@ int _addtopath(Xpost_Context *ctx, Xpost_Object elem, Xpost_Object path)
     }
     else
     {
-        cmd = xpost_dict_get(ctx, elem, namecmd);
-        if (xpost_dict_compare_objects(ctx, cmd, namemove) == 0)
+        cmd = xpost_dict_get(ctx, elem, ctx->name_shortcuts.cmd);
+        if (xpost_dict_compare_objects(ctx, cmd, ctx->name_shortcuts.move) == 0)
         {
             int subpathlen;
             subpath = xpost_dict_get(ctx, path, xpost_int_cons(pathlen - 1));
             subpathlen = xpost_dict_length_memory(xpost_context_select_memory(ctx, subpath), subpath);
             lastelem = xpost_dict_get(ctx, subpath, xpost_int_cons(subpathlen - 1));
-            cmd = xpost_dict_get(ctx, lastelem, namecmd);
-            if (xpost_dict_compare_objects(ctx, cmd, namemove) == 0)
+            cmd = xpost_dict_get(ctx, lastelem, ctx->name_shortcuts.cmd);
+            if (xpost_dict_compare_objects(ctx, cmd, ctx->name_shortcuts.move) == 0)
             {
                 /* Merge "move" */
                 Xpost_Object data;
-                data = xpost_dict_get(ctx, elem, namedata);
-                xpost_dict_put(ctx, lastelem, namedata, data);
+                data = xpost_dict_get(ctx, elem, ctx->name_shortcuts.data);
+                xpost_dict_put(ctx, lastelem, ctx->name_shortcuts.data, data);
             }
             else
             {
@@ -281,7 +252,7 @@ int _moveto(Xpost_Context *ctx, Xpost_Object x, Xpost_Object y)
 {
     xpost_stack_push(ctx->lo, ctx->os, x);
     xpost_stack_push(ctx->lo, ctx->os, y);
-    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(_moveto_cont_opcode));
+    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.moveto_cont));
     xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.transform));
     return 0;
 }
@@ -294,8 +265,8 @@ int _moveto_cont(Xpost_Context *ctx, Xpost_Object x, Xpost_Object y)
     xpost_array_put(ctx, data, 0, x);
     xpost_array_put(ctx, data, 1, y);
     elem = xpost_dict_cons(ctx, 2);
-    xpost_dict_put(ctx, elem, namecmd, namemove);
-    xpost_dict_put(ctx, elem, namedata, data);
+    xpost_dict_put(ctx, elem, ctx->name_shortcuts.cmd, ctx->name_shortcuts.move);
+    xpost_dict_put(ctx, elem, ctx->name_shortcuts.data, data);
     return _addtopath(ctx, elem, _cpath(ctx));
 }
 
@@ -304,8 +275,8 @@ int _rmoveto(Xpost_Context *ctx, Xpost_Object dx, Xpost_Object dy)
 {
     xpost_stack_push(ctx->lo, ctx->os, dx);
     xpost_stack_push(ctx->lo, ctx->os, dy);
-    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(_rmoveto_cont_opcode));
-    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(_currentpoint_opcode));
+    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.rmoveto_cont));
+    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.currentpoint));
     return 0;
 }
 
@@ -324,7 +295,7 @@ int _lineto(Xpost_Context *ctx, Xpost_Object x, Xpost_Object y)
 {
     xpost_stack_push(ctx->lo, ctx->os, x);
     xpost_stack_push(ctx->lo, ctx->os, y);
-    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(_lineto_cont_opcode));
+    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.lineto_cont));
     xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.transform));
     return 0;
 }
@@ -337,8 +308,8 @@ int _lineto_cont(Xpost_Context *ctx, Xpost_Object x, Xpost_Object y)
     xpost_array_put(ctx, data, 0, x);
     xpost_array_put(ctx, data, 1, y);
     elem = xpost_dict_cons(ctx, 2);
-    xpost_dict_put(ctx, elem, namecmd, nameline);
-    xpost_dict_put(ctx, elem, namedata, data);
+    xpost_dict_put(ctx, elem, ctx->name_shortcuts.cmd, ctx->name_shortcuts.line);
+    xpost_dict_put(ctx, elem, ctx->name_shortcuts.data, data);
     return _addtopath(ctx, elem, _cpath(ctx));
 }
 
@@ -347,8 +318,8 @@ int _rlineto(Xpost_Context *ctx, Xpost_Object dx, Xpost_Object dy)
 {
     xpost_stack_push(ctx->lo, ctx->os, dx);
     xpost_stack_push(ctx->lo, ctx->os, dy);
-    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(_rlineto_cont_opcode));
-    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(_currentpoint_opcode));
+    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.rlineto_cont));
+    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.currentpoint));
     return 0;
 }
 
@@ -374,7 +345,7 @@ int _curveto(Xpost_Context *ctx,
     xpost_stack_push(ctx->lo, ctx->os, y2);
     xpost_stack_push(ctx->lo, ctx->os, x3);
     xpost_stack_push(ctx->lo, ctx->os, y3);
-    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(_curveto_cont1_opcode));
+    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.curveto_cont1));
     xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.transform));
     return 0;
 }
@@ -391,7 +362,7 @@ int _curveto_cont1(Xpost_Context *ctx,
     xpost_stack_push(ctx->lo, ctx->os, y1);
     xpost_stack_push(ctx->lo, ctx->os, x2);
     xpost_stack_push(ctx->lo, ctx->os, y2);
-    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(_curveto_cont2_opcode));
+    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.curveto_cont2));
     xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.transform));
     return 0;
 }
@@ -408,7 +379,7 @@ int _curveto_cont2(Xpost_Context *ctx,
     xpost_stack_push(ctx->lo, ctx->os, Y3);
     xpost_stack_push(ctx->lo, ctx->os, x1);
     xpost_stack_push(ctx->lo, ctx->os, y1);
-    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(_curveto_cont3_opcode));
+    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.curveto_cont3));
     xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.transform));
     return 0;
 }
@@ -428,8 +399,8 @@ int _curveto_cont3(Xpost_Context *ctx,
     xpost_array_put(ctx, data, 4, X3);
     xpost_array_put(ctx, data, 5, Y3);
     elem = xpost_dict_cons(ctx, 2);
-    xpost_dict_put(ctx, elem, namecmd, namecurve);
-    xpost_dict_put(ctx, elem, namedata, data);
+    xpost_dict_put(ctx, elem, ctx->name_shortcuts.cmd, ctx->name_shortcuts.curve);
+    xpost_dict_put(ctx, elem, ctx->name_shortcuts.data, data);
     return _addtopath(ctx, elem, _cpath(ctx));
 }
 
@@ -445,8 +416,8 @@ int _rcurveto(Xpost_Context *ctx,
     xpost_stack_push(ctx->lo, ctx->os, y2);
     xpost_stack_push(ctx->lo, ctx->os, x3);
     xpost_stack_push(ctx->lo, ctx->os, y3);
-    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(_rcurveto_cont_opcode));
-    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(_currentpoint_opcode));
+    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.rcurveto_cont));
+    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.currentpoint));
     return 0;
 }
 
@@ -494,14 +465,14 @@ int _closepath(Xpost_Context *ctx)
         subpath = xpost_dict_get(ctx, path, xpost_int_cons(pathlen - 1));
         subpathlen = xpost_dict_length_memory(xpost_context_select_memory(ctx, subpath), subpath);
         lastelem = xpost_dict_get(ctx, subpath, xpost_int_cons(subpathlen - 1));
-        cmd = xpost_dict_get(ctx, lastelem, namecmd);
-        if (xpost_dict_compare_objects(ctx, cmd, nameclose) != 0)
+        cmd = xpost_dict_get(ctx, lastelem, ctx->name_shortcuts.cmd);
+        if (xpost_dict_compare_objects(ctx, cmd, ctx->name_shortcuts.close) != 0)
         {
             firstelem = xpost_dict_get(ctx, subpath, xpost_int_cons(0));
-            data = xpost_dict_get(ctx, firstelem, namedata);
+            data = xpost_dict_get(ctx, firstelem, ctx->name_shortcuts.data);
             elem = xpost_dict_cons(ctx, 2);
-            xpost_dict_put(ctx, elem, namecmd, nameclose);
-            xpost_dict_put(ctx, elem, namedata, data);
+            xpost_dict_put(ctx, elem, ctx->name_shortcuts.cmd, ctx->name_shortcuts.close);
+            xpost_dict_put(ctx, elem, ctx->name_shortcuts.data, data);
             return _addtopath(ctx, elem, _cpath(ctx));
         }
     }
@@ -553,8 +524,6 @@ void _transform(Xpost_Matrix mat, real x, real y, real *xres, real *yres)
     *yres = mat.yx * x + mat.yy * y + mat.yz;
 }
 
-static
-Xpost_Object _arc_start_proc;
 
 static
 int _arcbez(Xpost_Context *ctx,
@@ -621,13 +590,13 @@ int _arc(Xpost_Context *ctx,
         //Xpost_Object path = _cpath(ctx);
         //int pathlen = xpost_dict_length_memory(xpost_context_select_memory(ctx, path), path);
         _arcbez(ctx, x, y, r, xpost_real_cons(a1), xpost_real_cons(a2));
-        xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(_curveto_opcode));
-        xpost_stack_push(ctx->lo, ctx->es, _arc_start_proc);
+        xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.curveto));
+        xpost_stack_push(ctx->lo, ctx->es, ctx->arc_start_proc);
         /*
         if (pathlen)
-            xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(_lineto_opcode));
+            xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.lineto));
         else
-            xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(_moveto_opcode));
+            xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.moveto));
             */
     }
     return 0;
@@ -656,13 +625,13 @@ int _arcn(Xpost_Context *ctx,
         //Xpost_Object path = _cpath(ctx);
         //int pathlen = xpost_dict_length_memory(xpost_context_select_memory(ctx, path), path);
         _arcbez(ctx, x, y, r, xpost_real_cons(a1), xpost_real_cons(a2));
-        xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(_curveto_opcode));
-        xpost_stack_push(ctx->lo, ctx->es, _arc_start_proc);
+        xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.curveto));
+        xpost_stack_push(ctx->lo, ctx->es, ctx->arc_start_proc);
         /*
         if (pathlen)
-            xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(_lineto_opcode));
+            xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.lineto));
         else
-            xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(_moveto_opcode));
+            xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.moveto));
             */
     }
     return 0;
@@ -727,11 +696,11 @@ int _chopcurve(Xpost_Context *ctx,
     {
         Xpost_Object elem, data;
         elem = xpost_dict_cons(ctx, 2);
-        xpost_dict_put(ctx, elem, namecmd, nameline);
+        xpost_dict_put(ctx, elem, ctx->name_shortcuts.cmd, ctx->name_shortcuts.line);
         data = xpost_object_cvlit(xpost_array_cons(ctx, 2));
         xpost_array_put(ctx, data, 0, xpost_real_cons(x3));
         xpost_array_put(ctx, data, 1, xpost_real_cons(y3));
-        xpost_dict_put(ctx, elem, namedata, data);
+        xpost_dict_put(ctx, elem, ctx->name_shortcuts.data, data);
         _addtopath(ctx, elem, _cpath(ctx));
     }
     else
@@ -755,11 +724,11 @@ int _flattenpath (Xpost_Context *ctx)
     int ret;
     int i;
 
-    ret = xpost_op_any_load(ctx, namegraphicsdict);
+    ret = xpost_op_any_load(ctx, ctx->name_shortcuts.graphicsdict);
     if (ret) return ret;
     gd = xpost_stack_pop(ctx->lo, ctx->os);
     xpost_stack_push(ctx->lo, ctx->hold, gd);
-    gstate = xpost_dict_get(ctx, gd, namecurrgstate);
+    gstate = xpost_dict_get(ctx, gd, ctx->name_shortcuts.currgstate);
     flat = xpost_dict_get(ctx, gstate, xpost_name_cons(ctx, "flat"));
 
     path = _cpath(ctx);
@@ -794,27 +763,27 @@ int _flattenpath (Xpost_Context *ctx)
                 XPOST_LOG_ERR("elem %d not found in subpath %d (size %d)", j, i, subpathlen);
                 return undefined;
             }
-            cmd = xpost_dict_get(ctx, elem, namecmd);
+            cmd = xpost_dict_get(ctx, elem, ctx->name_shortcuts.cmd);
             if (xpost_object_get_type(cmd) == invalidtype)
             {
                 XPOST_LOG_ERR("/cmd not found in elem %d of subpath %d", j, i);
                 return undefined;
             }
-            if (cmd.mark_.padw == namemove.mark_.padw)
+            if (cmd.mark_.padw == ctx->name_shortcuts.move.mark_.padw)
             {
-                cp = xpost_dict_get(ctx, elem, namedata);
+                cp = xpost_dict_get(ctx, elem, ctx->name_shortcuts.data);
                 ret = _addtopath(ctx, elem, the_new_path);
                 if (ret)
                     return ret;
             }
-            else if (cmd.mark_.padw == nameline.mark_.padw)
+            else if (cmd.mark_.padw == ctx->name_shortcuts.line.mark_.padw)
             {
-                cp = xpost_dict_get(ctx, elem, namedata);
+                cp = xpost_dict_get(ctx, elem, ctx->name_shortcuts.data);
                 ret = _addtopath(ctx, elem, the_new_path);
                 if (ret)
                     return ret;
             }
-            else if (cmd.mark_.padw == namecurve.mark_.padw)
+            else if (cmd.mark_.padw == ctx->name_shortcuts.curve.mark_.padw)
             {
 
                 Xpost_Object data;
@@ -822,7 +791,7 @@ int _flattenpath (Xpost_Context *ctx)
                 x0 = NUM(num);
                 num = xpost_array_get(ctx, cp, 1);
                 y0 = NUM(num);
-                data = xpost_dict_get(ctx, elem, namedata);
+                data = xpost_dict_get(ctx, elem, ctx->name_shortcuts.data);
                 num = xpost_array_get(ctx, data, 0);
                 x1 = NUM(num);
                 num = xpost_array_get(ctx, data, 1);
@@ -839,9 +808,9 @@ int _flattenpath (Xpost_Context *ctx)
 
                 _chopcurve(ctx, x0, y0, x1, y1, x2, y2, x3, y3, flat);
             }
-            else if (cmd.mark_.padw == nameclose.mark_.padw)
+            else if (cmd.mark_.padw == ctx->name_shortcuts.close.mark_.padw)
             {
-                cp = xpost_dict_get(ctx, elem, namedata);
+                cp = xpost_dict_get(ctx, elem, ctx->name_shortcuts.data);
                 ret = _addtopath(ctx, elem, the_new_path);
                 if (ret)
                     return ret;
@@ -864,80 +833,77 @@ int xpost_oper_init_path_ops(Xpost_Context *ctx,
     //xpost_memory_table_get_addr(ctx->gl, XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE, &optadr);
     //optab = (void *)(ctx->gl->base + optadr);
 
-    if (xpost_object_get_type((namegraphicsdict = xpost_name_cons(ctx, "graphicsdict"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.graphicsdict = xpost_name_cons(ctx, "graphicsdict"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((namecurrgstate = xpost_name_cons(ctx, "currgstate"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.currgstate = xpost_name_cons(ctx, "currgstate"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((namecurrpath = xpost_name_cons(ctx, "currpath"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.currpath = xpost_name_cons(ctx, "currpath"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((namecmd = xpost_name_cons(ctx, "cmd"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.cmd = xpost_name_cons(ctx, "cmd"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((namedata = xpost_name_cons(ctx, "data"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.data = xpost_name_cons(ctx, "data"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((namemove = xpost_name_cons(ctx, "move"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.move = xpost_name_cons(ctx, "move"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((nameline = xpost_name_cons(ctx, "line"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.line = xpost_name_cons(ctx, "line"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((namecurve = xpost_name_cons(ctx, "curve"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.curve = xpost_name_cons(ctx, "curve"))) == invalidtype)
         return VMerror;
-    if (xpost_object_get_type((nameclose = xpost_name_cons(ctx, "close"))) == invalidtype)
+    if (xpost_object_get_type((ctx->name_shortcuts.close = xpost_name_cons(ctx, "close"))) == invalidtype)
         return VMerror;
 
-    _mat = xpost_object_cvlit(xpost_array_cons(ctx, 6));
-    _mat1 = xpost_object_cvlit(xpost_array_cons(ctx, 6));
-
     op = xpost_operator_cons(ctx, "newpath", (Xpost_Op_Func)_newpath, 0, 0);
     INSTALL;
     op = xpost_operator_cons(ctx, "currentpoint", (Xpost_Op_Func)_currentpoint, 0, 0);
-    _currentpoint_opcode = op.mark_.padw;
+    ctx->opcode_shortcuts.currentpoint = op.mark_.padw;
     INSTALL;
 
     op = xpost_operator_cons(ctx, "moveto", (Xpost_Op_Func)_moveto, 0, 2, numbertype, numbertype);
-    _moveto_opcode = op.mark_.padw;
+    ctx->opcode_shortcuts.moveto = op.mark_.padw;
     INSTALL;
     op = xpost_operator_cons(ctx, "moveto_cont", (Xpost_Op_Func)_moveto_cont, 0, 2, numbertype, numbertype);
-    _moveto_cont_opcode = op.mark_.padw;
+    ctx->opcode_shortcuts.moveto_cont = op.mark_.padw;
 
     op = xpost_operator_cons(ctx, "rmoveto", (Xpost_Op_Func)_rmoveto, 0, 2, floattype, floattype);
     INSTALL;
     op = xpost_operator_cons(ctx, "rmoveto_cont", (Xpost_Op_Func)_rmoveto_cont, 0, 4,
                              floattype, floattype, floattype, floattype);
-    _rmoveto_cont_opcode = op.mark_.padw;
+    ctx->opcode_shortcuts.rmoveto_cont = op.mark_.padw;
 
     op = xpost_operator_cons(ctx, "lineto", (Xpost_Op_Func)_lineto, 0, 2, numbertype, numbertype);
-    _lineto_opcode = op.mark_.padw;
+    ctx->opcode_shortcuts.lineto = op.mark_.padw;
     INSTALL;
     op = xpost_operator_cons(ctx, "lineto_cont", (Xpost_Op_Func)_lineto_cont, 0, 2, numbertype, numbertype);
-    _lineto_cont_opcode = op.mark_.padw;
+    ctx->opcode_shortcuts.lineto_cont = op.mark_.padw;
 
     op = xpost_operator_cons(ctx, "rlineto", (Xpost_Op_Func)_rlineto, 0, 2, floattype, floattype);
     INSTALL;
     op = xpost_operator_cons(ctx, "rlineto_cont", (Xpost_Op_Func)_rlineto_cont, 0, 4,
                              floattype, floattype, floattype, floattype);
-    _rlineto_cont_opcode = op.mark_.padw;
+    ctx->opcode_shortcuts.rlineto_cont = op.mark_.padw;
 
     op = xpost_operator_cons(ctx, "curveto", (Xpost_Op_Func)_curveto, 0, 6,
                              numbertype, numbertype, numbertype, numbertype, numbertype, numbertype);
-    _curveto_opcode = op.mark_.padw;
+    ctx->opcode_shortcuts.curveto = op.mark_.padw;
     INSTALL;
     op = xpost_operator_cons(ctx, "curveto_cont1", (Xpost_Op_Func)_curveto_cont1, 0, 6,
                              numbertype, numbertype, numbertype, numbertype, numbertype, numbertype);
-    _curveto_cont1_opcode = op.mark_.padw;
+    ctx->opcode_shortcuts.curveto_cont1 = op.mark_.padw;
 
     op = xpost_operator_cons(ctx, "curveto_cont2", (Xpost_Op_Func)_curveto_cont2, 0, 6,
                              numbertype, numbertype, numbertype, numbertype, numbertype, numbertype);
-    _curveto_cont2_opcode = op.mark_.padw;
+    ctx->opcode_shortcuts.curveto_cont2 = op.mark_.padw;
 
     op = xpost_operator_cons(ctx, "curveto_cont3", (Xpost_Op_Func)_curveto_cont3, 0, 6,
                              numbertype, numbertype, numbertype, numbertype, numbertype, numbertype);
-    _curveto_cont3_opcode = op.mark_.padw;
+    ctx->opcode_shortcuts.curveto_cont3 = op.mark_.padw;
 
     op = xpost_operator_cons(ctx, "rcurveto", (Xpost_Op_Func)_rcurveto, 0, 6,
                              floattype, floattype, floattype, floattype, floattype, floattype);
     INSTALL;
     op = xpost_operator_cons(ctx, "rcurveto_cont", (Xpost_Op_Func)_rcurveto_cont, 0, 8,
                              floattype, floattype, floattype, floattype, floattype, floattype, floattype, floattype);
-    _rcurveto_cont_opcode = op.mark_.padw;
+    ctx->opcode_shortcuts.rcurveto_cont = op.mark_.padw;
 
     op = xpost_operator_cons(ctx, "closepath", (Xpost_Op_Func)_closepath, 0, 0);
     INSTALL;
@@ -952,22 +918,22 @@ int xpost_oper_init_path_ops(Xpost_Context *ctx,
     op = xpost_operator_cons(ctx, "flattenpath", (Xpost_Op_Func)_flattenpath, 0, 0);
     INSTALL;
 
-    _arc_start_proc = xpost_array_cons(ctx, 7);
-    xpost_array_put(ctx, _arc_start_proc, 0, xpost_object_cvx(xpost_name_cons(ctx, "cpath")));
-    xpost_array_put(ctx, _arc_start_proc, 1, xpost_object_cvx(xpost_name_cons(ctx, "length")));
-    xpost_array_put(ctx, _arc_start_proc, 2, xpost_int_cons(0));
-    xpost_array_put(ctx, _arc_start_proc, 3, xpost_object_cvx(xpost_name_cons(ctx, "gt")));
+    ctx->arc_start_proc = xpost_array_cons(ctx, 7);
+    xpost_array_put(ctx, ctx->arc_start_proc, 0, xpost_object_cvx(xpost_name_cons(ctx, "cpath")));
+    xpost_array_put(ctx, ctx->arc_start_proc, 1, xpost_object_cvx(xpost_name_cons(ctx, "length")));
+    xpost_array_put(ctx, ctx->arc_start_proc, 2, xpost_int_cons(0));
+    xpost_array_put(ctx, ctx->arc_start_proc, 3, xpost_object_cvx(xpost_name_cons(ctx, "gt")));
     {
         Xpost_Object true_clause = xpost_object_cvx(xpost_array_cons(ctx, 1));
         xpost_array_put(ctx, true_clause, 0, xpost_object_cvx(xpost_name_cons(ctx, "lineto")));
-        xpost_array_put(ctx, _arc_start_proc, 4, true_clause);
+        xpost_array_put(ctx, ctx->arc_start_proc, 4, true_clause);
     }
     {
         Xpost_Object false_clause = xpost_object_cvx(xpost_array_cons(ctx, 1));
         xpost_array_put(ctx, false_clause, 0, xpost_object_cvx(xpost_name_cons(ctx, "moveto")));
-        xpost_array_put(ctx, _arc_start_proc, 5, false_clause);
+        xpost_array_put(ctx, ctx->arc_start_proc, 5, false_clause);
     }
-    xpost_array_put(ctx, _arc_start_proc, 6, xpost_object_cvx(xpost_name_cons(ctx, "ifelse")));
+    xpost_array_put(ctx, ctx->arc_start_proc, 6, xpost_object_cvx(xpost_name_cons(ctx, "ifelse")));
 
     return 0;
 }
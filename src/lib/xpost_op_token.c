@@ -33,13 +33,12 @@
 #endif
 
 #include <assert.h>
-#include <ctype.h>
 #include <errno.h> /* errno */
 #include <limits.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <string.h> /* strchr */
+#include <string.h> /* memcpy */
 
 #include "xpost.h"
 #include "xpost_log.h"
@@ -62,192 +61,230 @@
 
 enum { NBUF = 2 * BUFSIZ };
 
-static
-int puff(Xpost_Context *ctx,
-         char *buf,
-         int nbuf,
-         Xpost_Object *src,
-         int (*next)(Xpost_Context *ctx, Xpost_Object *src),
-         void (*back)(Xpost_Context *ctx, int c, Xpost_Object *src));
-static
-int toke(Xpost_Context *ctx,
-         Xpost_Object *src,
-         int (*next)(Xpost_Context *ctx, Xpost_Object *src),
-         void (*back)(Xpost_Context *ctx, int c, Xpost_Object *src),
-         Xpost_Object *retval);
+/* character classes of the scanner */
+#define XPOST_SCAN_SPACE  1  /* white space */
+#define XPOST_SCAN_DELIM  2  /* ()[]<>{}/% */
+#define XPOST_SCAN_DIGIT  4  /* 0-9 */
+#define XPOST_SCAN_XDIGIT 8  /* 0-9 A-F a-f */
+#define XPOST_SCAN_ALNUM 16  /* 0-9 A-Z a-z */
+#define XPOST_SCAN_EOL   32  /* ends a comment */
+#define XPOST_SCAN_BINARY 64  /* 128-159, binary token */
 
-static
-int ishash(int c)
-{
-    return c == '#';
-}
+/* characters which end a name or number */
+#define XPOST_SCAN_END (XPOST_SCAN_SPACE | XPOST_SCAN_DELIM | XPOST_SCAN_BINARY)
 
-static
-int isdot(int c)
-{
-    return c == '.';
-}
+#define S_ XPOST_SCAN_SPACE
+#define L_ (XPOST_SCAN_SPACE | XPOST_SCAN_EOL)
+#define D_ XPOST_SCAN_DELIM
+#define N_ (XPOST_SCAN_DIGIT | XPOST_SCAN_XDIGIT | XPOST_SCAN_ALNUM)
+#define H_ (XPOST_SCAN_XDIGIT | XPOST_SCAN_ALNUM)
+#define A_ XPOST_SCAN_ALNUM
+#define B_ XPOST_SCAN_BINARY
 
-/* FIXME: return (c == 'e') || (c = 'E') faster ? */
+/* class of each byte, replacing strchr and ctype calls */
 static
-int ise(int c)
-{
-    return strchr("eE", c) != NULL;
-}
+const unsigned char _xpost_scan_class[256] = {
+    0,  0,  0,  0,  0,  0,  0,  0,  0, S_, L_, S_, L_, S_,  0,  0, /* \t \n \v \f \r */
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   S_,  0,  0,  0,  0, D_,  0,  0, D_, D_,  0,  0,  0,  0,  0, D_, /* space % ( ) / */
+   N_, N_, N_, N_, N_, N_, N_, N_, N_, N_,  0,  0, D_,  0, D_,  0, /* 0-9 < > */
+    0, H_, H_, H_, H_, H_, H_, A_, A_, A_, A_, A_, A_, A_, A_, A_, /* A-O */
+   A_, A_, A_, A_, A_, A_, A_, A_, A_, A_, A_, D_,  0, D_,  0,  0, /* P-Z [ ] */
+    0, H_, H_, H_, H_, H_, H_, A_, A_, A_, A_, A_, A_, A_, A_, A_, /* a-o */
+   A_, A_, A_, A_, A_, A_, A_, A_, A_, A_, A_, D_,  0, D_,  0,  0, /* p-z { } */
+   B_, B_, B_, B_, B_, B_, B_, B_, B_, B_, B_, B_, B_, B_, B_, B_, /* 128-143 */
+   B_, B_, B_, B_, B_, B_, B_, B_, B_, B_, B_, B_, B_, B_, B_, B_, /* 144-159 */
+    /* 160-255 are regular characters */
+};
 
-/* FIXME: see FIXME above */
-static
-int issign(int c)
-{
-    return strchr("+-", c) != NULL;
-}
+#undef S_
+#undef L_
+#undef D_
+#undef N_
+#undef H_
+#undef A_
+#undef B_
 
-/* FIXME: see FIXME above */
-static
-int isdel(int c)
-{
-    return strchr("()[]<>{}/%", c) != NULL;
-}
+#define XPOST_SCAN_IS(c, cls) (_xpost_scan_class[(unsigned char)(c)] & (cls))
 
-static
-int isreg(int c)
-{
-    return (c != EOF) && (!isspace(c)) && (!isdel(c));
-}
+/* value of a digit of a radix number or a hex string */
+#define XPOST_SCAN_VALUE(c) \
+    ((c) <= '9' ? (c) - '0' : ((c) | 0x20) - 'a' + 10)
 
-//int isxdigit (int c) { return strchr("0123456789ABCDEFabcdef", c) != NULL; }
+/* largest value of an integer object */
+#define XPOST_SCAN_INTEGER_MAX \
+    (sizeof(integer) < sizeof(long) ? \
+     (unsigned long)((dword)~(dword)0 >> 1) : (unsigned long)LONG_MAX)
 
+/* the source of the scanner:
+   a FILE *, read through stdio,
+   or the bytes of a string, or of a file read from memory, read in place.
+   the string is re-located at each token, since vm may move
+   while the objects of a procedure body are allocated. */
 typedef
 struct
 {
-    int (*pred)(int);
-    int y;
-    int n;
-} test;
-
-test fsm_dec[] = {
-    /*  int pred(int), y,  n */
-    /*       -------- --  -- */
-    /* 0 */ { issign,  1,  1 },
-    /* 1 */ { isdigit, 2, -1 },
-    /* 2 */ { isdigit, 2, -1 } };
+    Xpost_Context *ctx;
+    FILE *fp;
+    Xpost_Object *str;
+    Xpost_File_Map *map;
+    int hit; /* the scan of the bytes reached their end */
+    const unsigned char *beg;
+    const unsigned char *p;
+    const unsigned char *end;
+} scanner;
+
 static
-int accept_dec(int i)
+void resync(scanner *sc)
 {
-    return i == 2;
+    unsigned int n;
+
+    if (sc->fp || sc->map) /* a span does not move */
+        return;
+    n = sc->p - sc->beg;
+    sc->str->comp_.off += n;
+    sc->str->comp_.sz -= n;
+    sc->beg = sc->p = (unsigned char *)xpost_string_get_pointer(sc->ctx, *sc->str);
+    sc->end = sc->p + sc->str->comp_.sz;
 }
 
-test fsm_rad[] = {
-    /* 0 */ { isdigit, 1, -1 },
-    /* 1 */ { isdigit, 1,  2 },
-    /* 2 */ { ishash,  3, -1 },
-    /* 3 */ { isalnum, 4, -1 },
-    /* 4 */ { isalnum, 4, -1 } };
+/* whether more bytes may be added to the span:
+   a syntax error at its end is not reported, the scan is retried */
 static
-int accept_rad(int i)
+int growing(scanner *sc)
 {
-    return i == 4;
+    return sc->map && !sc->map->ended;
 }
 
-test fsm_real[] = {
-    /* 0 */  { issign,  1,   1 },
-    /* 1 */  { isdigit, 2,   4 },
-    /* 2 */  { isdigit, 2,   3 },
-    /* 3 */  { isdot,   6,   7 },
-    /* 4 */  { isdot,   5,  -1 },
-    /* 5 */  { isdigit, 6,  -1 },
-    /* 6 */  { isdigit, 6,   7 },
-    /* 7 */  { ise,     8,  -1 },
-    /* 8 */  { issign,  9,   9 },
-    /* 9 */  { isdigit, 10, -1 },
-    /* 10 */ { isdigit, 10, -1 } };
 static
-int accept_real(int i)
+int next(scanner *sc)
 {
-    switch (i) { //case 2:
-        case 6: case 10: return 1; default: return 0; }
-    //return (i & 3) == 2;  // 2, 6 == 2|4, 10 == 2|8
+    if (sc->fp)
+        return xpost_file_getc(sc->fp);
+    if (sc->p < sc->end)
+        return *sc->p++;
+    sc->hit = 1;
+    return EOF;
 }
 
 static
-int fsm_check(char *s,
-              int ns,
-              test *fsm,
-              int (*accept)(int final))
+void back(scanner *sc, int c)
 {
-    int sta = 0;
-    char *sp = s;
-    while (sta != -1 && *sp)
-    {
-        if (sp - s > ns) break;
-        if (fsm[sta].pred(*sp))
-        {
-            sta = fsm[sta].y;
-            ++sp;
-        }
-        else
-        {
-            sta = fsm[sta].n;
-        }
-    }
-    return accept(sta);
+    if (c == EOF)
+        return;
+    if (sc->fp)
+        (void)ungetc(c, sc->fp);
+    else
+        --sc->p;
 }
 
 static
-int grok(Xpost_Context *ctx,
-         char *s,
-         int ns,
-         Xpost_Object *src,
-         int (*next)(Xpost_Context *ctx, Xpost_Object *src),
-         void (*back)(Xpost_Context *ctx, int c, Xpost_Object *src),
-         Xpost_Object *retval)
+int puff(scanner *sc,
+         char *buf,
+         int nbuf);
+static
+int toke(scanner *sc,
+         Xpost_Object *retval);
+
+/* scan a whole token as a number in one pass.
+     [sign] digits                                    integer
+     digits # alnum...                                radix integer
+     [sign] (digits [. digits] | . digits) [e [sign] digits]  real
+   anything else is not a number (*isnum = 0), and becomes a name.
+   s must be nul-terminated. */
+static
+int number(char *s,
+           int ns,
+           int *isnum,
+           Xpost_Object *retval)
 {
-    Xpost_Object obj;
-    //printf("grok: %s\n", s);
+    const unsigned char *p = (unsigned char *)s;
+    const unsigned char *e = p + ns;
+    unsigned long val = 0;
+    int overflow = 0;
+    int sign = 0;
+    int ndig = 0;
+    int nfrac = 0;
 
-    if (ns == NBUF)
+    *isnum = 0;
+
+    if (p < e && (*p == '+' || *p == '-'))
+        sign = *p++;
+    for ( ; p < e && XPOST_SCAN_IS(*p, XPOST_SCAN_DIGIT); ++p, ++ndig)
     {
-        XPOST_LOG_ERR("buf maxxed");
-        return limitcheck;
+        if (val > (ULONG_MAX - 9) / 10)
+            overflow = 1;
+        val = val * 10 + (*p - '0');
     }
-    s[ns] = '\0';  //fsm_check & xpost_name_cons  terminate on \0
 
-    if (fsm_check(s, ns, fsm_dec, accept_dec))
+    if (p == e) /* integer */
     {
-        long num;
-        num = strtol(s, NULL, 10);
-        if ((num == LONG_MAX || num == LONG_MIN) && errno==ERANGE)
+        if (!ndig)
+            return 0;
+        *isnum = 1;
+        if (!overflow &&
+            val <= (sign == '-' ? XPOST_SCAN_INTEGER_MAX + 1 : XPOST_SCAN_INTEGER_MAX))
         {
-            XPOST_LOG_ERR("integer out of range");
-            return limitcheck;
+            *retval = xpost_int_cons(sign == '-' ? (integer)(0 - val) : (integer)val);
+            return 0;
         }
-        //return xpost_int_cons(num);
-        *retval = xpost_int_cons(num);
+        /* too large for an integer: a real, like the PLRM says */
+        *retval = xpost_real_cons((real)strtod(s, NULL));
         return 0;
     }
 
-    else if (fsm_check(s, ns, fsm_rad, accept_rad))
+    if (*p == '#') /* radix integer */
     {
-        long base, num;
-        base = strtol(s, &s, 10);
-        if ((base > 36) || (base < 2))
+        const unsigned char *q;
+        unsigned long base = val;
+        unsigned long num = 0;
+        int d;
+
+        if (sign || !ndig || p + 1 == e)
+            return 0;
+        for (q = p + 1; q < e; ++q)
+            if (!XPOST_SCAN_IS(*q, XPOST_SCAN_ALNUM))
+                return 0;
+        *isnum = 1;
+        if (overflow || base > 36 || base < 2)
         {
             XPOST_LOG_ERR("bad radix");
             return limitcheck;
         }
-        errno = 0;
-        num = strtol(s + 1, NULL, base);
-        if ((num == LONG_MAX || num == LONG_MIN) && errno == ERANGE)
+        /* like strtol, stop at the first digit out of the base */
+        for (q = p + 1; q < e && (d = XPOST_SCAN_VALUE(*q)) < (int)base; ++q)
         {
-            XPOST_LOG_ERR("radixnumber out of range");
-            return limitcheck;
+            if (num > ((unsigned long)LONG_MAX - d) / base)
+            {
+                XPOST_LOG_ERR("radixnumber out of range");
+                return limitcheck;
+            }
+            num = num * base + d;
         }
-        //return xpost_int_cons(num);
-        *retval = xpost_int_cons(num);
+        *retval = xpost_int_cons((long)num);
         return 0;
     }
 
-    else if (fsm_check(s, ns, fsm_real, accept_real))
+    /* real */
+    if (*p == '.')
+        for (++p; p < e && XPOST_SCAN_IS(*p, XPOST_SCAN_DIGIT); ++p)
+            ++nfrac;
+    if (!ndig && !nfrac)
+        return 0;
+    if (p < e && (*p == 'e' || *p == 'E'))
+    {
+        ++p;
+        if (p < e && (*p == '+' || *p == '-'))
+            ++p;
+        if (p == e || !XPOST_SCAN_IS(*p, XPOST_SCAN_DIGIT))
+            return 0;
+        while (p < e && XPOST_SCAN_IS(*p, XPOST_SCAN_DIGIT))
+            ++p;
+    }
+    if (p != e)
+        return 0;
+
+    *isnum = 1;
     {
         double num;
         num = strtod(s, NULL);
@@ -256,245 +293,303 @@ int grok(Xpost_Context *ctx,
             XPOST_LOG_ERR("real out of range");
             return limitcheck;
         }
-        //return xpost_real_cons(num);
         *retval = xpost_real_cons((real)num);
+    }
+    return 0;
+}
+
+static
+int grok(scanner *sc,
+         char *s,
+         int ns,
+         Xpost_Object *retval)
+{
+    Xpost_Context *ctx = sc->ctx;
+    Xpost_Object obj;
+    int isnum;
+    int ret;
+    //printf("grok: %s\n", s);
+
+    if (ns == NBUF)
+    {
+        XPOST_LOG_ERR("buf maxxed");
+        return limitcheck;
+    }
+    s[ns] = '\0';  //strtod & xpost_name_cons  terminate on \0
+
+    if (!XPOST_SCAN_IS(*s, XPOST_SCAN_DELIM))
+    {
+        ret = number(s, ns, &isnum, retval);
+        if (isnum)
+            return ret;
+        *retval = xpost_object_cvx(xpost_name_cons(ctx, s));
         return 0;
     }
 
-    else
-        switch(*s)
+    switch(*s)
+    {
+        case '(':
         {
-            case '(':
+            int c, defer = 1;
+            char *sp = s;
+            while (defer && (c = next(sc)) != EOF)
             {
-                int c, defer = 1;
-                char *sp = s;
-                while (defer && (c = next(ctx, src)) != EOF)
+                switch(c)
                 {
-                    switch(c)
-                    {
-                        case '(': ++defer; break;
-                        case ')': --defer; break;
-                        case '\\':
-                            switch(c = next(ctx, src))
-                            {
-                                case '\n': continue;
-                                case 'a': c = '\a'; break;
-                                case 'b': c = '\b'; break;
-                                case 'f': c = '\f'; break;
-                                case 'n': c = '\n'; break;
-                                case 'r': c = '\r'; break;
-                                case 't': c = '\t'; break;
-                                case 'v': c = '\v'; break;
-                                default:
-                                    if (isdigit(c))
-                                    {
-                                        int t = 0, n = 0;
-                                        do {
-                                            t *= 8;
-                                            t += c - '0';
-                                            ++n;
-                                            c = next(ctx, src);
-                                        } while (isdigit(c) && n < 3);
-                                        if (!isdigit(c)) back(ctx, c, src);
-                                        c = t;
-                                    }
-                            }
-                    }
-                    if (!defer) break;
-                    if (sp - s > NBUF)
-                    {
-                        XPOST_LOG_ERR("string exceeds buf");
-                        return limitcheck;
-                    }
-                    else *sp++ = c;
+                    case '(': ++defer; break;
+                    case ')': --defer; break;
+                    case '\\':
+                        switch(c = next(sc))
+                        {
+                            case '\n': continue;
+                            case 'a': c = '\a'; break;
+                            case 'b': c = '\b'; break;
+                            case 'f': c = '\f'; break;
+                            case 'n': c = '\n'; break;
+                            case 'r': c = '\r'; break;
+                            case 't': c = '\t'; break;
+                            case 'v': c = '\v'; break;
+                            default:
+                                if (c != EOF && XPOST_SCAN_IS(c, XPOST_SCAN_DIGIT))
+                                {
+                                    int t = 0, n = 0;
+                                    do {
+                                        t *= 8;
+                                        t += c - '0';
+                                        ++n;
+                                        c = next(sc);
+                                    } while (c != EOF && XPOST_SCAN_IS(c, XPOST_SCAN_DIGIT) && n < 3);
+                                    if (c == EOF || !XPOST_SCAN_IS(c, XPOST_SCAN_DIGIT)) back(sc, c);
+                                    c = t;
+                                }
+                        }
                 }
-                obj = xpost_string_cons(ctx, sp - s, s);
-                if (xpost_object_get_type(obj) == nulltype)
-                    return VMerror;
-                //return xpost_object_cvlit(obj);
-                *retval = xpost_object_cvlit(obj);
-                return 0;
+                if (!defer) break;
+                if (sp - s > NBUF)
+                {
+                    XPOST_LOG_ERR("string exceeds buf");
+                    return limitcheck;
+                }
+                else *sp++ = c;
             }
+            obj = xpost_string_cons(ctx, sp - s, s);
+            if (xpost_object_get_type(obj) == nulltype)
+                return VMerror;
+            //return xpost_object_cvlit(obj);
+            *retval = xpost_object_cvlit(obj);
+            return 0;
+        }
 
-            case '<':
+        case '<':
+        {
+            int c;
+            char d;
+            char *sp = s;
+            c = next(sc);
+            if (c == '<')
             {
-                int c;
-                char d;
-                const char *x = "0123456789ABCDEF";
-                char *sp = s;
-                c = next(ctx, src);
-                if (c == '<')
+                //return xpost_object_cvx(xpost_name_cons(ctx, "<<"));
+                *retval = xpost_object_cvx(xpost_name_cons(ctx, "<<"));
+                return 0;
+            }
+            back(sc, c);
+            while (c = next(sc), c != '>' && c != EOF)
+            {
+                if (XPOST_SCAN_IS(c, XPOST_SCAN_SPACE))
+                    continue;
+                if (XPOST_SCAN_IS(c, XPOST_SCAN_XDIGIT))
+                    c = XPOST_SCAN_VALUE(c);
+                else
+                {
+                    XPOST_LOG_ERR("non-hex digit in hex string");
+                    return syntaxerror;
+                }
+                d = c << 4; // hi nib
+                while ((c = next(sc)) != EOF && XPOST_SCAN_IS(c, XPOST_SCAN_SPACE))
+                    /**/;
+                if (c != EOF && XPOST_SCAN_IS(c, XPOST_SCAN_XDIGIT))
+                    c = XPOST_SCAN_VALUE(c);
+                else if (c == '>')
                 {
-                    //return xpost_object_cvx(xpost_name_cons(ctx, "<<"));
-                    *retval = xpost_object_cvx(xpost_name_cons(ctx, "<<"));
-                    return 0;
+                    back(sc, c); // pushback for next iter
+                    c = 0;       // pretend it got a 0
                 }
-                back(ctx, c, src);
-                while (c = next(ctx, src), c != '>' && c != EOF)
+                else
                 {
-                    if (isspace(c))
-                        continue;
-                    if (isxdigit(c))
-                        c = strchr(x, toupper(c)) - x;
-                    else
-                    {
+                    if (c != EOF || !growing(sc))
                         XPOST_LOG_ERR("non-hex digit in hex string");
-                        return syntaxerror;
-                    }
-                    d = c << 4; // hi nib
-                    while (isspace(c = next(ctx, src)))
-                        /**/;
-                    if (isxdigit(c))
-                        c = strchr(x, toupper(c)) - x;
-                    else if (c == '>')
-                    {
-                        back(ctx, c, src); // pushback for next iter
-                        c = 0;             // pretend it got a 0
-                    }
-                    else
-                    {
-                        XPOST_LOG_ERR("non-hex digit in hex string");
-                        return syntaxerror;
-                    }
-                    d |= c;
-                    if (sp - s > NBUF)
-                    {
-                        XPOST_LOG_ERR("hexstring exceeds buf");
-                        return limitcheck;
-                    }
-                    *sp++ = d;
+                    return syntaxerror;
                 }
-                obj = xpost_string_cons(ctx, sp - s, s);
-                if (xpost_object_get_type(obj) == nulltype)
-                    return VMerror;
-                //return xpost_object_cvlit(obj);
-                *retval = xpost_object_cvlit(obj);
+                d |= c;
+                if (sp - s > NBUF)
+                {
+                    XPOST_LOG_ERR("hexstring exceeds buf");
+                    return limitcheck;
+                }
+                *sp++ = d;
+            }
+            obj = xpost_string_cons(ctx, sp - s, s);
+            if (xpost_object_get_type(obj) == nulltype)
+                return VMerror;
+            //return xpost_object_cvlit(obj);
+            *retval = xpost_object_cvlit(obj);
+            return 0;
+        }
+
+        case '>':
+        {
+            int c;
+            if ((c = next(sc)) == '>')
+            {
+                //return xpost_object_cvx(xpost_name_cons(ctx, ">>"));
+                *retval = xpost_object_cvx(xpost_name_cons(ctx, ">>"));
                 return 0;
             }
+            else
+            {
+                XPOST_LOG_ERR("bare angle bracket");
+                return syntaxerror;
+            }
+        }
+        return unregistered; //not reached
 
-            case '>':
+        case '{':
+        { // This is the one part that makes it a recursive-descent parser
+            Xpost_Object tail;
+            tail = xpost_name_cons(ctx, "}");
+            xpost_stack_push(ctx->lo, ctx->os, mark);
+            while (1)
             {
-                int c;
-                if ((c = next(ctx, src)) == '>')
-                {
-                    //return xpost_object_cvx(xpost_name_cons(ctx, ">>"));
-                    *retval = xpost_object_cvx(xpost_name_cons(ctx, ">>"));
-                    return 0;
-                }
-                else
+                Xpost_Object t;
+                ret = toke(sc, &t);
+                //printf("grok: x?%d", xpost_object_is_exe(t));
+                if (ret)
+                    return ret;
+                if (xpost_object_get_type(t) == nulltype)
                 {
-                    XPOST_LOG_ERR("bare angle bracket");
+                    /* the input ended within the body,
+                       unless more is to come in a growing span */
+                    if (!growing(sc))
+                        XPOST_LOG_ERR("unterminated procedure");
                     return syntaxerror;
                 }
+                if ((xpost_object_get_type(t) == nametype) &&
+                    (xpost_dict_compare_objects(ctx, t, tail) == 0))
+                    break;
+                xpost_stack_push(ctx->lo, ctx->os, t);
             }
-            return unregistered; //not reached
-
-            case '{':
-            { // This is the one part that makes it a recursive-descent parser
-                int ret;
-                Xpost_Object tail;
-                tail = xpost_name_cons(ctx, "}");
-                xpost_stack_push(ctx->lo, ctx->os, mark);
-                while (1)
+            ret = xpost_op_array_to_mark(ctx);  // ie. the /] operator
+            if (ret)
+                return ret;
+            //return xpost_object_cvx(xpost_stack_pop(ctx->lo, ctx->os));
+            *retval = xpost_object_cvx(xpost_stack_pop(ctx->lo, ctx->os));
+            return 0;
+        }
+
+        case '/':
+        {
+            int c = next(sc);
+            *s = c;
+            if (c == '/')
+            {
+                Xpost_Object r;
+                ns = puff(sc, s, NBUF);
+                if (ns == NBUF)
                 {
-                    Xpost_Object t;
-                    ret = toke(ctx, src, next, back, &t);
-                    //printf("grok: x?%d", xpost_object_is_exe(t));
-                    if (ret)
-                        return ret;
-                    if ((xpost_object_get_type(t) == nametype) &&
-                        (xpost_dict_compare_objects(ctx, t, tail) == 0))
-                        break;
-                    xpost_stack_push(ctx->lo, ctx->os, t);
+                    XPOST_LOG_ERR("immediate name exceeds buf");
+                    return limitcheck;
                 }
-                ret = xpost_op_array_to_mark(ctx);  // ie. the /] operator
-                if (ret)
-                    return ret;
-                //return xpost_object_cvx(xpost_stack_pop(ctx->lo, ctx->os));
-                *retval = xpost_object_cvx(xpost_stack_pop(ctx->lo, ctx->os));
+                s[ns] = '\0';
+                //xpost_stack_push(ctx->lo, ctx->os, xpost_object_cvx(xpost_name_cons(ctx, s)));
+                //xpost_operator_exec(ctx, xpost_operator_cons(ctx, "load", NULL,0,0).mark_.padw);
+                if (ctx->debugload)
+                    printf("\ntoken: loading immediate name %s\n", s);
+                xpost_op_any_load(ctx, xpost_object_cvx(xpost_name_cons(ctx, s)));
+                r = xpost_stack_pop(ctx->lo, ctx->os);
+                if (ctx->debugload)
+                    xpost_object_dump(r);
+                //return r;
+                *retval = r;
                 return 0;
             }
-
-            case '/':
+            else
             {
-                *s = next(ctx, src);
-                //ns = puff(ctx, s, NBUF, src, next, back);
-                if (ns && *s == '/')
+                if (c == EOF || XPOST_SCAN_IS(c, XPOST_SCAN_SPACE))
                 {
-                    Xpost_Object ret;
-                    ns = puff(ctx, s, NBUF, src, next, back);
-                    if (ns == NBUF)
-                    {
-                        XPOST_LOG_ERR("immediate name exceeds buf");
-                        return limitcheck;
-                    }
-                    s[ns] = '\0';
-                    //xpost_stack_push(ctx->lo, ctx->os, xpost_object_cvx(xpost_name_cons(ctx, s)));
-                    //xpost_operator_exec(ctx, xpost_operator_cons(ctx, "load", NULL,0,0).mark_.padw);
-                    if (DEBUGLOAD)
-                        printf("\ntoken: loading immediate name %s\n", s);
-                    xpost_op_any_load(ctx, xpost_object_cvx(xpost_name_cons(ctx, s)));
-                    ret = xpost_stack_pop(ctx->lo, ctx->os);
-                    if (DEBUGLOAD)
-                        xpost_object_dump(ret);
-                    //return ret;
-                    *retval = ret;
-                    return 0;
+                    ns = 0;
                 }
-                else
+                else if (XPOST_SCAN_IS(c, XPOST_SCAN_DELIM | XPOST_SCAN_BINARY))
                 {
-                    if (isspace(*s))
-                    {
-                        ns = 0;
-                    }
-                    else if (isdel(*s))
-                    {
-                        back(ctx, *s, src);
-                        ns = 0;
-                    }
-                    else
-                    {
-                        ns += puff(ctx, s + 1, NBUF - 1, src, next, back);
-                    }
+                    back(sc, c);
+                    ns = 0;
                 }
-                if (ns == NBUF)
+                else
                 {
-                    XPOST_LOG_ERR("name exceeds buf");
-                    return limitcheck;
+                    ns += puff(sc, s + 1, NBUF - 1);
                 }
-                //printf("grok:/%s\n", s);
-                s[ns] = '\0';
-                //return xpost_object_cvlit(xpost_name_cons(ctx, s));
-                *retval = xpost_object_cvlit(xpost_name_cons(ctx, s));
-                return 0;
             }
-            default:
+            if (ns == NBUF)
             {
-                //return xpost_object_cvx(xpost_name_cons(ctx, s));
-                *retval = xpost_object_cvx(xpost_name_cons(ctx, s));
-                return 0;
+                XPOST_LOG_ERR("name exceeds buf");
+                return limitcheck;
             }
+            //printf("grok:/%s\n", s);
+            s[ns] = '\0';
+            //return xpost_object_cvlit(xpost_name_cons(ctx, s));
+            *retval = xpost_object_cvlit(xpost_name_cons(ctx, s));
+            return 0;
+        }
+        default:
+        {
+            //return xpost_object_cvx(xpost_name_cons(ctx, s));
+            *retval = xpost_object_cvx(xpost_name_cons(ctx, s));
+            return 0;
         }
+    }
 }
 
 /* read until a non-whitespace, non-comment char.
-   "prime" the buffer.  */
+   "prime" the buffer.
+   a string is skipped in place, without calls per character. */
 static
-int snip(Xpost_Context *ctx,
-         char *buf,
-         Xpost_Object *src,
-         int (*next)(Xpost_Context *ctx, Xpost_Object *src))
+int snip(scanner *sc,
+         char *buf)
 {
     int c;
+
+    if (!sc->fp)
+    {
+        const unsigned char *p = sc->p;
+        const unsigned char *end = sc->end;
+        while (p < end)
+        {
+            if (XPOST_SCAN_IS(*p, XPOST_SCAN_SPACE))
+                ++p;
+            else if (*p == '%')
+                while (++p < end && !XPOST_SCAN_IS(*p, XPOST_SCAN_EOL))
+                    /**/;
+            else
+                break;
+        }
+        sc->p = p;
+        if (p == end)
+        {
+            sc->hit = 1;
+            return 0;
+        }
+        *buf = *sc->p++;
+        return 1;
+    }
+
     do {
-        c = next(ctx, src);
+        c = next(sc);
         if (c == '%')
         {
             do {
-                c = next(ctx, src);
+                c = next(sc);
             } while(c != '\n' && c != '\f' && c != EOF);
         }
-    } while(c != EOF && isspace(c));
+    } while(c != EOF && XPOST_SCAN_IS(c, XPOST_SCAN_SPACE));
     if (c == EOF) return 0;
     *buf = c;
     return 1; // true, and size of buffer
@@ -504,52 +599,524 @@ int snip(Xpost_Context *ctx,
    read into buf any regular characters,
    if we read one too many, put it back, unless whitespace. */
 static
-int puff(Xpost_Context *ctx,
+int puff(scanner *sc,
          char *buf,
-         int nbuf,
-         Xpost_Object *src,
-         int (*next)(Xpost_Context *ctx, Xpost_Object *src),
-         void (*back)(Xpost_Context *ctx, int c, Xpost_Object *src))
+         int nbuf)
 {
     int c;
     char *s = buf;
-    while (isreg(c = next(ctx, src)))
+
+    if (!sc->fp)
+    {
+        const unsigned char *p = sc->p;
+        const unsigned char *end = sc->end;
+        while (p < end && !XPOST_SCAN_IS(*p, XPOST_SCAN_END))
+        {
+            if (s - buf >= nbuf) break;
+            *s++ = *p++;
+        }
+        if (p == end)
+            sc->hit = 1;
+        else if (XPOST_SCAN_IS(*p, XPOST_SCAN_SPACE) && s - buf < nbuf)
+            ++p;
+        sc->p = p;
+        return s - buf;
+    }
+
+    while ((c = next(sc)) != EOF && !XPOST_SCAN_IS(c, XPOST_SCAN_END))
     {
-        if (s - buf >= nbuf) return 0;
+        if (s - buf >= nbuf) return nbuf;
         *s++ = c;
     }
-    if (!isspace(c) && c != EOF) back(ctx, c, src);
+    if (c != EOF && !XPOST_SCAN_IS(c, XPOST_SCAN_SPACE)) back(sc, c);
     return s - buf;
 }
 
+/* binary encodings, PLRM 3.14.
+   multi-byte values are read in the byte order given by the token. */
+
+enum { BOS_MAXDEPTH = 100 };
 
 static
-int toke(Xpost_Context *ctx,
-         Xpost_Object *src,
-         int (*next)(Xpost_Context *ctx, Xpost_Object *src),
-         void (*back)(Xpost_Context *ctx, int c, Xpost_Object *src),
-         Xpost_Object *retval)
+unsigned int u16(const unsigned char *b, int lsb)
 {
-    char buf[NBUF] = "";
-    int sta;  // status, and size
+    return lsb ? b[0] | (b[1] << 8) : (b[0] << 8) | b[1];
+}
+
+static
+unsigned int u32(const unsigned char *b, int lsb)
+{
+    return lsb ? b[0] | (b[1] << 8) | (b[2] << 16) | ((unsigned int)b[3] << 24)
+               : ((unsigned int)b[0] << 24) | (b[1] << 16) | (b[2] << 8) | b[3];
+}
+
+static
+Xpost_Object ieee(unsigned int v)
+{
+    float f;
+    memcpy(&f, &v, sizeof f);
+    return xpost_real_cons((real)f);
+}
+
+/* fixed point number with scale bits of fraction,
+   an integer if scale is 0. */
+static
+Xpost_Object fixed(int v, int scale)
+{
+    if (!scale)
+        return xpost_int_cons(v);
+    return xpost_real_cons((real)ldexp((double)v, -scale));
+}
+
+/* read n bytes of binary data */
+static
+int readbytes(scanner *sc,
+              unsigned char *dst,
+              unsigned int n)
+{
+    if (sc->fp)
+        return fread(dst, 1, n, sc->fp) == n;
+    if ((unsigned int)(sc->end - sc->p) < n)
+    {
+        sc->p = sc->end;
+        sc->hit = 1;
+        return 0;
+    }
+    memcpy(dst, sc->p, n);
+    sc->p += n;
+    return 1;
+}
+
+/* decode a number representation r of a binary token:
+   0-31 32-bit fixed point with scale r, 32-47 16-bit fixed point
+   with scale r-32, 48 IEEE real, 49 native real, +128 low-order byte
+   first. the size of one number is returned, 0 if r is invalid. */
+static
+int numrep(int r,
+           int *lsb,
+           int *scale)
+{
+    *lsb = r >= 128;
+    r &= 127;
+    *scale = r < 32 ? r : r - 32;
+    if (r < 32 || r == 48 || r == 49)
+        return 4;
+    if (r < 48)
+        return 2;
+    return 0;
+}
+
+static
+Xpost_Object numval(const unsigned char *b,
+                    int size,
+                    int lsb,
+                    int r,
+                    int scale)
+{
+    if (size == 2)
+        return fixed((short)u16(b, lsb), scale);
+    if ((r & 127) >= 48)
+        return ieee(u32(b, lsb));
+    return fixed((int)u32(b, lsb), scale);
+}
+
+/* homogeneous number array: the numbers are decoded in chunks
+   directly into the new array's memory. */
+static
+int numarray(scanner *sc,
+             Xpost_Object *retval)
+{
+    Xpost_Context *ctx = sc->ctx;
+    unsigned char hdr[3];
+    unsigned char chunk[1024];
+    Xpost_Memory_File *mem;
+    Xpost_Object arr;
+    Xpost_Object *dst;
+    unsigned int adr;
+    unsigned int n, i;
+    int size, lsb, scale;
+
+    if (!readbytes(sc, hdr, 3) ||
+        !(size = numrep(hdr[0], &lsb, &scale)))
+    {
+        XPOST_LOG_ERR("bad homogeneous number array");
+        return syntaxerror;
+    }
+    n = u16(hdr + 1, lsb);
+    arr = xpost_array_cons(ctx, n);
+    if (xpost_object_get_type(arr) == nulltype)
+        return VMerror;
+    resync(sc); /* vm may have moved */
+    if (n)
+    {
+        mem = xpost_context_select_memory(ctx, arr);
+        if (!xpost_memory_table_get_addr(mem, xpost_object_get_ent(arr), &adr))
+            return VMerror;
+        dst = (Xpost_Object *)(mem->base + adr);
+        for (i = 0; i < n; )
+        {
+            unsigned int m = n - i;
+            const unsigned char *b = chunk;
+            if (m > sizeof chunk / size)
+                m = sizeof chunk / size;
+            if (!readbytes(sc, chunk, m * size))
+            {
+                XPOST_LOG_ERR("short homogeneous number array");
+                return syntaxerror;
+            }
+            for ( ; m; --m, ++i, b += size)
+                dst[i] = numval(b, size, lsb, hdr[0], scale);
+        }
+    }
+    *retval = xpost_object_cvlit(arr);
+    return 0;
+}
+
+static
+int bosarray(scanner *sc,
+             const unsigned char *seq,
+             unsigned int len,
+             unsigned int off,
+             unsigned int n,
+             int lsb,
+             int depth,
+             Xpost_Object *retval);
+
+/* one 8-byte object of a binary object sequence:
+     type (bit 7: executable), tag, length, value.
+   strings, names and arrays are located by offset
+   from the start of the top-level array. */
+static
+int bosobject(scanner *sc,
+              const unsigned char *seq,
+              unsigned int len,
+              const unsigned char *b,
+              int lsb,
+              int depth,
+              Xpost_Object *retval)
+{
+    Xpost_Context *ctx = sc->ctx;
+    unsigned int blen = u16(b + 2, lsb);
+    unsigned int val = u32(b + 4, lsb);
     Xpost_Object o;
     int ret;
 
-    if (!src)
+    switch (b[0] & 127)
+    {
+        case 0: o = null; break;
+        case 1: o = xpost_int_cons((integer)val); break;
+        case 2:
+            if (blen == 0)
+                o = ieee(val);
+            else if (blen < 32)
+                o = fixed((int)val, blen);
+            else
+            {
+                XPOST_LOG_ERR("bad fixed point scale in binary object sequence");
+                return syntaxerror;
+            }
+            break;
+        case 3: /* name */
+        case 6: /* immediately evaluated name */
+        {
+            char s[NBUF];
+            if (blen == 0 || blen == 0xFFFF)
+            {
+                XPOST_LOG_ERR("system and user name indices are not supported");
+                return undefined;
+            }
+            if (val > len || blen > len - val)
+                return syntaxerror;
+            if (blen >= NBUF)
+            {
+                XPOST_LOG_ERR("name exceeds buf");
+                return limitcheck;
+            }
+            memcpy(s, seq + val, blen);
+            s[blen] = '\0';
+            o = xpost_name_cons(ctx, s);
+            if (xpost_object_get_type(o) == invalidtype)
+                return VMerror;
+            if ((b[0] & 127) == 6)
+            {
+                ret = xpost_op_any_load(ctx, xpost_object_cvx(o));
+                if (ret)
+                    return ret;
+                *retval = xpost_stack_pop(ctx->lo, ctx->os);
+                return 0;
+            }
+            break;
+        }
+        case 4: o = xpost_bool_cons(val != 0); break;
+        case 5:
+            if (val > len || blen > len - val)
+                return syntaxerror;
+            o = xpost_string_cons(ctx, blen, (const char *)seq + val);
+            if (xpost_object_get_type(o) == nulltype)
+                return VMerror;
+            break;
+        case 9:
+            if (depth >= BOS_MAXDEPTH)
+            {
+                XPOST_LOG_ERR("binary object sequence nested too deep");
+                return limitcheck;
+            }
+            ret = bosarray(sc, seq, len, val, blen, lsb, depth + 1, &o);
+            if (ret)
+                return ret;
+            break;
+        case 10: o = mark; break;
+        default:
+            XPOST_LOG_ERR("bad object type %d in binary object sequence", b[0] & 127);
+            return syntaxerror;
+    }
+    *retval = (b[0] & 128) ? xpost_object_cvx(o) : xpost_object_cvlit(o);
+    return 0;
+}
+
+/* the objects are collected on the operand stack
+   while nested strings and arrays are allocated,
+   as for a procedure body. */
+static
+int bosarray(scanner *sc,
+             const unsigned char *seq,
+             unsigned int len,
+             unsigned int off,
+             unsigned int n,
+             int lsb,
+             int depth,
+             Xpost_Object *retval)
+{
+    Xpost_Context *ctx = sc->ctx;
+    unsigned int i;
+    int cnt;
+    int ret;
+
+    if (off > len || n > (len - off) / 8)
+    {
+        XPOST_LOG_ERR("array exceeds binary object sequence");
+        return syntaxerror;
+    }
+    cnt = xpost_stack_count(ctx->lo, ctx->os);
+    if (!xpost_stack_push(ctx->lo, ctx->os, mark))
+        return stackoverflow;
+    for (i = 0; i < n; i++)
+    {
+        Xpost_Object o;
+        ret = bosobject(sc, seq, len, seq + off + i * 8, lsb, depth, &o);
+        if (ret)
+            goto drop;
+        if (!xpost_stack_push(ctx->lo, ctx->os, o))
+        {
+            ret = stackoverflow;
+            goto drop;
+        }
+    }
+    ret = xpost_op_array_to_mark(ctx);
+    if (ret)
+        goto drop;
+    *retval = xpost_stack_pop(ctx->lo, ctx->os);
+    return 0;
+
+  drop:
+    /* leave the stack as it was: no mark, no objects collected */
+    while (xpost_stack_count(ctx->lo, ctx->os) > cnt)
+        (void)xpost_stack_pop(ctx->lo, ctx->os);
+    return ret;
+}
+
+/* binary object sequence.
+   header: token, top-level array length (byte), overall length (2 bytes)
+   or, if that byte is 0: token, 0, array length (2), overall length (4).
+   128 and 130 are high-order byte first, 129 and 131 low-order first. */
+static
+int bos(scanner *sc,
+        int token,
+        Xpost_Object *retval)
+{
+    unsigned char hdr[7];
+    unsigned char *seq;
+    unsigned int n, total, hlen;
+    int lsb = token & 1;
+    int ret;
+
+    if (!readbytes(sc, hdr, 3))
+        return syntaxerror;
+    if (hdr[0])
+    {
+        n = hdr[0];
+        total = u16(hdr + 1, lsb);
+        hlen = 4;
+    }
+    else
+    {
+        if (!readbytes(sc, hdr + 3, 4))
+            return syntaxerror;
+        n = u16(hdr + 1, lsb);
+        total = u32(hdr + 3, lsb);
+        hlen = 8;
+    }
+    if (total < hlen)
+    {
+        XPOST_LOG_ERR("bad binary object sequence length");
+        return syntaxerror;
+    }
+    total -= hlen;
+    seq = malloc(total ? total : 1);
+    if (!seq)
+        return VMerror;
+    if (!readbytes(sc, seq, total))
+    {
+        free(seq);
+        XPOST_LOG_ERR("short binary object sequence");
+        return syntaxerror;
+    }
+    ret = bosarray(sc, seq, total, 0, n, lsb, 0, retval);
+    free(seq);
+    if (ret)
+        return ret;
+    *retval = xpost_object_cvx(*retval);
+    sc->ctx->binseq = 1;
+    return 0;
+}
+
+/* a binary token, 128-159 */
+static
+int binary(scanner *sc,
+           int token,
+           Xpost_Object *retval)
+{
+    Xpost_Context *ctx = sc->ctx;
+    unsigned char b[4];
+    int size, lsb, scale;
+
+    switch (token)
     {
-        XPOST_LOG_ERR("src is NULL");
-        return unregistered;
+        case 128: case 129: case 130: case 131:
+            return bos(sc, token, retval);
+
+        case 132: case 133: /* 32-bit integer */
+            if (!readbytes(sc, b, 4))
+                break;
+            *retval = xpost_int_cons((integer)u32(b, token == 133));
+            return 0;
+
+        case 134: case 135: /* 16-bit integer */
+            if (!readbytes(sc, b, 2))
+                break;
+            *retval = xpost_int_cons((short)u16(b, token == 135));
+            return 0;
+
+        case 136: /* 8-bit integer */
+            if (!readbytes(sc, b, 1))
+                break;
+            *retval = xpost_int_cons((signed char)b[0]);
+            return 0;
+
+        case 137: /* fixed point */
+            if (!readbytes(sc, b, 1))
+                break;
+            if (!(size = numrep(b[0], &lsb, &scale)) || (b[0] & 127) >= 48)
+            {
+                XPOST_LOG_ERR("bad fixed point representation");
+                return syntaxerror;
+            }
+            {
+                int r = b[0];
+                if (!readbytes(sc, b, size))
+                    break;
+                *retval = numval(b, size, lsb, r, scale);
+            }
+            return 0;
+
+        case 138: case 139: /* IEEE real */
+            if (!readbytes(sc, b, 4))
+                break;
+            *retval = ieee(u32(b, token == 139));
+            return 0;
+
+        case 140: /* native real */
+        {
+            float f;
+            if (!readbytes(sc, (unsigned char *)&f, sizeof f))
+                break;
+            *retval = xpost_real_cons((real)f);
+            return 0;
+        }
+
+        case 141: /* boolean */
+            if (!readbytes(sc, b, 1))
+                break;
+            *retval = xpost_bool_cons(b[0]);
+            return 0;
+
+        case 142: case 143: case 144: /* string */
+        {
+            unsigned int n;
+            char *s;
+            Xpost_Object str;
+
+            if (!readbytes(sc, b, token == 142 ? 1 : 2))
+                break;
+            n = token == 142 ? b[0] : u16(b, token == 144);
+            s = malloc(n ? n : 1);
+            if (!s)
+                return VMerror;
+            if (!readbytes(sc, (unsigned char *)s, n))
+            {
+                free(s);
+                break;
+            }
+            str = xpost_string_cons(ctx, n, s);
+            free(s);
+            if (xpost_object_get_type(str) == nulltype)
+                return VMerror;
+            *retval = xpost_object_cvlit(str);
+            return 0;
+        }
+
+        case 145: case 146: case 147: case 148: /* system or user name index */
+            (void)readbytes(sc, b, 1);
+            XPOST_LOG_ERR("system and user name indices are not supported");
+            return undefined;
+
+        case 149:
+            return numarray(sc, retval);
+
+        default:
+            XPOST_LOG_ERR("unassigned binary token %d", token);
+            return syntaxerror;
     }
+    XPOST_LOG_ERR("short binary token");
+    return syntaxerror;
+}
+
+
+static
+int toke(scanner *sc,
+         Xpost_Object *retval)
+{
+    char buf[NBUF];
+    int sta;  // status, and size
+    Xpost_Object o;
+    int ret;
 
-    sta = snip(ctx, buf, src, next);
+    resync(sc);
+    sc->ctx->binseq = 0; /* the last token of a procedure body is } */
+    sta = snip(sc, buf);
     if (!sta)
     {
         *retval = null;
         return 0;
     }
-    if (!isdel(*buf))
-        sta += puff(ctx, buf + 1, NBUF - 1, src, next, back);
-    ret = grok(ctx, buf, sta, src, next, back, &o);
+    if (XPOST_SCAN_IS(*buf, XPOST_SCAN_BINARY))
+        ret = binary(sc, (unsigned char)*buf, &o);
+    else
+    {
+        if (!XPOST_SCAN_IS(*buf, XPOST_SCAN_DELIM))
+            sta += puff(sc, buf + 1, NBUF - 1);
+        ret = grok(sc, buf, sta, &o);
+    }
     if (ret)
         return ret;
     *retval = o;
@@ -561,22 +1128,10 @@ int toke(Xpost_Context *ctx,
    false
    read token from file */
 static
-int Fnext(Xpost_Context *ctx,
-          Xpost_Object *F)
-{
-    return xpost_file_getc(xpost_file_get_file_pointer(ctx->lo, *F));
-}
-static
-void Fback(Xpost_Context *ctx,
-           int c,
-           Xpost_Object *F)
-{
-    (void)ungetc(c, xpost_file_get_file_pointer(ctx->lo, *F));
-}
-static
 int Ftoken(Xpost_Context *ctx,
            Xpost_Object F)
 {
+    scanner sc = { 0 };
     Xpost_Object t;
     int ret;
 
@@ -584,7 +1139,51 @@ int Ftoken(Xpost_Context *ctx,
 
     if (!xpost_file_get_status(ctx->lo, F))
         return ioerror;
-    ret = toke(ctx, &F, Fnext, Fback, &t);
+    sc.ctx = ctx;
+    sc.fp = xpost_file_get_file_pointer(ctx->lo, F);
+    sc.map = xpost_file_get_map(ctx->lo, F);
+    if (sc.map)
+    {
+        int cnt = xpost_stack_count(ctx->lo, ctx->os);
+
+        /* scan the span in place */
+        sc.fp = NULL;
+        for (;;)
+        {
+            sc.beg = sc.p = sc.map->base + sc.map->pos;
+            sc.end = sc.map->base + sc.map->size;
+            sc.hit = 0;
+            ret = toke(&sc, &t);
+            if (!sc.hit || sc.map->ended)
+                break;
+            /* the scan needed bytes not read yet,
+               to end the token or to find one:
+               drop it, and scan again with them */
+            while (xpost_stack_count(ctx->lo, ctx->os) > cnt)
+                (void)xpost_stack_pop(ctx->lo, ctx->os);
+            if (xpost_file_map_more(sc.map) < 0)
+            {
+                /* none yet, retry when the caller resumes,
+                   or when the fifo has bytes */
+                ctx->iofd = sc.map->fd;
+                xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons(ctx, "token", NULL,0,0));
+                xpost_stack_push(ctx->lo, ctx->os, F);
+                return ioblock;
+            }
+        }
+        sc.map->pos = sc.p - sc.map->base;
+    }
+    else
+    {
+        if (xpost_file_fill_source(ctx->lo, F) < 0)
+        {
+            ctx->iofd = -1;
+            xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons(ctx, "token", NULL,0,0));
+            xpost_stack_push(ctx->lo, ctx->os, F);
+            return ioblock;
+        }
+        ret = toke(&sc, &t);
+    }
     if (ret)
         return ret;
     if (xpost_object_get_type(t) != nulltype)
@@ -603,37 +1202,22 @@ int Ftoken(Xpost_Context *ctx,
    false
    read token from string */
 static
-int Snext(Xpost_Context *ctx,
-          Xpost_Object *S)
-{
-    int ret;
-    if (S->comp_.sz == 0) return EOF;
-    ret = xpost_string_get_pointer(ctx, *S)[0];
-    ++S->comp_.off;
-    --S->comp_.sz;
-    return ret;
-}
-static
-void Sback(Xpost_Context *ctx,
-           int c,
-           Xpost_Object *S)
-{
-    --S->comp_.off;
-    ++S->comp_.sz;
-    xpost_string_get_pointer(ctx, *S)[0] = c;
-}
-static
 int Stoken(Xpost_Context *ctx,
            Xpost_Object S)
 {
+    scanner sc = { 0 };
     Xpost_Object t;
     int ret;
 
     xpost_stack_push(ctx->lo, ctx->hold, S);
 
-    ret = toke(ctx, &S, Snext, Sback, &t);
+    sc.ctx = ctx;
+    sc.str = &S;
+    sc.beg = sc.p = sc.end = NULL;
+    ret = toke(&sc, &t);
     if (ret)
         return ret;
+    resync(&sc);
     if (xpost_object_get_type(t) != nulltype)
     {
         xpost_stack_push(ctx->lo, ctx->os, S);
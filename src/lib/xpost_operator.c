@@ -82,10 +82,6 @@ Xpost_Object _promote_integer_to_real(Xpost_Object o)
    #define MAXOPS 20
 */
 
-/* the number of ops, at any given time. */
-static
-int _xpost_noops = 0;
-
 static
 int _stack_none(Xpost_Context *ctx)
 {
@@ -300,7 +296,7 @@ int xpost_operator_init_optab(Xpost_Context *ctx)
     }
     tab = &ctx->gl->table;
     assert(ent == XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE);
-    tab->tab[ent].sz = 0; // so gc will ignore it
+    tab->sz[ent] = 0; // so gc will ignore it
     //printf("ent: %d\nOPTAB: %d\n", ent, (int)XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE);
 
     return 1;
@@ -341,7 +337,7 @@ Xpost_Object xpost_operator_cons_opcode(int opcode)
     op.mark_.tag = operatortype;
     op.mark_.pad0 = 0;
     op.mark_.padw = opcode;
-    if (opcode >= _xpost_noops)
+    if (opcode < 0 || opcode >= MAXOPS)
     {
         XPOST_LOG_ERR("opcode does not index a valid operator");
         return null;
@@ -374,6 +370,7 @@ Xpost_Object xpost_operator_cons(Xpost_Context *ctx,
     Xpost_Operator *optab;
     Xpost_Operator  op;
     unsigned int optadr;
+    int noops;
     int ret;
 
     //fprintf(stderr, "name: %s\n", name);
@@ -403,19 +400,22 @@ Xpost_Object xpost_operator_cons(Xpost_Context *ctx,
         return invalid;
     ctx->vmmode = vmmode;
 
+    /* the table of each global vm is filled in order, the first
+       entry without signatures ends it */
     optab = (void *)(ctx->gl->base + optadr);
-    for (opcode = 0; optab[opcode].name != nm.mark_.padw; opcode++)
+    for (opcode = 0; opcode < MAXOPS && optab[opcode].n; opcode++)
     {
-        if (opcode == _xpost_noops) break;
+        if (optab[opcode].name == nm.mark_.padw) break;
     }
+    noops = opcode < MAXOPS && optab[opcode].n ? -1 : opcode;
 
     /* install a new signature (prototype) */
     if (fp)
     {
-        if (opcode == _xpost_noops)
+        if (opcode == noops)
         { /* a new operator */
             unsigned adr;
-            if (_xpost_noops == MAXOPS-1)
+            if (noops >= MAXOPS-1)
             {
                 XPOST_LOG_ERR("optab too small in xpost_operator.h");
                 XPOST_LOG_ERR("operator %s NOT installed", name);
@@ -432,7 +432,6 @@ Xpost_Object xpost_operator_cons(Xpost_Context *ctx,
             op.n = 1;
             op.sigadr = adr;
             optab[opcode] = op;
-            ++_xpost_noops;
             si = 0;
         }
         else
@@ -506,7 +505,7 @@ Xpost_Object xpost_operator_cons(Xpost_Context *ctx,
             //sp[si].checkstack = NULL;
         }
     }
-    else if (opcode == _xpost_noops)
+    else if (opcode == noops)
     {
         XPOST_LOG_ERR("operator not found");
         return null;
@@ -517,6 +516,52 @@ Xpost_Object xpost_operator_cons(Xpost_Context *ctx,
     return o;
 }
 
+/* copy the function pointers of the signatures of all operators
+   from old, a copy of global vm holding the same operator table,
+   made by this process. the global vm of ctx was loaded from an
+   image written by another process, so its pointers are stale.
+   return 0 if the operator tables do not match. */
+int xpost_operator_relink(Xpost_Context *ctx,
+                          const unsigned char *old,
+                          unsigned int oldsz)
+{
+    const Xpost_Operator *oldtab;
+    const Xpost_Signature *oldsp;
+    Xpost_Operator *optab;
+    Xpost_Signature *sp;
+    unsigned int optadr;
+    int opcode;
+    int i;
+
+    if (!xpost_memory_table_get_addr(ctx->gl,
+                XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE, &optadr))
+        return 0;
+    if (optadr + MAXOPS * sizeof(Xpost_Operator) > oldsz)
+        return 0;
+    optab = (void *)(ctx->gl->base + optadr);
+    oldtab = (const void *)(old + optadr);
+
+    for (opcode = 0; opcode < MAXOPS; opcode++)
+    {
+        if (optab[opcode].name != oldtab[opcode].name ||
+            optab[opcode].n != oldtab[opcode].n ||
+            optab[opcode].sigadr != oldtab[opcode].sigadr)
+            return 0;
+        if (!optab[opcode].n)
+            continue;
+        if (optab[opcode].sigadr + optab[opcode].n * sizeof(Xpost_Signature) > oldsz)
+            return 0;
+        sp = (void *)(ctx->gl->base + optab[opcode].sigadr);
+        oldsp = (const void *)(old + oldtab[opcode].sigadr);
+        for (i = 0; i < optab[opcode].n; i++)
+        {
+            sp[i].fp = oldsp[i].fp;
+            sp[i].checkstack = oldsp[i].checkstack;
+        }
+    }
+    return 1;
+}
+
 /* clear hold and pop n objects from opstack to hold stack.
    The hold stack is used as temporary storage to hold the
    arguments for an operator-function call.
@@ -48,9 +48,10 @@
  * a global struct of "opcuts" (operator object shortcuts),
  * but here it would need to be "global", either in global-vm
  * or in the context struct.
- * One goal of the planned "quick-launch" option is to remove
- * these lookups from the initialization, too. One requirement
- * for the quick-launch is removing all function-pointers from vm.
+ * The "quick-launch" image (xpost_image.h) removes the interpretation
+ * of init.ps from the initialization. Since the signatures hold
+ * function-pointers in vm, xpost_operator_relink copies them from
+ * a freshly initialized optab into the optab loaded from an image.
  *
  * ----
  * To speed-up typechecks,
@@ -149,6 +150,13 @@ Xpost_Object xpost_operator_cons(Xpost_Context *ctx,
                                  int in,
                                  ...);
 
+/**
+ * @brief copy operator function pointers into a vm loaded from an image
+ */
+int xpost_operator_relink(Xpost_Context *ctx,
+                          const unsigned char *old,
+                          unsigned int oldsz);
+
 /**
  * @brief execute an operator
  */
@@ -112,7 +112,7 @@ int xpost_oplib_init_ops(Xpost_Context *ctx)
     xpost_stack_push(ctx->lo, ctx->ds, sd); // push systemdict on dictstack
     ent = xpost_object_get_ent(sd);
     tab = &ctx->gl->table;
-    tab->tab[ent].sz = 0; // make systemdict immune to collection
+    tab->sz[ent] = 0; // make systemdict immune to collection
 
     //xpost_memory_table_get_addr(ctx->gl, XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE, &optadr);
     //optab = (void *)(ctx->gl->base + optadr);
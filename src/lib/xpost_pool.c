@@ -0,0 +1,318 @@
+/*
+ * Xpost - a Level-2 Postscript interpreter
+ * Copyright (C) 2013-2016, Michael Joshua Ryan
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the Xpost software product nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdlib.h> /* calloc free */
+
+#include "xpost.h"
+#include "xpost_log.h"
+#include "xpost_compat.h" /* Xpost_Lock Xpost_Thread */
+#include "xpost_memory.h"
+#include "xpost_object.h"
+#include "xpost_context.h"
+#include "xpost_interpreter.h" /* MAXMFILE */
+#include "xpost_error.h" /* yieldtocaller ioblock */
+
+/* contexts cloned from one frozen context, and their availability */
+struct _Xpost_Context_Pool
+{
+    Xpost_Context *origin;
+    Xpost_Context **ctx;
+    int *busy;
+    int size;
+    Xpost_Lock lock; /* held to take or give back a context */
+};
+
+/* the jobs of a call to xpost_context_pool_run(), and the next one to take */
+typedef struct
+{
+    Xpost_Context_Pool *pool;
+    Xpost_Job *jobs;
+    int count;
+    int next;
+} Xpost_Context_Pool_Run;
+
+XPAPI Xpost_Context_Pool *xpost_context_pool_create(int size,
+                                                    const char *device,
+                                                    Xpost_Output_Type output_type,
+                                                    const void *outputptr,
+                                                    Xpost_Showpage_Semantics semantics,
+                                                    Xpost_Output_Message output_msg,
+                                                    Xpost_Set_Size set_size,
+                                                    int width,
+                                                    int height)
+{
+    Xpost_Context_Pool *pool;
+    int i;
+
+    if (size < 0)
+    {
+        XPOST_LOG_ERR("pool size must not be negative");
+        return NULL;
+    }
+    if (size == 0)
+    {
+        size = xpost_cpu_count();
+        /* each clone has its own memory files, the frozen context has the others */
+        if (size > MAXMFILE - 1)
+            size = MAXMFILE - 1;
+    }
+
+    pool = calloc(1, sizeof(Xpost_Context_Pool));
+    if (!pool)
+    {
+        XPOST_LOG_ERR("cannot allocate context pool");
+        return NULL;
+    }
+    xpost_lock_init(&pool->lock);
+    pool->ctx = calloc(size, sizeof(Xpost_Context *));
+    pool->busy = calloc(size, sizeof(int));
+    if (!pool->ctx || !pool->busy)
+    {
+        XPOST_LOG_ERR("cannot allocate context pool");
+        goto free_pool;
+    }
+
+    /* the only context which runs init.ps */
+    pool->origin = xpost_create(device, output_type, outputptr,
+                                semantics, output_msg, set_size,
+                                width, height);
+    if (!pool->origin)
+        goto free_pool;
+    if (!xpost_freeze(pool->origin, 1))
+        goto destroy_origin;
+
+    for (i = 0; i < size; i++)
+    {
+        pool->ctx[i] = xpost_clone(pool->origin);
+        if (!pool->ctx[i])
+        {
+            XPOST_LOG_ERR("cannot fill context pool (%d of %d)", i, size);
+            goto destroy_clones;
+        }
+        pool->size++;
+    }
+
+    return pool;
+
+  destroy_clones:
+    for (i = 0; i < pool->size; i++)
+        xpost_destroy(pool->ctx[i]);
+  destroy_origin:
+    xpost_destroy(pool->origin);
+  free_pool:
+    xpost_lock_fini(&pool->lock);
+    free(pool->busy);
+    free(pool->ctx);
+    free(pool);
+    return NULL;
+}
+
+XPAPI Xpost_Context *xpost_context_pool_acquire(Xpost_Context_Pool *pool)
+{
+    Xpost_Context *ctx = NULL;
+    int i;
+
+    xpost_lock(&pool->lock);
+    for (i = 0; i < pool->size; i++)
+    {
+        if (!pool->busy[i])
+        {
+            pool->busy[i] = 1;
+            ctx = pool->ctx[i];
+            break;
+        }
+    }
+    xpost_unlock(&pool->lock);
+
+    if (!ctx)
+        XPOST_LOG_ERR("all %d contexts of the pool are in use", pool->size);
+    return ctx;
+}
+
+XPAPI int xpost_context_pool_release(Xpost_Context_Pool *pool,
+                                     Xpost_Context *ctx)
+{
+    Xpost_Context *clone;
+    int i;
+
+    xpost_lock(&pool->lock);
+    for (i = 0; i < pool->size; i++)
+    {
+        if (pool->ctx[i] == ctx && pool->busy[i])
+            break;
+    }
+    xpost_unlock(&pool->lock);
+    if (i == pool->size)
+    {
+        XPOST_LOG_ERR("context is not acquired from this pool");
+        return 0;
+    }
+
+    /* the context is still busy: nothing else uses it meanwhile */
+    clone = ctx;
+    if (!xpost_reset(ctx))
+    {
+        /* replace the context rather than reuse a damaged one */
+        xpost_destroy(ctx);
+        clone = xpost_clone(pool->origin);
+    }
+
+    xpost_lock(&pool->lock);
+    /* the slot may have moved while the pool shrank */
+    for (i = 0; i < pool->size; i++)
+    {
+        if (pool->ctx[i] == ctx && pool->busy[i])
+            break;
+    }
+    if (!clone)
+    {
+        XPOST_LOG_ERR("cannot replace context of the pool");
+        pool->ctx[i] = pool->ctx[--pool->size];
+        pool->busy[i] = pool->busy[pool->size];
+        xpost_unlock(&pool->lock);
+        return 0;
+    }
+    pool->ctx[i] = clone;
+    pool->busy[i] = 0;
+    xpost_unlock(&pool->lock);
+    return 1;
+}
+
+/* run a job to its end on ctx */
+static void
+_xpost_context_pool_job(Xpost_Context *ctx, Xpost_Job *job)
+{
+    int ret;
+
+    ret = xpost_run(ctx, job->input_type, job->input);
+    while (ret == yieldtocaller || ret == ioblock)
+        ret = xpost_run(ctx, XPOST_INPUT_RESUME, NULL);
+    job->result = ret;
+}
+
+/* take the jobs not yet taken, one at a time, until none is left */
+static void
+_xpost_context_pool_worker(void *data)
+{
+    Xpost_Context_Pool_Run *run = data;
+    Xpost_Context *ctx;
+    int i;
+
+    for (;;)
+    {
+        xpost_lock(&run->pool->lock);
+        i = run->next < run->count ? run->next++ : run->count;
+        xpost_unlock(&run->pool->lock);
+        if (i == run->count)
+            return;
+
+        ctx = xpost_context_pool_acquire(run->pool);
+        if (!ctx)
+        {
+            run->jobs[i].result = -1;
+            continue;
+        }
+        _xpost_context_pool_job(ctx, &run->jobs[i]);
+        (void)xpost_context_pool_release(run->pool, ctx);
+    }
+}
+
+XPAPI int xpost_context_pool_run(Xpost_Context_Pool *pool,
+                                 Xpost_Job *jobs,
+                                 int count)
+{
+    Xpost_Context_Pool_Run run;
+    Xpost_Thread *threads;
+    int nthreads;
+    int started;
+    int i;
+
+    if (count <= 0)
+        return 1;
+
+    /* one thread for each context not taken by the caller */
+    nthreads = 0;
+    xpost_lock(&pool->lock);
+    for (i = 0; i < pool->size; i++)
+    {
+        if (!pool->busy[i])
+            nthreads++;
+    }
+    xpost_unlock(&pool->lock);
+    if (nthreads == 0)
+    {
+        XPOST_LOG_ERR("all %d contexts of the pool are in use", pool->size);
+        return 0;
+    }
+    if (nthreads > count)
+        nthreads = count;
+
+    run.pool = pool;
+    run.jobs = jobs;
+    run.count = count;
+    run.next = 0;
+
+    started = 0;
+    threads = malloc(nthreads * sizeof(Xpost_Thread));
+    if (threads)
+    {
+        while (started < nthreads &&
+               xpost_thread_start(&threads[started],
+                                  _xpost_context_pool_worker, &run))
+            started++;
+    }
+
+    /* without threads, the jobs run here */
+    if (started == 0)
+        _xpost_context_pool_worker(&run);
+
+    for (i = 0; i < started; i++)
+        xpost_thread_join(threads[i]);
+    free(threads);
+
+    return 1;
+}
+
+XPAPI void xpost_context_pool_destroy(Xpost_Context_Pool *pool)
+{
+    int i;
+
+    for (i = 0; i < pool->size; i++)
+        xpost_destroy(pool->ctx[i]);
+    xpost_destroy(pool->origin);
+    xpost_lock_fini(&pool->lock);
+    free(pool->busy);
+    free(pool->ctx);
+    free(pool);
+}
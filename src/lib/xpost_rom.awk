@@ -0,0 +1,200 @@
+# Xpost - a Level-2 Postscript interpreter
+# Copyright (C) 2013-2016, Michael Joshua Ryan
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# - Redistributions of source code must retain the above copyright notice,
+#   this list of conditions and the following disclaimer.
+# - Redistributions in binary form must reproduce the above copyright notice,
+#   this list of conditions and the following disclaimer in the documentation
+#   and/or other materials provided with the distribution.
+# - Neither the name of the Xpost software product nor the names of its
+#   contributors may be used to endorse or promote products derived from this
+#   software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+# Generate the table of built-in PostScript resources (xpost_rom_data.h)
+# from the files of the data directory.
+#
+#   awk -f xpost_rom.awk data/init.ps data/err.ps ... > xpost_rom_data.h
+#
+# Each file is reduced to its token stream: comments are removed and
+# runs of whitespace are collapsed to a single separator (dropped
+# entirely next to a self-delimiting character). Strings and hex
+# strings are copied verbatim. The result is emitted as a C string
+# literal, so that the interpreter scans the same tokens as it would
+# from the file on disk, without the file system and without the
+# bytes spent on comments and indentation.
+
+BEGIN {
+    print "/* generated by xpost_rom.awk, do not edit */"
+    print ""
+    print "static const Xpost_Rom_Entry _xpost_rom_entries[] ="
+    print "{"
+    name = ""
+}
+
+FNR == 1 {
+    if (name != "")
+        end_file()
+    name = FILENAME
+    sub(/.*\//, "", name)
+    start_file()
+}
+
+{
+    scan($0 "\n")
+}
+
+END {
+    if (name != "")
+        end_file()
+    print "    { NULL, NULL, 0 }"
+    print "};"
+}
+
+function start_file() {
+    size = 0
+    line = ""
+    nlines = 0
+    depth = 0
+    esc = 0
+    hex = 0
+    comment = 0
+    pend = 0
+    last = ""
+    print "    {"
+    print "        \"" name "\","
+}
+
+function end_file() {
+    if (size > 0 && last != "\n")
+        emit("\n")
+    flush_line()
+    if (nlines == 0)
+        print "        \"\""
+    print "        , " size
+    print "    },"
+}
+
+function flush_line() {
+    if (line != "")
+    {
+        print "        \"" line "\""
+        nlines++
+    }
+    line = ""
+}
+
+function emit(c) {
+    size++
+    last = c
+    if (c == "\\")
+        line = line "\\\\"
+    else if (c == "\"")
+        line = line "\\\""
+    else if (c == "?")
+        line = line "\\?"
+    else if (c == "\t")
+        line = line "\\t"
+    else if (c == "\r")
+        line = line "\\r"
+    else if (c == "\f")
+        line = line "\\f"
+    else if (c == "\n")
+    {
+        line = line "\\n"
+        flush_line()
+        return
+    }
+    else
+        line = line c
+    if (length(line) >= 500)
+        flush_line()
+}
+
+function delimiter(c) {
+    return c == "(" || c == ")" || c == "[" || c == "]" || c == "{" || c == "}"
+}
+
+function scan(s,    i, n, c) {
+    n = length(s)
+    for (i = 1; i <= n; i++)
+    {
+        c = substr(s, i, 1)
+        if (comment)
+        {
+            if (c == "\n")
+            {
+                comment = 0
+                pend = 2
+            }
+            continue
+        }
+        if (depth > 0)
+        {
+            emit(c)
+            if (esc)
+                esc = 0
+            else if (c == "\\")
+                esc = 1
+            else if (c == "(")
+                depth++
+            else if (c == ")")
+                depth--
+            continue
+        }
+        if (hex)
+        {
+            emit(c)
+            if (c == ">")
+                hex = 0
+            continue
+        }
+        if (c == " " || c == "\t" || c == "\r" || c == "\n" || c == "\f")
+        {
+            if (c == "\n")
+                pend = 2
+            else if (!pend)
+                pend = 1
+            continue
+        }
+        if (c == "%")
+        {
+            comment = 1
+            continue
+        }
+        if (pend)
+        {
+            if (size > 0 && !delimiter(c) && c != "/" && !delimiter(last))
+                emit(pend == 2 ? "\n" : " ")
+            pend = 0
+        }
+        if (c == "(")
+            depth = 1
+        else if (c == "<")
+        {
+            if (substr(s, i + 1, 1) == "<")
+            {
+                emit(c)
+                i++
+            }
+            else
+                hex = 1
+        }
+        emit(c)
+    }
+}
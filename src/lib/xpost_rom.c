@@ -0,0 +1,103 @@
+/*
+ * Xpost - a Level-2 Postscript interpreter
+ * Copyright (C) 2013-2016, Michael Joshua Ryan
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the Xpost software product nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stddef.h> /* NULL size_t */
+#include <string.h> /* strcmp strlen strncmp */
+
+#include "xpost_rom.h"
+
+typedef struct
+{
+    const char *name;
+    const char *data;
+    size_t size;
+} Xpost_Rom_Entry;
+
+#ifdef XPOST_BUILD_ROM
+# include "xpost_rom_data.h"
+#else
+/* built without the generator (eg. Visual Studio): no built-in files */
+static const Xpost_Rom_Entry _xpost_rom_entries[] =
+{
+    { NULL, NULL, 0 }
+};
+#endif
+
+const char *
+xpost_rom_find(const char *name, size_t *size)
+{
+    const Xpost_Rom_Entry *e;
+    size_t l;
+
+    l = strlen(XPOST_ROM_DEVICE);
+    if (strncmp(name, XPOST_ROM_DEVICE, l) == 0)
+        name += l;
+    if (*name == '/')
+        name++;
+
+    for (e = _xpost_rom_entries; e->name; e++)
+    {
+        if (strcmp(e->name, name) == 0)
+        {
+            if (size)
+                *size = e->size;
+            return e->data;
+        }
+    }
+
+    return NULL;
+}
+
+unsigned int
+xpost_rom_hash(const char *name)
+{
+    const char *data;
+    size_t size;
+    size_t i;
+    unsigned int h;
+
+    data = xpost_rom_find(name, &size);
+    if (!data)
+        return 0;
+
+    /* FNV-1a */
+    h = 2166136261u;
+    for (i = 0; i < size; i++)
+    {
+        h ^= (unsigned char)data[i];
+        h *= 16777619u;
+    }
+
+    return h;
+}
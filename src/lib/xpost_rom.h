@@ -0,0 +1,73 @@
+/*
+ * Xpost - a Level-2 Postscript interpreter
+ * Copyright (C) 2013-2016, Michael Joshua Ryan
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the Xpost software product nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef XPOST_ROM_H
+#define XPOST_ROM_H
+
+/**
+ * @file xpost_rom.h
+ * @brief PostScript resources built into the library
+ *
+ * The PostScript files needed to initialize the interpreter (init.ps
+ * and the files it runs, graphics.ps with its own files, and test.ps) are
+ * compiled into libxpost at build time, reduced to their tokens by
+ * xpost_rom.awk. They are opened with the file operator under the
+ * device name %rom%, as "%rom%/init.ps", so the interpreter works
+ * without its data directory being installed.
+ *
+ * xpost_create() uses the built-in files unless the XPOST_DATA_DIR
+ * environment variable is set, in which case the files on disk are
+ * used, for instance to work on them without rebuilding.
+ */
+
+/**
+ * @brief prefix of the names of built-in files
+ */
+#define XPOST_ROM_DEVICE "%rom%"
+
+/**
+ * @brief find a built-in file
+ *
+ * name is the name of the file, with or without the
+ * XPOST_ROM_DEVICE prefix and a leading '/'. Return its contents
+ * and store its size in size, or return NULL if there is no such
+ * file.
+ */
+const char *xpost_rom_find(const char *name, size_t *size);
+
+/**
+ * @brief return the hash of a built-in file, 0 if it does not exist
+ *
+ * The hash identifies the contents of the file, as the date of
+ * modification does for files on disk.
+ */
+unsigned int xpost_rom_hash(const char *name);
+
+#endif
@@ -77,7 +77,7 @@ int xpost_save_init(Xpost_Memory_File *mem)
 
     xpost_stack_init(mem, &t);
     tab = &mem->table;
-    tab->tab[ent].adr = t;
+    tab->adr[ent] = t;
 
     return 1;
 }
@@ -104,6 +104,36 @@ Xpost_Object xpost_save_create_snapshot_object(Xpost_Memory_File *mem)
     return v;
 }
 
+/* the current save level is the save-stack count.
+   composites allocated now get this as their llev and tlev. */
+static
+int _xpost_save_level(Xpost_Memory_File *mem,
+                      unsigned int *lev)
+{
+    unsigned int vs;
+    int ret;
+
+    ret = xpost_memory_table_get_addr(mem,
+                                      XPOST_MEMORY_TABLE_SPECIAL_SAVE_STACK, &vs);
+    if (!ret)
+    {
+        XPOST_LOG_ERR("cannot load save stack");
+        return 0;
+    }
+    *lev = xpost_stack_count(mem, vs);
+    return 1;
+}
+
+/* set the tlev field of ent */
+static
+void _xpost_save_set_toplevel(Xpost_Memory_Table *tab,
+                              unsigned int ent,
+                              unsigned int tlev)
+{
+    tab->lev[ent] &= ~XPOST_MEMORY_TABLE_LEVEL_DATA_TOPLEVEL_MASK; // clear TLEV field
+    tab->lev[ent] |= (tlev << XPOST_MEMORY_TABLE_LEVEL_DATA_TOPLEVEL_OFFSET);  // set TLEV field
+}
+
 /* check ent's llev and tlev
    against current save level (save-stack count)
    returns 1 if ent is saved (or not necessary to save),
@@ -115,35 +145,27 @@ unsigned xpost_save_ent_is_saved(Xpost_Memory_File *mem,
     Xpost_Memory_Table *tab;
     unsigned int llev;
     unsigned int tlev;
-    unsigned int vs;
-    int ret;
-    Xpost_Object sav;
+    unsigned int lev;
 
-    ret = xpost_memory_table_get_addr(mem,
-                                      XPOST_MEMORY_TABLE_SPECIAL_SAVE_STACK, &vs);
-    if (!ret)
-    {
-        XPOST_LOG_ERR("cannot load save stack");
+    if (!_xpost_save_level(mem, &lev))
         return 0;
-    }
 
-    if (xpost_stack_count(mem, vs) == 0)
+    if (lev == 0)
         return 1;
 
-    sav = xpost_stack_topdown_fetch(mem, vs, 0);
     tab = &mem->table;
     if (ent >= tab->nextent)
     {
         XPOST_LOG_ERR("cannot find table for ent %u", ent);
         return 0;
     }
-    tlev = (tab->tab[ent].mark & XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_MASK)
-        >> XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_OFFSET;
-    llev = (tab->tab[ent].mark & XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_MASK)
-        >> XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_OFFSET;
+    tlev = (tab->lev[ent] & XPOST_MEMORY_TABLE_LEVEL_DATA_TOPLEVEL_MASK)
+        >> XPOST_MEMORY_TABLE_LEVEL_DATA_TOPLEVEL_OFFSET;
+    llev = (tab->lev[ent] & XPOST_MEMORY_TABLE_LEVEL_DATA_LOWLEVEL_MASK)
+        >> XPOST_MEMORY_TABLE_LEVEL_DATA_LOWLEVEL_OFFSET;
 
-    return llev < sav.save_.lev ?
-        tlev == sav.save_.lev : 1;
+    return llev < lev ?
+        tlev == lev : 1;
 }
 
 /* make a clone of ent, return new ent */
@@ -162,7 +184,7 @@ unsigned int _copy_ent(Xpost_Memory_File *mem,
         XPOST_LOG_ERR("cannot find table for ent %u", ent);
         return 0;
     }
-    if (!xpost_memory_table_alloc(mem, tab->tab[ent].sz, tab->tab[ent].tag, &new))
+    if (!xpost_memory_table_alloc(mem, tab->sz[ent], tab->tag[ent], &new))
     {
         XPOST_LOG_ERR("cannot allocate entity to backup object");
         return 0;
@@ -181,26 +203,27 @@ unsigned int _copy_ent(Xpost_Memory_File *mem,
         return 0;
     }
     memcpy(mem->base + adr,
-           mem->base + tab->tab[ent].adr,
-           tab->tab[ent].sz);
+           mem->base + tab->adr[ent],
+           tab->sz[ent]);
+    tab->used[new] = tab->used[ent];
 
     XPOST_LOG_INFO("ent %u copied to ent %u in %s", ent, new, mem->fname);
     return new;
 }
 
-/* set tlev for ent to current save level
-   push saverec relating ent to saved copy */
-int xpost_save_save_ent(Xpost_Memory_File *mem,
-                        unsigned tag,
-                        unsigned pad,
-                        unsigned ent)
+/* push saverec relating ent to its copy (or chunk map),
+   remembering ent's tlev, and set tlev to current save level */
+static
+int _xpost_save_push_rec(Xpost_Memory_File *mem,
+                         unsigned tag,
+                         unsigned ent,
+                         unsigned cpy,
+                         unsigned lev)
 {
-    Xpost_Memory_Table *tab;
+    Xpost_Memory_Table *tab = &mem->table;
     Xpost_Object o;
-    unsigned tlev;
     Xpost_Object sav;
     unsigned int adr;
-    unsigned int cpy;
     int ret;
 
     ret = xpost_memory_table_get_addr(mem,
@@ -212,19 +235,38 @@ int xpost_save_save_ent(Xpost_Memory_File *mem,
     }
     sav = xpost_stack_topdown_fetch(mem, adr, 0);
 
-    tab = &mem->table;
-    if (ent >= tab->nextent)
+    o.saverec_.tag = tag;
+    o.saverec_.pad = (tab->lev[ent] & XPOST_MEMORY_TABLE_LEVEL_DATA_TOPLEVEL_MASK)
+        >> XPOST_MEMORY_TABLE_LEVEL_DATA_TOPLEVEL_OFFSET;
+    o.saverec_.src = ent;
+    o.saverec_.cpy = cpy;
+    if (!xpost_stack_push(mem, sav.save_.stk, o))
+    {
+        XPOST_LOG_ERR("cannot push save record");
+        return 0;
+    }
+    _xpost_save_set_toplevel(&mem->table, ent, lev);
+    return 1;
+}
+
+/* set tlev for ent to current save level
+   push saverec relating ent to saved copy */
+int xpost_save_save_ent(Xpost_Memory_File *mem,
+                        unsigned tag,
+                        unsigned ent)
+{
+    unsigned int lev;
+    unsigned int cpy;
+
+    if (!_xpost_save_level(mem, &lev))
+        return 0;
+
+    if (ent >= mem->table.nextent)
     {
         XPOST_LOG_ERR("cannot find table for ent %u", ent);
         return 0;
     }
-    tlev = sav.save_.lev;
-    tab->tab[ent].mark &= ~XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_MASK; // clear TLEV field
-    tab->tab[ent].mark |= (tlev << XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_OFFSET);  // set TLEV field
 
-    o.saverec_.tag = tag;
-    o.saverec_.pad = pad;
-    o.saverec_.src = ent;
     cpy = _copy_ent(mem, ent);
     if (cpy == 0)
     {
@@ -232,13 +274,147 @@ int xpost_save_save_ent(Xpost_Memory_File *mem,
         return 0;
     }
 
-    o.saverec_.cpy = cpy;
-    xpost_stack_push(mem, sav.save_.stk, o);
+    return _xpost_save_push_rec(mem, tag, ent, cpy, lev);
+}
+
+/* check the chunk of ent containing byte offset off
+   returns 1 if chunk is saved (or not necessary to save),
+   returns 0 if chunk needs to be saved before changing.
+ */
+unsigned xpost_save_chunk_is_saved(Xpost_Memory_File *mem,
+                                   unsigned ent,
+                                   unsigned off)
+{
+    Xpost_Memory_Table *tab;
+    unsigned int lev;
+    unsigned int llev;
+    unsigned int map;
+    unsigned int chunk;
+
+    if (!xpost_save_ent_is_saved(mem, ent))
+        return 0;
+
+    if (!_xpost_save_level(mem, &lev))
+        return 0;
+    tab = &mem->table;
+    llev = (tab->lev[ent] & XPOST_MEMORY_TABLE_LEVEL_DATA_LOWLEVEL_MASK)
+        >> XPOST_MEMORY_TABLE_LEVEL_DATA_LOWLEVEL_OFFSET;
+    map = tab->cow[ent];
+    if (llev >= lev || map == 0) /* created at this level, or saved whole */
+        return 1;
+
+    if (!xpost_memory_get(mem, map, 1 + off / XPOST_SAVE_CHUNK_SIZE,
+                          sizeof(unsigned int), &chunk))
+    {
+        XPOST_LOG_ERR("cannot load chunk map of ent %u", ent);
+        return 0;
+    }
+    return chunk != 0;
+}
+
+/* copy the chunk of ent containing byte offset off,
+   creating the chunk map for the current save level
+   if ent has not been saved at this level. */
+int xpost_save_save_chunk(Xpost_Memory_File *mem,
+                          unsigned ent,
+                          unsigned off)
+{
+    Xpost_Memory_Table *tab;
+    unsigned int lev;
+    unsigned int tlev;
+    unsigned int map;
+    unsigned int chunk;
+    unsigned int idx;
+    unsigned int sz;
+
+    if (!_xpost_save_level(mem, &lev))
+        return 0;
+
+    tab = &mem->table;
+    if (ent >= tab->nextent)
+    {
+        XPOST_LOG_ERR("cannot find table for ent %u", ent);
+        return 0;
+    }
+    tlev = (tab->lev[ent] & XPOST_MEMORY_TABLE_LEVEL_DATA_TOPLEVEL_MASK)
+        >> XPOST_MEMORY_TABLE_LEVEL_DATA_TOPLEVEL_OFFSET;
+
+    if (tlev != lev)
+    {
+        unsigned int n;
+
+        /* new chunk map: previous map, then one slot per chunk */
+        n = (tab->used[ent] + XPOST_SAVE_CHUNK_SIZE - 1) / XPOST_SAVE_CHUNK_SIZE;
+        if (!xpost_memory_table_alloc(mem, (n + 1) * sizeof(unsigned int), 0, &map))
+        {
+            XPOST_LOG_ERR("cannot allocate chunk map");
+            return 0;
+        }
+        if (map > XPOST_OBJECT_COMP_MAX_ENT)
+        {
+            XPOST_LOG_ERR("ent number %u exceeds object storage max %u",
+                          map, XPOST_OBJECT_COMP_MAX_ENT);
+            return 0;
+        }
+        tab = &mem->table; //recalc
+        memset(mem->base + tab->adr[map], 0, (n + 1) * sizeof(unsigned int));
+        memcpy(mem->base + tab->adr[map], &tab->cow[ent], sizeof(unsigned int));
+        if (!_xpost_save_push_rec(mem, arraytype, ent, map, lev))
+            return 0;
+        tab->cow[ent] = map;
+    }
+    map = tab->cow[ent];
+
+    idx = off / XPOST_SAVE_CHUNK_SIZE;
+    sz = tab->used[ent] - idx * XPOST_SAVE_CHUNK_SIZE;
+    if (sz > XPOST_SAVE_CHUNK_SIZE)
+        sz = XPOST_SAVE_CHUNK_SIZE;
+    if (!xpost_memory_table_alloc(mem, sz, 0, &chunk))
+    {
+        XPOST_LOG_ERR("cannot allocate entity to backup chunk");
+        return 0;
+    }
+    tab = &mem->table; //recalc
+    memcpy(mem->base + tab->adr[chunk],
+           mem->base + tab->adr[ent] + idx * XPOST_SAVE_CHUNK_SIZE,
+           sz);
+    if (!xpost_memory_put(mem, map, 1 + idx, sizeof(unsigned int), &chunk))
+    {
+        XPOST_LOG_ERR("cannot store chunk in chunk map");
+        return 0;
+    }
+
+    XPOST_LOG_INFO("ent %u chunk %u copied to ent %u in %s", ent, idx, chunk, mem->fname);
     return 1;
 }
 
+/* copy the saved chunks in map back into ent,
+   reinstate the previous chunk map */
+static
+void _xpost_save_restore_chunks(Xpost_Memory_File *mem,
+                                unsigned int ent,
+                                unsigned int map)
+{
+    Xpost_Memory_Table *tab = &mem->table;
+    unsigned int *slot;
+    unsigned int n;
+    unsigned int i;
+
+    slot = (unsigned int *)(mem->base + tab->adr[map]);
+    n = tab->used[map] / sizeof(unsigned int);
+    for (i = 1; i < n; i++)
+    {
+        if (slot[i])
+            memcpy(mem->base + tab->adr[ent] + (i - 1) * XPOST_SAVE_CHUNK_SIZE,
+                   mem->base + tab->adr[slot[i]],
+                   tab->used[slot[i]]);
+    }
+    tab->cow[ent] = slot[0];
+}
+
 /* for each saverec from current save stack
-        exchange adrs between src and cpy
+        exchange adrs between src and cpy,
+        or copy back the saved chunks of src
         pop saverec
     pop save stack */
 void xpost_save_restore_snapshot(Xpost_Memory_File *mem)
@@ -282,9 +458,25 @@ void xpost_save_restore_snapshot(Xpost_Memory_File *mem)
             XPOST_LOG_ERR("cannot find table for ent %u", cent);
             return;
         }
-        hold = tab->tab[sent].adr;                 // tmp = src
-        tab->tab[sent].adr = tab->tab[cent].adr;  // src = cpy
-        tab->tab[cent].adr = hold;                 // cpy = tmp
+        if (rec.saverec_.tag == arraytype)
+        {
+            _xpost_save_restore_chunks(mem, sent, cent);
+        }
+        else
+        {
+            hold = tab->adr[sent];                 // tmp = src
+            tab->adr[sent] = tab->adr[cent];  // src = cpy
+            tab->adr[cent] = hold;                 // cpy = tmp
+
+            /* a dict may have grown since it was saved */
+            hold = tab->sz[sent];
+            tab->sz[sent] = tab->sz[cent];
+            tab->sz[cent] = hold;
+            hold = tab->used[sent];
+            tab->used[sent] = tab->used[cent];
+            tab->used[cent] = hold;
+        }
+        _xpost_save_set_toplevel(tab, sent, rec.saverec_.pad);
     }
     //xpost_stack_free(mem, sav.save_.stk);
 }
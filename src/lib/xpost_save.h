@@ -41,9 +41,19 @@
  *  The save object contains an address of a(nother) stack,
  *  this one containing saverec_ structures.
  *  A saverec_ object contains 2 entity numbers, one the source,
- *  the other the copy, of the "saved" array or dictionary.
+ *  the other the copy, of the "saved" array or dictionary,
+ *  and the TOPLEVEL the source had before it was saved.
  *
- *  stashed and stash are the interfaces used by composite objects
+ *  Dictionaries are copied whole, since growing a dict rehashes
+ *  the entire table. Arrays are copied on write one chunk of
+ *  XPOST_SAVE_CHUNK_SIZE bytes at a time: the copy is a chunk map,
+ *  an allocation of unsigned ints holding the previous chunk map of
+ *  the source followed by one entity number per chunk (0 if that
+ *  chunk has not been written at this level). The chunk map of the
+ *  current level is found through the @c cow field of the memory
+ *  table. Restore copies back just the saved chunks.
+ *
+ *  is_saved and save are the interfaces used by composite objects
  *  to check-if-copying-is-necessary
  *  and copy-the-value-and-add-saverec-to-current-savelevel-stack
 
@@ -62,6 +72,13 @@
  *
  */
 
+/**
+ * @def XPOST_SAVE_CHUNK_SIZE
+ * @brief Granularity in bytes of copy-on-write for saved arrays.
+ * Must be a multiple of sizeof(Xpost_Object).
+ */
+#define XPOST_SAVE_CHUNK_SIZE 512
+
 /*
  * @brief initialize the save stack for memory file.
  */
@@ -81,7 +98,17 @@ unsigned xpost_save_ent_is_saved(Xpost_Memory_File *mem, unsigned ent);
 /*
  * @brief add ent to current snapshot
  */
-int xpost_save_save_ent(Xpost_Memory_File *mem, unsigned tag, unsigned pad, unsigned ent);
+int xpost_save_save_ent(Xpost_Memory_File *mem, unsigned tag, unsigned ent);
+
+/*
+ * @brief check whether the chunk containing byte offset off of ent is contained in the current snapshot
+ */
+unsigned xpost_save_chunk_is_saved(Xpost_Memory_File *mem, unsigned ent, unsigned off);
+
+/*
+ * @brief add the chunk containing byte offset off of ent to current snapshot
+ */
+int xpost_save_save_chunk(Xpost_Memory_File *mem, unsigned ent, unsigned off);
 
 /*
  * @brief rewind the stack 1 level, reverting memory to previous snapshot.
@@ -116,13 +116,13 @@ XPCHECKAPI void xpost_stack_free(Xpost_Memory_File *mem,
         xpost_stack_free(mem, s->nextseg);
     xpost_memory_table_alloc(mem, 0, 0, &e); /* allocate entry with 0 size */
     tab = &mem->table;
-    tab->tab[e].adr = stackadr; /* insert address */
-    tab->tab[e].sz = sizeof(Xpost_Stack); /* insert size */
+    tab->adr[e] = stackadr; /* insert address */
+    tab->sz[e] = sizeof(Xpost_Stack); /* insert size */
     /* discard */
 }
 
-int xpost_stack_count(Xpost_Memory_File *mem,
-                      unsigned int stackadr)
+XPCHECKAPI int xpost_stack_count(Xpost_Memory_File *mem,
+                                 unsigned int stackadr)
 {
     Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
     unsigned int ct = 0;
@@ -176,9 +176,9 @@ XPCHECKAPI int xpost_stack_push(Xpost_Memory_File *mem,
     return 1;
 }
 
-Xpost_Object xpost_stack_topdown_fetch(Xpost_Memory_File *mem,
-                                       unsigned int stackadr,
-                                       int idx)
+XPCHECKAPI Xpost_Object xpost_stack_topdown_fetch(Xpost_Memory_File *mem,
+                                                  unsigned int stackadr,
+                                                  int idx)
 {
 #if 0
     int i = idx;
@@ -97,7 +97,7 @@ XPCHECKAPI void xpost_stack_free(Xpost_Memory_File *mem, unsigned int stackadr);
 /**
  * @brief Count elements in stack.
  */
-int xpost_stack_count(Xpost_Memory_File *mem, unsigned int stackadr);
+XPCHECKAPI int xpost_stack_count(Xpost_Memory_File *mem, unsigned int stackadr);
 
 /**
  * @brief Put an object on top of the stack.
@@ -109,9 +109,9 @@ XPCHECKAPI int xpost_stack_push(Xpost_Memory_File *mem,
 /**
  * @brief Index the stack from the top down, fetching object.
  */
-Xpost_Object xpost_stack_topdown_fetch(Xpost_Memory_File *mem,
-                                       unsigned stackadr,
-                                       int i);
+XPCHECKAPI Xpost_Object xpost_stack_topdown_fetch(Xpost_Memory_File *mem,
+                                                  unsigned stackadr,
+                                                  int i);
 
 /**
  * @brief Index the stack from the top down, replacing object.
@@ -4,6 +4,7 @@ check_PROGRAMS = src/tests/xpost_suite
 src_tests_xpost_suite_SOURCES = \
 src/tests/xpost_suite.c \
 src/tests/xpost_suite.h \
+src/tests/xpost_test_interpreter.c \
 src/tests/xpost_test_main.c \
 src/tests/xpost_test_memory.c \
 src/tests/xpost_test_stack.c
@@ -50,6 +50,7 @@ static const Xpost_Test_Case _tests[] = {
     { "Main", xpost_test_main },
     { "Memory", xpost_test_memory },
     { "Stack", xpost_test_stack },
+    { "Interpreter", xpost_test_interpreter },
     { NULL, NULL }
 };
 
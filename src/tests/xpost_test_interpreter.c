@@ -0,0 +1,767 @@
+/*
+ * Xpost - a Level-2 Postscript interpreter
+ * Copyright (C) 2013-2016, Michael Joshua Ryan
+ * Copyright (C) 2013-2016, Vincent Torri
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the Xpost software product nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined (HAVE_POLL_H) && defined (HAVE_UNISTD_H) && !defined (_WIN32)
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <fcntl.h> /* open */
+# include <unistd.h> /* close getpid unlink */
+# define XPOST_TEST_FIFO
+#endif
+
+#include <check.h>
+
+#include "xpost.h"
+#include "xpost_log.h"
+#include "xpost_memory.h"
+#include "xpost_object.h"
+#include "xpost_stack.h"
+#include "xpost_context.h"
+
+#include "xpost_suite.h"
+
+/* a program given to a callback a chunk at a time */
+typedef struct
+{
+    const char *program;
+    size_t len;
+    size_t pos;
+    size_t avail; /* the end of the chunks given so far */
+} Xpost_Test_Chunks;
+
+static long
+_xpost_test_chunks_read(void *data, void *buf, size_t len)
+{
+    Xpost_Test_Chunks *in = data;
+    size_t n;
+
+    if (in->pos == in->len)
+        return 0;
+    /* the next chunk comes only when the caller resumes */
+    if (in->pos == in->avail)
+        return -1;
+    n = in->avail - in->pos;
+    if (n > len)
+        n = len;
+    memcpy(buf, in->program + in->pos, n);
+    in->pos += n;
+    return (long)n;
+}
+
+static Xpost_Context *
+_xpost_test_create(void)
+{
+    return xpost_create("null",
+                        XPOST_OUTPUT_DEFAULT,
+                        NULL,
+                        XPOST_SHOWPAGE_NOPAUSE,
+                        XPOST_OUTPUT_MESSAGE_QUIET,
+                        XPOST_IGNORE_SIZE, 0, 0);
+}
+
+/* return 1 if the program ran by ctx ended with ret 0,
+   leaving true on the operand stack, and destroy ctx */
+static int
+_xpost_test_result(Xpost_Context *ctx, int ret)
+{
+    Xpost_Object o;
+    int ok = 0;
+
+    if (ret == 0 &&
+        xpost_stack_count(ctx->lo, ctx->os) > 0)
+    {
+        o = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 0);
+        ok = (xpost_object_get_type(o) == booleantype) && o.int_.val;
+    }
+
+    xpost_destroy(ctx);
+    return ok;
+}
+
+/* run a program of len bytes in a new context of the null device.
+   return 1 if it leaves true on the operand stack */
+static int
+_xpost_test_run_buffer(const char *program, size_t len)
+{
+    Xpost_Context *ctx;
+
+    ctx = _xpost_test_create();
+    if (!ctx)
+        return 0;
+
+    return _xpost_test_result(ctx, xpost_run_buffer(ctx, program, len));
+}
+
+/* the same, with the program read by a callback
+   in chunks of chunk bytes, resuming after each */
+static int
+_xpost_test_run_chunks(const char *program, size_t chunk)
+{
+    Xpost_Test_Chunks in;
+    Xpost_Input_Callback cb;
+    Xpost_Context *ctx;
+    int ret;
+
+    ctx = _xpost_test_create();
+    if (!ctx)
+        return 0;
+
+    in.program = program;
+    in.len = strlen(program);
+    in.pos = 0;
+    in.avail = chunk;
+    cb.read = _xpost_test_chunks_read;
+    cb.data = &in;
+    ret = xpost_run(ctx, XPOST_INPUT_CALLBACK, &cb);
+    while (ret == XPOST_RUN_IOBLOCK && in.avail < in.len)
+    {
+        in.avail = in.avail + chunk < in.len ? in.avail + chunk : in.len;
+        ret = xpost_run(ctx, XPOST_INPUT_RESUME, NULL);
+    }
+
+    return _xpost_test_result(ctx, ret);
+}
+
+static int
+_xpost_test_run(const char *program)
+{
+    return _xpost_test_run_buffer(program, strlen(program));
+}
+
+/* the copies of a saved array reuse entities of the free list,
+   whose sizes must not be stale when they are collected */
+START_TEST(xpost_interpreter_save_collect)
+{
+    int ret;
+
+    xpost_init();
+
+    ret = _xpost_test_run(
+        "/churn { 0 1 500 { pop 7 array pop 300 array pop"
+        "  40 string pop 2000 string pop } for } def "
+        "churn 1 vmreclaim "
+        "/a 1000 array def 0 1 999 { a exch dup put } for "
+        "/s save def "
+        "0 1 999 { a exch (x) put } for "
+        "churn 1 vmreclaim "
+        "a 999 get (x) eq "
+        "s restore "
+        "a 999 get 999 eq and");
+    ck_assert_int_eq (ret, 1);
+
+    xpost_quit();
+}
+END_TEST
+
+/* numbers of each syntax, from the program and from strings,
+   and tokens which look like numbers but are names */
+START_TEST(xpost_interpreter_number_token)
+{
+    int ret;
+
+    xpost_init();
+
+    ret = _xpost_test_run(
+        "12 type /integertype eq "
+        "-7 3 add -4 eq and "
+        "1.5e2 150 eq and "
+        ".5 0.5 eq and "
+        "-.5E1 -5 eq and "
+        "+1.25 type /realtype eq and "
+        "8#777 511 eq and "
+        "16#fF 255 eq and "
+        "36#Z 35 eq and "
+        "99999999999999999999 type /realtype eq and "
+        "{ 1e 1.2.3 +- 16# #10 1a e5 . } "
+        "  { type /nametype eq and } forall "
+        "(16#10 -.5 x) token pop exch token pop exch token pop "
+        "  exch pop /x eq exch -0.5 eq and exch 16 eq and and");
+    ck_assert_int_eq (ret, 1);
+
+    xpost_quit();
+}
+END_TEST
+
+/* a long EODString: a partial match of it, passed through
+   when the reader's buffer is nearly full, is kept whole */
+START_TEST(xpost_interpreter_subfile_long_eod)
+{
+    int ret;
+
+    xpost_init();
+
+    ret = _xpost_test_run(
+        "/pat 6000 string def "
+        "0 1 5998 { pat exch 97 put } for pat 5999 98 put "
+        "/src 21000 string def "
+        "0 1 20999 { src exch 120 put } for "
+        "8000 1 13998 { src exch 97 put } for src 13999 99 put "
+        "src 14000 pat putinterval "
+        "src 0 pat /SubFileDecode filter "
+        "dup 21000 string readstring pop exch closefile "
+        "dup length 14000 eq exch dup 7999 get 120 eq exch "
+        "dup 8000 get 97 eq exch 13999 get 99 eq and and and");
+    ck_assert_int_eq (ret, 1);
+
+    xpost_quit();
+}
+END_TEST
+
+/* a program read by a callback, cut in the middle of its tokens
+   and of the data read from it, by operators and by a filter */
+START_TEST(xpost_interpreter_callback_chunks)
+{
+    static const char program[] =
+        "/abcdefgh 12345678 def "
+        "abcdefgh 12345678 eq "
+        "currentfile 10 string readstring 0123456789 "
+        "  pop (0123456789) eq and "
+        "currentfile 20 string readline abc\n"
+        "  pop (abc) eq and "
+        "currentfile /ASCIIHexDecode filter 5 string readstring "
+        "48656c6c6f> pop (Hello) eq and "
+        "(rest) (rest) eq and";
+    int ret;
+
+    xpost_init();
+
+    ret = _xpost_test_run_chunks(program, 7);
+    ck_assert_int_eq (ret, 1);
+
+    xpost_quit();
+}
+END_TEST
+
+/* the ARGB pixel at x, y of a buffer, as 0xAARRGGBB */
+static unsigned int
+_xpost_test_argb(const Xpost_Output_Buffer *buf, int x, int y)
+{
+    const unsigned char *p = buf->pixels + y * buf->stride + x * 4;
+
+    return ((unsigned int)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+/* 1 if the bytes past the pixels of each row still hold val */
+static int
+_xpost_test_padding(const Xpost_Output_Buffer *buf, unsigned char val)
+{
+    int x;
+    int y;
+
+    for (y = 0; y < buf->height; y++)
+        for (x = buf->width * 4; x < buf->stride; x++)
+            if (buf->pixels[y * buf->stride + x] != val)
+                return 0;
+    return 1;
+}
+
+/* an output buffer must fit the device which renders into it,
+   which draws into it in place, in its stride and format */
+START_TEST(xpost_interpreter_buffer_in)
+{
+    static unsigned char pixels[(16 * 4 + 8) * 8];
+    static const char fill[] = "1 0 0 setrgbcolor 4 2 6 3 rectfill";
+    Xpost_Output_Buffer buf;
+    Xpost_Context *ctx;
+
+    xpost_init();
+
+    buf.pixels = pixels;
+    buf.width = 16;
+    buf.height = 8;
+    buf.stride = 16 * 3;
+    buf.format = XPOST_PIXEL_FORMAT_RGB;
+
+    /* bgr renders bgr pixels only */
+    ctx = xpost_create("bgr", XPOST_OUTPUT_BUFFERIN, &buf,
+                       XPOST_SHOWPAGE_NOPAUSE, XPOST_OUTPUT_MESSAGE_QUIET,
+                       XPOST_IGNORE_SIZE, 0, 0);
+    ck_assert(ctx == NULL);
+
+    /* rows of 4-byte pixels do not fit in 3 bytes each */
+    buf.format = XPOST_PIXEL_FORMAT_ARGB;
+    ctx = xpost_create("raster", XPOST_OUTPUT_BUFFERIN, &buf,
+                       XPOST_SHOWPAGE_NOPAUSE, XPOST_OUTPUT_MESSAGE_QUIET,
+                       XPOST_IGNORE_SIZE, 0, 0);
+    ck_assert(ctx == NULL);
+
+    /* rows of a larger canvas, whose end must not be touched */
+    memset(pixels, 0xa5, sizeof(pixels));
+    buf.stride = 16 * 4 + 8;
+    ctx = xpost_create("raster", XPOST_OUTPUT_BUFFERIN, &buf,
+                       XPOST_SHOWPAGE_NOPAUSE, XPOST_OUTPUT_MESSAGE_QUIET,
+                       XPOST_IGNORE_SIZE, 0, 0);
+    ck_assert(ctx != NULL);
+
+    /* the page is cleared in the buffer, then the rectangle
+       covers the rows 3 to 5 and the columns 5 to 10 */
+    ck_assert_int_eq (xpost_run_buffer(ctx, fill, sizeof(fill) - 1), 0);
+    ck_assert_int_eq (_xpost_test_argb(&buf, 5, 3), 0xffff0000);
+    ck_assert_int_eq (_xpost_test_argb(&buf, 10, 5), 0xffff0000);
+    ck_assert_int_eq (_xpost_test_argb(&buf, 4, 4), 0xffffffff);
+    ck_assert_int_eq (_xpost_test_argb(&buf, 11, 4), 0xffffffff);
+    ck_assert_int_eq (_xpost_test_argb(&buf, 7, 2), 0xffffffff);
+    ck_assert_int_eq (_xpost_test_argb(&buf, 7, 6), 0xffffffff);
+    ck_assert_int_eq (_xpost_test_argb(&buf, 0, 0), 0xffffffff);
+    ck_assert_int_eq (_xpost_test_argb(&buf, 15, 7), 0xffffffff);
+    ck_assert(_xpost_test_padding(&buf, 0xa5));
+
+    /* erasepage paints the same memory white */
+    ck_assert_int_eq (xpost_run_buffer(ctx, "erasepage", 9), 0);
+    ck_assert_int_eq (_xpost_test_argb(&buf, 7, 4), 0xffffffff);
+    ck_assert(_xpost_test_padding(&buf, 0xa5));
+
+    xpost_destroy(ctx);
+
+    xpost_quit();
+}
+END_TEST
+
+/* an unreachable file of local vm is closed by the collector,
+   which flushes what was written to it, not a reachable one */
+START_TEST(xpost_interpreter_collect_file)
+{
+    int ret;
+
+    xpost_init();
+
+    ret = _xpost_test_run(
+        "/rd { (r) file dup 100 string readstring pop exch closefile } def "
+        "(xpost_test_dropped) (w) file (dropped) writestring "
+        "/g (xpost_test_kept) (w) file def g (kept) writestring "
+        "(xpost_test_dropped) rd () eq "
+        "1 vmreclaim "
+        "(xpost_test_dropped) rd (dropped) eq and "
+        "(xpost_test_kept) rd () eq and "
+        "g status and "
+        "g closefile (xpost_test_kept) rd (kept) eq and");
+    remove("xpost_test_dropped");
+    remove("xpost_test_kept");
+    ck_assert_int_eq (ret, 1);
+
+    xpost_quit();
+}
+END_TEST
+
+/* binary tokens of each encoding, scanned from strings */
+START_TEST(xpost_interpreter_binary_token)
+{
+    int ret;
+
+    xpost_init();
+
+    ret = _xpost_test_run(
+        "/tok { token pop exch pop } def "
+        "<88FE> tok -2 eq "
+        "<8400010000> tok 65536 eq and "
+        "<8500000100> tok 65536 eq and "
+        "<860100> tok 256 eq and "
+        "<8A3FC00000> tok 1.5 eq and "
+        "<890100000003> tok 1.5 eq and "
+        "<8D01> tok and "
+        "<8E03616263> tok (abc) eq and "
+        "<95200003000100020003> tok aload pop "
+        "  3 eq exch 2 eq and exch 1 eq and and "
+        /* { 1 2 add } as a sequence, followed by p */
+        "<8003001F 0100000000000001 0100000000000002"
+        "  8300000300000018 616464 70> "
+        "token pop exch length 1 eq exch exec 3 eq and and");
+    ck_assert_int_eq (ret, 1);
+
+    xpost_quit();
+}
+END_TEST
+
+/* binary tokens in a program end the token before them,
+   and a binary object sequence is executed as it is scanned */
+START_TEST(xpost_interpreter_binary_program)
+{
+    static const char program[] =
+        "1\x88\x02" " add 3 eq "
+        "\x80\x03\x00\x1f"
+        "\x01\x00\x00\x00\x00\x00\x00\x01"
+        "\x01\x00\x00\x00\x00\x00\x00\x02"
+        "\x83\x00\x00\x03\x00\x00\x00\x18"
+        "add"
+        " 3 eq and";
+    int ret;
+
+    xpost_init();
+
+    ret = _xpost_test_run_buffer(program, sizeof(program) - 1);
+    ck_assert_int_eq (ret, 1);
+
+    /* a bad object type, first or after an object, is an error
+       that leaves only the operand and the result of stopped */
+    ret = _xpost_test_run("{ <8001000C7F00000000000000> token } stopped "
+                          "count 2 eq and "
+                          "clear "
+                          "{ <8002001401000000000000017F00000000000000> token } stopped "
+                          "count 2 eq and");
+    ck_assert_int_eq (ret, 1);
+
+    xpost_quit();
+}
+END_TEST
+
+/* a job run in slices, returning at its page, then to its end */
+START_TEST(xpost_interpreter_step)
+{
+    Xpost_Context *ctx;
+    Xpost_Step_Status st;
+    Xpost_Object o;
+    int slices;
+
+    xpost_init();
+
+    ctx = xpost_create("null", XPOST_OUTPUT_DEFAULT, NULL,
+                       XPOST_SHOWPAGE_RETURN, XPOST_OUTPUT_MESSAGE_QUIET,
+                       XPOST_IGNORE_SIZE, 0, 0);
+    ck_assert(ctx != NULL);
+
+    ck_assert_int_eq (xpost_start(ctx, XPOST_INPUT_STRING,
+                                  "/n 0 def 1 1 100 { n add /n exch def } for "
+                                  "n showpage n 1 add"), 0);
+
+    /* the loop takes many slices of 50 objects */
+    slices = 0;
+    while ((st = xpost_step(ctx, 50, 0)) == XPOST_STEP_RUNNING)
+        slices++;
+    ck_assert(slices > 10);
+    ck_assert_int_eq (st, XPOST_STEP_PAGE);
+    o = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 0);
+    ck_assert_int_eq (xpost_object_get_type(o), integertype);
+    ck_assert_int_eq (o.int_.val, 5050);
+
+    /* the end of the job, in one slice */
+    ck_assert_int_eq (xpost_step(ctx, 0, 0), XPOST_STEP_DONE);
+    o = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 0);
+    ck_assert_int_eq (o.int_.val, 5051);
+
+    /* no job is left to step */
+    ck_assert_int_eq (xpost_step(ctx, 0, 0), XPOST_STEP_ERROR);
+
+    /* the context still runs a whole job */
+    ck_assert(_xpost_test_result(ctx, xpost_run(ctx, XPOST_INPUT_STRING,
+                                                "1 2 add 3 eq")));
+
+    xpost_quit();
+}
+END_TEST
+
+/* what the page callback was given at each showpage */
+typedef struct
+{
+    int pages;
+    int page[2];
+    int width;
+    int height;
+    int stride;
+    Xpost_Pixel_Format format;
+    unsigned int rgb[2]; /* a pixel of the rectangle, as 0xRRGGBB */
+} Xpost_Test_Pages;
+
+static void
+_xpost_test_page(Xpost_Context *ctx,
+                 int page,
+                 const unsigned char *pixels,
+                 int width,
+                 int height,
+                 int stride,
+                 Xpost_Pixel_Format format,
+                 void *data)
+{
+    Xpost_Test_Pages *pages = data;
+    const unsigned char *p;
+
+    (void)ctx;
+    if (pages->pages == 2)
+    {
+        pages->pages++;
+        return;
+    }
+    /* the rectangle covers the rows 762 to 771 from the top */
+    p = pixels + 765 * stride + 5 * 3;
+    pages->page[pages->pages] = page;
+    pages->rgb[pages->pages] = (p[0] << 16) | (p[1] << 8) | p[2];
+    pages->width = width;
+    pages->height = height;
+    pages->stride = stride;
+    pages->format = format;
+    pages->pages++;
+}
+
+/* the raster device lends its page at each showpage */
+START_TEST(xpost_interpreter_page_callback)
+{
+    static const char program[] =
+        "1 0 0 setrgbcolor 0 20 10 10 rectfill showpage "
+        "0 0 1 setrgbcolor 0 20 10 10 rectfill showpage";
+    Xpost_Test_Pages pages;
+    Xpost_Context *ctx;
+
+    xpost_init();
+
+    ctx = xpost_create("raster", XPOST_OUTPUT_DEFAULT, NULL,
+                       XPOST_SHOWPAGE_NOPAUSE, XPOST_OUTPUT_MESSAGE_QUIET,
+                       XPOST_IGNORE_SIZE, 0, 0);
+    ck_assert(ctx != NULL);
+
+    memset(&pages, 0, sizeof(pages));
+    xpost_page_callback_set(ctx, _xpost_test_page, &pages);
+    ck_assert_int_eq (xpost_run_buffer(ctx, program, sizeof(program) - 1), 0);
+
+    ck_assert_int_eq (pages.pages, 2);
+    ck_assert_int_eq (pages.page[0], 1);
+    ck_assert_int_eq (pages.page[1], 2);
+    ck_assert_int_eq (pages.width, 612);
+    ck_assert_int_eq (pages.height, 792);
+    ck_assert_int_eq (pages.stride, 612 * 3);
+    ck_assert_int_eq (pages.format, XPOST_PIXEL_FORMAT_RGB);
+    ck_assert_int_eq (pages.rgb[0], 0xff0000);
+    ck_assert_int_eq (pages.rgb[1], 0x0000ff);
+
+    xpost_destroy(ctx);
+
+    xpost_quit();
+}
+END_TEST
+
+/* contexts which yield take turns: each writes its letter
+   four times, never three times in a row */
+START_TEST(xpost_interpreter_yield)
+{
+    int ret;
+
+    xpost_init();
+
+    ret = _xpost_test_run(
+        "/s 8 string def /i 0 def "
+        "/put1 { s i 3 -1 roll put /i i 1 add def } def "
+        "mark { 4 { 65 put1 yield } repeat } fork "
+        "mark { 4 { 66 put1 yield } repeat } fork "
+        "join cleartomark join cleartomark "
+        "/n 0 def s { 65 eq { /n n 1 add def } if } forall "
+        "i 8 eq n 4 eq and "
+        "s (AAA) search { pop pop pop false } { pop true } ifelse and "
+        "s (BBB) search { pop pop pop false } { pop true } ifelse and");
+    ck_assert_int_eq (ret, 1);
+
+    xpost_quit();
+}
+END_TEST
+
+/* more contexts than a segment of the context table
+   and than a context list holds, forked and joined twice
+   to reuse their released cids */
+START_TEST(xpost_interpreter_fork_many)
+{
+    int ret;
+
+    xpost_init();
+
+    ret = _xpost_test_run(
+        "/sum { [ 1 1 100 { mark exch { dup mul } fork } for ] "
+        "0 exch { join exch pop add } forall } def "
+        "sum 338350 eq sum 338350 eq and count 1 eq and");
+    ck_assert_int_eq (ret, 1);
+
+    xpost_quit();
+}
+END_TEST
+
+/* count the pages shown on a context */
+static void
+_xpost_test_count_page(Xpost_Context *ctx,
+                       int page,
+                       const unsigned char *pixels,
+                       int width,
+                       int height,
+                       int stride,
+                       Xpost_Pixel_Format format,
+                       void *data)
+{
+    (void)ctx;
+    (void)page;
+    (void)pixels;
+    (void)width;
+    (void)height;
+    (void)stride;
+    (void)format;
+    (*(int *)data)++;
+}
+
+/* more jobs than contexts run on the threads of a pool,
+   each showing a page unless a previous job left its mark */
+START_TEST(xpost_interpreter_pool_run)
+{
+    static const char program[] =
+        "userdict /leak known not { showpage } if "
+        "/leak true def";
+    Xpost_Context_Pool *pool;
+    Xpost_Context *ctx[2];
+    Xpost_Job jobs[8];
+    int pages[2];
+    int i;
+
+    xpost_init();
+
+    pool = xpost_context_pool_create(2, "raster", XPOST_OUTPUT_DEFAULT, NULL,
+                                     XPOST_SHOWPAGE_NOPAUSE,
+                                     XPOST_OUTPUT_MESSAGE_QUIET,
+                                     XPOST_IGNORE_SIZE, 0, 0);
+    ck_assert(pool != NULL);
+
+    /* the callbacks are kept when the contexts are released */
+    for (i = 0; i < 2; i++)
+    {
+        pages[i] = 0;
+        ctx[i] = xpost_context_pool_acquire(pool);
+        ck_assert(ctx[i] != NULL);
+        xpost_page_callback_set(ctx[i], _xpost_test_count_page, &pages[i]);
+    }
+    for (i = 0; i < 2; i++)
+        ck_assert(xpost_context_pool_release(pool, ctx[i]));
+
+    for (i = 0; i < 8; i++)
+    {
+        jobs[i].input_type = XPOST_INPUT_STRING;
+        jobs[i].input = program;
+        jobs[i].result = -1;
+    }
+    ck_assert(xpost_context_pool_run(pool, jobs, 8));
+    for (i = 0; i < 8; i++)
+        ck_assert_int_eq (jobs[i].result, 0);
+    ck_assert_int_eq (pages[0] + pages[1], 8);
+
+    xpost_context_pool_destroy(pool);
+
+    xpost_quit();
+}
+END_TEST
+
+/* a callback without bytes returns to the caller,
+   and the job goes on when it is resumed */
+START_TEST(xpost_interpreter_ioblock)
+{
+    static const char program[] = "1 2 add 3 eq";
+    Xpost_Test_Chunks in;
+    Xpost_Input_Callback cb;
+    Xpost_Context *ctx;
+    int ret;
+
+    xpost_init();
+
+    ctx = _xpost_test_create();
+    ck_assert(ctx != NULL);
+
+    in.program = program;
+    in.len = sizeof(program) - 1;
+    in.pos = 0;
+    in.avail = 0;
+    cb.read = _xpost_test_chunks_read;
+    cb.data = &in;
+    ck_assert_int_eq (xpost_run(ctx, XPOST_INPUT_CALLBACK, &cb), XPOST_RUN_IOBLOCK);
+    ck_assert_int_eq (in.pos, 0);
+
+    in.avail = in.len;
+    ret = xpost_run(ctx, XPOST_INPUT_RESUME, NULL);
+    ck_assert_int_eq (in.pos, in.len);
+    ck_assert(_xpost_test_result(ctx, ret));
+
+    xpost_quit();
+}
+END_TEST
+
+#ifdef XPOST_TEST_FIFO
+
+/* a context reading an empty fifo waits for it in poll(),
+   while the context it forked writes to it */
+START_TEST(xpost_interpreter_fifo)
+{
+    char path[64];
+    char program[512];
+    int fd;
+    int ret;
+
+    xpost_init();
+
+    snprintf(path, sizeof(path), "/tmp/xpost_test_fifo%d", (int)getpid());
+    ck_assert_int_eq (mkfifo(path, 0600), 0);
+    /* a writer, so that opening the fifo to read does not wait */
+    fd = open(path, O_RDWR | O_NONBLOCK);
+    ck_assert(fd >= 0);
+
+    snprintf(program, sizeof(program),
+             "/f (%s) (r) file def "
+             "mark { 3 { yield } repeat "
+             "(%s) (w) file dup (42 ) writestring closefile } fork "
+             "f token pop exch join cleartomark 42 eq",
+             path, path);
+    ret = _xpost_test_run(program);
+
+    close(fd);
+    unlink(path);
+    ck_assert_int_eq (ret, 1);
+
+    xpost_quit();
+}
+END_TEST
+
+#endif
+
+void xpost_test_interpreter(TCase *tc)
+{
+    tcase_add_test(tc, xpost_interpreter_save_collect);
+    tcase_add_test(tc, xpost_interpreter_collect_file);
+    tcase_add_test(tc, xpost_interpreter_number_token);
+    tcase_add_test(tc, xpost_interpreter_binary_token);
+    tcase_add_test(tc, xpost_interpreter_binary_program);
+    tcase_add_test(tc, xpost_interpreter_subfile_long_eod);
+    tcase_add_test(tc, xpost_interpreter_callback_chunks);
+    tcase_add_test(tc, xpost_interpreter_buffer_in);
+    tcase_add_test(tc, xpost_interpreter_step);
+    tcase_add_test(tc, xpost_interpreter_page_callback);
+    tcase_add_test(tc, xpost_interpreter_yield);
+    tcase_add_test(tc, xpost_interpreter_fork_many);
+    tcase_add_test(tc, xpost_interpreter_pool_run);
+    tcase_add_test(tc, xpost_interpreter_ioblock);
+#ifdef XPOST_TEST_FIFO
+    tcase_add_test(tc, xpost_interpreter_fifo);
+#endif
+}
@@ -34,13 +34,19 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
 #include <check.h>
 
 #include "xpost.h"
 #include "xpost_log.h"
 #include "xpost_memory.h"
+#include "xpost_free.h"
 
 #include "xpost_suite.h"
 
@@ -52,7 +58,7 @@ START_TEST(xpost_memory_init_simple)
     xpost_init();
 
     memset(&mem, 0, sizeof(Xpost_Memory_File));
-    ret = xpost_memory_file_init(&mem, NULL, -1, NULL, NULL, NULL);
+    ret = xpost_memory_file_init(&mem, NULL, -1, NULL);
     ck_assert_int_eq (ret, 1);
     ck_assert(mem.base != NULL);
     ret = xpost_memory_file_exit(&mem);
@@ -71,7 +77,7 @@ START_TEST(xpost_memory_init_alloc)
     xpost_init();
 
     memset(&mem, 0, sizeof(Xpost_Memory_File));
-    ret = xpost_memory_file_init(&mem, NULL, -1, NULL, NULL, NULL);
+    ret = xpost_memory_file_init(&mem, NULL, -1, NULL);
     ck_assert_int_eq (ret, 1);
     ck_assert(mem.base != NULL);
     ret = xpost_memory_file_alloc(&mem, 64, &addr);
@@ -112,7 +118,7 @@ START_TEST(xpost_memory_grow)
 
     xpost_init();
 
-    ret = xpost_memory_file_init(&mem, NULL, -1, NULL, NULL, NULL);
+    ret = xpost_memory_file_init(&mem, NULL, -1, NULL);
     ck_assert_int_eq (ret, 1);
     ck_assert(mem.base != NULL);
 
@@ -139,7 +145,7 @@ START_TEST(xpost_memory_tab_init)
 
     xpost_init();
 
-    ret = xpost_memory_file_init(&mem, NULL, -1, NULL, NULL, NULL);
+    ret = xpost_memory_file_init(&mem, NULL, -1, NULL);
     ck_assert_int_eq (ret, 1);
     ck_assert(mem.base != NULL);
     ret = xpost_memory_table_init(&mem);
@@ -163,7 +169,7 @@ START_TEST(xpost_memory_tab_alloc)
 
     xpost_init();
 
-    ret = xpost_memory_file_init(&mem, NULL, -1, NULL, NULL, NULL);
+    ret = xpost_memory_file_init(&mem, NULL, -1, NULL);
     ck_assert_int_eq (ret, 1);
     ck_assert(mem.base != NULL);
     ret = xpost_memory_table_init(&mem);
@@ -187,6 +193,299 @@ START_TEST(xpost_memory_tab_alloc)
 }
 END_TEST
 
+START_TEST(xpost_memory_tab_grow)
+{
+    Xpost_Memory_File mem = {0};
+    unsigned int ent;
+    unsigned int val;
+    unsigned int lev;
+    unsigned int i;
+    int ret;
+
+    xpost_init();
+
+    ret = xpost_memory_file_init(&mem, NULL, -1, NULL);
+    ck_assert_int_eq (ret, 1);
+    ret = xpost_memory_table_init(&mem);
+    ck_assert_int_eq (ret, 1);
+
+    /* allocate enough entities to force the table to grow */
+    for (i = 0; i < 2500; i++)
+    {
+        ret = xpost_memory_table_alloc(&mem, sizeof i, 0, &ent);
+        ck_assert_int_eq (ret, 1);
+        ck_assert_int_eq (ent, i);
+        ret = xpost_memory_put(&mem, ent, 0, sizeof i, &i);
+        ck_assert_int_eq (ret, 1);
+        ret = xpost_memory_table_set_lev(&mem, ent, i & 0xff);
+        ck_assert_int_eq (ret, 1);
+    }
+    ck_assert(mem.table.max > 2500);
+
+    for (i = 0; i < 2500; i++)
+    {
+        ret = xpost_memory_get(&mem, i, 0, sizeof val, &val);
+        ck_assert_int_eq (ret, 1);
+        ck_assert_int_eq (val, i);
+        ret = xpost_memory_table_get_lev(&mem, i, &lev);
+        ck_assert_int_eq (ret, 1);
+        ck_assert_int_eq (lev, i & 0xff);
+    }
+
+    ret = xpost_memory_file_exit(&mem);
+    ck_assert_int_eq (ret, 1);
+    ck_assert(mem.table.adr == NULL);
+
+    xpost_quit();
+}
+END_TEST
+
+#if defined(HAVE_MMAP) && !defined(_WIN32)
+/* create an unlinked temporary file and a memory file, mapped on it
+   if map is set, with a table, a free list and an entity holding 42.
+   return the file descriptor, or -1 on failure */
+static int
+_xpost_test_memory_fixture(Xpost_Memory_File *mem,
+                           int map,
+                           unsigned int *ent)
+{
+    char fname[] = "/tmp/xpost_test_XXXXXX";
+    unsigned int val = 42;
+    int fd;
+
+    fd = mkstemp(fname);
+    if (fd == -1)
+        return -1;
+    unlink(fname);
+
+    if (!xpost_memory_file_init(mem, NULL, map ? fd : -1, NULL) ||
+        !xpost_memory_table_init(mem) ||
+        !xpost_free_init(mem) ||
+        !xpost_memory_table_alloc(mem, sizeof val, 0, ent) ||
+        !xpost_memory_put(mem, *ent, 0, sizeof val, &val))
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static int _xpost_test_memory_finalized;
+
+static int
+_xpost_test_memory_finalize(Xpost_Memory_File *mem, unsigned int ent)
+{
+    (void)mem;
+    (void)ent;
+    _xpost_test_memory_finalized++;
+    return 1;
+}
+
+START_TEST(xpost_memory_freeze_reset)
+{
+    Xpost_Memory_File mem = {0};
+    unsigned int ent;
+    unsigned int ent2;
+    unsigned int used;
+    unsigned int val;
+    int ret;
+
+    xpost_init();
+
+    ck_assert(_xpost_test_memory_fixture(&mem, 1, &ent) != -1);
+    used = mem.used;
+
+    ret = xpost_memory_file_freeze(&mem);
+    ck_assert_int_eq (ret, 1);
+
+    /* modify the frozen entity and allocate a new one */
+    val = 7;
+    ret = xpost_memory_put(&mem, ent, 0, sizeof val, &val);
+    ck_assert_int_eq (ret, 1);
+    ret = xpost_memory_table_alloc(&mem, sizeof val, 0, &ent2);
+    ck_assert_int_eq (ret, 1);
+    ck_assert(mem.used > used);
+
+    ret = xpost_memory_file_reset(&mem);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (mem.used, used);
+    ck_assert_int_eq (mem.table.nextent, ent + 1);
+    ret = xpost_memory_get(&mem, ent, 0, sizeof val, &val);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (val, 42);
+
+    ret = xpost_memory_file_exit(&mem);
+    ck_assert_int_eq (ret, 1);
+
+    xpost_quit();
+}
+END_TEST
+
+START_TEST(xpost_memory_freeze_reset_freed)
+{
+    Xpost_Memory_File mem = {0};
+    unsigned int ent;
+    unsigned int fent;
+    unsigned int ent2;
+    unsigned int nextent;
+    unsigned int val;
+    int ret;
+
+    xpost_init();
+
+    ck_assert(_xpost_test_memory_fixture(&mem, 1, &ent) != -1);
+    ret = xpost_memory_register_finalize_function(&mem, 1, _xpost_test_memory_finalize);
+    ck_assert_int_eq (ret, 1);
+    val = 42;
+    ret = xpost_memory_table_alloc(&mem, sizeof val, 1, &fent);
+    ck_assert_int_eq (ret, 1);
+    ret = xpost_memory_put(&mem, fent, 0, sizeof val, &val);
+    ck_assert_int_eq (ret, 1);
+    nextent = mem.table.nextent;
+
+    ret = xpost_memory_file_freeze(&mem);
+    ck_assert_int_eq (ret, 1);
+    _xpost_test_memory_finalized = 0;
+
+    /* free both, as a sweep does: the frozen resource is kept */
+    ret = xpost_free_memory_ent(&mem, ent);
+    ck_assert(ret > 0);
+    ret = xpost_free_memory_ent(&mem, fent);
+    ck_assert_int_eq (ret, 0);
+    ck_assert_int_eq (_xpost_test_memory_finalized, 0);
+
+    /* reuse the freed entity for a new resource */
+    ret = xpost_memory_table_alloc(&mem, sizeof val, 1, &ent2);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (ent2, ent);
+    val = 7;
+    ret = xpost_memory_put(&mem, ent2, 0, sizeof val, &val);
+    ck_assert_int_eq (ret, 1);
+
+    /* the new resource is released, the frozen ones come back */
+    ret = xpost_memory_file_reset(&mem);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (_xpost_test_memory_finalized, 1);
+    ck_assert_int_eq (mem.table.tag[ent], 0);
+    ck_assert_int_eq (mem.table.tag[fent], 1);
+    ret = xpost_memory_get(&mem, ent, 0, sizeof val, &val);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (val, 42);
+    ret = xpost_memory_get(&mem, fent, 0, sizeof val, &val);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (val, 42);
+
+    /* and so does the empty free list */
+    ret = xpost_memory_table_alloc(&mem, sizeof val, 0, &ent2);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (ent2, nextent);
+
+    ret = xpost_memory_file_exit(&mem);
+    ck_assert_int_eq (ret, 1);
+
+    xpost_quit();
+}
+END_TEST
+
+START_TEST(xpost_memory_clone)
+{
+    Xpost_Memory_File mem = {0};
+    Xpost_Memory_File mem2 = {0};
+    unsigned int ent;
+    unsigned int ent2;
+    unsigned int used;
+    unsigned int val;
+    int ret;
+
+    xpost_init();
+
+    ck_assert(_xpost_test_memory_fixture(&mem, 1, &ent) != -1);
+    used = mem.used;
+
+    ret = xpost_memory_file_freeze(&mem);
+    ck_assert_int_eq (ret, 1);
+    ret = xpost_memory_file_clone(&mem2, &mem);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (mem2.used, used);
+
+    /* changes to the clone, even growing it, are private */
+    val = 7;
+    ret = xpost_memory_put(&mem2, ent, 0, sizeof val, &val);
+    ck_assert_int_eq (ret, 1);
+    ret = xpost_memory_table_alloc(&mem2, 4 * mem2.max, 0, &ent2);
+    ck_assert_int_eq (ret, 1);
+    ret = xpost_memory_get(&mem, ent, 0, sizeof val, &val);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (val, 42);
+
+    ret = xpost_memory_file_reset(&mem2);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (mem2.used, used);
+    ret = xpost_memory_get(&mem2, ent, 0, sizeof val, &val);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (val, 42);
+
+    ret = xpost_memory_file_exit(&mem2);
+    ck_assert_int_eq (ret, 1);
+    ret = xpost_memory_file_exit(&mem);
+    ck_assert_int_eq (ret, 1);
+
+    xpost_quit();
+}
+END_TEST
+
+START_TEST(xpost_memory_image)
+{
+    Xpost_Memory_File mem = {0};
+    Xpost_Memory_File mem2 = {0};
+    unsigned int ent;
+    unsigned int ent2;
+    unsigned int val;
+    int fd;
+    int ret;
+
+    xpost_init();
+
+    fd = _xpost_test_memory_fixture(&mem, 0, &ent);
+    ck_assert(fd != -1);
+
+    ret = xpost_memory_file_save_image(&mem, fd);
+    ck_assert_int_eq (ret, 1);
+
+    ret = xpost_memory_file_init(&mem2, NULL, -1, NULL);
+    ck_assert_int_eq (ret, 1);
+    ret = xpost_memory_table_init(&mem2);
+    ck_assert_int_eq (ret, 1);
+    ck_assert(lseek(fd, 0, SEEK_SET) == 0);
+    ret = xpost_memory_file_load_image(&mem2, fd);
+    ck_assert_int_eq (ret, 1);
+    close(fd);
+    ck_assert_int_eq (mem2.image, 1);
+    ck_assert_int_eq (mem2.used, mem.used);
+    ck_assert_int_eq (mem2.table.nextent, mem.table.nextent);
+    ret = xpost_memory_get(&mem2, ent, 0, sizeof val, &val);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (val, 42);
+
+    /* growing copies the image out of the mapping */
+    ret = xpost_memory_table_alloc(&mem2, 4 * mem2.max, 0, &ent2);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (mem2.image, 0);
+    ret = xpost_memory_get(&mem2, ent, 0, sizeof val, &val);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (val, 42);
+
+    ret = xpost_memory_file_exit(&mem2);
+    ck_assert_int_eq (ret, 1);
+    ret = xpost_memory_file_exit(&mem);
+    ck_assert_int_eq (ret, 1);
+
+    xpost_quit();
+}
+END_TEST
+#endif
+
 void xpost_test_memory(TCase *tc)
 {
     tcase_add_test(tc, xpost_memory_init_simple);
@@ -195,4 +494,11 @@ void xpost_test_memory(TCase *tc)
     tcase_add_test(tc, xpost_memory_grow);
     tcase_add_test(tc, xpost_memory_tab_init);
     tcase_add_test(tc, xpost_memory_tab_alloc);
+    tcase_add_test(tc, xpost_memory_tab_grow);
+#if defined(HAVE_MMAP) && !defined(_WIN32)
+    tcase_add_test(tc, xpost_memory_freeze_reset);
+    tcase_add_test(tc, xpost_memory_freeze_reset_freed);
+    tcase_add_test(tc, xpost_memory_clone);
+    tcase_add_test(tc, xpost_memory_image);
+#endif
 }
@@ -54,7 +54,7 @@ START_TEST(xpost_stack)
     xpost_init();
 
     memset(&mem, 0, sizeof(Xpost_Memory_File));
-    ret = xpost_memory_file_init(&mem, NULL, -1, NULL, NULL, NULL);
+    ret = xpost_memory_file_init(&mem, NULL, -1, NULL);
     ck_assert_int_eq (ret, 1);
     ck_assert(mem.base != NULL);
 
@@ -81,7 +81,7 @@ START_TEST(xpost_stack_push_pop)
     xpost_init();
 
     memset(&mem, 0, sizeof(Xpost_Memory_File));
-    ret = xpost_memory_file_init(&mem, NULL, -1, NULL, NULL, NULL);
+    ret = xpost_memory_file_init(&mem, NULL, -1, NULL);
     ck_assert_int_eq (ret, 1);
     ck_assert(mem.base != NULL);
 